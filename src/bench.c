@@ -0,0 +1,1013 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * Loopback Benchmark
+ * @author Mark Jannenga
+ *
+ * This program measures the server and client over loopback. For every
+ * combination of file size, window size, payload size and loss rate swept, it
+ * starts a server, runs a client against it, and prints one line of JSON with
+ * the throughput, time to first byte, CPU time per GB and retransmit ratio of
+ * the transfer. Loss is injected by an impairment relay (see impair.h) run in
+ * a thread between the client and the server, which drops datagrams in both
+ * directions with a seeded generator, and may impair them in other ways too.
+ * The results may be compared to a baseline written by an earlier run, so a
+ * change that makes the transfer slower, or costlier, shows up.
+ ******************************************************************************/
+
+#include "rudp_packet.h"
+#include "impair.h"
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/un.h>
+
+#define MAX_SWEEP 16            /*Most values of each setting swept*/
+#define MAX_RUNS 16             /*Most runs of each combination*/
+#define MAX_BASELINE 1024       /*Most results read from a baseline*/
+#define RUN_TIMEOUT 600         /*Seconds a transfer may take*/
+#define START_WAIT 5000000      /*Time for the server to start (us)*/
+#define CLOSE_WAIT 2000000      /*Time for the server to close a session (us)*/
+#define POLL_WAIT 10000         /*Time between checks on a process (us)*/
+#define STATS_REPLY 65536       /*Room for the reply of the stats socket*/
+#define NAME_LEN 64             /*Room for the name of a file sent*/
+#define MARK_STRIDE 1073741824ULL /*Bytes between the marks of a file sent*/
+
+#define DEFAULT_SIZES "1K,1M,64M"       /*File sizes swept by default*/
+#define DEFAULT_WINDOWS "256,4096"      /*Window sizes swept by default*/
+#define DEFAULT_PAYLOADS "0,1444"       /*Payload sizes swept by default*/
+#define DEFAULT_LOSSES "0,1"            /*Loss rates (%) swept by default*/
+#define DEFAULT_RUNS 3                  /*Runs of each combination by default*/
+#define DEFAULT_TOLERANCE 25            /*Change from the baseline allowed (%)*/
+#define COMPARE_SIZE 16777216           /*Smallest transfer compared to the
+                                         *baseline. Shorter ones mostly time
+                                         *starting the server and client*/
+
+/*Names of the server and client programs, found next to this program*/
+#ifndef BENCH_SERVER
+#define BENCH_SERVER "server"
+#endif
+#ifndef BENCH_CLIENT
+#define BENCH_CLIENT "client"
+#endif
+
+/*Custom struct for the settings of one benchmark combination*/
+struct config_t{
+    u_int64_t size;                 //Size of the file sent
+    u_int32_t window;               //Packets in the window of the server
+    u_int32_t payload;              //File data per packet, or 0 for the
+                                    //most the path MTU allows
+    double loss;                    //Datagrams dropped by the relay (%)
+};
+
+/*Custom struct for what was measured of a combination. With several runs,
+ * each number is the median of the runs*/
+struct result_t{
+    struct config_t config;         //The settings measured
+    u_int32_t payload;              //File data per packet actually used
+    int runs;                       //Runs that succeeded
+    double mb_s;                    //File data delivered (MB/s)
+    double ttfb_ms;                 //Time to the first byte of data (ms)
+    double server_cpu_s;            //CPU time of the server (s)
+    double client_cpu_s;            //CPU time of the client (s)
+    double cpu_s_per_gb;            //CPU time of both per GB delivered (s)
+    double retransmit_ratio;        //Data packets resent per packet sent
+};
+
+/*Custom struct for the settings of the whole benchmark*/
+struct bench_t{
+    char server[MAX_LINE * 2];      //Path of the server program
+    char client[MAX_LINE * 2];      //Path of the client program
+    char dir[MAX_LINE];             //Directory holding the files sent
+    int runs;                       //Runs of each combination
+    double tolerance;               //Change from the baseline allowed (%)
+    impair_opts_t impair;           //Impairments of every run, besides loss
+    bool impaired;                  //Whether impairments were given
+    const char *fec;                //Parity the server sends, as given to
+                                    //its -f option, or NULL
+};
+
+/*Typedefs*/
+typedef struct config_t config_t;
+typedef struct result_t result_t;
+typedef struct bench_t bench_t;
+
+/*Function prototypes*/
+int parse_list(const char * list, double * values, bool sizes);
+bool run_config(bench_t * bench, const config_t * config, result_t * result);
+bool run_once(bench_t * bench, const config_t * config, double * sample);
+void print_result(const result_t * result);
+void remove_file(bench_t * bench, const char * name);
+int load_baseline(const char * path, result_t * baseline, int max);
+bool check_baseline(const result_t * result, const result_t * baseline,
+                    int count, double tolerance);
+
+/*******************************************************************************
+ * Benchmark main method. The file sizes (-s, with K, M or G suffixes), window
+ * sizes (-w), payload sizes (-p, 0 meaning the most the path allows) and loss
+ * rates (-l, in percent) to sweep are each given as a comma separated list.
+ * Each combination is run a number of times (-n) and the median of the runs
+ * is printed. With -b, each result is compared to the one for the same
+ * combination in a baseline file, which is any earlier output of this
+ * program, and the program fails if throughput fell, or CPU time per GB rose,
+ * by more than the tolerance (-t, in percent) in any transfer of at least
+ * COMPARE_SIZE. Every run may also be impaired in other ways with -i, given
+ * as by the -i option of rudp_proxy, though the loss rate is always the one
+ * swept. With -f, the server sends parity of the given code, as with its
+ * own -f option. The server and client are found next to this program unless
+ * given with -S and -C, and the files sent are made, sparse, in a new
+ * directory under /tmp unless one is given with -d. A run also fails if the
+ * client's copy of the file does not have the marks of the file in place.
+ *
+ * @param argc
+ * @param argv - [-s Sizes] [-w Windows] [-p Payloads] [-l Loss rates (%)]
+ *               [-n Runs] [-b Baseline] [-t Tolerance (%)] [-i Impairments]
+ *               [-f FEC[:Block]] [-S Server] [-C Client] [-d Directory]
+ * @return
+ ******************************************************************************/
+int main(int argc, char **argv){
+    const char * sizes = DEFAULT_SIZES, * windows = DEFAULT_WINDOWS;
+    const char * payloads = DEFAULT_PAYLOADS, * losses = DEFAULT_LOSSES;
+    const char * baseline_path = NULL;
+    double size_list[MAX_SWEEP], window_list[MAX_SWEEP];
+    double payload_list[MAX_SWEEP], loss_list[MAX_SWEEP];
+    int size_count, window_count, payload_count, loss_count, baseline_count = 0;
+    int opt, s, w, p, l, failed = 0;
+    char self[MAX_LINE], * slash;
+    bool made_dir = FALSE;
+    ssize_t len;
+    bench_t bench;
+    config_t config;
+    result_t result, * baseline = NULL;
+
+    memset(&bench, 0, sizeof(bench_t));
+    bench.runs = DEFAULT_RUNS;
+    init_impair_opts(&bench.impair);
+    bench.tolerance = DEFAULT_TOLERANCE;
+
+    /*The server and client are looked for next to this program*/
+    len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    self[len > 0 ? len : 0] = '\0';
+    slash = strrchr(self, '/');
+    if(slash != NULL){
+        *slash = '\0';
+    }
+    else {
+        strcpy(self, ".");
+    }
+    snprintf(bench.server, sizeof(bench.server), "%s/%s", self, BENCH_SERVER);
+    snprintf(bench.client, sizeof(bench.client), "%s/%s", self, BENCH_CLIENT);
+
+    /*Check command line options*/
+    while((opt = getopt(argc, argv, "s:w:p:l:n:b:t:i:f:S:C:d:")) != -1){
+        switch(opt){
+            case 's':
+                sizes = optarg;
+                break;
+            case 'w':
+                windows = optarg;
+                break;
+            case 'p':
+                payloads = optarg;
+                break;
+            case 'l':
+                losses = optarg;
+                break;
+            case 'n':
+                bench.runs = atoi(optarg);
+                if(bench.runs < 1 || bench.runs > MAX_RUNS){
+                    fprintf(stderr, "Runs must be 1 to %d\n", MAX_RUNS);
+                    exit(1);
+                }
+                break;
+            case 'b':
+                baseline_path = optarg;
+                break;
+            case 't':
+                bench.tolerance = atof(optarg);
+                break;
+            case 'i':
+                if(!parse_impair(&bench.impair, optarg)){
+                    fprintf(stderr, "Bad impairments %s\n", optarg);
+                    exit(1);
+                }
+                bench.impaired = TRUE;
+                break;
+            case 'f':
+                bench.fec = optarg;
+                break;
+            case 'S':
+                snprintf(bench.server, sizeof(bench.server), "%s", optarg);
+                break;
+            case 'C':
+                snprintf(bench.client, sizeof(bench.client), "%s", optarg);
+                break;
+            case 'd':
+                snprintf(bench.dir, sizeof(bench.dir), "%s", optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-s Sizes] [-w Windows] "
+                        "[-p Payloads] [-l Loss rates (%%)] [-n Runs] "
+                        "[-b Baseline] [-t Tolerance (%%)] [-i Impairments] "
+                        "[-f xor|rs[:Block]] [-S Server] [-C Client] "
+                        "[-d Directory]\n", argv[0]);
+                exit(1);
+        }
+    }
+
+    /*Check the lists to sweep*/
+    size_count = parse_list(sizes, size_list, TRUE);
+    window_count = parse_list(windows, window_list, FALSE);
+    payload_count = parse_list(payloads, payload_list, FALSE);
+    loss_count = parse_list(losses, loss_list, FALSE);
+    if(size_count <= 0 || window_count <= 0 || payload_count <= 0 ||
+            loss_count <= 0){
+        fprintf(stderr, "Each list must hold 1 to %d numbers\n", MAX_SWEEP);
+        exit(1);
+    }
+    for(p = 0; p < payload_count; p++){
+        if(payload_list[p] != 0 && (payload_list[p] < 576 - UDP_OVERHEAD -
+                                    RUDP_HEAD ||
+                                    payload_list[p] > MAX_PAYLOAD)){
+            fprintf(stderr, "Payloads must be 0 or %d to %d bytes\n",
+                    576 - UDP_OVERHEAD - RUDP_HEAD, MAX_PAYLOAD);
+            exit(1);
+        }
+    }
+    for(l = 0; l < loss_count; l++){
+        if(loss_list[l] < 0 || loss_list[l] >= 100){
+            fprintf(stderr, "Loss rates must be 0 to 100%%\n");
+            exit(1);
+        }
+    }
+    if(access(bench.server, X_OK) != 0 || access(bench.client, X_OK) != 0){
+        fprintf(stderr, "Could not find the server %s and client %s\n",
+                bench.server, bench.client);
+        exit(1);
+    }
+
+    /*Read the baseline to compare to*/
+    if(baseline_path != NULL){
+        baseline = calloc(MAX_BASELINE, sizeof(result_t));
+        if(baseline == NULL){
+            fprintf(stderr, "Could not allocate baseline\n");
+            exit(1);
+        }
+        baseline_count = load_baseline(baseline_path, baseline, MAX_BASELINE);
+        if(baseline_count < 0){
+            fprintf(stderr, "Could not read baseline %s\n", baseline_path);
+            exit(1);
+        }
+    }
+
+    /*Make the directory the server sends files from*/
+    if(bench.dir[0] == '\0'){
+        strcpy(bench.dir, "/tmp/rudp_bench.XXXXXX");
+        if(mkdtemp(bench.dir) == NULL){
+            fprintf(stderr, "Could not make a directory for the files\n");
+            exit(1);
+        }
+        made_dir = TRUE;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    /*Run every combination, the fastest changing setting last*/
+    for(s = 0; s < size_count; s++){
+        for(w = 0; w < window_count; w++){
+            for(p = 0; p < payload_count; p++){
+                for(l = 0; l < loss_count; l++){
+                    config.size = (u_int64_t) size_list[s];
+                    config.window = (u_int32_t) window_list[w];
+                    config.payload = (u_int32_t) payload_list[p];
+                    config.loss = loss_list[l];
+                    if(!run_config(&bench, &config, &result)){
+                        failed++;
+                        continue;
+                    }
+                    print_result(&result);
+                    if(baseline != NULL &&
+                            !check_baseline(&result, baseline, baseline_count,
+                                            bench.tolerance)){
+                        failed++;
+                    }
+                }
+            }
+        }
+    }
+
+    /*Clean up, keeping the logs of a failed run*/
+    free(baseline);
+    if(failed > 0){
+        fprintf(stderr, "%d combinations failed or regressed\n", failed);
+        return 1;
+    }
+    if(made_dir){
+        remove_file(&bench, "server.log");
+        remove_file(&bench, "client.json");
+        rmdir(bench.dir);
+    }
+    return 0;
+}
+
+/*******************************************************************************
+ * Reads a comma separated list of numbers (list) into values, which holds
+ * MAX_SWEEP. Sizes (sizes) may end in K, M or G, for powers of 1024. Returns
+ * the number of values, or -1 if the list is malformed or too long.
+ *
+ * @param list - The list
+ * @param values - The numbers read
+ * @param sizes - Whether the numbers may have a size suffix
+ * @return count - The number of values, or -1
+ ******************************************************************************/
+int parse_list(const char * list, double * values, bool sizes){
+    const char * pos = list;
+    char * end;
+    int count = 0;
+
+    while(*pos != '\0'){
+        if(count == MAX_SWEEP){
+            return -1;
+        }
+        values[count] = strtod(pos, &end);
+        if(end == pos || values[count] < 0){
+            return -1;
+        }
+        if(sizes && (*end == 'K' || *end == 'k')){
+            values[count] *= 1024;
+            end++;
+        }
+        else if(sizes && (*end == 'M' || *end == 'm')){
+            values[count] *= 1024 * 1024;
+            end++;
+        }
+        else if(sizes && (*end == 'G' || *end == 'g')){
+            values[count] *= 1024.0 * 1024 * 1024;
+            end++;
+        }
+        count++;
+        if(*end == ','){
+            end++;
+        }
+        else if(*end != '\0'){
+            return -1;
+        }
+        pos = end;
+    }
+    return count;
+}
+
+/*******************************************************************************
+ * Returns a UDP port of loopback that nothing is bound to now
+ *
+ * @return port - The port
+ ******************************************************************************/
+static int free_port(void){
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0), port = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(sockfd >= 0 &&
+            bind(sockfd, (struct sockaddr *) &addr, sizeof(addr)) == 0 &&
+            getsockname(sockfd, (struct sockaddr *) &addr, &addr_len) == 0){
+        port = ntohs(addr.sin_port);
+    }
+    close(sockfd);
+    return port;
+}
+
+/*******************************************************************************
+ * Starts a program (args) in a directory (dir) with its stdout and stderr
+ * written to a file (out). Returns the process id, or -1.
+ *
+ * @param args - The program and its arguments, ending in NULL
+ * @param dir - The directory to run it in
+ * @param out - The file to write its output to
+ * @return pid - The process id, or -1
+ ******************************************************************************/
+static pid_t spawn(char * const args[], const char * dir, const char * out){
+    pid_t pid = fork();
+    int fd;
+
+    if(pid != 0){
+        return pid;
+    }
+    fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(chdir(dir) != 0 || fd < 0){
+        _exit(127);
+    }
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+    execv(args[0], args);
+    _exit(127);
+}
+
+/*******************************************************************************
+ * Waits up to a given time (timeout) for a process (pid) to end, killing it
+ * if it has not. Returns its status, with the CPU time it used in usage.
+ *
+ * @param pid - The process
+ * @param timeout - How long to wait (us)
+ * @param usage - The resources the process used
+ * @return status - The status of the process, as from wait
+ ******************************************************************************/
+static int wait_for(pid_t pid, u_int64_t timeout, struct rusage * usage){
+    u_int64_t deadline = get_time_us() + timeout;
+    int status = 0;
+
+    while(wait4(pid, &status, WNOHANG, usage) == 0){
+        if(get_time_us() > deadline){
+            kill(pid, SIGKILL);
+            wait4(pid, &status, 0, usage);
+            break;
+        }
+        usleep(POLL_WAIT);
+    }
+    return status;
+}
+
+/*******************************************************************************
+ * Asks the stats socket of a server (path) for its counts and returns them in
+ * buf, of len bytes. Returns FALSE if the server could not be reached.
+ *
+ * @param path - The path of the stats socket
+ * @param buf - The buffer for the counts, as JSON
+ * @param len - The size of the buffer
+ * @return TRUE or FALSE - Whether or not the counts were read
+ ******************************************************************************/
+static bool read_stats(const char * path, char * buf, size_t len){
+    struct sockaddr_un addr;
+    size_t total = 0;
+    ssize_t n;
+    int sockfd;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(sockfd < 0 || connect(sockfd, (struct sockaddr *) &addr,
+                             sizeof(addr)) < 0){
+        close(sockfd);
+        return FALSE;
+    }
+    while(total < len - 1 &&
+            (n = recv(sockfd, buf + total, len - 1 - total, 0)) > 0){
+        total += (size_t) n;
+    }
+    buf[total] = '\0';
+    close(sockfd);
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Finds the number named key in a line of JSON (json), after a given member
+ * (after) if that is not NULL, and returns it in value. Returns FALSE if the
+ * number is not there.
+ *
+ * @param json - The JSON
+ * @param after - A member the number follows, or NULL
+ * @param key - The name of the number
+ * @param value - The number
+ * @return TRUE or FALSE - Whether or not the number was found
+ ******************************************************************************/
+static bool json_number(const char * json, const char * after,
+                        const char * key, double * value){
+    char name[MAX_LINE];
+    const char * pos = json;
+    char * end;
+
+    if(after != NULL){
+        snprintf(name, sizeof(name), "\"%s\":", after);
+        pos = strstr(pos, name);
+        if(pos == NULL){
+            return FALSE;
+        }
+    }
+    snprintf(name, sizeof(name), "\"%s\":", key);
+    pos = strstr(pos, name);
+    if(pos == NULL){
+        return FALSE;
+    }
+    pos += strlen(name);
+    *value = strtod(pos, &end);
+    return end != pos ? TRUE : FALSE;
+}
+
+/*******************************************************************************
+ * Writes, or with check compares, a mark at a given offset (offset) of a file
+ * (fd). The mark is the offset itself, as 8 bytes in network byte order.
+ * Returns FALSE if the mark could not be written or does not match.
+ *
+ * @param fd - The file
+ * @param offset - The offset of the mark
+ * @param check - Whether to compare the mark rather than write it
+ * @return TRUE or FALSE - Whether or not the mark is in place
+ ******************************************************************************/
+static bool mark_at(int fd, u_int64_t offset, bool check){
+    u_int64_t mark = htobe64(offset), found = 0;
+
+    if(!check){
+        return pwrite(fd, &mark, sizeof(mark), (off_t) offset) ==
+               (ssize_t) sizeof(mark) ? TRUE : FALSE;
+    }
+    return pread(fd, &found, sizeof(found), (off_t) offset) ==
+           (ssize_t) sizeof(found) && found == mark ? TRUE : FALSE;
+}
+
+/*******************************************************************************
+ * Writes, or with check compares, the marks of a file (fd) of a given size
+ * (size): at its start and end, and on both sides of every multiple of
+ * MARK_STRIDE. A packet written at the wrong offset, such as one past 2 or 4
+ * GB whose offset overflowed, leaves a mark missing, although the rest of the
+ * file is zeros. Returns FALSE if any mark is not in place.
+ *
+ * @param fd - The file
+ * @param size - The size of the file
+ * @param check - Whether to compare the marks rather than write them
+ * @return TRUE or FALSE - Whether or not every mark is in place
+ ******************************************************************************/
+static bool mark_file(int fd, u_int64_t size, bool check){
+    u_int64_t at;
+
+    if(size < sizeof(u_int64_t)){
+        return TRUE;
+    }
+    for(at = 0; at < size; at += MARK_STRIDE){
+        if(at > 0 && !mark_at(fd, at - sizeof(u_int64_t), check)){
+            return FALSE;
+        }
+        if(at <= size - sizeof(u_int64_t) && !mark_at(fd, at, check)){
+            return FALSE;
+        }
+    }
+    return mark_at(fd, size - sizeof(u_int64_t), check);
+}
+
+/*******************************************************************************
+ * Makes a sparse file of a given size (size) named for its size in the
+ * benchmark directory, if it is not there already, and writes its name into
+ * name, of len bytes. The file is zeros but for its marks (see mark_file).
+ * Returns FALSE if the file could not be made.
+ *
+ * @param bench - The benchmark
+ * @param size - The size of the file
+ * @param name - The name of the file
+ * @param len - The size of name
+ * @return TRUE or FALSE - Whether or not the file is ready
+ ******************************************************************************/
+static bool make_file(bench_t * bench, u_int64_t size, char * name,
+                      size_t len){
+    char path[MAX_LINE * 2];
+    int fd;
+
+    snprintf(name, len, "bench_%llu.bin", (unsigned long long) size);
+    snprintf(path, sizeof(path), "%s/%s", bench->dir, name);
+    fd = open(path, O_WRONLY | O_CREAT, 0644);
+    if(fd < 0 || ftruncate(fd, (off_t) size) != 0 ||
+            !mark_file(fd, size, FALSE)){
+        close(fd);
+        return FALSE;
+    }
+    close(fd);
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Returns TRUE if a copy (name) in the benchmark directory of a file made by
+ * make_file of a given size (size) has every mark where it belongs, else
+ * FALSE
+ *
+ * @param bench - The benchmark
+ * @param name - The name of the copy
+ * @param size - The size of the file
+ * @return TRUE or FALSE - Whether or not the marks are in place
+ ******************************************************************************/
+static bool check_file(bench_t * bench, const char * name, u_int64_t size){
+    char path[MAX_LINE * 2];
+    bool ok;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s", bench->dir, name);
+    fd = open(path, O_RDONLY);
+    if(fd < 0){
+        return FALSE;
+    }
+    ok = mark_file(fd, size, TRUE);
+    close(fd);
+    return ok;
+}
+
+/*******************************************************************************
+ * Removes a file (name) from the benchmark directory
+ *
+ * @param bench - The benchmark
+ * @param name - The name of the file
+ ******************************************************************************/
+void remove_file(bench_t * bench, const char * name){
+    char path[MAX_LINE * 2];
+
+    snprintf(path, sizeof(path), "%s/%s", bench->dir, name);
+    unlink(path);
+}
+
+/*******************************************************************************
+ * Reads a file (name) of the benchmark directory into buf, of len bytes,
+ * keeping only its last line. Returns FALSE if it could not be read.
+ *
+ * @param bench - The benchmark
+ * @param name - The name of the file
+ * @param buf - The last line of the file
+ * @param len - The size of the buffer
+ * @return TRUE or FALSE - Whether or not a line was read
+ ******************************************************************************/
+static bool read_last_line(bench_t * bench, const char * name, char * buf,
+                           size_t len){
+    char path[MAX_LINE * 2];
+    bool found = FALSE;
+    FILE * fd;
+
+    snprintf(path, sizeof(path), "%s/%s", bench->dir, name);
+    fd = fopen(path, "r");
+    if(fd == NULL){
+        return FALSE;
+    }
+    while(fgets(buf, (int) len, fd) != NULL){
+        found = TRUE;
+    }
+    fclose(fd);
+    return found;
+}
+
+/*Indexes of the numbers measured by one run*/
+#define SAMPLE_MB_S 0
+#define SAMPLE_TTFB 1
+#define SAMPLE_SERVER_CPU 2
+#define SAMPLE_CLIENT_CPU 3
+#define SAMPLE_RETRANSMIT 4
+#define SAMPLE_BYTES 5
+#define SAMPLES 6
+
+/*******************************************************************************
+ * Runs one transfer of a combination of settings (config): starts a server,
+ * and a relay if datagrams are to be impaired, runs the client to the end, and
+ * then stops the server. Returns the numbers measured in sample, indexed by
+ * the SAMPLE_ constants, or FALSE if the transfer failed.
+ *
+ * @param bench - The benchmark
+ * @param config - The settings
+ * @param sample - The numbers measured
+ * @return TRUE or FALSE - Whether or not the transfer succeeded
+ ******************************************************************************/
+bool run_once(bench_t * bench, const config_t * config, double * sample){
+    char name[NAME_LEN], out[NAME_LEN + 8], line[STATS_REPLY];
+    char stats_path[MAX_LINE * 2], log_path[MAX_LINE * 2];
+    char json_path[MAX_LINE * 2], window[32], mtu[32], port[32], target[32];
+    char * server_args[16], * client_args[8];
+    struct rusage server_usage, client_usage;
+    double duration, first_byte, bytes, sent, retransmits, served = 0;
+    u_int64_t deadline;
+    pid_t server, client;
+    struct sockaddr_in addr;
+    impair_opts_t opts = bench->impair;
+    impair_t relay;
+    bool ok = FALSE, relayed = config->loss > 0 || bench->impaired ?
+                                    TRUE : FALSE;
+    int status, i = 0, server_port, client_port;
+
+    if(!make_file(bench, config->size, name, sizeof(name))){
+        fprintf(stderr, "Could not make a %llu byte file\n",
+                (unsigned long long) config->size);
+        return FALSE;
+    }
+    snprintf(out, sizeof(out), "%s.out", name);
+    snprintf(stats_path, sizeof(stats_path), "%s/stats.sock", bench->dir);
+    snprintf(log_path, sizeof(log_path), "%s/server.log", bench->dir);
+    snprintf(json_path, sizeof(json_path), "%s/client.json", bench->dir);
+
+    /*Start the server and wait until its stats socket answers*/
+    server_port = free_port();
+    snprintf(window, sizeof(window), "%u", config->window);
+    snprintf(mtu, sizeof(mtu), "%u",
+             config->payload + RUDP_HEAD + UDP_OVERHEAD);
+    snprintf(port, sizeof(port), "%d", server_port);
+    server_args[i++] = bench->server;
+    server_args[i++] = "-w";
+    server_args[i++] = window;
+    server_args[i++] = "-l";
+    server_args[i++] = "warn";
+    server_args[i++] = "-s";
+    server_args[i++] = stats_path;
+    if(config->payload != 0){
+        server_args[i++] = "-m";
+        server_args[i++] = mtu;
+    }
+    if(bench->fec != NULL){
+        server_args[i++] = "-f";
+        server_args[i++] = (char *) bench->fec;
+    }
+    server_args[i++] = port;
+    server_args[i] = NULL;
+    unlink(stats_path);
+    server = spawn(server_args, bench->dir, log_path);
+    if(server < 0){
+        return FALSE;
+    }
+    deadline = get_time_us() + START_WAIT;
+    while(!read_stats(stats_path, line, sizeof(line)) &&
+            get_time_us() < deadline){
+        usleep(POLL_WAIT);
+    }
+
+    /*Put the relay between the client and the server*/
+    client_port = server_port;
+    if(relayed){
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons((uint16_t) server_port);
+        opts.loss = config->loss / 100;
+        client_port = init_impair(&relay, &opts, 0, &addr);
+        if(client_port == 0 || !start_impair(&relay)){
+            fprintf(stderr, "Could not start the relay\n");
+            free_impair(&relay);
+            kill(server, SIGKILL);
+            waitpid(server, &status, 0);
+            return FALSE;
+        }
+    }
+
+    /*Run the client to the end. It fails if the file digest is wrong*/
+    snprintf(target, sizeof(target), "%d", client_port);
+    client_args[0] = bench->client;
+    client_args[1] = target;
+    client_args[2] = "127.0.0.1";
+    client_args[3] = name;
+    client_args[4] = NULL;
+    client = spawn(client_args, bench->dir, json_path);
+    if(client > 0){
+        status = wait_for(client, (u_int64_t) RUN_TIMEOUT * 1000000,
+                          &client_usage);
+        ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 ? TRUE : FALSE;
+    }
+
+    /*The client prints its counts as the last line of its output, and the
+     * server closes the session soon after*/
+    if(ok && (!read_last_line(bench, "client.json", line, sizeof(line)) ||
+              !json_number(line, NULL, "duration_s", &duration) ||
+              !json_number(line, NULL, "first_byte_s", &first_byte) ||
+              !json_number(line, NULL, "bytes", &bytes) ||
+              bytes != (double) config->size)){
+        ok = FALSE;
+    }
+
+    /*The digest only covers the packets as they arrived, so check that
+     * they were also written where they belong*/
+    if(ok && !check_file(bench, out, config->size)){
+        fprintf(stderr, "%s was written at the wrong offsets\n", out);
+        ok = FALSE;
+    }
+    deadline = get_time_us() + CLOSE_WAIT;
+    while(ok && served < 1 && get_time_us() < deadline){
+        if(!read_stats(stats_path, line, sizeof(line)) ||
+                !json_number(line, NULL, "served", &served)){
+            usleep(POLL_WAIT);
+            continue;
+        }
+        if(served < 1){
+            usleep(POLL_WAIT);
+        }
+    }
+    if(ok && (served < 1 ||
+              !json_number(line, "closed", "packets_sent", &sent) ||
+              !json_number(line, "closed", "retransmits", &retransmits))){
+        ok = FALSE;
+    }
+
+    /*Stop the relay and the server*/
+    if(relayed){
+        stop_impair(&relay);
+        free_impair(&relay);
+    }
+    kill(server, SIGTERM);
+    wait_for(server, CLOSE_WAIT, &server_usage);
+    remove_file(bench, out);
+    unlink(stats_path);
+    if(!ok){
+        fprintf(stderr, "Transfer of %llu bytes failed, see %s\n",
+                (unsigned long long) config->size, log_path);
+        return FALSE;
+    }
+
+    sample[SAMPLE_MB_S] = duration > 0 ? bytes / duration / 1e6 : 0;
+    sample[SAMPLE_TTFB] = first_byte * 1e3;
+    sample[SAMPLE_SERVER_CPU] =
+            server_usage.ru_utime.tv_sec + server_usage.ru_stime.tv_sec +
+            (server_usage.ru_utime.tv_usec +
+             server_usage.ru_stime.tv_usec) / 1e6;
+    sample[SAMPLE_CLIENT_CPU] =
+            client_usage.ru_utime.tv_sec + client_usage.ru_stime.tv_sec +
+            (client_usage.ru_utime.tv_usec +
+             client_usage.ru_stime.tv_usec) / 1e6;
+    sample[SAMPLE_RETRANSMIT] = sent > 0 ? retransmits / sent : 0;
+    sample[SAMPLE_BYTES] = bytes;
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Compares two numbers (a, b) for qsort
+ *
+ * @param a - The first number
+ * @param b - The second number
+ * @return order - Less than, equal to or greater than 0
+ ******************************************************************************/
+static int compare_doubles(const void * a, const void * b){
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/*******************************************************************************
+ * Returns the median of count numbers (values), reordering them
+ *
+ * @param values - The numbers
+ * @param count - The number of numbers
+ * @return median - The median
+ ******************************************************************************/
+static double median(double * values, int count){
+    qsort(values, (size_t) count, sizeof(double), compare_doubles);
+    if(count % 2 == 0){
+        return (values[count / 2 - 1] + values[count / 2]) / 2;
+    }
+    return values[count / 2];
+}
+
+/*******************************************************************************
+ * Runs a combination of settings (config) as many times as the benchmark
+ * asks and puts the median of each number measured in result. The file sent
+ * is removed afterwards. Returns FALSE if any run failed.
+ *
+ * @param bench - The benchmark
+ * @param config - The settings
+ * @param result - The numbers measured
+ * @return TRUE or FALSE - Whether or not every run succeeded
+ ******************************************************************************/
+bool run_config(bench_t * bench, const config_t * config, result_t * result){
+    double samples[SAMPLES][MAX_RUNS], sample[SAMPLES], cpu;
+    struct sockaddr_in loopback;
+    char name[NAME_LEN];
+    int run, i;
+
+    memset(result, 0, sizeof(result_t));
+    result->config = *config;
+    result->payload = config->payload;
+    if(result->payload == 0){
+        memset(&loopback, 0, sizeof(loopback));
+        loopback.sin_family = AF_INET;
+        loopback.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        result->payload = mtu_payload(path_mtu(&loopback));
+    }
+    for(run = 0; run < bench->runs; run++){
+        if(!run_once(bench, config, sample)){
+            break;
+        }
+        for(i = 0; i < SAMPLES; i++){
+            samples[i][run] = sample[i];
+        }
+    }
+    snprintf(name, sizeof(name), "bench_%llu.bin",
+             (unsigned long long) config->size);
+    remove_file(bench, name);
+    if(run < bench->runs){
+        return FALSE;
+    }
+
+    result->runs = run;
+    result->mb_s = median(samples[SAMPLE_MB_S], run);
+    result->ttfb_ms = median(samples[SAMPLE_TTFB], run);
+    result->retransmit_ratio = median(samples[SAMPLE_RETRANSMIT], run);
+
+    /*CPU time per GB is taken from each run before the median, so a run
+     * of an unusual length does not skew it*/
+    for(i = 0; i < run; i++){
+        cpu = samples[SAMPLE_SERVER_CPU][i] + samples[SAMPLE_CLIENT_CPU][i];
+        samples[SAMPLE_BYTES][i] = cpu / (samples[SAMPLE_BYTES][i] / 1e9);
+    }
+    result->server_cpu_s = median(samples[SAMPLE_SERVER_CPU], run);
+    result->client_cpu_s = median(samples[SAMPLE_CLIENT_CPU], run);
+    result->cpu_s_per_gb = median(samples[SAMPLE_BYTES], run);
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Prints what was measured of a combination (result) as one line of JSON
+ *
+ * @param result - The numbers measured
+ ******************************************************************************/
+void print_result(const result_t * result){
+    fprintf(stdout, "{\"size\":%llu,\"window\":%u,\"payload\":%u,"
+            "\"loss\":%g,\"runs\":%d,\"mb_s\":%.3f,\"ttfb_ms\":%.3f,"
+            "\"server_cpu_s\":%.3f,\"client_cpu_s\":%.3f,"
+            "\"cpu_s_per_gb\":%.3f,\"retransmit_ratio\":%.5f}\n",
+            (unsigned long long) result->config.size, result->config.window,
+            result->payload, result->config.loss, result->runs,
+            result->mb_s, result->ttfb_ms, result->server_cpu_s,
+            result->client_cpu_s, result->cpu_s_per_gb,
+            result->retransmit_ratio);
+    fflush(stdout);
+}
+
+/*******************************************************************************
+ * Reads the results of an earlier run of the benchmark from a file (path),
+ * one line of JSON each, into baseline, which holds max results. Lines that
+ * are not results are skipped. Returns the number read, or -1 if the file
+ * could not be opened.
+ *
+ * @param path - The file
+ * @param baseline - The results read
+ * @param max - The most results to read
+ * @return count - The number of results, or -1
+ ******************************************************************************/
+int load_baseline(const char * path, result_t * baseline, int max){
+    char line[MAX_LINE];
+    double size, window, payload, loss;
+    result_t * r;
+    int count = 0;
+    FILE * fd = fopen(path, "r");
+
+    if(fd == NULL){
+        return -1;
+    }
+    while(count < max && fgets(line, sizeof(line), fd) != NULL){
+        r = &baseline[count];
+        if(!json_number(line, NULL, "size", &size) ||
+                !json_number(line, NULL, "window", &window) ||
+                !json_number(line, NULL, "payload", &payload) ||
+                !json_number(line, NULL, "loss", &loss) ||
+                !json_number(line, NULL, "mb_s", &r->mb_s) ||
+                !json_number(line, NULL, "cpu_s_per_gb", &r->cpu_s_per_gb)){
+            continue;
+        }
+        r->config.size = (u_int64_t) size;
+        r->config.window = (u_int32_t) window;
+        r->payload = (u_int32_t) payload;
+        r->config.loss = loss;
+        count++;
+    }
+    fclose(fd);
+    return count;
+}
+
+/*******************************************************************************
+ * Compares a result (result) to the result of the same combination in a
+ * baseline (baseline) of count results. Prints a warning and returns FALSE if
+ * throughput fell, or CPU time per GB rose, by more than tolerance percent.
+ * Combinations missing from the baseline, and transfers under COMPARE_SIZE,
+ * pass.
+ *
+ * @param result - The result
+ * @param baseline - The results to compare to
+ * @param count - The number of results in the baseline
+ * @param tolerance - The change allowed (%)
+ * @return TRUE or FALSE - Whether or not the result is as good
+ ******************************************************************************/
+bool check_baseline(const result_t * result, const result_t * baseline,
+                    int count, double tolerance){
+    const result_t * b;
+    bool ok = TRUE;
+    int i;
+
+    if(result->config.size < COMPARE_SIZE){
+        return TRUE;
+    }
+    for(i = 0; i < count; i++){
+        b = &baseline[i];
+        if(b->config.size != result->config.size ||
+                b->config.window != result->config.window ||
+                b->payload != result->payload ||
+                b->config.loss != result->config.loss){
+            continue;
+        }
+        if(result->mb_s < b->mb_s * (1 - tolerance / 100)){
+            fprintf(stderr, "Regression: %llu bytes, window %u, payload %u, "
+                    "loss %g%%: %.3f MB/s, baseline %.3f MB/s\n",
+                    (unsigned long long) result->config.size,
+                    result->config.window, result->payload,
+                    result->config.loss, result->mb_s, b->mb_s);
+            ok = FALSE;
+        }
+        if(result->cpu_s_per_gb > b->cpu_s_per_gb * (1 + tolerance / 100)){
+            fprintf(stderr, "Regression: %llu bytes, window %u, payload %u, "
+                    "loss %g%%: %.3f CPU s/GB, baseline %.3f CPU s/GB\n",
+                    (unsigned long long) result->config.size,
+                    result->config.window, result->payload,
+                    result->config.loss, result->cpu_s_per_gb,
+                    b->cpu_s_per_gb);
+            ok = FALSE;
+        }
+        return ok;
+    }
+    return TRUE;
+}
@@ -36,7 +36,7 @@ node_t * remove_node(cache_list_t * cache, int seq_num){
     node_t * tmp;
     for(tmp = cache->head; tmp != NULL; tmp = tmp->next){
 
-        if(tmp->data->rudp_pkt->seq_num == seq_num) {
+        if(get_seq_num(tmp->data->rudp_pkt) == (u_int64_t) seq_num) {
             /*Case with 1 element list*/
             if(tmp == cache->head && tmp == cache->tail){
                 cache->head = NULL;
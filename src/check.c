@@ -0,0 +1,607 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * Kernel checks
+ * @author Mark Jannenga
+ *
+ * This program checks that every kernel the CPU supports computes the same
+ * result as a plain reference written for clarity rather than speed, over
+ * random data of random lengths at random alignments. The fastest kernel is
+ * picked when a program starts, so one that disagrees on some CPU would
+ * otherwise only show up as bad checksums in transfers on that CPU. CRC32Cs
+ * are also continued over pieces and combined, as the file digest is, and
+ * compared to the CRC of the whole. Parity is checked by encoding random
+ * files, losing up to as many packets of each block as the code can make up
+ * for, and rebuilding them. Each check prints one line, and the program
+ * exits with status 1 if any failed.
+ ******************************************************************************/
+
+#include "rudp_packet.h"
+#include "checksum.h"
+#include "crc32c.h"
+#include "fec.h"
+
+#define CHECK_SEED 1            /*Default seed of the random data*/
+#define CHECK_ROUNDS 2000       /*Default random cases of each check*/
+#define MAX_LEN 4096            /*Longest random length checked*/
+#define MAX_ALIGN 64            /*Alignments checked, from 0 bytes*/
+#define LONG_LEN 1200000        /*Length of the long cases, past the point
+                                 *where vector lanes are moved into the sum*/
+#define CRC_POLY 0x82F63B78     /*CRC32C polynomial, bits reversed*/
+#define CRC_CHECK 0xE3069283    /*CRC32C of "123456789"*/
+#define GF_POLY 0x1D            /*Low bits of the GF(2^8) polynomial 0x11D*/
+#define FEC_FILES 50            /*Files encoded with each code and kernel*/
+#define FEC_PAYLOAD 2048        /*Largest payload of a file encoded*/
+#define FEC_BLOCKS 3            /*Most blocks of a file encoded*/
+
+/*Function prototypes*/
+u_int64_t next_random(void);
+void fill_random(unsigned char * buf, size_t len);
+int check_checksum_kernels(unsigned char * buf, int rounds);
+int check_crc32c_kernels(unsigned char * buf, int rounds);
+int check_crc32c_combine(unsigned char * buf, int rounds);
+int check_gf_arithmetic(void);
+int check_gf_kernels(unsigned char * buf, int rounds);
+int check_fec_round_trip(unsigned char * buf);
+
+/*State of the random number generator*/
+static u_int64_t random_state;
+
+/*Kernels of each checksum*/
+static const char * inet_kernels[] = {"scalar", "sse2", "avx2"};
+static const char * crc_kernels[] = {"bytewise", "slice8", "sse4.2"};
+static const char * fec_kernels[] = {"scalar", "ssse3", "avx2"};
+
+/*******************************************************************************
+ * Kernel check main method. The random data is made from the seed given with
+ * -s, and each check runs the number of random cases given with -n.
+ *
+ * @param argc
+ * @param argv - [-s Seed] [-n Cases]
+ * @return status - 0 if every kernel agreed with its reference, else 1
+ ******************************************************************************/
+int main(int argc, char **argv){
+    u_int64_t seed = CHECK_SEED;
+    int rounds = CHECK_ROUNDS, failed = 0, opt;
+    unsigned char * buf;
+
+    /*Check command line options*/
+    while((opt = getopt(argc, argv, "s:n:")) != -1){
+        switch(opt){
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                rounds = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-s Seed] [-n Cases]\n", argv[0]);
+                exit(1);
+        }
+    }
+    if(rounds <= 0){
+        fprintf(stderr, "Cases must be above 0\n");
+        exit(1);
+    }
+    random_state = seed != 0 ? seed : CHECK_SEED;
+    buf = malloc(LONG_LEN + MAX_ALIGN);
+    if(buf == NULL){
+        fprintf(stderr, "Could not allocate %d bytes\n", LONG_LEN + MAX_ALIGN);
+        exit(1);
+    }
+
+    failed += check_checksum_kernels(buf, rounds);
+    failed += check_crc32c_kernels(buf, rounds);
+    failed += check_crc32c_combine(buf, rounds);
+    failed += check_gf_arithmetic();
+    failed += check_gf_kernels(buf, rounds);
+    failed += check_fec_round_trip(buf);
+
+    free(buf);
+    if(failed > 0){
+        fprintf(stderr, "%d checks failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
+
+/*******************************************************************************
+ * Returns the next number of the random number generator, with xorshift64*
+ *
+ * @return random - The number
+ ******************************************************************************/
+u_int64_t next_random(void){
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 0x2545F4914F6CDD1DULL;
+}
+
+/*******************************************************************************
+ * Fills a buffer (buf) of len bytes with random bytes
+ *
+ * @param buf - The buffer
+ * @param len - The number of bytes
+ ******************************************************************************/
+void fill_random(unsigned char * buf, size_t len){
+    u_int64_t word;
+    size_t i;
+
+    for(i = 0; i < len; i += sizeof(word)){
+        word = next_random();
+        memcpy(buf + i, &word, len - i < sizeof(word) ? len - i :
+                                                        sizeof(word));
+    }
+}
+
+/*******************************************************************************
+ * Picks the length (len) and alignment (align) of a case (round) of a check
+ * with a given number of random cases (rounds), and fills the case in buf.
+ * The random cases are followed by two long ones: one of 0xFF bytes, which
+ * makes the largest sums, and one of random bytes at an odd alignment.
+ *
+ * @param buf - The buffer of LONG_LEN + MAX_ALIGN bytes
+ * @param round - The case
+ * @param rounds - The number of random cases
+ * @param len - The location to store the length
+ * @param align - The location to store the alignment
+ ******************************************************************************/
+static void make_case(unsigned char * buf, int round, int rounds,
+                      size_t * len, size_t * align){
+    if(round < rounds){
+        *len = (size_t) (next_random() % (MAX_LEN + 1));
+        *align = (size_t) (next_random() % MAX_ALIGN);
+        fill_random(buf + *align, *len);
+    }
+    else if(round == rounds){
+        *len = LONG_LEN;
+        *align = 0;
+        memset(buf, 0xFF, *len);
+    }
+    else{
+        *len = LONG_LEN;
+        *align = 1;
+        fill_random(buf + *align, *len);
+    }
+}
+
+/*******************************************************************************
+ * Adds up bytes (p) as 16-bit words one at a time, padding a trailing byte
+ * with zero, and folds the carries back in, as sum_words should
+ *
+ * @param p - The bytes to add up
+ * @param len - The number of bytes
+ * @return sum - The sum, no larger than 0xFFFF
+ ******************************************************************************/
+static u_int32_t ref_sum_words(const unsigned char * p, size_t len){
+    u_int64_t sum = 0;
+    u_int16_t word;
+    size_t i;
+
+    for(i = 0; i + 1 < len; i += 2){
+        memcpy(&word, p + i, 2);
+        sum += word;
+    }
+    if(len % 2 == 1){
+        word = 0;
+        memcpy(&word, p + len - 1, 1);
+        sum += word;
+    }
+    while(sum >> 16){
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (u_int32_t) sum;
+}
+
+/*******************************************************************************
+ * Checks sum_words with every kernel the CPU supports against ref_sum_words.
+ * Returns the number of kernels that disagreed.
+ *
+ * @param buf - A buffer of LONG_LEN + MAX_ALIGN bytes
+ * @param rounds - The number of random cases
+ * @return failed - The number of kernels that disagreed
+ ******************************************************************************/
+int check_checksum_kernels(unsigned char * buf, int rounds){
+    const char * kernel = checksum_kernel();
+    u_int32_t got, want;
+    size_t len, align;
+    int k, r, bad, failed = 0;
+
+    for(k = 0; k < (int) (sizeof(inet_kernels) / sizeof(inet_kernels[0]));
+            k++){
+        if(!set_checksum_kernel(inet_kernels[k])){
+            printf("checksum/%s: not supported, skipped\n", inet_kernels[k]);
+            continue;
+        }
+        bad = 0;
+        for(r = 0; r < rounds + 2; r++){
+            make_case(buf, r, rounds, &len, &align);
+            got = sum_words(buf + align, len);
+            want = ref_sum_words(buf + align, len);
+            if(got != want && bad++ == 0){
+                printf("checksum/%s: %zu bytes at offset %zu gave 0x%04x, "
+                       "expected 0x%04x\n", inet_kernels[k], len, align, got,
+                       want);
+            }
+        }
+        printf("checksum/%s: %d of %d cases %s\n", inet_kernels[k],
+               rounds + 2 - bad, rounds + 2, bad == 0 ? "ok" : "FAILED");
+        failed += bad > 0 ? 1 : 0;
+    }
+    set_checksum_kernel(kernel);
+    return failed;
+}
+
+/*******************************************************************************
+ * Continues a CRC32C (crc) over len more bytes (p) one bit at a time, as
+ * crc32c should
+ *
+ * @param crc - The CRC of the bytes before p
+ * @param p - The bytes to add
+ * @param len - The number of bytes
+ * @return crc - The CRC including p
+ ******************************************************************************/
+static u_int32_t ref_crc32c(u_int32_t crc, const unsigned char * p,
+                            size_t len){
+    size_t i;
+    int bit;
+
+    crc = ~crc;
+    for(i = 0; i < len; i++){
+        crc ^= p[i];
+        for(bit = 0; bit < 8; bit++){
+            crc = crc & 1 ? (crc >> 1) ^ CRC_POLY : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+/*******************************************************************************
+ * Checks crc32c with every kernel the CPU supports against ref_crc32c, both
+ * over each case at once and continued from a random point of it. Returns
+ * the number of kernels that disagreed.
+ *
+ * @param buf - A buffer of LONG_LEN + MAX_ALIGN bytes
+ * @param rounds - The number of random cases
+ * @return failed - The number of kernels that disagreed
+ ******************************************************************************/
+int check_crc32c_kernels(unsigned char * buf, int rounds){
+    const char * kernel = crc32c_kernel();
+    u_int32_t got, part, want;
+    size_t len, align, split;
+    int k, r, bad, failed = 0;
+
+    /*The reference itself must give the standard check value*/
+    if(ref_crc32c(0, (const unsigned char *) "123456789", 9) != CRC_CHECK){
+        printf("crc32c/reference: wrong check value, FAILED\n");
+        return 1;
+    }
+    for(k = 0; k < (int) (sizeof(crc_kernels) / sizeof(crc_kernels[0])); k++){
+        if(!set_crc32c_kernel(crc_kernels[k])){
+            printf("crc32c/%s: not supported, skipped\n", crc_kernels[k]);
+            continue;
+        }
+        bad = 0;
+        for(r = 0; r < rounds + 2; r++){
+            make_case(buf, r, rounds, &len, &align);
+            split = len > 0 ? (size_t) (next_random() % (len + 1)) : 0;
+            want = ref_crc32c(0, buf + align, len);
+            got = crc32c(0, buf + align, len);
+            part = crc32c(crc32c(0, buf + align, split), buf + align + split,
+                          len - split);
+            if((got != want || part != want) && bad++ == 0){
+                printf("crc32c/%s: %zu bytes at offset %zu gave 0x%08x, and "
+                       "0x%08x split at %zu, expected 0x%08x\n",
+                       crc_kernels[k], len, align, got, part, split, want);
+            }
+        }
+        printf("crc32c/%s: %d of %d cases %s\n", crc_kernels[k],
+               rounds + 2 - bad, rounds + 2, bad == 0 ? "ok" : "FAILED");
+        failed += bad > 0 ? 1 : 0;
+    }
+    set_crc32c_kernel(kernel);
+    return failed;
+}
+
+/*******************************************************************************
+ * Checks that combining the CRC32Cs of two pieces of each case, with
+ * crc32c_combine and with crc32c_combine_op, gives ref_crc32c of the whole
+ * case. Returns 1 if any case disagreed, else 0.
+ *
+ * @param buf - A buffer of LONG_LEN + MAX_ALIGN bytes
+ * @param rounds - The number of random cases
+ * @return failed - 1 if the check failed, else 0
+ ******************************************************************************/
+int check_crc32c_combine(unsigned char * buf, int rounds){
+    u_int32_t first, second, got, got_op, want;
+    size_t len, align, split;
+    int r, bad = 0;
+
+    for(r = 0; r < rounds + 2; r++){
+        make_case(buf, r, rounds, &len, &align);
+        split = len > 0 ? (size_t) (next_random() % (len + 1)) : 0;
+        want = ref_crc32c(0, buf + align, len);
+        first = ref_crc32c(0, buf + align, split);
+        second = ref_crc32c(0, buf + align + split, len - split);
+        got = crc32c_combine(first, second, len - split);
+        got_op = crc32c_combine_op(first, second, crc32c_shift(len - split));
+        if((got != want || got_op != want) && bad++ == 0){
+            printf("crc32c/combine: %zu bytes split at %zu gave 0x%08x and "
+                   "0x%08x, expected 0x%08x\n", len, split, got, got_op,
+                   want);
+        }
+    }
+    printf("crc32c/combine: %d of %d cases %s\n", rounds + 2 - bad,
+           rounds + 2, bad == 0 ? "ok" : "FAILED");
+    return bad > 0 ? 1 : 0;
+}
+
+/*******************************************************************************
+ * Multiplies two elements (a and b) of GF(2^8) by shifting and adding, as
+ * gf_mul should
+ *
+ * @param a - The first element
+ * @param b - The second element
+ * @return product - The product
+ ******************************************************************************/
+static u_int8_t ref_gf_mul(u_int8_t a, u_int8_t b){
+    u_int8_t product = 0;
+
+    while(b != 0){
+        if(b & 1){
+            product ^= a;
+        }
+        a = (u_int8_t) (a & 0x80 ? (a << 1) ^ GF_POLY : a << 1);
+        b >>= 1;
+    }
+    return product;
+}
+
+/*******************************************************************************
+ * Checks gf_mul against ref_gf_mul for every pair of elements, and gf_inv
+ * for every non-zero element. Returns 1 if any disagreed, else 0.
+ *
+ * @return failed - 1 if the check failed, else 0
+ ******************************************************************************/
+int check_gf_arithmetic(void){
+    int a, b, bad = 0;
+
+    for(a = 0; a < 256; a++){
+        for(b = 0; b < 256; b++){
+            if(gf_mul((u_int8_t) a, (u_int8_t) b) !=
+                    ref_gf_mul((u_int8_t) a, (u_int8_t) b) && bad++ == 0){
+                printf("gf/mul: %d * %d gave %d, expected %d\n", a, b,
+                       gf_mul((u_int8_t) a, (u_int8_t) b),
+                       ref_gf_mul((u_int8_t) a, (u_int8_t) b));
+            }
+        }
+        if(a > 0 && ref_gf_mul((u_int8_t) a, gf_inv((u_int8_t) a)) != 1 &&
+                bad++ == 0){
+            printf("gf/inv: inverse of %d gave %d\n", a,
+                   gf_inv((u_int8_t) a));
+        }
+    }
+    printf("gf/arithmetic: %s\n", bad == 0 ? "ok" : "FAILED");
+    return bad > 0 ? 1 : 0;
+}
+
+/*******************************************************************************
+ * Checks gf_mul_add with every kernel the CPU supports against ref_gf_mul,
+ * with random constants, including 0 and 1, and the region added to at its
+ * own random alignment. Returns the number of kernels that disagreed.
+ *
+ * @param buf - A buffer of LONG_LEN + MAX_ALIGN bytes
+ * @param rounds - The number of random cases
+ * @return failed - The number of kernels that disagreed
+ ******************************************************************************/
+int check_gf_kernels(unsigned char * buf, int rounds){
+    const char * kernel = fec_kernel();
+    unsigned char * dst, * want;
+    size_t len, align, dst_align, i;
+    int k, r, bad, failed = 0;
+    u_int8_t c;
+
+    dst = malloc(LONG_LEN + MAX_ALIGN);
+    want = malloc(LONG_LEN + MAX_ALIGN);
+    if(dst == NULL || want == NULL){
+        fprintf(stderr, "Could not allocate %d bytes\n", LONG_LEN + MAX_ALIGN);
+        exit(1);
+    }
+    for(k = 0; k < (int) (sizeof(fec_kernels) / sizeof(fec_kernels[0])); k++){
+        if(!set_fec_kernel(fec_kernels[k])){
+            printf("gf_mul_add/%s: not supported, skipped\n", fec_kernels[k]);
+            continue;
+        }
+        bad = 0;
+        for(r = 0; r < rounds + 2; r++){
+            make_case(buf, r, rounds, &len, &align);
+            dst_align = r < rounds ? (size_t) (next_random() % MAX_ALIGN) : 3;
+            c = (u_int8_t) (r % 8 < 2 ? (u_int64_t) (r % 8) : next_random());
+            fill_random(dst + dst_align, len);
+            for(i = 0; i < len; i++){
+                want[i] = dst[dst_align + i] ^ ref_gf_mul(c, buf[align + i]);
+            }
+            gf_mul_add(dst + dst_align, buf + align, c, len);
+            if(memcmp(dst + dst_align, want, len) != 0 && bad++ == 0){
+                printf("gf_mul_add/%s: %zu bytes at offsets %zu and %zu "
+                       "times %d disagreed\n", fec_kernels[k], len, align,
+                       dst_align, c);
+            }
+        }
+        printf("gf_mul_add/%s: %d of %d cases %s\n", fec_kernels[k],
+               rounds + 2 - bad, rounds + 2, bad == 0 ? "ok" : "FAILED");
+        failed += bad > 0 ? 1 : 0;
+    }
+    set_fec_kernel(kernel);
+    free(dst);
+    free(want);
+    return failed;
+}
+
+/*******************************************************************************
+ * Picks which packets of a block of count data packets and parity parity
+ * packets, of a code (code), are lost, as many as the code can make up for:
+ * up to parity packets of any kind with Reed-Solomon, and up to one of the
+ * packets of each row with XOR. Packet i is lost if lost[i] is set, the data
+ * packets coming first.
+ *
+ * @param code - FEC_XOR or FEC_RS
+ * @param count - The number of data packets
+ * @param parity - The number of parity packets
+ * @param lost - The location to mark the lost packets in
+ ******************************************************************************/
+static void pick_losses(u_int32_t code, u_int32_t count, u_int32_t parity,
+                        unsigned char * lost){
+    u_int32_t losses, members, row, pick;
+
+    memset(lost, 0, count + parity);
+    if(code == FEC_RS){
+        losses = (u_int32_t) (next_random() % (parity + 1));
+        while(losses > 0){
+            pick = (u_int32_t) (next_random() % (count + parity));
+            if(!lost[pick]){
+                lost[pick] = 1;
+                losses--;
+            }
+        }
+        return;
+    }
+
+    /*Row r holds data packets r, r + parity, ... and parity packet r*/
+    for(row = 0; row < parity; row++){
+        if(next_random() % 2 == 0){
+            continue;
+        }
+        members = row < count ? (count - row + parity - 1) / parity : 0;
+        pick = (u_int32_t) (next_random() % (members + 1));
+        lost[pick < members ? row + pick * parity : count + row] = 1;
+    }
+}
+
+/*******************************************************************************
+ * Checks encode_packet, add_data_packet, add_parity_packet and
+ * rebuilt_packet together, with each code and every kernel the CPU
+ * supports. Each of FEC_FILES random files, of random payload and block
+ * sizes, is encoded with a random number of parity packets per block, and
+ * every block is received with the losses of pick_losses. Every lost data
+ * packet must be rebuilt with its exact data. Returns the number of codes and
+ * kernels that failed.
+ *
+ * @param buf - A buffer of LONG_LEN + MAX_ALIGN bytes for the files
+ * @return failed - The number of codes and kernels that failed
+ ******************************************************************************/
+int check_fec_round_trip(unsigned char * buf){
+    static const u_int32_t codes[] = {FEC_XOR, FEC_RS};
+    const char * kernel = fec_kernel();
+    unsigned char lost[FEC_MAX_DATA + FEC_MAX_PARITY];
+    unsigned char done[FEC_MAX_DATA], * parity_pkts;
+    u_int32_t payload, block, packets, count, parity, made, i, j, n;
+    u_int64_t seq, first, file_size;
+    int k, c, f, bad, failed = 0, size, total;
+    const unsigned char * got;
+    fec_encoder_t enc;
+    fec_decoder_t dec;
+    size_t len, got_len;
+
+    size = RUDP_HEAD + (int) sizeof(parity_t) + FEC_PAYLOAD;
+    parity_pkts = malloc((size_t) size * FEC_MAX_PARITY);
+    if(parity_pkts == NULL){
+        fprintf(stderr, "Could not allocate parity packets\n");
+        exit(1);
+    }
+    for(k = 0; k < (int) (sizeof(fec_kernels) / sizeof(fec_kernels[0])); k++){
+        if(!set_fec_kernel(fec_kernels[k])){
+            continue;
+        }
+        for(c = 0; c < 2; c++){
+            bad = 0;
+            total = 0;
+            for(f = 0; f < FEC_FILES; f++){
+                payload = 1 + (u_int32_t) (next_random() % FEC_PAYLOAD);
+                block = 2 + (u_int32_t) (next_random() % (FEC_MAX_DATA - 1));
+                packets = 1 + (u_int32_t) (next_random() %
+                                           (block * FEC_BLOCKS));
+                file_size = (u_int64_t) (packets - 1) * payload + 1 +
+                            next_random() % payload;
+                fill_random(buf, (size_t) file_size);
+                size = RUDP_HEAD + (int) sizeof(parity_t) + (int) payload;
+                init_fec_encoder(&enc, codes[c], block, payload);
+                init_fec_decoder(&dec, codes[c], block, payload, file_size);
+
+                /*Encode each block, then receive it with losses*/
+                for(first = 0; first < packets; first += block){
+                    count = packets - first < block ?
+                            (u_int32_t) (packets - first) : block;
+                    enc.parity = 1 + (u_int32_t) (next_random() %
+                                                  FEC_MAX_PARITY);
+                    made = 0;
+                    for(i = 0; i < count; i++){
+                        seq = first + i;
+                        len = seq == packets - 1 ?
+                              (size_t) (file_size - seq * payload) : payload;
+                        made = encode_packet(&enc, seq, buf + seq * payload,
+                                             (int) len, seq == packets - 1 ?
+                                             TRUE : FALSE);
+                    }
+                    parity = made;
+                    for(j = 0; j < parity; j++){
+                        memcpy(parity_pkts + (size_t) size * j,
+                               get_parity(&enc, j), (size_t) size);
+                    }
+                    pick_losses(codes[c], count, parity, lost);
+                    memset(done, 0, sizeof(done));
+                    for(i = 0; i < count + parity; i++){
+                        if(lost[i]){
+                            continue;
+                        }
+                        seq = first + i;
+                        if(i < count){
+                            len = seq == packets - 1 ?
+                                  (size_t) (file_size - seq * payload) :
+                                  payload;
+                            n = add_data_packet(&dec, seq,
+                                                buf + seq * payload, len);
+                        }
+                        else{
+                            n = add_parity_packet(&dec, (rudp_packet_t *)
+                                    (parity_pkts + (size_t) size *
+                                     (i - count)), size);
+                        }
+
+                        /*Each rebuilt packet must be one that was lost*/
+                        for(j = 0; j < n; j++){
+                            seq = dec.rebuilt[j];
+                            got = rebuilt_packet(&dec, seq, &got_len);
+                            len = seq == packets - 1 ?
+                                  (size_t) (file_size - seq * payload) :
+                                  payload;
+                            if(seq < first || seq - first >= count ||
+                                    !lost[seq - first] ||
+                                    done[seq - first] || got_len != len ||
+                                    memcmp(got, buf + seq * payload,
+                                           len) != 0){
+                                bad++;
+                                continue;
+                            }
+                            done[seq - first] = 1;
+                        }
+                    }
+                    for(i = 0; i < count; i++){
+                        if(lost[i]){
+                            total++;
+                            bad += done[i] ? 0 : 1;
+                        }
+                    }
+                }
+                free_fec_encoder(&enc);
+                free_fec_decoder(&dec);
+            }
+            printf("fec/%s/%s: %d lost packets, %s\n", fec_name(codes[c]),
+                   fec_kernels[k], total, bad == 0 ? "all rebuilt" :
+                   "FAILED");
+            failed += bad > 0 ? 1 : 0;
+        }
+    }
+    set_fec_kernel(kernel);
+    free(parity_pkts);
+    return failed;
+}
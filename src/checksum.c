@@ -0,0 +1,226 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * checksum.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in checksum.h
+ ******************************************************************************/
+
+#include "checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+/*Vector lanes hold 32-bit sums, and each step adds at most two 16-bit words
+ * to a lane, so they are moved into the 64-bit sum at least this often*/
+#define LANE_STEPS 16384
+
+/*A kernel adds len bytes at p to the running 64-bit sum and returns it*/
+typedef u_int64_t (*sum_kernel_t)(const unsigned char *p, size_t len,
+                                  u_int64_t sum);
+
+/*******************************************************************************
+ * Adds up bytes (p) 8 at a time into a 64-bit sum. Each 64-bit load is added
+ * as two 32-bit halves, which is the same as adding its 16-bit words once the
+ * sum is folded, whatever the byte order.
+ *
+ * @param p - The bytes to add up
+ * @param len - The number of bytes
+ * @param sum - The sum so far
+ * @return sum - The new sum
+ ******************************************************************************/
+static u_int64_t sum_scalar(const unsigned char *p, size_t len, u_int64_t sum){
+    u_int64_t word64;
+    u_int32_t word32;
+    u_int16_t word16;
+
+    while(len >= 8){
+        memcpy(&word64, p, 8);
+        sum += (word64 & 0xFFFFFFFF) + (word64 >> 32);
+        p += 8;
+        len -= 8;
+    }
+    if(len >= 4){
+        memcpy(&word32, p, 4);
+        sum += word32;
+        p += 4;
+        len -= 4;
+    }
+    if(len >= 2){
+        memcpy(&word16, p, 2);
+        sum += word16;
+        p += 2;
+        len -= 2;
+    }
+
+    /*Pad a trailing byte with zero*/
+    if(len > 0){
+        word16 = 0;
+        memcpy(&word16, p, 1);
+        sum += word16;
+    }
+    return sum;
+}
+
+#ifdef HAVE_X86
+/*******************************************************************************
+ * Adds up bytes (p) 16 at a time with SSE2. The 16-bit words are widened to
+ * 32-bit lanes and added, and the rest is left to sum_scalar.
+ *
+ * @param p - The bytes to add up
+ * @param len - The number of bytes
+ * @param sum - The sum so far
+ * @return sum - The new sum
+ ******************************************************************************/
+__attribute__((target("sse2")))
+static u_int64_t sum_sse2(const unsigned char *p, size_t len, u_int64_t sum){
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc, v;
+    u_int32_t lanes[4];
+    size_t steps;
+
+    while(len >= 16){
+        acc = zero;
+        for(steps = 0; steps < LANE_STEPS && len >= 16; steps++){
+            v = _mm_loadu_si128((const __m128i *) p);
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+            p += 16;
+            len -= 16;
+        }
+        _mm_storeu_si128((__m128i *) lanes, acc);
+        sum += (u_int64_t) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    return sum_scalar(p, len, sum);
+}
+
+/*******************************************************************************
+ * Adds up bytes (p) 32 at a time with AVX2, in the same way as sum_sse2
+ *
+ * @param p - The bytes to add up
+ * @param len - The number of bytes
+ * @param sum - The sum so far
+ * @return sum - The new sum
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static u_int64_t sum_avx2(const unsigned char *p, size_t len, u_int64_t sum){
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc, v;
+    u_int32_t lanes[8];
+    size_t steps;
+    int i;
+
+    while(len >= 32){
+        acc = zero;
+        for(steps = 0; steps < LANE_STEPS && len >= 32; steps++){
+            v = _mm256_loadu_si256((const __m256i *) p);
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+            p += 32;
+            len -= 32;
+        }
+        _mm256_storeu_si256((__m256i *) lanes, acc);
+        for(i = 0; i < 8; i++){
+            sum += lanes[i];
+        }
+    }
+    return sum_scalar(p, len, sum);
+}
+#endif
+
+/*The kernel in use, chosen before main runs*/
+static sum_kernel_t kernel = sum_scalar;
+static const char * kernel_name = "scalar";
+
+/*******************************************************************************
+ * Picks the fastest kernel the CPU supports. Runs before main, so the choice
+ * is made before any thread could use it.
+ ******************************************************************************/
+__attribute__((constructor))
+static void init_checksum(void){
+#ifdef HAVE_X86
+    __builtin_cpu_init();
+    if(!set_checksum_kernel("avx2")){
+        set_checksum_kernel("sse2");
+    }
+#endif
+}
+
+/*******************************************************************************
+ * Adds up a buffer (buf) of len bytes as 16-bit words, folding the carries
+ * into a 16-bit result. A trailing odd byte is added as if followed by a zero
+ * byte. Sums of the parts of a packet, each starting at an even offset, may
+ * be added together and folded with fold_checksum to get the checksum of the
+ * packet.
+ *
+ * @param buf - The bytes to add up
+ * @param len - The number of bytes
+ * @return sum - The sum, no larger than 0xFFFF
+ ******************************************************************************/
+u_int32_t sum_words(const void * buf, size_t len){
+    u_int64_t sum = kernel(buf, len, 0);
+
+    /*Add the overflow above 16 bits back in until there is none left*/
+    while(sum >> 16){
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (u_int32_t) sum;
+}
+
+/*******************************************************************************
+ * Folds the carries of a sum of 16-bit words (sum) back into the low 16 bits
+ * and returns its one's complement, which is the checksum
+ *
+ * @param sum - The sum to fold
+ * @return checksum - The folded checksum
+ ******************************************************************************/
+u_int16_t fold_checksum(u_int32_t sum){
+
+    /*Add the overflow above 16 bits back in until there is none left*/
+    while(sum >> 16){
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    /*Takes one's complement to get final checksum value*/
+    return (u_int16_t) ~sum;
+}
+
+/*******************************************************************************
+ * Returns the name of the kernel sum_words is using: "scalar", "sse2" or
+ * "avx2"
+ *
+ * @return name - The name of the kernel
+ ******************************************************************************/
+const char * checksum_kernel(void){
+    return kernel_name;
+}
+
+/*******************************************************************************
+ * Makes sum_words use the kernel called name, if the CPU supports it. Returns
+ * TRUE if the kernel was selected, else FALSE.
+ *
+ * @param name - "scalar", "sse2" or "avx2"
+ * @return TRUE or FALSE - Whether or not the kernel was selected
+ ******************************************************************************/
+bool set_checksum_kernel(const char * name){
+    if(strcmp(name, "scalar") == 0){
+        kernel = sum_scalar;
+        kernel_name = "scalar";
+    }
+#ifdef HAVE_X86
+    else if(strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")){
+        kernel = sum_sse2;
+        kernel_name = "sse2";
+    }
+    else if(strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")){
+        kernel = sum_avx2;
+        kernel_name = "avx2";
+    }
+#endif
+    else {
+        return FALSE;
+    }
+    return TRUE;
+}
@@ -0,0 +1,56 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * checksum.h header file
+ * @author Mark Jannenga
+ *
+ * Declares the functions used to compute the internet checksum of RUDP
+ * packets. The bytes are added up by one of several kernels (plain 64-bit,
+ * SSE2 or AVX2), and the fastest one the CPU supports is chosen when the
+ * program starts.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_CHECKSUM_H
+#define PROJECT_4_CHECKSUM_H
+
+#include "rudp_packet.h"
+
+/*******************************************************************************
+ * Adds up a buffer (buf) of len bytes as 16-bit words, folding the carries
+ * into a 16-bit result. A trailing odd byte is added as if followed by a zero
+ * byte. Sums of the parts of a packet, each starting at an even offset, may
+ * be added together and folded with fold_checksum to get the checksum of the
+ * packet.
+ *
+ * @param buf - The bytes to add up
+ * @param len - The number of bytes
+ * @return sum - The sum, no larger than 0xFFFF
+ ******************************************************************************/
+u_int32_t sum_words(const void * buf, size_t len);
+
+/*******************************************************************************
+ * Folds the carries of a sum of 16-bit words (sum) back into the low 16 bits
+ * and returns its one's complement, which is the checksum
+ *
+ * @param sum - The sum to fold
+ * @return checksum - The folded checksum
+ ******************************************************************************/
+u_int16_t fold_checksum(u_int32_t sum);
+
+/*******************************************************************************
+ * Returns the name of the kernel sum_words is using: "scalar", "sse2" or
+ * "avx2"
+ *
+ * @return name - The name of the kernel
+ ******************************************************************************/
+const char * checksum_kernel(void);
+
+/*******************************************************************************
+ * Makes sum_words use the kernel called name, if the CPU supports it. Returns
+ * TRUE if the kernel was selected, else FALSE.
+ *
+ * @param name - "scalar", "sse2" or "avx2"
+ * @return TRUE or FALSE - Whether or not the kernel was selected
+ ******************************************************************************/
+bool set_checksum_kernel(const char * name);
+
+#endif //PROJECT_4_CHECKSUM_H
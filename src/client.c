@@ -7,28 +7,133 @@
  * reliability functioonality, similar to that of TCP. It sends a request for
  * a file to the server, and, once the server confirms the connection, listens
  * for Reliable UDP (RUDP) packets, writes them to file, and sends
- * acknowledgements for those packets.
+ * acknowledgements for those packets. If the server sends parity, lost
+ * packets are rebuilt from it where possible instead of waiting for them to
+ * be resent.
  ******************************************************************************/
 
 #include "rudp_packet.h"
+#include "sack.h"
+#include "rtt.h"
+#include "writer.h"
+#include "log.h"
+#include "trace.h"
+#include "digest.h"
+#include "crc32c.h"
+#include "metrics.h"
+#include "fec.h"
 #include <time.h>
 
+/*******************************************************************************
+ * Sends a SACK (sack) to the server (serveraddr), counting it in the ACK
+ * stats (stats) and, with how long it was delayed, in the counts of the
+ * transfer (metrics)
+ *
+ * @param sockfd - The socket to send over
+ * @param serveraddr - The address of the server
+ * @param sack - The received packets to acknowledge
+ * @param stats - The stats of ACKs sent
+ * @param metrics - The counts of the transfer
+ ******************************************************************************/
+static void ack_data(int sockfd, struct sockaddr_in * serveraddr,
+                     sack_t * sack, io_stats_t * stats, metrics_t * metrics){
+
+    /*The delayed ACK timer started when the first pending packet arrived*/
+    if(sack->pending > 0){
+        record_ack(metrics, get_time_us() - (sack->deadline - ACK_DELAY));
+    }
+    else {
+        metrics->acks++;
+    }
+    send_sack(sockfd, (struct sockaddr *) serveraddr, sack);
+    record_io(stats, 1);
+}
+
+/*******************************************************************************
+ * Records the packets the blocks (dec) last rebuilt in the receive state
+ * (sack) as if they arrived with a given timestamp (timestamp), adds them to
+ * the digest (digest) if there is one, and writes them to the output file
+ * (writer) at once, since the blocks may reuse their memory for the next
+ * packet. The loss counts of the blocks are copied into the receive state for
+ * the next SACK. Returns the number of packets saved.
+ *
+ * @param dec - The blocks of the transfer
+ * @param sack - The receive state
+ * @param timestamp - The timestamp of the packet that rebuilt them
+ * @param writer - The writer of the output file
+ * @param digest - The digest of the file, or NULL
+ * @param metrics - The counts of the transfer
+ * @return saved - The number of rebuilt packets saved
+ ******************************************************************************/
+static u_int32_t save_rebuilt(fec_decoder_t * dec, sack_t * sack,
+                              u_int32_t timestamp, file_writer_t * writer,
+                              digest_t * digest, metrics_t * metrics){
+    const unsigned char * data;
+    u_int32_t i, saved = 0;
+    u_int64_t seq;
+    size_t len;
+
+    sack->fec_expected = dec->expected;
+    sack->fec_lost = dec->lost;
+    for(i = 0; i < dec->rebuilt_count; i++){
+        seq = dec->rebuilt[i];
+        if(!record_seq(sack, seq, timestamp)){
+            continue;
+        }
+        data = rebuilt_packet(dec, seq, &len);
+        trace_event(TRACE_REBUILD, sack->session, seq, RUDP_HEAD + (int) len);
+        log_msg(LOG_TRACE, "\t|-Rebuilt packet %llu from parity\n",
+                (unsigned long long) seq);
+        metrics->recovered++;
+        metrics->bytes += (u_int64_t) len;
+        if(digest != NULL){
+            add_packet_crc(digest, seq, crc32c(0, data, len));
+            advance_digest(digest, sack->cum_ack);
+        }
+        write_now(writer, (u_int64_t) dec->payload * seq, data, len);
+        saved++;
+    }
+    return saved;
+}
+
 /*******************************************************************************
  * Client main method. Expects a port number, the IPv4 address of the server,
- * and an optional filename as command line arguments.
+ * and an optional filename as command line arguments. The level of messages
+ * to print is taken from RUDP_LOG, and packet events are traced to the file
+ * named by RUDP_TRACE. Exits with status 1 if the server does not answer,
+ * could not send the file, falls silent for RECV_IDLE during the transfer,
+ * or sent a file whose digest does not match.
  *
  * @param argc
  * @param argv - [Port] [IP] [Filename (optional)]
- * @return
+ * @return status - 0 if the file was received intact, else 1
  ******************************************************************************/
 int main(int argc, char **argv){
-    int sockfd, count, len;
+    int sockfd, timeout_ms, i, n, group;
     ssize_t bytes_read;
+    struct pollfd fd;
+    unsigned char *buffers;
+    struct mmsghdr msgs[BATCH_SIZE];
+    struct iovec iov[BATCH_SIZE];
+    io_stats_t recv_stats, ack_stats;
+    metrics_t metrics;
+    bool need_ack, finished;
+    sack_t sack;
+    rtt_t rtt;
+    u_int64_t now, seq, last_heard, wait_until;
+    bool in_order, is_new, heard, timed_out = FALSE;
     struct sockaddr_in serveraddr;
-    char filename[MAX_LINE], read_buf[MAX_LINE];
+    char filename[MAX_LINE], out_name[MAX_LINE + 8], json[METRICS_JSON];
     rudp_packet_t *rudp_pkt;
-    FILE *file;
-    bool is_open;
+    syn_t syn;
+    syn_ack_t syn_ack;
+    end_seq_t end_seq;
+    file_writer_t writer;
+    digest_t digest;
+    fec_decoder_t dec;
+    bool is_open, use_crc, use_fec, good_checksum, digest_ok = TRUE;
+    u_int32_t data_crc, payload, offer, session;
+    size_t name_len, stride, data_len;
 
     /*Check command line arguments*/
     if(argc != 3 && argc != 4) {
@@ -37,12 +142,16 @@ int main(int argc, char **argv){
         exit(1);
     }
 
+    init_log();
+    init_trace();
+
     /*Create UDP socket*/
     sockfd = socket(AF_INET, SOCK_DGRAM, 0);
     if(sockfd < 0){
         printf("There was an error creating the socket\n");
         exit(1);
     }
+    set_socket_buffers(sockfd, SOCKET_BUFFER);
 
     /*Create server address and port*/
     serveraddr.sin_family=AF_INET;
@@ -61,87 +170,362 @@ int main(int argc, char **argv){
     }
 
     /*Send file name to server*/
-    fprintf(stdout, "Requesting %s from server...\n", filename);
+    log_msg(LOG_INFO, "Requesting %s from server...\n", filename);
 
-    /*Initialize data packet with file request*/
-    u_int32_t seq_num = 0;
-    rudp_pkt = create_rudp_packet(filename, strlen(filename), &seq_num);
+    /*Initialize data packet with file request, offering both integrity
+     * checks, both parity codes and packets as large as the path to the
+     * server can carry*/
+    u_int64_t seq_num = 0;
+    memset(&syn, 0, sizeof(syn_t));
+    syn.integrity = htonl(INTEGRITY_INET | INTEGRITY_CRC32C);
+    offer = mtu_payload(path_mtu(&serveraddr));
+    syn.payload = htonl(offer);
+    syn.fec = htonl(FEC_XOR | FEC_RS);
+    name_len = strlen(filename);
+    if(name_len > RUDP_DATA - sizeof(syn_t)){
+        name_len = RUDP_DATA - sizeof(syn_t);
+    }
+    rudp_pkt = create_rudp_packet(&syn, sizeof(syn_t), &seq_num);
+    memcpy(rudp_pkt->data + sizeof(syn_t), filename, name_len);
 
     /*Change packet type to SYN*/
-    rudp_pkt->checksum = 0;
-    rudp_pkt->type = SYN;
-    rudp_pkt->checksum = calc_checksum(rudp_pkt);
+    set_checksum(rudp_pkt, 0);
+    set_type(rudp_pkt, SYN);
+    set_length(rudp_pkt, (u_int16_t) (sizeof(syn_t) + name_len));
+    set_checksum(rudp_pkt, calc_checksum(rudp_pkt, RUDP_HEAD +
+                                         (int) (sizeof(syn_t) + name_len)));
 
     /*Stop and wait for SYN_ACK*/
     rudp_packet_t ack;
-    send_and_wait(sockfd, (struct sockaddr *)&serveraddr, rudp_pkt,
-                  strlen(filename) + RUDP_HEAD, &ack, NULL);
+    init_rtt(&rtt, RTO_INITIAL);
+    init_metrics(&metrics);
+    if(!send_and_wait(sockfd, (struct sockaddr *)&serveraddr, rudp_pkt,
+                      sizeof(syn_t) + name_len + RUDP_HEAD, &ack, &rtt)){
+        fprintf(stderr, "No response from the server\n");
+        free(rudp_pkt);
+        close(sockfd);
+        exit(1);
+    }
+    if(rtt.has_sample){
+        record_rtt(&metrics, rtt.srtt);
+    }
 
     /*Send ACK for SYN_ACK. If packet dropped, will resend ack in loop*/
     send_rudp_ack(sockfd, (struct sockaddr *) &serveraddr, &ack);
 
-    /*Did the server locate the file?*/
-    is_open = (bool)ack.data;
+    /*Did the server locate the file, and how large is it? Every later
+     * packet of the server carries the session of the SYN_ACK*/
+    memcpy(&syn_ack, ack.data, sizeof(syn_ack_t));
+    syn_ack.is_open = ntohl(syn_ack.is_open);
+    syn_ack.integrity = ntohl(syn_ack.integrity);
+    syn_ack.file_size = be64toh(syn_ack.file_size);
+    syn_ack.payload = ntohl(syn_ack.payload);
+    syn_ack.fec = ntohl(syn_ack.fec);
+    syn_ack.fec_block = ntohl(syn_ack.fec_block);
+    session = get_session(&ack);
+    is_open = syn_ack.is_open ? TRUE : FALSE;
+    use_crc = is_open && syn_ack.integrity == INTEGRITY_CRC32C ? TRUE : FALSE;
+    payload = syn_ack.payload;
+    if(payload == 0 || payload > MAX_PAYLOAD){
+        payload = RUDP_DATA;
+    }
+
+    /*Parity packets are a parity_t larger than data packets, and must fit
+     * the packets this client offered*/
+    use_fec = is_open && (syn_ack.fec == FEC_XOR || syn_ack.fec == FEC_RS) &&
+              syn_ack.fec_block >= 2 && syn_ack.fec_block <= FEC_MAX_DATA &&
+              payload <= MAX_PAYLOAD - sizeof(parity_t) &&
+              payload + sizeof(parity_t) <= offer ? TRUE : FALSE;
     if(is_open){
-        fprintf(stdout, "\nServer successfully opened %s\n", filename);
+        log_msg(LOG_INFO, "\nServer successfully opened %s (%llu bytes)\n",
+                filename, (unsigned long long) syn_ack.file_size);
+        log_msg(LOG_INFO, "Packet data size: %u bytes\n", payload);
+        log_msg(LOG_INFO, "Integrity check: %s\n", use_crc ?
+                "CRC32C with file digest" : "internet checksum");
+        if(use_fec){
+            log_msg(LOG_INFO, "Parity: %s, %u packets per block\n",
+                    fec_name(syn_ack.fec), syn_ack.fec_block);
+        }
     }
     else{
-        fprintf(stdout, "\nServer could not locate %s\n", filename);
+        log_msg(LOG_ERROR, "\nServer could not locate %s\n", filename);
     }
     free(rudp_pkt);
 
-    /*Open file write file*/
-    sprintf(filename, "%s.out", filename);
-    file = fopen(filename, "w+");
+    /*Open file write file, allocated at the size of the file*/
+    snprintf(out_name, sizeof(out_name), "%s.out", filename);
+    if(is_open){
+        if(!open_writer(&writer, out_name, syn_ack.file_size)){
+            log_msg(LOG_ERROR, "\nFailed to open %s\n", out_name);
+            is_open = FALSE;
+        }
+        else{
+            log_msg(LOG_INFO, "\nOpened %s\n", out_name);
+        }
+    }
 
-    if(file == NULL){
-        fprintf(stdout, "\nFailed to open %s\n", filename);
-        is_open = FALSE;
+    /*Read file from server*/
+    init_sack(&sack, RECV_WINDOW);
+    sack.session = session;
+    if(use_crc){
+        sack.flags = CHECK_CRC32C;
+        init_digest(&digest, sack.capacity, syn_ack.file_size, payload);
     }
-    else{
-        fprintf(stdout, "\nOpened %s\n", filename);
+    if(use_fec){
+        sack.fec = TRUE;
+        init_fec_decoder(&dec, syn_ack.fec, syn_ack.fec_block, payload,
+                         syn_ack.file_size);
     }
+    memset(&recv_stats, 0, sizeof(io_stats_t));
+    memset(&ack_stats, 0, sizeof(io_stats_t));
 
-    /*Read file from server*/
-    count = 0;
-    len = sizeof(struct sockaddr_in);
+    /*Each receive buffer holds one packet of the negotiated size, or a
+     * parity packet if it is larger. Batches are received into WRITE_GROUPS
+     * groups of buffers in turn, so a batch can still be being written to
+     * disk while the next ones arrive*/
+    stride = (size_t) RUDP_HEAD + payload;
+    if(use_fec){
+        stride += sizeof(parity_t);
+    }
+    buffers = malloc(WRITE_GROUPS * BATCH_SIZE * stride);
+    if(buffers == NULL){
+        fprintf(stderr, "Could not allocate receive buffers\n");
+        exit(1);
+    }
+    memset(msgs, 0, sizeof(msgs));
+    for(i = 0; i < BATCH_SIZE; i++){
+        iov[i].iov_len = stride;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    fd.fd = sockfd;
+    fd.events = POLLIN;
+    group = 0;
+    last_heard = get_time_us();
     while(is_open) {
-        /*Receive packet from server*/
-        memset(read_buf, 0, MAX_LINE);
-        bytes_read = recvfrom(sockfd, read_buf, MAX_LINE,
-                              0, (struct sockaddr *) &serveraddr,
-                              (socklen_t *) &len);
-        rudp_pkt = (rudp_packet_t *) read_buf;
-
-        /*Print packet contents to stdout*/
-        fprintf(stdout, "\nGot %d byte packet\n", (int) bytes_read);
-        bool good_checksum = print_rudp_packet(rudp_pkt);
-
-        if(good_checksum){
-            fprintf(stdout, "\t|-Sending ACK for packet #%d\n", rudp_pkt->seq_num);
-            send_rudp_ack(sockfd, (struct sockaddr *) &serveraddr, rudp_pkt);
+        /*Wait for a packet, but no longer than a pending ACK may be delayed,
+         * or than the server may stay silent*/
+        now = get_time_us();
+        wait_until = last_heard + RECV_IDLE;
+        if(sack.pending > 0 && sack.deadline < wait_until){
+            wait_until = sack.deadline;
         }
-        else{
-            fprintf(stdout, "\t|-BAD CHECKSUM\n");
+        timeout_ms = wait_until <= now ? 0 :
+                     (int) ((wait_until - now + 999) / 1000);
+        if(poll(&fd, 1, timeout_ms) == 0){
+            if(sack.pending > 0){
+                log_msg(LOG_TRACE, "\t|-Sending delayed ACK up to packet "
+                        "#%llu\n", (unsigned long long) sack.cum_ack);
+                ack_data(sockfd, &serveraddr, &sack, &ack_stats, &metrics);
+            }
+            else if(get_time_us() - last_heard >= RECV_IDLE){
+                fprintf(stderr, "No packets from the server for %d s\n",
+                        RECV_IDLE / 1000000);
+                timed_out = TRUE;
+                break;
+            }
             continue;
         }
 
-        if( rudp_pkt->type == END_SEQ ) {
-            break;
+        /*Receive every packet that is queued on the socket into the next
+         * group of buffers, once no write still reads from it*/
+        group = (group + 1) % WRITE_GROUPS;
+        claim_buffers(&writer, group);
+        for(i = 0; i < BATCH_SIZE; i++){
+            iov[i].iov_base = buffers + (group * BATCH_SIZE + i) * stride;
+        }
+        n = recvmmsg(sockfd, msgs, BATCH_SIZE, MSG_DONTWAIT, NULL);
+        if(n <= 0){
+            continue;
         }
-        count += bytes_read - RUDP_HEAD;
+        record_io(&recv_stats, n);
 
-        /*Adjust file pointer to correct location for packet*/
-        fseek(file, RUDP_DATA * rudp_pkt->seq_num, SEEK_SET);
+        need_ack = FALSE;
+        finished = FALSE;
+        heard = FALSE;
+        for(i = 0; i < n && !finished; i++){
+            bytes_read = (ssize_t) msgs[i].msg_len;
+            rudp_pkt = (rudp_packet_t *) iov[i].iov_base;
 
-        /*Write to file*/
-        fprintf(stderr, "\t|-Writing packet %d to file\n", rudp_pkt->seq_num);
-        fwrite(rudp_pkt->data, 1, (size_t) (bytes_read - RUDP_HEAD), file);
+            /*Print packet contents to stdout. With CRC32C, checking the
+             * packet also gives the CRC of its data for the digest*/
+            log_msg(LOG_TRACE, "\nGot %d byte packet\n", (int) bytes_read);
+            good_checksum = check_packet(rudp_pkt, (int) bytes_read,
+                                         &data_crc);
+            if(use_crc && (get_type(rudp_pkt) == DATA_PKT ||
+                    get_type(rudp_pkt) == PARITY) &&
+                    !(get_flags(rudp_pkt) & CHECK_CRC32C)){
+                good_checksum = FALSE;
+            }
+            if(log_enabled(LOG_TRACE)){
+                print_rudp_header(rudp_pkt, good_checksum);
+            }
+
+            if(!good_checksum){
+                log_msg(LOG_TRACE, "\t|-BAD CHECKSUM\n");
+                trace_event(TRACE_BAD_SUM, get_session(rudp_pkt),
+                            get_seq_num(rudp_pkt), (int) bytes_read);
+                metrics.bad_checksums++;
+                continue;
+            }
+            if(get_session(rudp_pkt) != session){
+                log_msg(LOG_TRACE, "\t|-WRONG SESSION\n");
+                trace_event(TRACE_DROP, get_session(rudp_pkt),
+                            get_seq_num(rudp_pkt), (int) bytes_read);
+                continue;
+            }
+            heard = TRUE;
+
+            /*Parity is never acknowledged or resent, but may complete a
+             * block whose lost packets it rebuilds*/
+            if(get_type(rudp_pkt) == PARITY){
+                trace_event(TRACE_PARITY, session, get_seq_num(rudp_pkt),
+                            (int) bytes_read);
+                if(use_fec && add_parity_packet(&dec, rudp_pkt,
+                                                (int) bytes_read) > 0 &&
+                        save_rebuilt(&dec, &sack, get_timestamp(rudp_pkt),
+                                     &writer, use_crc ? &digest : NULL,
+                                     &metrics) > 0){
+                    need_ack = TRUE;
+                }
+                continue;
+            }
+
+            /*Handshake and teardown packets are acknowledged individually*/
+            if(get_type(rudp_pkt) != DATA_PKT){
+                if(sack.pending > 0){
+                    ack_data(sockfd, &serveraddr, &sack, &ack_stats,
+                             &metrics);
+                    need_ack = FALSE;
+                }
+                log_msg(LOG_DEBUG, "\t|-Sending ACK for packet #%llu\n",
+                        (unsigned long long) get_seq_num(rudp_pkt));
+                send_rudp_ack(sockfd, (struct sockaddr *) &serveraddr,
+                              rudp_pkt);
+                record_io(&ack_stats, 1);
+                if( get_type(rudp_pkt) == END_SEQ ) {
+                    finished = TRUE;
+
+                    /*Every packet has arrived, so the digest is complete*/
+                    if(use_crc && bytes_read >=
+                            RUDP_HEAD + (ssize_t) sizeof(end_seq_t)){
+                        memcpy(&end_seq, rudp_pkt->data, sizeof(end_seq_t));
+                        advance_digest(&digest, sack.cum_ack);
+                        digest_ok = digest.crc == ntohl(end_seq.digest) ?
+                                    TRUE : FALSE;
+                    }
+                }
+                continue;
+            }
+
+            /*A data packet holds at most one payload and lies within the
+             * file, or its write would land on the next packet's place or
+             * past the end of the file. Others are dropped before they are
+             * recorded*/
+            seq = get_seq_num(rudp_pkt);
+            data_len = (size_t) (bytes_read - RUDP_HEAD);
+            if(data_len > payload || seq > syn_ack.file_size / payload ||
+                    seq * payload + data_len > syn_ack.file_size){
+                log_msg(LOG_TRACE, "\t|-OUTSIDE THE FILE\n");
+                trace_event(TRACE_DROP, session, seq, (int) bytes_read);
+                continue;
+            }
+
+            /*ACK every ACK_EVERY packets, or at once if a packet is duplicated
+             * or arrives out of order so the server learns of the gap quickly.
+             * The ACK is deferred to the end of the batch so that one SACK
+             * covers everything received in it*/
+            in_order = seq == sack.cum_ack ? TRUE : FALSE;
+            is_new = record_packet(&sack, rudp_pkt);
+            if(!is_new || !in_order || sack.pending >= ACK_EVERY){
+                need_ack = TRUE;
+            }
+            trace_event(is_new ? TRACE_RECV : TRACE_DROP, session,
+                        seq, (int) bytes_read);
+            metrics.packets_received++;
+            if(!is_new){
+                metrics.duplicates++;
+                continue;
+            }
+            if(!in_order){
+                metrics.out_of_order++;
+            }
+            if(metrics.first_byte == 0){
+                metrics.first_byte = get_time_us();
+            }
+            metrics.bytes += (u_int64_t) data_len;
+            if(use_crc){
+                add_packet_crc(&digest, seq, data_crc);
+                advance_digest(&digest, sack.cum_ack);
+            }
+
+            /*Write to file at the location of the packet. Packets that
+             * follow one another are written together*/
+            log_msg(LOG_TRACE, "\t|-Writing packet %llu to file\n",
+                    (unsigned long long) seq);
+            write_data(&writer, seq * payload, rudp_pkt->data, data_len);
+            if(use_fec){
+                add_data_packet(&dec, seq, rudp_pkt->data, data_len);
+                if(save_rebuilt(&dec, &sack, get_timestamp(rudp_pkt),
+                                &writer, use_crc ? &digest : NULL,
+                                &metrics) > 0){
+                    need_ack = TRUE;
+                }
+            }
+        }
+
+        /*Start writing the batch. Its buffers are not received into again
+         * until the writes from them have finished*/
+        flush_writer(&writer);
+        if(heard){
+            last_heard = get_time_us();
+        }
+
+        if(need_ack){
+            log_msg(LOG_TRACE, "\t|-Sending ACK up to packet #%llu\n",
+                    (unsigned long long) sack.cum_ack);
+            ack_data(sockfd, &serveraddr, &sack, &ack_stats, &metrics);
+        }
+        if(finished){
+            break;
+        }
     }
-    fprintf(stdout, "%d total bytes received\n", count);
+    metrics.finished = get_time_us();
+    log_msg(LOG_INFO, "%llu total bytes received\n",
+            (unsigned long long) metrics.bytes);
+    print_io_stats("Data received", &recv_stats);
+    print_io_stats("ACKs sent", &ack_stats);
 
-    /*Clean up*/
-    fclose(file);
+    if(use_crc){
+        log_msg(LOG_INFO, "File digest: 0x%08x (CRC32C, %s)\n", digest.crc,
+                crc32c_kernel());
+        if(!digest_ok){
+            log_msg(LOG_ERROR, "File digest does not match the server's\n");
+        }
+    }
+
+    /*Clean up. The receive buffers are freed after the writer is closed, as
+     * writes in flight may still read from them*/
+    free_sack(&sack);
+    if(use_crc){
+        free_digest(&digest);
+    }
+    if(use_fec){
+        free_fec_decoder(&dec);
+    }
+    if(is_open){
+        print_io_stats("Disk writes", &writer.stats);
+        close_writer(&writer);
+        if(writer.ring.stats.calls > 0){
+            print_io_stats("io_uring submits", &writer.ring.stats);
+        }
+    }
+    free(buffers);
     close(sockfd);
-    return 0;
-}
\ No newline at end of file
+
+    /*Print the counts of the transfer, whatever the log level, as one line
+     * of JSON on stdout*/
+    format_metrics(&metrics, "\"role\":\"client\",", json, sizeof(json));
+    fprintf(stdout, "%s\n", json);
+    return is_open && digest_ok && !timed_out ? 0 : 1;
+}
@@ -0,0 +1,372 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * congestion.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in congestion.h
+ ******************************************************************************/
+
+#include "congestion.h"
+
+#define GAIN_UNIT 1000      /*Gains below are in thousandths*/
+#define BBR_HIGH_GAIN 2885  /*2/ln(2), doubles the rate each round*/
+#define BBR_DRAIN_GAIN 347  /*1/2.885, drains the startup queue in a round*/
+#define BBR_CWND_GAIN 2000  /*Window allowed in flight, in BDPs*/
+#define BBR_CYCLE 8         /*Number of phases in the PROBE_BW gain cycle*/
+#define BBR_FULL_ROUNDS 3   /*Rounds without growth before leaving startup*/
+
+/*Pacing gain of each PROBE_BW phase: probe, drain, then cruise*/
+static const u_int32_t bbr_cycle_gain[BBR_CYCLE] = {
+    1250, 750, 1000, 1000, 1000, 1000, 1000, 1000
+};
+
+/*******************************************************************************
+ * Limits the congestion window of a controller (cc) to between MIN_CWND and
+ * the window capacity
+ *
+ * @param cc - The congestion controller
+ ******************************************************************************/
+static void clamp_cwnd(cc_t * cc){
+    if(cc->cwnd < MIN_CWND){
+        cc->cwnd = MIN_CWND;
+    }
+    if(cc->cwnd > cc->max_cwnd){
+        cc->cwnd = cc->max_cwnd;
+    }
+}
+
+/*******************************************************************************
+ * Paces a controller (cc) to send gain thousandths of its congestion window per
+ * smoothed round trip, or leaves it unpaced if no round trip is known yet
+ *
+ * @param cc - The congestion controller
+ * @param gain - The pacing gain in thousandths
+ ******************************************************************************/
+static void pace_cwnd(cc_t * cc, u_int32_t gain){
+    if(cc->srtt == 0){
+        cc->pacing_rate = 0;
+        return;
+    }
+    cc->pacing_rate = (u_int64_t) cc->cwnd * cc->mss * 1000000 / cc->srtt *
+                      gain / GAIN_UNIT;
+}
+
+/*******************************************************************************
+ * No congestion control: the whole window may be in flight, unpaced
+ ******************************************************************************/
+static void none_init(cc_t * cc){
+    cc->cwnd = cc->max_cwnd;
+    cc->pacing_rate = 0;
+}
+
+static void none_on_ack(cc_t * cc, u_int32_t acked, u_int32_t in_flight,
+                        u_int64_t now){
+}
+
+static void none_on_loss(cc_t * cc, bool timeout, u_int64_t now){
+}
+
+static void none_on_rtt_sample(cc_t * cc, u_int64_t rtt, u_int64_t now){
+}
+
+/*******************************************************************************
+ * Reno style AIMD: the window grows by one packet per acknowledged packet in
+ * slow start and by one packet per round trip afterwards, halves when packets
+ * are lost, and falls to the minimum when a retransmission timer expires. The
+ * window is paced at twice its rate in slow start, else 1.2 times.
+ ******************************************************************************/
+static void reno_init(cc_t * cc){
+    cc->cwnd = INITIAL_CWND;
+    cc->ssthresh = cc->max_cwnd;
+    cc->cwnd_cnt = 0;
+    clamp_cwnd(cc);
+}
+
+static void reno_pace(cc_t * cc){
+    pace_cwnd(cc, cc->cwnd < cc->ssthresh ? 2000 : 1200);
+}
+
+static void reno_on_ack(cc_t * cc, u_int32_t acked, u_int32_t in_flight,
+                        u_int64_t now){
+    if(cc->cwnd < cc->ssthresh){
+        cc->cwnd += acked;
+        if(cc->cwnd > cc->ssthresh){
+            cc->cwnd = cc->ssthresh;
+        }
+    }
+    else{
+        cc->cwnd_cnt += acked;
+        while(cc->cwnd_cnt >= cc->cwnd){
+            cc->cwnd_cnt -= cc->cwnd;
+            cc->cwnd++;
+        }
+    }
+    clamp_cwnd(cc);
+    reno_pace(cc);
+}
+
+static void reno_on_loss(cc_t * cc, bool timeout, u_int64_t now){
+    cc->ssthresh = cc->cwnd / 2;
+    if(cc->ssthresh < MIN_CWND){
+        cc->ssthresh = MIN_CWND;
+    }
+    cc->cwnd = timeout ? MIN_CWND : cc->ssthresh;
+    cc->cwnd_cnt = 0;
+    clamp_cwnd(cc);
+    reno_pace(cc);
+}
+
+static void reno_on_rtt_sample(cc_t * cc, u_int64_t rtt, u_int64_t now){
+    reno_pace(cc);
+}
+
+/*******************************************************************************
+ * BBR style rate based control: the delivery rate of each round trip feeds a
+ * windowed max filter estimating the bottleneck bandwidth, and the smallest
+ * recent round trip estimates the propagation delay. The server paces at a
+ * multiple of the bandwidth, doubling each round in startup until the
+ * bandwidth stops growing, then draining the queue it built and cycling
+ * around the estimate. The window is capped at two bandwidth-delay products,
+ * plus room for the packets a single delayed ACK may cover so that ACK
+ * aggregation does not starve the pipe. Isolated losses are not treated as
+ * congestion.
+ ******************************************************************************/
+static void bbr_init(cc_t * cc){
+    cc->cwnd = INITIAL_CWND;
+    cc->mode = BBR_STARTUP;
+    cc->btl_bw = 0;
+    memset(cc->bw_samples, 0, sizeof(cc->bw_samples));
+    cc->round = 0;
+    cc->round_start = 0;
+    cc->round_delivered = 0;
+    cc->full_bw = 0;
+    cc->full_bw_count = 0;
+    cc->cycle_index = 0;
+    cc->min_rtt = 0;
+    cc->min_rtt_stamp = 0;
+    cc->extra_acked = 0;
+    clamp_cwnd(cc);
+}
+
+static u_int32_t bbr_bdp(cc_t * cc){
+    return (u_int32_t) (cc->btl_bw * cc->min_rtt / 1000000 / cc->mss);
+}
+
+static void bbr_end_round(cc_t * cc, u_int32_t in_flight, u_int64_t now){
+    u_int64_t bw;
+    int i;
+
+    /*Record this round's delivery rate and take the max of recent rounds*/
+    bw = cc->round_delivered * 1000000 / (now - cc->round_start);
+    cc->bw_samples[cc->round % BW_ROUNDS] = bw;
+    cc->round++;
+    cc->btl_bw = 0;
+    for(i = 0; i < BW_ROUNDS; i++){
+        if(cc->bw_samples[i] > cc->btl_bw){
+            cc->btl_bw = cc->bw_samples[i];
+        }
+    }
+    cc->round_delivered = 0;
+    cc->round_start = now;
+
+    /*Forget old ACK aggregation along with old bandwidth samples*/
+    if(cc->round % BW_ROUNDS == 0){
+        cc->extra_acked = 0;
+    }
+
+    switch(cc->mode){
+        case BBR_STARTUP:
+            /*The pipe is full once the bandwidth stops growing by 25%*/
+            if(cc->btl_bw >= cc->full_bw * 5 / 4){
+                cc->full_bw = cc->btl_bw;
+                cc->full_bw_count = 0;
+            }
+            else if(++cc->full_bw_count >= BBR_FULL_ROUNDS){
+                cc->mode = BBR_DRAIN;
+            }
+            break;
+        case BBR_DRAIN:
+            if(in_flight <= bbr_bdp(cc)){
+                cc->mode = BBR_PROBE_BW;
+                cc->cycle_index = 0;
+            }
+            break;
+        default:
+            cc->cycle_index = (cc->cycle_index + 1) % BBR_CYCLE;
+            break;
+    }
+}
+
+static void bbr_on_ack(cc_t * cc, u_int32_t acked, u_int32_t in_flight,
+                       u_int64_t now){
+    u_int64_t round_time = cc->min_rtt > 1000 ? cc->min_rtt : 1000;
+    u_int32_t gain;
+
+    /*A round lasts one minimum round trip*/
+    cc->round_delivered += (u_int64_t) acked * cc->mss;
+    if(acked > cc->extra_acked){
+        cc->extra_acked = acked;
+    }
+    if(cc->round_start == 0){
+        cc->round_start = now;
+    }
+    else if(now - cc->round_start >= round_time){
+        bbr_end_round(cc, in_flight, now);
+    }
+
+    switch(cc->mode){
+        case BBR_STARTUP: gain = BBR_HIGH_GAIN; break;
+        case BBR_DRAIN: gain = BBR_DRAIN_GAIN; break;
+        default: gain = bbr_cycle_gain[cc->cycle_index]; break;
+    }
+
+    /*Until the bandwidth is measured, grow like slow start*/
+    if(cc->btl_bw == 0 || cc->min_rtt == 0){
+        cc->cwnd += acked;
+        clamp_cwnd(cc);
+        pace_cwnd(cc, BBR_HIGH_GAIN);
+        return;
+    }
+
+    cc->cwnd = bbr_bdp(cc) * BBR_CWND_GAIN / GAIN_UNIT + 2 * cc->extra_acked;
+    if(cc->mode == BBR_STARTUP && cc->cwnd < in_flight + acked){
+        cc->cwnd = in_flight + acked;
+    }
+    if(cc->cwnd < 4){
+        cc->cwnd = 4;
+    }
+    clamp_cwnd(cc);
+    cc->pacing_rate = cc->btl_bw * gain / GAIN_UNIT;
+}
+
+static void bbr_on_loss(cc_t * cc, bool timeout, u_int64_t now){
+}
+
+static void bbr_on_rtt_sample(cc_t * cc, u_int64_t rtt, u_int64_t now){
+    if(cc->min_rtt == 0 || rtt <= cc->min_rtt ||
+            now - cc->min_rtt_stamp > MIN_RTT_WINDOW){
+        cc->min_rtt = rtt;
+        cc->min_rtt_stamp = now;
+    }
+}
+
+/*Table of the available congestion control algorithms*/
+static const cc_ops_t cc_algorithms[] = {
+    {"none", none_init, none_on_ack, none_on_loss, none_on_rtt_sample},
+    {"reno", reno_init, reno_on_ack, reno_on_loss, reno_on_rtt_sample},
+    {"bbr", bbr_init, bbr_on_ack, bbr_on_loss, bbr_on_rtt_sample},
+};
+
+/*******************************************************************************
+ * Initializes a congestion controller (cc) running the algorithm named name
+ * ("reno", "bbr" or "none"). The window never exceeds max_cwnd packets of mss
+ * bytes. Returns TRUE if the algorithm exists, else FALSE.
+ *
+ * @param cc - The congestion controller to initialize
+ * @param name - The name of the algorithm
+ * @param max_cwnd - The largest congestion window allowed (packets)
+ * @param mss - The size of a full packet (bytes)
+ * @return TRUE or FALSE - Whether or not the algorithm was found
+ ******************************************************************************/
+bool init_cc(cc_t * cc, const char * name, u_int32_t max_cwnd, u_int32_t mss){
+    size_t i;
+
+    memset(cc, 0, sizeof(cc_t));
+    for(i = 0; i < sizeof(cc_algorithms) / sizeof(cc_ops_t); i++){
+        if(strcmp(cc_algorithms[i].name, name) == 0){
+            cc->ops = &cc_algorithms[i];
+        }
+    }
+    if(cc->ops == NULL){
+        return FALSE;
+    }
+
+    cc->max_cwnd = max_cwnd;
+    cc->mss = mss;
+    cc->ops->init(cc);
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Tells the congestion controller (cc) that acked packets were acknowledged,
+ * leaving in_flight packets still unacknowledged
+ *
+ * @param cc - The congestion controller
+ * @param acked - The number of packets newly acknowledged
+ * @param in_flight - The number of packets sent but not yet acknowledged
+ ******************************************************************************/
+void cc_on_ack(cc_t * cc, u_int32_t acked, u_int32_t in_flight){
+    cc->ops->on_ack(cc, acked, in_flight, get_time_us());
+}
+
+/*******************************************************************************
+ * Tells the congestion controller (cc) that packets were lost, either because
+ * a retransmission timer expired (timeout) or because later packets were
+ * acknowledged first. Losses within one round trip count as a single event.
+ *
+ * @param cc - The congestion controller
+ * @param timeout - Whether the loss was found by a retransmission timeout
+ ******************************************************************************/
+void cc_on_loss(cc_t * cc, bool timeout){
+    u_int64_t now = get_time_us();
+
+    if(!timeout && now < cc->recovery_end){
+        return;
+    }
+    cc->recovery_end = now + cc->srtt;
+    cc->ops->on_loss(cc, timeout, now);
+}
+
+/*******************************************************************************
+ * Gives the congestion controller (cc) a new round trip measurement (rtt)
+ * along with the smoothed round trip time (srtt)
+ *
+ * @param cc - The congestion controller
+ * @param rtt - The measured round trip time (us)
+ * @param srtt - The smoothed round trip time (us)
+ ******************************************************************************/
+void cc_on_rtt_sample(cc_t * cc, u_int64_t rtt, u_int64_t srtt){
+    cc->srtt = srtt;
+    cc->ops->on_rtt_sample(cc, rtt, get_time_us());
+}
+
+/*******************************************************************************
+ * Checks whether the congestion controller (cc) allows a packet to be sent at
+ * time now. New packets (is_new) must also fit in the congestion window given
+ * in_flight packets outstanding, while retransmissions are only paced.
+ *
+ * @param cc - The congestion controller
+ * @param in_flight - The number of packets sent but not yet acknowledged
+ * @param is_new - Whether the packet is being sent for the first time
+ * @param now - The current time (us)
+ * @return TRUE or FALSE - Whether or not the packet may be sent
+ ******************************************************************************/
+bool cc_can_send(cc_t * cc, u_int32_t in_flight, bool is_new, u_int64_t now){
+    if(is_new && in_flight >= cc->cwnd){
+        return FALSE;
+    }
+    if(cc->pacing_rate != 0 && cc->next_send > now){
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Tells the congestion controller (cc) that a packet of size bytes was sent
+ * at time now, so the pacing clock can advance
+ *
+ * @param cc - The congestion controller
+ * @param size - The size of the packet sent
+ * @param now - The current time (us)
+ ******************************************************************************/
+void cc_on_send(cc_t * cc, int size, u_int64_t now){
+    if(cc->pacing_rate == 0){
+        return;
+    }
+
+    /*An idle sender may catch up on at most PACING_BURST of sending*/
+    if(cc->next_send + PACING_BURST < now){
+        cc->next_send = now - PACING_BURST;
+    }
+    cc->next_send += (u_int64_t) size * 1000000 / cc->pacing_rate;
+}
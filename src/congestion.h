@@ -0,0 +1,143 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * congestion.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used to control
+ * how fast the server sends. A congestion controller is a small table of
+ * callbacks (on_ack, on_loss, on_rtt_sample) that set a congestion window,
+ * the number of packets allowed in flight, and a pacing rate. Controllers are
+ * looked up by name, so each server can choose its own.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_CONGESTION_H
+#define PROJECT_4_CONGESTION_H
+
+#include "rudp_packet.h"
+
+#define INITIAL_CWND 10     /*Packets allowed in flight at the start*/
+#define MIN_CWND 2          /*Smallest congestion window ever used*/
+#define PACING_BURST 1000   /*Longest idle time credited to pacing (us)*/
+#define BW_ROUNDS 10        /*Rounds the BBR bandwidth filter remembers*/
+#define MIN_RTT_WINDOW 10000000 /*How long a BBR min RTT sample lasts (us)*/
+#define DEFAULT_CC "reno"   /*Congestion controller used if none is chosen*/
+
+/*BBR states*/
+#define BBR_STARTUP 0       /*Doubling the rate each round*/
+#define BBR_DRAIN 1         /*Draining the queue built during startup*/
+#define BBR_PROBE_BW 2      /*Cycling around the bottleneck bandwidth*/
+
+struct cc_t;
+
+/*Callbacks implementing a congestion control algorithm*/
+struct cc_ops_t{
+    const char * name;
+    void (*init)(struct cc_t * cc);
+    void (*on_ack)(struct cc_t * cc, u_int32_t acked, u_int32_t in_flight,
+                   u_int64_t now);
+    void (*on_loss)(struct cc_t * cc, bool timeout, u_int64_t now);
+    void (*on_rtt_sample)(struct cc_t * cc, u_int64_t rtt, u_int64_t now);
+};
+
+/*Custom struct to hold the state of a congestion controller. The fields in
+ * the first group are shared by every algorithm, the rest belong to one*/
+struct cc_t{
+    const struct cc_ops_t * ops;    //The algorithm in use
+    u_int32_t cwnd;                 //Packets allowed in flight
+    u_int32_t max_cwnd;             //Largest window, i.e. the window capacity
+    u_int64_t pacing_rate;          //Bytes per second, 0 if not paced
+    u_int64_t next_send;            //Earliest time the next packet may go (us)
+    u_int32_t mss;                  //Size of a full packet in bytes
+    u_int64_t srtt;                 //Latest smoothed round trip time (us)
+    u_int64_t recovery_end;         //Losses before this are one event (us)
+
+    /*Reno*/
+    u_int32_t ssthresh;             //Slow start threshold in packets
+    u_int32_t cwnd_cnt;             //Packets acked toward the next increase
+
+    /*BBR*/
+    int mode;                       //BBR_STARTUP, BBR_DRAIN or BBR_PROBE_BW
+    u_int64_t btl_bw;               //Estimated bottleneck bandwidth (B/s)
+    u_int64_t bw_samples[BW_ROUNDS];//Delivery rate of recent rounds (B/s)
+    u_int32_t round;                //Number of rounds completed
+    u_int64_t round_start;          //Time the current round began (us)
+    u_int64_t round_delivered;      //Bytes delivered in the current round
+    u_int64_t full_bw;              //Bandwidth when startup last grew 25%
+    u_int32_t full_bw_count;        //Rounds without 25% growth
+    u_int32_t cycle_index;          //Position in the PROBE_BW gain cycle
+    u_int64_t min_rtt;              //Smallest recent round trip time (us)
+    u_int64_t min_rtt_stamp;        //Time min_rtt was measured (us)
+    u_int32_t extra_acked;          //Most packets covered by one recent ACK
+};
+
+/*Typedefs*/
+typedef struct cc_ops_t cc_ops_t;
+typedef struct cc_t cc_t;
+
+/*******************************************************************************
+ * Initializes a congestion controller (cc) running the algorithm named name
+ * ("reno", "bbr" or "none"). The window never exceeds max_cwnd packets of mss
+ * bytes. Returns TRUE if the algorithm exists, else FALSE.
+ *
+ * @param cc - The congestion controller to initialize
+ * @param name - The name of the algorithm
+ * @param max_cwnd - The largest congestion window allowed (packets)
+ * @param mss - The size of a full packet (bytes)
+ * @return TRUE or FALSE - Whether or not the algorithm was found
+ ******************************************************************************/
+bool init_cc(cc_t * cc, const char * name, u_int32_t max_cwnd, u_int32_t mss);
+
+/*******************************************************************************
+ * Tells the congestion controller (cc) that acked packets were acknowledged,
+ * leaving in_flight packets still unacknowledged
+ *
+ * @param cc - The congestion controller
+ * @param acked - The number of packets newly acknowledged
+ * @param in_flight - The number of packets sent but not yet acknowledged
+ ******************************************************************************/
+void cc_on_ack(cc_t * cc, u_int32_t acked, u_int32_t in_flight);
+
+/*******************************************************************************
+ * Tells the congestion controller (cc) that packets were lost, either because
+ * a retransmission timer expired (timeout) or because later packets were
+ * acknowledged first. Losses within one round trip count as a single event.
+ *
+ * @param cc - The congestion controller
+ * @param timeout - Whether the loss was found by a retransmission timeout
+ ******************************************************************************/
+void cc_on_loss(cc_t * cc, bool timeout);
+
+/*******************************************************************************
+ * Gives the congestion controller (cc) a new round trip measurement (rtt)
+ * along with the smoothed round trip time (srtt)
+ *
+ * @param cc - The congestion controller
+ * @param rtt - The measured round trip time (us)
+ * @param srtt - The smoothed round trip time (us)
+ ******************************************************************************/
+void cc_on_rtt_sample(cc_t * cc, u_int64_t rtt, u_int64_t srtt);
+
+/*******************************************************************************
+ * Checks whether the congestion controller (cc) allows a packet to be sent at
+ * time now. New packets (is_new) must also fit in the congestion window given
+ * in_flight packets outstanding, while retransmissions are only paced.
+ *
+ * @param cc - The congestion controller
+ * @param in_flight - The number of packets sent but not yet acknowledged
+ * @param is_new - Whether the packet is being sent for the first time
+ * @param now - The current time (us)
+ * @return TRUE or FALSE - Whether or not the packet may be sent
+ ******************************************************************************/
+bool cc_can_send(cc_t * cc, u_int32_t in_flight, bool is_new, u_int64_t now);
+
+/*******************************************************************************
+ * Tells the congestion controller (cc) that a packet of size bytes was sent
+ * at time now, so the pacing clock can advance
+ *
+ * @param cc - The congestion controller
+ * @param size - The size of the packet sent
+ * @param now - The current time (us)
+ ******************************************************************************/
+void cc_on_send(cc_t * cc, int size, u_int64_t now);
+
+#endif //PROJECT_4_CONGESTION_H
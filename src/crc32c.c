@@ -0,0 +1,274 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * crc32c.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in crc32c.h
+ ******************************************************************************/
+
+#include "crc32c.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define HAVE_SSE42 1
+#endif
+
+#define CRC32C_POLY 0x82F63B78  /*Castagnoli polynomial, bit reversed*/
+
+/*A kernel continues the raw (not inverted) CRC over len bytes at p*/
+typedef u_int32_t (*crc_kernel_t)(u_int32_t crc, const unsigned char *p,
+                                  size_t len);
+
+/*Slice-by-8 tables. Row 0 is the usual byte table, and row k advances a
+ * byte that is followed by k more bytes*/
+static u_int32_t crc_table[8][256];
+
+/*x2n_table[k] is x^(2^k) modulo the polynomial, for crc32c_shift*/
+static u_int32_t x2n_table[32];
+
+/*******************************************************************************
+ * Continues a raw CRC (crc) over bytes (p) one at a time
+ *
+ * @param crc - The raw CRC so far
+ * @param p - The bytes to add
+ * @param len - The number of bytes
+ * @return crc - The new raw CRC
+ ******************************************************************************/
+static u_int32_t crc_bytewise(u_int32_t crc, const unsigned char *p,
+                              size_t len){
+    while(len > 0){
+        crc = (crc >> 8) ^ crc_table[0][(crc ^ *p) & 0xFF];
+        p++;
+        len--;
+    }
+    return crc;
+}
+
+/*******************************************************************************
+ * Continues a raw CRC (crc) over bytes (p) 8 at a time with the slice-by-8
+ * tables. Only used on little endian machines.
+ *
+ * @param crc - The raw CRC so far
+ * @param p - The bytes to add
+ * @param len - The number of bytes
+ * @return crc - The new raw CRC
+ ******************************************************************************/
+static u_int32_t crc_slice8(u_int32_t crc, const unsigned char *p, size_t len){
+    u_int64_t word;
+
+    while(len >= 8){
+        memcpy(&word, p, 8);
+        word ^= crc;
+        crc = crc_table[7][word & 0xFF] ^
+              crc_table[6][(word >> 8) & 0xFF] ^
+              crc_table[5][(word >> 16) & 0xFF] ^
+              crc_table[4][(word >> 24) & 0xFF] ^
+              crc_table[3][(word >> 32) & 0xFF] ^
+              crc_table[2][(word >> 40) & 0xFF] ^
+              crc_table[1][(word >> 48) & 0xFF] ^
+              crc_table[0][word >> 56];
+        p += 8;
+        len -= 8;
+    }
+    return crc_bytewise(crc, p, len);
+}
+
+#ifdef HAVE_SSE42
+/*******************************************************************************
+ * Continues a raw CRC (crc) over bytes (p) 8 at a time with the SSE4.2 crc32
+ * instruction
+ *
+ * @param crc - The raw CRC so far
+ * @param p - The bytes to add
+ * @param len - The number of bytes
+ * @return crc - The new raw CRC
+ ******************************************************************************/
+__attribute__((target("sse4.2")))
+static u_int32_t crc_sse42(u_int32_t crc, const unsigned char *p, size_t len){
+    u_int64_t word, crc64 = crc;
+
+    while(len >= 8){
+        memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+        p += 8;
+        len -= 8;
+    }
+    crc = (u_int32_t) crc64;
+    while(len > 0){
+        crc = _mm_crc32_u8(crc, *p);
+        p++;
+        len--;
+    }
+    return crc;
+}
+#endif
+
+/*The kernel in use, chosen before main runs*/
+static crc_kernel_t kernel = crc_bytewise;
+static const char * kernel_name = "bytewise";
+
+/*******************************************************************************
+ * Multiplies two polynomials (a and b) modulo the CRC polynomial, with bits
+ * reversed as in the CRC itself
+ *
+ * @param a - The first polynomial
+ * @param b - The second polynomial
+ * @return product - a times b modulo the polynomial
+ ******************************************************************************/
+static u_int32_t multmodp(u_int32_t a, u_int32_t b){
+    u_int32_t m = (u_int32_t) 1 << 31, p = 0;
+
+    while(TRUE){
+        if(a & m){
+            p ^= b;
+            if((a & (m - 1)) == 0){
+                break;
+            }
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+/*******************************************************************************
+ * Builds the tables and picks the fastest kernel the CPU supports. Runs
+ * before main, so the tables are ready before any thread could use them.
+ ******************************************************************************/
+__attribute__((constructor))
+static void init_crc32c(void){
+    u_int32_t crc, p;
+    int n, k;
+
+    for(n = 0; n < 256; n++){
+        crc = (u_int32_t) n;
+        for(k = 0; k < 8; k++){
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        }
+        crc_table[0][n] = crc;
+    }
+    for(n = 0; n < 256; n++){
+        for(k = 1; k < 8; k++){
+            crc_table[k][n] = (crc_table[k - 1][n] >> 8) ^
+                              crc_table[0][crc_table[k - 1][n] & 0xFF];
+        }
+    }
+
+    /*x^1, then square it to get x^2, x^4, x^8 and so on*/
+    p = (u_int32_t) 1 << 30;
+    x2n_table[0] = p;
+    for(n = 1; n < 32; n++){
+        p = multmodp(p, p);
+        x2n_table[n] = p;
+    }
+
+#ifdef HAVE_SSE42
+    __builtin_cpu_init();
+    if(set_crc32c_kernel("sse4.2")){
+        return;
+    }
+#endif
+    set_crc32c_kernel("slice8");
+}
+
+/*******************************************************************************
+ * Continues a CRC32C (crc) over len more bytes (buf). Start from 0, so that
+ * crc32c(crc32c(0, a, n), b, m) is the CRC of a followed by b.
+ *
+ * @param crc - The CRC of the bytes before buf
+ * @param buf - The bytes to add
+ * @param len - The number of bytes
+ * @return crc - The CRC including buf
+ ******************************************************************************/
+u_int32_t crc32c(u_int32_t crc, const void * buf, size_t len){
+    return ~kernel(~crc, buf, len);
+}
+
+/*******************************************************************************
+ * Returns the operator that crc32c_combine_op uses to append len bytes. It
+ * depends only on len, so it can be computed once for a fixed packet size.
+ *
+ * @param len - The number of bytes that will be appended
+ * @return op - The operator for len bytes
+ ******************************************************************************/
+u_int32_t crc32c_shift(size_t len){
+    u_int32_t p = (u_int32_t) 1 << 31;
+    int k = 3;
+
+    /*x^(8 * len), built from the powers x^(2^k) for the bits of len*/
+    while(len > 0){
+        if(len & 1){
+            p = multmodp(x2n_table[k & 31], p);
+        }
+        len >>= 1;
+        k++;
+    }
+    return p;
+}
+
+/*******************************************************************************
+ * Combines the CRC of some bytes (crc1) with the CRC of the bytes that follow
+ * them (crc2), where op is crc32c_shift of the length of the second part.
+ * Returns the CRC of both parts together.
+ *
+ * @param crc1 - The CRC of the first part
+ * @param crc2 - The CRC of the second part
+ * @param op - crc32c_shift of the length of the second part
+ * @return crc - The CRC of both parts
+ ******************************************************************************/
+u_int32_t crc32c_combine_op(u_int32_t crc1, u_int32_t crc2, u_int32_t op){
+    return multmodp(op, crc1) ^ crc2;
+}
+
+/*******************************************************************************
+ * Combines the CRC of some bytes (crc1) with the CRC of the len2 bytes that
+ * follow them (crc2). Returns the CRC of both parts together.
+ *
+ * @param crc1 - The CRC of the first part
+ * @param crc2 - The CRC of the second part
+ * @param len2 - The length of the second part
+ * @return crc - The CRC of both parts
+ ******************************************************************************/
+u_int32_t crc32c_combine(u_int32_t crc1, u_int32_t crc2, size_t len2){
+    return crc32c_combine_op(crc1, crc2, crc32c_shift(len2));
+}
+
+/*******************************************************************************
+ * Returns the name of the kernel crc32c is using: "sse4.2", "slice8" or
+ * "bytewise"
+ *
+ * @return name - The name of the kernel
+ ******************************************************************************/
+const char * crc32c_kernel(void){
+    return kernel_name;
+}
+
+/*******************************************************************************
+ * Makes crc32c use the kernel called name, if the CPU supports it. Returns
+ * TRUE if the kernel was selected, else FALSE.
+ *
+ * @param name - "sse4.2", "slice8" or "bytewise"
+ * @return TRUE or FALSE - Whether or not the kernel was selected
+ ******************************************************************************/
+bool set_crc32c_kernel(const char * name){
+    if(strcmp(name, "bytewise") == 0){
+        kernel = crc_bytewise;
+        kernel_name = "bytewise";
+    }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    else if(strcmp(name, "slice8") == 0){
+        kernel = crc_slice8;
+        kernel_name = "slice8";
+    }
+#endif
+#ifdef HAVE_SSE42
+    else if(strcmp(name, "sse4.2") == 0 && __builtin_cpu_supports("sse4.2")){
+        kernel = crc_sse42;
+        kernel_name = "sse4.2";
+    }
+#endif
+    else {
+        return FALSE;
+    }
+    return TRUE;
+}
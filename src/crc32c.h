@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * crc32c.h header file
+ * @author Mark Jannenga
+ *
+ * Declares the functions used to compute CRC32C (Castagnoli) checksums, which
+ * can protect RUDP packets in place of the internet checksum. The CRC is
+ * computed with the SSE4.2 crc32 instruction when the CPU has it, and with
+ * slice-by-8 tables otherwise. CRCs of consecutive pieces of a file can be
+ * combined into the CRC of the whole file without reading it again.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_CRC32C_H
+#define PROJECT_4_CRC32C_H
+
+#include "rudp_packet.h"
+
+/*******************************************************************************
+ * Continues a CRC32C (crc) over len more bytes (buf). Start from 0, so that
+ * crc32c(crc32c(0, a, n), b, m) is the CRC of a followed by b.
+ *
+ * @param crc - The CRC of the bytes before buf
+ * @param buf - The bytes to add
+ * @param len - The number of bytes
+ * @return crc - The CRC including buf
+ ******************************************************************************/
+u_int32_t crc32c(u_int32_t crc, const void * buf, size_t len);
+
+/*******************************************************************************
+ * Returns the operator that crc32c_combine_op uses to append len bytes. It
+ * depends only on len, so it can be computed once for a fixed packet size.
+ *
+ * @param len - The number of bytes that will be appended
+ * @return op - The operator for len bytes
+ ******************************************************************************/
+u_int32_t crc32c_shift(size_t len);
+
+/*******************************************************************************
+ * Combines the CRC of some bytes (crc1) with the CRC of the bytes that follow
+ * them (crc2), where op is crc32c_shift of the length of the second part.
+ * Returns the CRC of both parts together.
+ *
+ * @param crc1 - The CRC of the first part
+ * @param crc2 - The CRC of the second part
+ * @param op - crc32c_shift of the length of the second part
+ * @return crc - The CRC of both parts
+ ******************************************************************************/
+u_int32_t crc32c_combine_op(u_int32_t crc1, u_int32_t crc2, u_int32_t op);
+
+/*******************************************************************************
+ * Combines the CRC of some bytes (crc1) with the CRC of the len2 bytes that
+ * follow them (crc2). Returns the CRC of both parts together.
+ *
+ * @param crc1 - The CRC of the first part
+ * @param crc2 - The CRC of the second part
+ * @param len2 - The length of the second part
+ * @return crc - The CRC of both parts
+ ******************************************************************************/
+u_int32_t crc32c_combine(u_int32_t crc1, u_int32_t crc2, size_t len2);
+
+/*******************************************************************************
+ * Returns the name of the kernel crc32c is using: "sse4.2", "slice8" or
+ * "bytewise"
+ *
+ * @return name - The name of the kernel
+ ******************************************************************************/
+const char * crc32c_kernel(void);
+
+/*******************************************************************************
+ * Makes crc32c use the kernel called name, if the CPU supports it. Returns
+ * TRUE if the kernel was selected, else FALSE.
+ *
+ * @param name - "sse4.2", "slice8" or "bytewise"
+ * @return TRUE or FALSE - Whether or not the kernel was selected
+ ******************************************************************************/
+bool set_crc32c_kernel(const char * name);
+
+#endif //PROJECT_4_CRC32C_H
@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * digest.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in digest.h
+ ******************************************************************************/
+
+#include "digest.h"
+#include "crc32c.h"
+
+/*******************************************************************************
+ * Initializes the digest (digest) of a file of a given size (size), sent in
+ * packets of payload bytes, able to hold the CRCs of capacity packets past
+ * the first one not yet received
+ *
+ * @param digest - The digest to initialize
+ * @param capacity - The number of packets that can be waiting
+ * @param size - The size of the file
+ * @param payload - The size of the data segment of each packet
+ ******************************************************************************/
+void init_digest(digest_t * digest, u_int32_t capacity, u_int64_t size,
+                 u_int32_t payload){
+    digest->crcs = calloc(capacity, sizeof(u_int32_t));
+    if(digest->crcs == NULL){
+        fprintf(stderr, "Could not allocate file digest\n");
+        exit(1);
+    }
+    digest->capacity = capacity;
+    digest->next = 0;
+    digest->crc = 0;
+    digest->shift = crc32c_shift(payload);
+    digest->size = size;
+    digest->payload = payload;
+}
+
+/*******************************************************************************
+ * Frees the ring buffer of the digest (digest)
+ *
+ * @param digest - The digest to free
+ ******************************************************************************/
+void free_digest(digest_t * digest){
+    free(digest->crcs);
+    digest->crcs = NULL;
+}
+
+/*******************************************************************************
+ * Keeps the CRC32C (crc) of the data of packet seq_num until the digest
+ * (digest) reaches it
+ *
+ * @param digest - The digest
+ * @param seq_num - The sequence number of the packet
+ * @param crc - The CRC32C of the packet's data
+ ******************************************************************************/
+void add_packet_crc(digest_t * digest, u_int64_t seq_num, u_int32_t crc){
+    digest->crcs[seq_num % digest->capacity] = crc;
+}
+
+/*******************************************************************************
+ * Combines the CRCs of the packets before cum_ack, which have all arrived,
+ * into the digest (digest)
+ *
+ * @param digest - The digest to advance
+ * @param cum_ack - The first packet not yet received
+ ******************************************************************************/
+void advance_digest(digest_t * digest, u_int64_t cum_ack){
+    u_int64_t offset, len;
+    u_int32_t crc;
+
+    while(digest->next != cum_ack){
+        crc = digest->crcs[digest->next % digest->capacity];
+
+        /*Every packet is full except perhaps the last one*/
+        offset = (u_int64_t) digest->payload * digest->next;
+        len = digest->size > offset ? digest->size - offset : 0;
+        if(len >= digest->payload){
+            digest->crc = crc32c_combine_op(digest->crc, crc, digest->shift);
+        }
+        else {
+            digest->crc = crc32c_combine(digest->crc, crc, (size_t) len);
+        }
+        digest->next++;
+    }
+}
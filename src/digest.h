@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * digest.h header file
+ * @author Mark Jannenga
+ *
+ * Defines custom structs and declares functions used by the client to build
+ * the CRC32C of the whole file as it is received. Packets may arrive out of
+ * order, so the CRC of each packet's data is kept until every packet before
+ * it has arrived, and is then combined into the digest. The data itself is
+ * never read again.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_DIGEST_H
+#define PROJECT_4_DIGEST_H
+
+#include "rudp_packet.h"
+
+/*Custom struct for the digest of a file. The CRC of packet seq_num is kept at
+ * index seq_num % capacity until the digest reaches it*/
+struct digest_t{
+    u_int32_t *crcs;                //Ring buffer of CRCs of packet data
+    u_int32_t capacity;             //Number of CRCs in the ring buffer
+    u_int64_t next;                 //First packet not yet in the digest
+    u_int32_t crc;                  //CRC32C of the file before packet next
+    u_int32_t shift;                //crc32c_shift of a full packet of data
+    u_int64_t size;                 //Size of the file
+    u_int32_t payload;              //Data in each packet but the last
+};
+
+/*Typedefs*/
+typedef struct digest_t digest_t;
+
+/*******************************************************************************
+ * Initializes the digest (digest) of a file of a given size (size), sent in
+ * packets of payload bytes, able to hold the CRCs of capacity packets past
+ * the first one not yet received
+ *
+ * @param digest - The digest to initialize
+ * @param capacity - The number of packets that can be waiting
+ * @param size - The size of the file
+ * @param payload - The size of the data segment of each packet
+ ******************************************************************************/
+void init_digest(digest_t * digest, u_int32_t capacity, u_int64_t size,
+                 u_int32_t payload);
+
+/*******************************************************************************
+ * Frees the ring buffer of the digest (digest)
+ *
+ * @param digest - The digest to free
+ ******************************************************************************/
+void free_digest(digest_t * digest);
+
+/*******************************************************************************
+ * Keeps the CRC32C (crc) of the data of packet seq_num until the digest
+ * (digest) reaches it
+ *
+ * @param digest - The digest
+ * @param seq_num - The sequence number of the packet
+ * @param crc - The CRC32C of the packet's data
+ ******************************************************************************/
+void add_packet_crc(digest_t * digest, u_int64_t seq_num, u_int32_t crc);
+
+/*******************************************************************************
+ * Combines the CRCs of the packets before cum_ack, which have all arrived,
+ * into the digest (digest)
+ *
+ * @param digest - The digest to advance
+ * @param cum_ack - The first packet not yet received
+ ******************************************************************************/
+void advance_digest(digest_t * digest, u_int64_t cum_ack);
+
+#endif //PROJECT_4_DIGEST_H
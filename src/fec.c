@@ -0,0 +1,1035 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * fec.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in fec.h
+ ******************************************************************************/
+
+#include "fec.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+#define GF_POLY 0x11D       /*x^8 + x^4 + x^3 + x^2 + 1, the field's modulus*/
+
+/*A kernel adds len bytes at src, multiplied by c, into dst*/
+typedef void (*gf_kernel_t)(unsigned char *dst, const unsigned char *src,
+                            u_int8_t c, size_t len);
+
+/*Tables of GF(2^8), built before main runs. Products of c are also kept as
+ * the products of the low and high 4 bits of a byte, for the vector kernels*/
+static u_int8_t gf_exp[512];
+static u_int8_t gf_log[256];
+static u_int8_t gf_table[256][256];
+static u_int8_t gf_nibbles[256][2][16];
+
+/*******************************************************************************
+ * Adds a region (src) of len bytes, multiplied by c, into dst a byte at a
+ * time from the table of products. With c of 1, 8 bytes are XORed at a time.
+ *
+ * @param dst - The region added to
+ * @param src - The region multiplied
+ * @param c - The constant
+ * @param len - The number of bytes
+ ******************************************************************************/
+static void mul_add_scalar(unsigned char *dst, const unsigned char *src,
+                           u_int8_t c, size_t len){
+    const u_int8_t * row = gf_table[c];
+    u_int64_t a, b;
+    size_t i = 0;
+
+    if(c == 1){
+        for(; i + 8 <= len; i += 8){
+            memcpy(&a, dst + i, 8);
+            memcpy(&b, src + i, 8);
+            a ^= b;
+            memcpy(dst + i, &a, 8);
+        }
+        for(; i < len; i++){
+            dst[i] ^= src[i];
+        }
+        return;
+    }
+    for(; i < len; i++){
+        dst[i] ^= row[src[i]];
+    }
+}
+
+#ifdef HAVE_X86
+/*******************************************************************************
+ * Adds a region (src) multiplied by c into dst 16 bytes at a time with SSSE3.
+ * Each byte is split into its low and high 4 bits, whose products are looked
+ * up with a shuffle and XORed together, and the rest is left to
+ * mul_add_scalar.
+ *
+ * @param dst - The region added to
+ * @param src - The region multiplied
+ * @param c - The constant
+ * @param len - The number of bytes
+ ******************************************************************************/
+__attribute__((target("ssse3")))
+static void mul_add_ssse3(unsigned char *dst, const unsigned char *src,
+                          u_int8_t c, size_t len){
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    const __m128i lo = _mm_loadu_si128((const __m128i *) gf_nibbles[c][0]);
+    const __m128i hi = _mm_loadu_si128((const __m128i *) gf_nibbles[c][1]);
+    __m128i v, d;
+    size_t i = 0;
+
+    for(; i + 16 <= len; i += 16){
+        v = _mm_loadu_si128((const __m128i *) (src + i));
+        d = _mm_loadu_si128((const __m128i *) (dst + i));
+        if(c != 1){
+            v = _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(v, mask)),
+                              _mm_shuffle_epi8(hi, _mm_and_si128(
+                                      _mm_srli_epi64(v, 4), mask)));
+        }
+        _mm_storeu_si128((__m128i *) (dst + i), _mm_xor_si128(d, v));
+    }
+    mul_add_scalar(dst + i, src + i, c, len - i);
+}
+
+/*******************************************************************************
+ * Adds a region (src) multiplied by c into dst 32 bytes at a time with AVX2,
+ * in the same way as mul_add_ssse3
+ *
+ * @param dst - The region added to
+ * @param src - The region multiplied
+ * @param c - The constant
+ * @param len - The number of bytes
+ ******************************************************************************/
+__attribute__((target("avx2")))
+static void mul_add_avx2(unsigned char *dst, const unsigned char *src,
+                         u_int8_t c, size_t len){
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    const __m256i lo = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) gf_nibbles[c][0]));
+    const __m256i hi = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128((const __m128i *) gf_nibbles[c][1]));
+    __m256i v, d;
+    size_t i = 0;
+
+    for(; i + 32 <= len; i += 32){
+        v = _mm256_loadu_si256((const __m256i *) (src + i));
+        d = _mm256_loadu_si256((const __m256i *) (dst + i));
+        if(c != 1){
+            v = _mm256_xor_si256(
+                    _mm256_shuffle_epi8(lo, _mm256_and_si256(v, mask)),
+                    _mm256_shuffle_epi8(hi, _mm256_and_si256(
+                            _mm256_srli_epi64(v, 4), mask)));
+        }
+        _mm256_storeu_si256((__m256i *) (dst + i), _mm256_xor_si256(d, v));
+    }
+    mul_add_scalar(dst + i, src + i, c, len - i);
+}
+#endif
+
+/*The kernel in use, chosen before main runs*/
+static gf_kernel_t kernel = mul_add_scalar;
+static const char * kernel_name = "scalar";
+
+/*******************************************************************************
+ * Builds the tables of GF(2^8) and picks the fastest kernel the CPU
+ * supports. Runs before main, so it is done before any thread could use them.
+ ******************************************************************************/
+__attribute__((constructor))
+static void init_fec(void){
+    unsigned int x = 1, i, a, b;
+
+    /*Powers of the generator 2, twice over so products need no modulo*/
+    for(i = 0; i < 255; i++){
+        gf_exp[i] = (u_int8_t) x;
+        gf_exp[i + 255] = (u_int8_t) x;
+        gf_log[x] = (u_int8_t) i;
+        x <<= 1;
+        if(x & 0x100){
+            x ^= GF_POLY;
+        }
+    }
+    gf_exp[510] = gf_exp[0];
+    gf_exp[511] = gf_exp[1];
+    for(a = 1; a < 256; a++){
+        for(b = 1; b < 256; b++){
+            gf_table[a][b] = gf_exp[gf_log[a] + gf_log[b]];
+        }
+    }
+    for(a = 0; a < 256; a++){
+        for(i = 0; i < 16; i++){
+            gf_nibbles[a][0][i] = gf_table[a][i];
+            gf_nibbles[a][1][i] = gf_table[a][i << 4];
+        }
+    }
+
+#ifdef HAVE_X86
+    __builtin_cpu_init();
+    if(!set_fec_kernel("avx2")){
+        set_fec_kernel("ssse3");
+    }
+#endif
+}
+
+/*******************************************************************************
+ * Multiplies two elements (a and b) of GF(2^8)
+ *
+ * @param a - The first element
+ * @param b - The second element
+ * @return product - The product
+ ******************************************************************************/
+u_int8_t gf_mul(u_int8_t a, u_int8_t b){
+    return gf_table[a][b];
+}
+
+/*******************************************************************************
+ * Returns the inverse of a non-zero element (a) of GF(2^8)
+ *
+ * @param a - The element
+ * @return inverse - The inverse
+ ******************************************************************************/
+u_int8_t gf_inv(u_int8_t a){
+    return gf_exp[255 - gf_log[a]];
+}
+
+/*******************************************************************************
+ * Adds a region (src) of len bytes, multiplied by a constant (c) of GF(2^8),
+ * into another region (dst). Addition is XOR, so with c of 1 this is an XOR
+ * of the regions.
+ *
+ * @param dst - The region added to
+ * @param src - The region multiplied
+ * @param c - The constant
+ * @param len - The number of bytes
+ ******************************************************************************/
+void gf_mul_add(unsigned char * dst, const unsigned char * src, u_int8_t c,
+                size_t len){
+    if(c != 0){
+        kernel(dst, src, c, len);
+    }
+}
+
+/*******************************************************************************
+ * Returns the name of the kernel gf_mul_add is using: "scalar", "ssse3" or
+ * "avx2"
+ *
+ * @return name - The name of the kernel
+ ******************************************************************************/
+const char * fec_kernel(void){
+    return kernel_name;
+}
+
+/*******************************************************************************
+ * Makes gf_mul_add use the kernel called name, if the CPU supports it.
+ * Returns TRUE if the kernel was selected, else FALSE.
+ *
+ * @param name - "scalar", "ssse3" or "avx2"
+ * @return TRUE or FALSE - Whether or not the kernel was selected
+ ******************************************************************************/
+bool set_fec_kernel(const char * name){
+    if(strcmp(name, "scalar") == 0){
+        kernel = mul_add_scalar;
+        kernel_name = "scalar";
+    }
+#ifdef HAVE_X86
+    else if(strcmp(name, "ssse3") == 0 && __builtin_cpu_supports("ssse3")){
+        kernel = mul_add_ssse3;
+        kernel_name = "ssse3";
+    }
+    else if(strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")){
+        kernel = mul_add_avx2;
+        kernel_name = "avx2";
+    }
+#endif
+    else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Returns the coefficient that data packet col of a block is multiplied by
+ * in parity packet row, for a block with a given number of parity packets
+ * (parity) and a given code (code)
+ *
+ * @param code - FEC_XOR or FEC_RS
+ * @param row - The parity packet
+ * @param col - The data packet
+ * @param parity - The number of parity packets of the block
+ * @return coef - The coefficient
+ ******************************************************************************/
+u_int8_t fec_coef(u_int32_t code, u_int32_t row, u_int32_t col,
+                  u_int32_t parity){
+    if(code == FEC_XOR){
+        return col % parity == row ? 1 : 0;
+    }
+
+    /*An element of the Cauchy matrix 1 / (x_row + y_col), with every x
+     * past every y, so no sum is zero and every square part of the matrix
+     * can be inverted*/
+    return gf_inv((u_int8_t) ((FEC_MAX_DATA + row) ^ col));
+}
+
+/*******************************************************************************
+ * Raises a number (base) to a whole power (exp)
+ *
+ * @param base - The number
+ * @param exp - The power
+ * @return result - base to the power exp
+ ******************************************************************************/
+static double power(double base, u_int32_t exp){
+    double result = 1.0;
+
+    while(exp-- > 0){
+        result *= base;
+    }
+    return result;
+}
+
+/*******************************************************************************
+ * Returns the chance that a block of count data packets and parity parity
+ * packets cannot be rebuilt with a given code (code), if packets are lost at
+ * random at a given rate (loss). Reed-Solomon parity fails if more than
+ * parity packets are lost, and XOR parity if more than one of a row and the
+ * data packets it covers is lost.
+ *
+ * @param code - FEC_XOR or FEC_RS
+ * @param count - The number of data packets
+ * @param parity - The number of parity packets
+ * @param loss - The loss rate, from 0 to 1
+ * @return chance - The chance the block cannot be rebuilt
+ ******************************************************************************/
+static double block_failure(u_int32_t code, u_int32_t count, u_int32_t parity,
+                            double loss){
+    double keep = 1.0 - loss, term, held, success = 1.0;
+    u_int32_t n, x, row;
+
+    if(code == FEC_XOR){
+        for(row = 0; row < parity; row++){
+            n = count / parity + (row < count % parity ? 1 : 0) + 1;
+            success *= power(keep, n) + n * loss * power(keep, n - 1);
+        }
+        return 1.0 - success;
+    }
+
+    /*Add up the binomial chances of losing 0 to parity packets*/
+    n = count + parity;
+    term = power(keep, n);
+    held = term;
+    for(x = 0; x < parity; x++){
+        term *= (double) (n - x) / (x + 1) * loss / keep;
+        held += term;
+    }
+    return 1.0 - held;
+}
+
+/*******************************************************************************
+ * Returns the fewest parity packets that let a block of count data packets
+ * be rebuilt with a given code (code) at least 1 - FEC_TARGET of the time,
+ * if packets are lost at random at a given rate (loss)
+ *
+ * @param code - FEC_XOR or FEC_RS
+ * @param count - The number of data packets in the block
+ * @param loss - The loss rate, from 0 to 1
+ * @return parity - The number of parity packets, from 1 to FEC_MAX_PARITY
+ ******************************************************************************/
+u_int32_t fec_choose_parity(u_int32_t code, u_int32_t count, double loss){
+    u_int32_t parity, most = FEC_MAX_PARITY;
+
+    /*XOR rows past the number of data packets would cover nothing*/
+    if(code == FEC_XOR && count < most){
+        most = count > 0 ? count : 1;
+    }
+    if(loss > 0.5){
+        loss = 0.5;
+    }
+    for(parity = 1; parity < most; parity++){
+        if(loss <= 0 || block_failure(code, count, parity, loss) <=
+                FEC_TARGET){
+            return parity;
+        }
+    }
+    return most;
+}
+
+/*******************************************************************************
+ * Reads a code and block size (block) from a setting (spec) of the form
+ * xor or rs, optionally followed by a colon and the number of data packets
+ * per block. Returns the code, or 0 if the setting is not valid.
+ *
+ * @param spec - The setting
+ * @param block - The location to store the block size
+ * @return code - FEC_XOR or FEC_RS, or 0
+ ******************************************************************************/
+u_int32_t parse_fec(const char * spec, u_int32_t * block){
+    const char * colon = strchr(spec, ':');
+    size_t len = colon != NULL ? (size_t) (colon - spec) : strlen(spec);
+    unsigned long n;
+    u_int32_t code;
+    char * end;
+
+    if(len == 3 && strncmp(spec, "xor", 3) == 0){
+        code = FEC_XOR;
+    }
+    else if(len == 2 && strncmp(spec, "rs", 2) == 0){
+        code = FEC_RS;
+    }
+    else {
+        return 0;
+    }
+    *block = FEC_BLOCK;
+    if(colon != NULL){
+        n = strtoul(colon + 1, &end, 10);
+        if(end == colon + 1 || *end != '\0' || n < 2 || n > FEC_MAX_DATA){
+            return 0;
+        }
+        *block = (u_int32_t) n;
+    }
+    return code;
+}
+
+/*******************************************************************************
+ * Returns the name of a code (code): "xor", "rs" or "none"
+ *
+ * @param code - FEC_XOR, FEC_RS or 0
+ * @return name - The name of the code
+ ******************************************************************************/
+const char * fec_name(u_int32_t code){
+    switch(code){
+        case FEC_XOR: return "xor";
+        case FEC_RS: return "rs";
+        default: return "none";
+    }
+}
+
+/*******************************************************************************
+ * Returns the start of parity packet row of a set (set) of a server's parity
+ * (enc)
+ *
+ * @param enc - The parity of the server
+ * @param set - The set
+ * @param row - The parity packet
+ * @return packet - The start of the packet
+ ******************************************************************************/
+static unsigned char * parity_at(fec_encoder_t * enc, u_int32_t set,
+                                 u_int32_t row){
+    return enc->buffers + (size_t) (set * FEC_MAX_PARITY + row) *
+                          (size_t) enc->packet_size;
+}
+
+/*******************************************************************************
+ * Initializes the parity of a server (enc) for a code (code), with block data
+ * packets per block, each carrying up to payload bytes
+ *
+ * @param enc - The parity to initialize
+ * @param code - FEC_XOR or FEC_RS
+ * @param block - The number of data packets per block
+ * @param payload - The size of the data segment of each packet
+ ******************************************************************************/
+void init_fec_encoder(fec_encoder_t * enc, u_int32_t code, u_int32_t block,
+                      u_int32_t payload){
+    memset(enc, 0, sizeof(fec_encoder_t));
+    enc->code = code;
+    enc->block = block;
+    enc->payload = payload;
+    enc->packet_size = RUDP_HEAD + (int) sizeof(parity_t) + (int) payload;
+    enc->buffers = calloc(FEC_SETS * FEC_MAX_PARITY,
+                          (size_t) enc->packet_size);
+    if(enc->buffers == NULL){
+        fprintf(stderr, "Could not allocate parity packets\n");
+        exit(1);
+    }
+    enc->loss = FEC_INITIAL_LOSS;
+    enc->parity = fec_choose_parity(code, block, enc->loss);
+
+    /*Nothing is encoded until the first block starts*/
+    enc->broken = TRUE;
+}
+
+/*******************************************************************************
+ * Frees the parity packets of a server (enc)
+ *
+ * @param enc - The parity to free
+ ******************************************************************************/
+void free_fec_encoder(fec_encoder_t * enc){
+    free(enc->buffers);
+    enc->buffers = NULL;
+}
+
+/*******************************************************************************
+ * Adds a data packet (seq) holding len bytes of data (data) to the parity of
+ * its block. Packets must be added in order, as they are first sent. Once
+ * the block is complete, or the packet is the last of the file (last), the
+ * parity packets of the block are made, with every field but the flags,
+ * session, timestamp and checksum, and their number is returned. They are
+ * found with get_parity until the next block is finished. A block missing a
+ * packet gets no parity.
+ *
+ * @param enc - The parity of the server
+ * @param seq - The sequence number of the packet
+ * @param data - The data of the packet
+ * @param len - The length of the data
+ * @param last - Whether it is the last packet of the file
+ * @return parity - The number of parity packets made, or 0
+ ******************************************************************************/
+u_int32_t encode_packet(fec_encoder_t * enc, u_int64_t seq,
+                        const unsigned char * data, int len, bool last){
+    const size_t head = (size_t) RUDP_HEAD + sizeof(parity_t);
+    rudp_packet_t * pkt;
+    parity_t body;
+    u_int32_t row, col;
+
+    /*A block starts at every multiple of block packets, and its parity is
+     * summed from zero in the next set*/
+    if(seq % enc->block == 0){
+        enc->first = seq;
+        enc->count = 0;
+        enc->broken = FALSE;
+        enc->block_parity = enc->parity;
+        for(row = 0; row < enc->block_parity; row++){
+            memset(parity_at(enc, enc->set, row) + head, 0, enc->payload);
+        }
+    }
+    else if(seq != enc->next){
+        enc->broken = TRUE;
+    }
+    enc->next = seq + 1;
+    if(enc->broken || len <= 0){
+        return 0;
+    }
+
+    /*Each XOR row only covers every block_parity-th packet*/
+    col = (u_int32_t) (seq - enc->first);
+    if(enc->code == FEC_XOR){
+        gf_mul_add(parity_at(enc, enc->set, col % enc->block_parity) + head,
+                   data, 1, (size_t) len);
+    }
+    else {
+        for(row = 0; row < enc->block_parity; row++){
+            gf_mul_add(parity_at(enc, enc->set, row) + head, data,
+                       fec_coef(enc->code, row, col, enc->block_parity),
+                       (size_t) len);
+        }
+    }
+    enc->count++;
+    if(enc->count < enc->block && !last){
+        return 0;
+    }
+
+    /*The block is complete, so fill in the headers of its parity*/
+    body.count = htons((u_int16_t) enc->count);
+    body.parity = htons((u_int16_t) enc->block_parity);
+    body.code = htons((u_int16_t) enc->code);
+    for(row = 0; row < enc->block_parity; row++){
+        pkt = (rudp_packet_t *) parity_at(enc, enc->set, row);
+        init_header(pkt, PARITY, enc->first,
+                    (u_int16_t) (sizeof(parity_t) + enc->payload));
+        body.index = htons((u_int16_t) row);
+        memcpy(pkt->data, &body, sizeof(parity_t));
+    }
+    enc->ready = enc->set;
+    enc->set = (enc->set + 1) % FEC_SETS;
+    enc->broken = TRUE;
+    return enc->block_parity;
+}
+
+/*******************************************************************************
+ * Returns parity packet row of the block last finished by encode_packet
+ *
+ * @param enc - The parity of the server
+ * @param row - The parity packet
+ * @return pkt - The parity packet
+ ******************************************************************************/
+rudp_packet_t * get_parity(fec_encoder_t * enc, u_int32_t row){
+    return (rudp_packet_t *) parity_at(enc, enc->ready, row);
+}
+
+/*******************************************************************************
+ * Takes the counts a client reported in a SACK (expected and lost), and
+ * moves the estimated loss rate toward the rate since the last report once
+ * FEC_SAMPLE packets have been counted. The first such sample replaces the
+ * initial guess outright. The number of parity packets of each
+ * later block is chosen for the new rate. Reports older than one already
+ * taken are ignored.
+ *
+ * @param enc - The parity of the server
+ * @param expected - The packets of the blocks the client closed
+ * @param lost - Of those, the packets that never arrived
+ ******************************************************************************/
+void fec_feedback(fec_encoder_t * enc, u_int32_t expected, u_int32_t lost){
+    u_int32_t more_expected = expected - enc->report_expected;
+    u_int32_t more_lost = lost - enc->report_lost;
+    double rate;
+
+    /*The counts only grow, so a report that is not ahead was reordered*/
+    if((int32_t) more_expected <= 0 || more_lost > more_expected){
+        return;
+    }
+    enc->report_expected = expected;
+    enc->report_lost = lost;
+    enc->sample_expected += more_expected;
+    enc->sample_lost += more_lost;
+    if(enc->sample_expected < FEC_SAMPLE){
+        return;
+    }
+    rate = (double) enc->sample_lost / (double) enc->sample_expected;
+    if(enc->measured){
+        enc->loss += FEC_GAIN * (rate - enc->loss);
+    }else{
+        enc->loss = rate;
+        enc->measured = TRUE;
+    }
+    enc->sample_expected = 0;
+    enc->sample_lost = 0;
+    enc->parity = fec_choose_parity(enc->code, enc->block, enc->loss);
+}
+
+/*******************************************************************************
+ * Initializes the blocks of a client (dec) receiving a file of file_size
+ * bytes in packets of payload bytes, protected by a code (code) with block
+ * data packets per block. As many blocks are held as fit in FEC_MEMORY.
+ *
+ * @param dec - The blocks to initialize
+ * @param code - FEC_XOR or FEC_RS
+ * @param block - The number of data packets per block
+ * @param payload - The size of the data segment of each packet
+ * @param file_size - The size of the file
+ ******************************************************************************/
+void init_fec_decoder(fec_decoder_t * dec, u_int32_t code, u_int32_t block,
+                      u_int32_t payload, u_int64_t file_size){
+    size_t block_bytes = (size_t) (block + FEC_MAX_PARITY) * payload;
+    u_int64_t blocks;
+    u_int32_t i;
+
+    memset(dec, 0, sizeof(fec_decoder_t));
+    dec->code = code;
+    dec->block = block;
+    dec->payload = payload;
+    dec->file_size = file_size;
+    dec->packets = (file_size + payload - 1) / payload;
+
+    /*Hold no more blocks than the file has*/
+    blocks = (dec->packets + block - 1) / block;
+    dec->ring = (u_int32_t) (FEC_MEMORY / block_bytes);
+    if(dec->ring < FEC_MIN_BLOCKS){
+        dec->ring = FEC_MIN_BLOCKS;
+    }
+    if(dec->ring > FEC_MAX_BLOCKS){
+        dec->ring = FEC_MAX_BLOCKS;
+    }
+    if(blocks < dec->ring){
+        dec->ring = blocks > 0 ? (u_int32_t) blocks : 1;
+    }
+    dec->blocks = calloc(dec->ring, sizeof(fec_block_t));
+    dec->memory = malloc(dec->ring * block_bytes);
+    if(dec->blocks == NULL || dec->memory == NULL){
+        fprintf(stderr, "Could not allocate %u FEC blocks\n", dec->ring);
+        exit(1);
+    }
+    for(i = 0; i < dec->ring; i++){
+        dec->blocks[i].data = dec->memory + i * block_bytes;
+    }
+}
+
+/*******************************************************************************
+ * Frees the blocks of a client (dec)
+ *
+ * @param dec - The blocks to free
+ ******************************************************************************/
+void free_fec_decoder(fec_decoder_t * dec){
+    free(dec->blocks);
+    free(dec->memory);
+    dec->blocks = NULL;
+    dec->memory = NULL;
+}
+
+/*******************************************************************************
+ * Returns the start of packet i of a block (blk): data packets come first,
+ * then parity packets from index block
+ *
+ * @param dec - The blocks of the client
+ * @param blk - The block
+ * @param i - The packet
+ * @return packet - The start of the packet, payload bytes long
+ ******************************************************************************/
+static unsigned char * packet_at(fec_decoder_t * dec, fec_block_t * blk,
+                                 u_int32_t i){
+    return blk->data + (size_t) i * dec->payload;
+}
+
+/*******************************************************************************
+ * Returns the number of data packets in a block (index) of the file
+ *
+ * @param dec - The blocks of the client
+ * @param index - The number of the block
+ * @return count - The number of data packets
+ ******************************************************************************/
+static u_int32_t block_count(fec_decoder_t * dec, u_int64_t index){
+    u_int64_t count = dec->packets - index * dec->block;
+
+    return count < dec->block ? (u_int32_t) count : dec->block;
+}
+
+/*******************************************************************************
+ * Closes every block before a given one (index), counting the packets each
+ * was sent and how many of those never arrived. A block that no packet of
+ * arrived is counted with the parity of the latest block.
+ *
+ * @param dec - The blocks of the client
+ * @param index - The first block left open
+ ******************************************************************************/
+static void close_blocks(fec_decoder_t * dec, u_int64_t index){
+    fec_block_t * blk;
+    u_int64_t sent, arrived;
+
+    while(dec->closed < index){
+        blk = &dec->blocks[dec->closed % dec->ring];
+        sent = block_count(dec, dec->closed) + dec->last_parity;
+        arrived = 0;
+        if(blk->used && blk->index == dec->closed){
+            if(blk->parity != 0){
+                sent = block_count(dec, dec->closed) + blk->parity;
+            }
+            arrived = blk->arrived < sent ? blk->arrived : sent;
+        }
+        dec->expected += sent;
+        dec->lost += sent - arrived;
+        dec->closed++;
+    }
+}
+
+/*******************************************************************************
+ * Returns the block (index) of the file, starting it in the ring if it is
+ * new, after closing every block before it. Returns NULL if the block is past
+ * the end of the file, or so old that a later block has taken its place.
+ *
+ * @param dec - The blocks of the client
+ * @param index - The number of the block
+ * @return blk - The block, or NULL
+ ******************************************************************************/
+static fec_block_t * get_block(fec_decoder_t * dec, u_int64_t index){
+    fec_block_t * blk = &dec->blocks[index % dec->ring];
+
+    if(index * dec->block >= dec->packets){
+        return NULL;
+    }
+    close_blocks(dec, index);
+    if(blk->used && blk->index == index){
+        return blk;
+    }
+    if(blk->used && blk->index > index){
+        return NULL;
+    }
+    blk->index = index;
+    blk->used = TRUE;
+    blk->complete = FALSE;
+    blk->count = block_count(dec, index);
+    blk->parity = 0;
+    blk->have_data = 0;
+    blk->have_parity = 0;
+    blk->arrived = 0;
+    memset(blk->have, 0, sizeof(blk->have));
+    return blk;
+}
+
+/*******************************************************************************
+ * Marks data packet col of a block (blk) as held, having been rebuilt
+ *
+ * @param dec - The blocks of the client
+ * @param blk - The block
+ * @param col - The data packet
+ ******************************************************************************/
+static void mark_rebuilt(fec_decoder_t * dec, fec_block_t * blk,
+                         u_int32_t col){
+    blk->have[col] = 1;
+    blk->have_data++;
+    dec->rebuilt[dec->rebuilt_count++] = blk->index * dec->block + col;
+}
+
+/*******************************************************************************
+ * Inverts an n by n matrix (matrix) of GF(2^8) into inverse by Gauss-Jordan
+ * elimination, destroying the matrix. Returns FALSE if it cannot be inverted.
+ *
+ * @param matrix - The matrix
+ * @param inverse - The location to store the inverse
+ * @param n - The size of the matrix
+ * @return TRUE or FALSE - Whether or not the matrix was inverted
+ ******************************************************************************/
+static bool invert(u_int8_t matrix[][FEC_MAX_PARITY],
+                   u_int8_t inverse[][FEC_MAX_PARITY], u_int32_t n){
+    u_int8_t swap, scale, factor;
+    u_int32_t row, col, pivot, k;
+
+    for(row = 0; row < n; row++){
+        for(col = 0; col < n; col++){
+            inverse[row][col] = row == col ? 1 : 0;
+        }
+    }
+    for(col = 0; col < n; col++){
+        for(pivot = col; pivot < n && matrix[pivot][col] == 0; pivot++){
+        }
+        if(pivot == n){
+            return FALSE;
+        }
+        for(k = 0; k < n; k++){
+            swap = matrix[col][k];
+            matrix[col][k] = matrix[pivot][k];
+            matrix[pivot][k] = swap;
+            swap = inverse[col][k];
+            inverse[col][k] = inverse[pivot][k];
+            inverse[pivot][k] = swap;
+        }
+        scale = gf_inv(matrix[col][col]);
+        for(k = 0; k < n; k++){
+            matrix[col][k] = gf_mul(matrix[col][k], scale);
+            inverse[col][k] = gf_mul(inverse[col][k], scale);
+        }
+        for(row = 0; row < n; row++){
+            factor = matrix[row][col];
+            if(row == col || factor == 0){
+                continue;
+            }
+            for(k = 0; k < n; k++){
+                matrix[row][k] ^= gf_mul(factor, matrix[col][k]);
+                inverse[row][k] ^= gf_mul(factor, inverse[col][k]);
+            }
+        }
+    }
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Rebuilds the missing data packets of a block (blk) that XOR parity allows:
+ * each one that is the only packet missing from a row whose parity is held
+ *
+ * @param dec - The blocks of the client
+ * @param blk - The block
+ ******************************************************************************/
+static void rebuild_xor(fec_decoder_t * dec, fec_block_t * blk){
+    u_int32_t row, col, missing, lost;
+    unsigned char * dst;
+
+    for(row = 0; row < blk->parity; row++){
+        if(!blk->have[dec->block + row]){
+            continue;
+        }
+        missing = 0;
+        lost = 0;
+        for(col = row; col < blk->count; col += blk->parity){
+            if(!blk->have[col]){
+                missing = col;
+                lost++;
+            }
+        }
+        if(lost != 1){
+            continue;
+        }
+
+        /*The missing packet is the parity with the rest of its row removed*/
+        dst = packet_at(dec, blk, missing);
+        memcpy(dst, packet_at(dec, blk, dec->block + row), dec->payload);
+        for(col = row; col < blk->count; col += blk->parity){
+            if(col != missing){
+                gf_mul_add(dst, packet_at(dec, blk, col), 1, dec->payload);
+            }
+        }
+        mark_rebuilt(dec, blk, missing);
+    }
+}
+
+/*******************************************************************************
+ * Rebuilds every missing data packet of a block (blk) with Reed-Solomon
+ * parity, if at least as many parity packets as missing packets are held.
+ * The data packets that arrived are taken out of that many parity packets,
+ * leaving sums of the missing packets alone, and those sums are multiplied by
+ * the inverse of their coefficients. The parity packets used are overwritten.
+ *
+ * @param dec - The blocks of the client
+ * @param blk - The block
+ ******************************************************************************/
+static void rebuild_rs(fec_decoder_t * dec, fec_block_t * blk){
+    u_int8_t matrix[FEC_MAX_PARITY][FEC_MAX_PARITY];
+    u_int8_t inverse[FEC_MAX_PARITY][FEC_MAX_PARITY];
+    u_int32_t rows[FEC_MAX_PARITY], cols[FEC_MAX_PARITY];
+    u_int32_t missing = blk->count - blk->have_data, n, r, c, col;
+    unsigned char * sum, * dst;
+
+    if(missing > blk->have_parity){
+        return;
+    }
+    for(n = 0, r = 0; r < blk->parity && n < missing; r++){
+        if(blk->have[dec->block + r]){
+            rows[n++] = r;
+        }
+    }
+    for(n = 0, col = 0; col < blk->count; col++){
+        if(!blk->have[col]){
+            cols[n++] = col;
+        }
+    }
+    for(r = 0; r < missing; r++){
+        for(c = 0; c < missing; c++){
+            matrix[r][c] = fec_coef(FEC_RS, rows[r], cols[c], blk->parity);
+        }
+    }
+    if(!invert(matrix, inverse, missing)){
+        return;
+    }
+
+    for(r = 0; r < missing; r++){
+        sum = packet_at(dec, blk, dec->block + rows[r]);
+        for(col = 0; col < blk->count; col++){
+            if(blk->have[col]){
+                gf_mul_add(sum, packet_at(dec, blk, col),
+                           fec_coef(FEC_RS, rows[r], col, blk->parity),
+                           dec->payload);
+            }
+        }
+    }
+    for(c = 0; c < missing; c++){
+        dst = packet_at(dec, blk, cols[c]);
+        memset(dst, 0, dec->payload);
+        for(r = 0; r < missing; r++){
+            gf_mul_add(dst, packet_at(dec, blk, dec->block + rows[r]),
+                       inverse[c][r], dec->payload);
+        }
+    }
+    for(c = 0; c < missing; c++){
+        mark_rebuilt(dec, blk, cols[c]);
+    }
+}
+
+/*******************************************************************************
+ * Rebuilds what it can of the missing data packets of a block (blk). Returns
+ * the number rebuilt.
+ *
+ * @param dec - The blocks of the client
+ * @param blk - The block
+ * @return rebuilt - The number of packets rebuilt
+ ******************************************************************************/
+static u_int32_t rebuild(fec_decoder_t * dec, fec_block_t * blk){
+    if(blk->complete || blk->have_parity == 0 ||
+            blk->have_data == blk->count){
+        blk->complete = blk->have_data == blk->count ? TRUE : FALSE;
+        return 0;
+    }
+    if(dec->code == FEC_XOR){
+        rebuild_xor(dec, blk);
+    }
+    else {
+        rebuild_rs(dec, blk);
+    }
+    blk->complete = blk->have_data == blk->count ? TRUE : FALSE;
+    return dec->rebuilt_count;
+}
+
+/*******************************************************************************
+ * Adds a newly received data packet (seq) holding len bytes of data (data)
+ * to its block, and rebuilds the packets of the block that are missing if it
+ * now can. Returns the number of packets rebuilt, whose sequence numbers are
+ * in the rebuilt array of the blocks and whose data is found with
+ * rebuilt_packet.
+ *
+ * @param dec - The blocks of the client
+ * @param seq - The sequence number of the packet
+ * @param data - The data of the packet
+ * @param len - The length of the data
+ * @return rebuilt - The number of packets rebuilt
+ ******************************************************************************/
+u_int32_t add_data_packet(fec_decoder_t * dec, u_int64_t seq,
+                          const unsigned char * data, size_t len){
+    fec_block_t * blk = get_block(dec, seq / dec->block);
+    u_int32_t col = (u_int32_t) (seq % dec->block);
+    unsigned char * dst;
+
+    dec->rebuilt_count = 0;
+    if(blk == NULL || blk->have[col]){
+        return 0;
+    }
+    if(blk->index >= dec->closed){
+        blk->arrived++;
+    }
+
+    /*Short packets are padded with zeros, as the parity takes them*/
+    if(len > dec->payload){
+        len = dec->payload;
+    }
+    dst = packet_at(dec, blk, col);
+    memcpy(dst, data, len);
+    memset(dst + len, 0, dec->payload - len);
+    blk->have[col] = 1;
+    blk->have_data++;
+    return rebuild(dec, blk);
+}
+
+/*******************************************************************************
+ * Adds a received parity packet (rudp_pkt) of a given size (size) to its
+ * block, and rebuilds the packets of the block that are missing if it now
+ * can, like add_data_packet. Parity that does not match the block is ignored.
+ *
+ * @param dec - The blocks of the client
+ * @param rudp_pkt - The parity packet
+ * @param size - The size of the packet
+ * @return rebuilt - The number of packets rebuilt
+ ******************************************************************************/
+u_int32_t add_parity_packet(fec_decoder_t * dec,
+                            const rudp_packet_t * rudp_pkt, int size){
+    u_int64_t first = get_seq_num(rudp_pkt);
+    u_int32_t row, count, parity;
+    fec_block_t * blk;
+    parity_t body;
+
+    dec->rebuilt_count = 0;
+    if(size != RUDP_HEAD + (int) sizeof(parity_t) + (int) dec->payload ||
+            first % dec->block != 0){
+        return 0;
+    }
+    memcpy(&body, rudp_pkt->data, sizeof(parity_t));
+    row = ntohs(body.index);
+    count = ntohs(body.count);
+    parity = ntohs(body.parity);
+    if(ntohs(body.code) != dec->code || parity == 0 ||
+            parity > FEC_MAX_PARITY || row >= parity){
+        return 0;
+    }
+    blk = get_block(dec, first / dec->block);
+    if(blk == NULL || count != blk->count ||
+            (blk->parity != 0 && blk->parity != parity)){
+        return 0;
+    }
+    blk->parity = parity;
+    dec->last_parity = parity;
+    if(blk->have[dec->block + row]){
+        return 0;
+    }
+    if(blk->index >= dec->closed){
+        blk->arrived++;
+    }
+    if(blk->complete){
+        return 0;
+    }
+    memcpy(packet_at(dec, blk, dec->block + row),
+           rudp_pkt->data + sizeof(parity_t), dec->payload);
+    blk->have[dec->block + row] = 1;
+    blk->have_parity++;
+    return rebuild(dec, blk);
+}
+
+/*******************************************************************************
+ * Returns the data of a rebuilt packet (seq) and stores its length in len.
+ * The data stays valid until the next packet is added.
+ *
+ * @param dec - The blocks of the client
+ * @param seq - The sequence number of the rebuilt packet
+ * @param len - The location to store the length of the data
+ * @return data - The data of the packet
+ ******************************************************************************/
+const unsigned char * rebuilt_packet(fec_decoder_t * dec, u_int64_t seq,
+                                     size_t * len){
+    fec_block_t * blk = &dec->blocks[(seq / dec->block) % dec->ring];
+    u_int64_t offset = seq * dec->payload;
+
+    *len = dec->file_size - offset < dec->payload ?
+           (size_t) (dec->file_size - offset) : dec->payload;
+    return packet_at(dec, blk, (u_int32_t) (seq % dec->block));
+}
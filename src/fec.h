@@ -0,0 +1,328 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * fec.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used for
+ * forward error correction. The server follows each block of data packets
+ * with parity packets, and the client rebuilds lost data packets of a block
+ * from the rest of the block and its parity, without waiting a round trip for
+ * them to be resent. Two codes are offered. With XOR parity, parity packet j
+ * of a block of k is the XOR of every data packet i with i % k == j, so one
+ * loss among each of those can be rebuilt, which also survives a burst of up
+ * to k losses. With Reed-Solomon parity, each parity packet is a different
+ * sum of every data packet over GF(2^8), from a Cauchy matrix, so any k
+ * losses in the block can be rebuilt. Regions are multiplied by a constant of
+ * GF(2^8) with one of several kernels (a lookup table, or SSSE3 or AVX2
+ * shuffles of 4-bit halves), and the fastest one the CPU supports is chosen
+ * when the program starts. The number of parity packets per block follows
+ * the loss rate the client reports.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_FEC_H
+#define PROJECT_4_FEC_H
+
+#include "rudp_packet.h"
+
+#define FEC_BLOCK 32        /*Default data packets per block*/
+#define FEC_MAX_DATA 128    /*Most data packets per block*/
+#define FEC_MAX_PARITY 16   /*Most parity packets per block*/
+#define FEC_TARGET 0.01     /*Share of blocks the parity may fail to rebuild
+                             *at the measured loss rate*/
+#define FEC_INITIAL_LOSS 0.01 /*Loss rate assumed until the client reports*/
+#define FEC_SAMPLE 256      /*Packets reported before the loss rate moves*/
+#define FEC_GAIN 0.25       /*Weight of each new sample of the loss rate*/
+#define FEC_SETS 2          /*Sets of parity packets the sender fills in
+                             *turn, so one can be sent while the next fills*/
+#define FEC_MEMORY 16777216 /*Most memory the client holds blocks in*/
+#define FEC_MIN_BLOCKS 4    /*Fewest blocks the client holds at once*/
+#define FEC_MAX_BLOCKS 256  /*Most blocks the client holds at once*/
+
+/*Custom struct for the parity of the blocks a server is sending. Data
+ * packets are added to the parity of their block as they are first sent, so
+ * the parity is ready as soon as the last of them has gone*/
+struct fec_encoder_t{
+    u_int32_t code;                 //FEC_XOR or FEC_RS
+    u_int32_t block;                //Data packets per block
+    u_int32_t payload;              //Data in each packet but the last
+    int packet_size;                //Size of a parity packet
+    unsigned char *buffers;         //FEC_SETS sets of FEC_MAX_PARITY parity
+                                    //packets
+    u_int32_t set;                  //Set of the block being encoded
+    u_int32_t ready;                //Set of the block last finished
+    bool queued[FEC_SETS];          //Whether a set may still be waiting to
+                                    //be sent, so must not be refilled
+    u_int32_t parity;               //Parity packets of the next block
+    u_int32_t block_parity;         //Parity packets of this block
+    u_int64_t first;                //First data packet of this block
+    u_int32_t count;                //Data packets added to this block
+    u_int64_t next;                 //Data packet expected next
+    bool broken;                    //Whether a packet of this block was
+                                    //skipped, so it gets no parity
+    double loss;                    //Estimated loss rate
+    bool measured;                  //Whether a sample replaced the guess
+    u_int32_t report_expected;      //Counts of the latest report
+    u_int32_t report_lost;
+    u_int64_t sample_expected;      //Counts reported since the loss rate
+    u_int64_t sample_lost;          //last moved
+};
+
+/*Custom struct for a block the client is receiving. Its data packets are
+ * kept, padded to the payload, followed by its parity packets*/
+struct fec_block_t{
+    u_int64_t index;                //Number of the block
+    bool used;                      //Whether the slot holds a block
+    bool complete;                  //Whether every data packet is held
+    u_int32_t count;                //Data packets in the block
+    u_int32_t parity;               //Parity packets of the block, or 0 if
+                                    //none has arrived
+    u_int32_t have_data;            //Data packets held
+    u_int32_t have_parity;          //Parity packets held
+    u_int32_t arrived;              //Packets that arrived before the block
+                                    //was closed
+    unsigned char have[FEC_MAX_DATA + FEC_MAX_PARITY]; //Which are held
+    unsigned char *data;            //The packets
+};
+
+/*Custom struct for the blocks a client is receiving, in a ring buffer at
+ * index block % ring. A block is closed, and its losses counted, once a
+ * packet of a later block arrives, since the server sends every packet of a
+ * block before the next. Its packets may still rebuild it after that*/
+struct fec_decoder_t{
+    u_int32_t code;                 //FEC_XOR or FEC_RS
+    u_int32_t block;                //Data packets per block
+    u_int32_t payload;              //Data in each packet but the last
+    u_int64_t file_size;            //Size of the file
+    u_int64_t packets;              //Data packets in the file
+    struct fec_block_t *blocks;     //Ring buffer of blocks
+    u_int32_t ring;                 //Number of blocks in the ring
+    unsigned char *memory;          //Packets of every block
+    u_int64_t closed;               //First block not yet closed
+    u_int32_t last_parity;          //Parity packets of the latest block
+    u_int64_t expected;             //Packets of the closed blocks
+    u_int64_t lost;                 //Of those, packets that never arrived
+    u_int64_t rebuilt[FEC_MAX_DATA];//Data packets rebuilt by the last call
+    u_int32_t rebuilt_count;        //Number of them
+};
+
+/*Typedefs*/
+typedef struct fec_encoder_t fec_encoder_t;
+typedef struct fec_block_t fec_block_t;
+typedef struct fec_decoder_t fec_decoder_t;
+
+/*******************************************************************************
+ * Multiplies two elements (a and b) of GF(2^8)
+ *
+ * @param a - The first element
+ * @param b - The second element
+ * @return product - The product
+ ******************************************************************************/
+u_int8_t gf_mul(u_int8_t a, u_int8_t b);
+
+/*******************************************************************************
+ * Returns the inverse of a non-zero element (a) of GF(2^8)
+ *
+ * @param a - The element
+ * @return inverse - The inverse
+ ******************************************************************************/
+u_int8_t gf_inv(u_int8_t a);
+
+/*******************************************************************************
+ * Adds a region (src) of len bytes, multiplied by a constant (c) of GF(2^8),
+ * into another region (dst). Addition is XOR, so with c of 1 this is an XOR
+ * of the regions.
+ *
+ * @param dst - The region added to
+ * @param src - The region multiplied
+ * @param c - The constant
+ * @param len - The number of bytes
+ ******************************************************************************/
+void gf_mul_add(unsigned char * dst, const unsigned char * src, u_int8_t c,
+                size_t len);
+
+/*******************************************************************************
+ * Returns the name of the kernel gf_mul_add is using: "scalar", "ssse3" or
+ * "avx2"
+ *
+ * @return name - The name of the kernel
+ ******************************************************************************/
+const char * fec_kernel(void);
+
+/*******************************************************************************
+ * Makes gf_mul_add use the kernel called name, if the CPU supports it.
+ * Returns TRUE if the kernel was selected, else FALSE.
+ *
+ * @param name - "scalar", "ssse3" or "avx2"
+ * @return TRUE or FALSE - Whether or not the kernel was selected
+ ******************************************************************************/
+bool set_fec_kernel(const char * name);
+
+/*******************************************************************************
+ * Returns the coefficient that data packet col of a block is multiplied by
+ * in parity packet row, for a block with a given number of parity packets
+ * (parity) and a given code (code)
+ *
+ * @param code - FEC_XOR or FEC_RS
+ * @param row - The parity packet
+ * @param col - The data packet
+ * @param parity - The number of parity packets of the block
+ * @return coef - The coefficient
+ ******************************************************************************/
+u_int8_t fec_coef(u_int32_t code, u_int32_t row, u_int32_t col,
+                  u_int32_t parity);
+
+/*******************************************************************************
+ * Returns the fewest parity packets that let a block of count data packets
+ * be rebuilt with a given code (code) at least 1 - FEC_TARGET of the time,
+ * if packets are lost at random at a given rate (loss)
+ *
+ * @param code - FEC_XOR or FEC_RS
+ * @param count - The number of data packets in the block
+ * @param loss - The loss rate, from 0 to 1
+ * @return parity - The number of parity packets, from 1 to FEC_MAX_PARITY
+ ******************************************************************************/
+u_int32_t fec_choose_parity(u_int32_t code, u_int32_t count, double loss);
+
+/*******************************************************************************
+ * Reads a code and block size (block) from a setting (spec) of the form
+ * xor or rs, optionally followed by a colon and the number of data packets
+ * per block. Returns the code, or 0 if the setting is not valid.
+ *
+ * @param spec - The setting
+ * @param block - The location to store the block size
+ * @return code - FEC_XOR or FEC_RS, or 0
+ ******************************************************************************/
+u_int32_t parse_fec(const char * spec, u_int32_t * block);
+
+/*******************************************************************************
+ * Returns the name of a code (code): "xor", "rs" or "none"
+ *
+ * @param code - FEC_XOR, FEC_RS or 0
+ * @return name - The name of the code
+ ******************************************************************************/
+const char * fec_name(u_int32_t code);
+
+/*******************************************************************************
+ * Initializes the parity of a server (enc) for a code (code), with block data
+ * packets per block, each carrying up to payload bytes
+ *
+ * @param enc - The parity to initialize
+ * @param code - FEC_XOR or FEC_RS
+ * @param block - The number of data packets per block
+ * @param payload - The size of the data segment of each packet
+ ******************************************************************************/
+void init_fec_encoder(fec_encoder_t * enc, u_int32_t code, u_int32_t block,
+                      u_int32_t payload);
+
+/*******************************************************************************
+ * Frees the parity packets of a server (enc)
+ *
+ * @param enc - The parity to free
+ ******************************************************************************/
+void free_fec_encoder(fec_encoder_t * enc);
+
+/*******************************************************************************
+ * Adds a data packet (seq) holding len bytes of data (data) to the parity of
+ * its block. Packets must be added in order, as they are first sent. Once
+ * the block is complete, or the packet is the last of the file (last), the
+ * parity packets of the block are made, with every field but the flags,
+ * session, timestamp and checksum, and their number is returned. They are
+ * found with get_parity until the next block is finished. A block missing a
+ * packet gets no parity.
+ *
+ * @param enc - The parity of the server
+ * @param seq - The sequence number of the packet
+ * @param data - The data of the packet
+ * @param len - The length of the data
+ * @param last - Whether it is the last packet of the file
+ * @return parity - The number of parity packets made, or 0
+ ******************************************************************************/
+u_int32_t encode_packet(fec_encoder_t * enc, u_int64_t seq,
+                        const unsigned char * data, int len, bool last);
+
+/*******************************************************************************
+ * Returns parity packet row of the block last finished by encode_packet
+ *
+ * @param enc - The parity of the server
+ * @param row - The parity packet
+ * @return pkt - The parity packet
+ ******************************************************************************/
+rudp_packet_t * get_parity(fec_encoder_t * enc, u_int32_t row);
+
+/*******************************************************************************
+ * Takes the counts a client reported in a SACK (expected and lost), and
+ * moves the estimated loss rate toward the rate since the last report once
+ * FEC_SAMPLE packets have been counted. The first such sample replaces the
+ * initial guess outright. The number of parity packets of each
+ * later block is chosen for the new rate. Reports older than one already
+ * taken are ignored.
+ *
+ * @param enc - The parity of the server
+ * @param expected - The packets of the blocks the client closed
+ * @param lost - Of those, the packets that never arrived
+ ******************************************************************************/
+void fec_feedback(fec_encoder_t * enc, u_int32_t expected, u_int32_t lost);
+
+/*******************************************************************************
+ * Initializes the blocks of a client (dec) receiving a file of file_size
+ * bytes in packets of payload bytes, protected by a code (code) with block
+ * data packets per block. As many blocks are held as fit in FEC_MEMORY.
+ *
+ * @param dec - The blocks to initialize
+ * @param code - FEC_XOR or FEC_RS
+ * @param block - The number of data packets per block
+ * @param payload - The size of the data segment of each packet
+ * @param file_size - The size of the file
+ ******************************************************************************/
+void init_fec_decoder(fec_decoder_t * dec, u_int32_t code, u_int32_t block,
+                      u_int32_t payload, u_int64_t file_size);
+
+/*******************************************************************************
+ * Frees the blocks of a client (dec)
+ *
+ * @param dec - The blocks to free
+ ******************************************************************************/
+void free_fec_decoder(fec_decoder_t * dec);
+
+/*******************************************************************************
+ * Adds a newly received data packet (seq) holding len bytes of data (data)
+ * to its block, and rebuilds the packets of the block that are missing if it
+ * now can. Returns the number of packets rebuilt, whose sequence numbers are
+ * in the rebuilt array of the blocks and whose data is found with
+ * rebuilt_packet.
+ *
+ * @param dec - The blocks of the client
+ * @param seq - The sequence number of the packet
+ * @param data - The data of the packet
+ * @param len - The length of the data
+ * @return rebuilt - The number of packets rebuilt
+ ******************************************************************************/
+u_int32_t add_data_packet(fec_decoder_t * dec, u_int64_t seq,
+                          const unsigned char * data, size_t len);
+
+/*******************************************************************************
+ * Adds a received parity packet (rudp_pkt) of a given size (size) to its
+ * block, and rebuilds the packets of the block that are missing if it now
+ * can, like add_data_packet. Parity that does not match the block is ignored.
+ *
+ * @param dec - The blocks of the client
+ * @param rudp_pkt - The parity packet
+ * @param size - The size of the packet
+ * @return rebuilt - The number of packets rebuilt
+ ******************************************************************************/
+u_int32_t add_parity_packet(fec_decoder_t * dec,
+                            const rudp_packet_t * rudp_pkt, int size);
+
+/*******************************************************************************
+ * Returns the data of a rebuilt packet (seq) and stores its length in len.
+ * The data stays valid until the next packet is added.
+ *
+ * @param dec - The blocks of the client
+ * @param seq - The sequence number of the rebuilt packet
+ * @param len - The location to store the length of the data
+ * @return data - The data of the packet
+ ******************************************************************************/
+const unsigned char * rebuilt_packet(fec_decoder_t * dec, u_int64_t seq,
+                                     size_t * len);
+
+#endif //PROJECT_4_FEC_H
@@ -0,0 +1,660 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * impair.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in impair.h
+ ******************************************************************************/
+
+#include "impair.h"
+
+#define IMPAIR_WAIT 100000  /*Longest wait before checking for a stop (us)*/
+
+/*Names of the directions, indexed by direction*/
+static const char * dir_names[DIRECTIONS] = {"To server", "To client"};
+
+/*******************************************************************************
+ * Sets the impairments (opts) to none: every datagram passes at once, in
+ * order, in both directions
+ *
+ * @param opts - The impairments to clear
+ ******************************************************************************/
+void init_impair_opts(impair_opts_t * opts){
+    memset(opts, 0, sizeof(impair_opts_t));
+    opts->ge_loss = 1.0;
+    opts->gap = IMPAIR_GAP;
+    opts->limit = IMPAIR_LIMIT;
+    opts->seed = IMPAIR_SEED;
+    opts->impair[TO_SERVER] = TRUE;
+    opts->impair[TO_CLIENT] = TRUE;
+}
+
+/*******************************************************************************
+ * Reads a percentage (value) as a chance from 0 to 1 (chance). Returns FALSE
+ * if it is not a number from 0 to 100.
+ *
+ * @param value - The percentage
+ * @param chance - The chance
+ * @return TRUE or FALSE - Whether or not the percentage was read
+ ******************************************************************************/
+static bool parse_chance(const char * value, double * chance){
+    char * end;
+    double percent = strtod(value, &end);
+
+    if(end == value || *end != '\0' || percent < 0 || percent > 100){
+        return FALSE;
+    }
+    *chance = percent / 100;
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Reads a number of milliseconds (value) as microseconds (us). Returns FALSE
+ * if it is not a number of at least 0.
+ *
+ * @param value - The milliseconds
+ * @param us - The microseconds
+ * @return TRUE or FALSE - Whether or not the time was read
+ ******************************************************************************/
+static bool parse_ms(const char * value, u_int64_t * us){
+    char * end;
+    double ms = strtod(value, &end);
+
+    if(end == value || *end != '\0' || ms < 0){
+        return FALSE;
+    }
+    *us = (u_int64_t) (ms * 1000);
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Reads one setting, named name, with a given value (value) into the
+ * impairments (opts). Returns FALSE if the name is unknown or the value is
+ * out of range.
+ *
+ * @param opts - The impairments
+ * @param name - The name of the setting
+ * @param value - The value of the setting
+ * @return TRUE or FALSE - Whether or not the setting was read
+ ******************************************************************************/
+static bool parse_setting(impair_opts_t * opts, const char * name,
+                          const char * value){
+    double p, r, l = 100;
+    char * end;
+    int count;
+
+    if(strcmp(name, "loss") == 0){
+        return parse_chance(value, &opts->loss);
+    }
+    if(strcmp(name, "gilbert") == 0){
+        count = sscanf(value, "%lf:%lf:%lf", &p, &r, &l);
+        if(count < 2 || p < 0 || p > 100 || r <= 0 || r > 100 || l < 0 ||
+                l > 100){
+            return FALSE;
+        }
+        opts->ge_p = p / 100;
+        opts->ge_r = r / 100;
+        opts->ge_loss = l / 100;
+        return TRUE;
+    }
+    if(strcmp(name, "corrupt") == 0){
+        return parse_chance(value, &opts->corrupt);
+    }
+    if(strcmp(name, "duplicate") == 0){
+        return parse_chance(value, &opts->duplicate);
+    }
+    if(strcmp(name, "reorder") == 0){
+        return parse_chance(value, &opts->reorder);
+    }
+    if(strcmp(name, "gap") == 0){
+        return parse_ms(value, &opts->gap);
+    }
+    if(strcmp(name, "delay") == 0){
+        return parse_ms(value, &opts->delay);
+    }
+    if(strcmp(name, "jitter") == 0){
+        return parse_ms(value, &opts->jitter);
+    }
+    if(strcmp(name, "rate") == 0){
+        opts->rate = strtod(value, &end);
+        return end != value && *end == '\0' && opts->rate >= 0 ? TRUE : FALSE;
+    }
+    if(strcmp(name, "limit") == 0){
+        opts->limit = (u_int32_t) strtoul(value, &end, 10);
+        return end != value && *end == '\0' && opts->limit > 0 ? TRUE : FALSE;
+    }
+    if(strcmp(name, "seed") == 0){
+        opts->seed = strtoull(value, &end, 0);
+        return end != value && *end == '\0' ? TRUE : FALSE;
+    }
+    if(strcmp(name, "dir") == 0){
+        opts->impair[TO_SERVER] = strcmp(value, "down") != 0 ? TRUE : FALSE;
+        opts->impair[TO_CLIENT] = strcmp(value, "up") != 0 ? TRUE : FALSE;
+        return strcmp(value, "both") == 0 || strcmp(value, "up") == 0 ||
+               strcmp(value, "down") == 0 ? TRUE : FALSE;
+    }
+    return FALSE;
+}
+
+/*******************************************************************************
+ * Reads impairments from a comma separated list of name=value settings (spec)
+ * into opts, leaving settings that are not named as they were. Chances are in
+ * percent and times in milliseconds:
+ *
+ *   loss=P          lose each datagram with chance P
+ *   gilbert=P:R[:L] bursty loss: go bad with chance P and good again with
+ *                   chance R, losing each datagram with chance L (100)
+ *                   while bad
+ *   corrupt=P       flip one bit of each datagram with chance P
+ *   duplicate=P     send each datagram twice with chance P
+ *   reorder=P       hold each datagram back an extra gap with chance P
+ *   gap=MS          extra delay of reordered datagrams (1)
+ *   delay=MS        delay every datagram
+ *   jitter=MS       add up to MS more delay at random, keeping order
+ *   rate=MBIT       let datagrams leave at most MBIT Mbit/s
+ *   limit=N         hold at most N datagrams, dropping the rest (1000)
+ *   seed=N          seed of the random choices
+ *   dir=D           impair both directions (both), only datagrams to the
+ *                   server (up) or only those to the clients (down)
+ *
+ * Returns FALSE if a setting is unknown or its value is out of range.
+ *
+ * @param opts - The impairments
+ * @param spec - The settings
+ * @return TRUE or FALSE - Whether or not every setting was read
+ ******************************************************************************/
+bool parse_impair(impair_opts_t * opts, const char * spec){
+    char buf[MAX_LINE], * setting, * value, * save = NULL;
+
+    if(strlen(spec) >= sizeof(buf)){
+        return FALSE;
+    }
+    strcpy(buf, spec);
+    for(setting = strtok_r(buf, ",", &save); setting != NULL;
+            setting = strtok_r(NULL, ",", &save)){
+        value = strchr(setting, '=');
+        if(value == NULL){
+            return FALSE;
+        }
+        *value++ = '\0';
+        if(!parse_setting(opts, setting, value)){
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Spreads a seed (seed) over all 64 bits with splitmix64, so seeds that differ
+ * in a few bits still start the generators far apart
+ *
+ * @param seed - The seed
+ * @return state - The starting state of a generator
+ ******************************************************************************/
+static u_int64_t mix_seed(u_int64_t seed){
+    seed += 0x9E3779B97F4A7C15ULL;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBULL;
+    return seed ^ (seed >> 31);
+}
+
+/*******************************************************************************
+ * Initializes a relay (relay) that impairs datagrams as opts says, listening
+ * on a given port (port) of every address, or any free port of loopback if
+ * port is 0, and relaying to the server at server. Returns the port it
+ * listens on, or 0 if the socket could not be opened.
+ *
+ * @param relay - The relay to initialize
+ * @param opts - How datagrams are impaired
+ * @param port - The port to listen on, or 0
+ * @param server - The address of the server
+ * @return port - The port listened on, or 0
+ ******************************************************************************/
+int init_impair(impair_t * relay, const impair_opts_t * opts, int port,
+                const struct sockaddr_in * server){
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int dir;
+
+    memset(relay, 0, sizeof(impair_t));
+    relay->front = -1;
+    relay->opts = *opts;
+    relay->server = *server;
+
+    /*Each direction draws its own numbers, so traffic one way does not
+     * change what happens to traffic the other way*/
+    for(dir = 0; dir < DIRECTIONS; dir++){
+        relay->dirs[dir].random = mix_seed(opts->seed + (u_int64_t) dir);
+        if(relay->dirs[dir].random == 0){
+            relay->dirs[dir].random = 1;
+        }
+    }
+
+    /*Every direction holds at most limit datagrams*/
+    relay->heap_cap = DIRECTIONS * opts->limit;
+    relay->heap = malloc(relay->heap_cap * sizeof(impair_held_t *));
+    relay->front = socket(AF_INET, SOCK_DGRAM, 0);
+    if(relay->heap == NULL || relay->front < 0){
+        return 0;
+    }
+    set_socket_buffers(relay->front, SOCKET_BUFFER);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t) port);
+    addr.sin_addr.s_addr = htonl(port == 0 ? INADDR_LOOPBACK : INADDR_ANY);
+    if(bind(relay->front, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+            getsockname(relay->front, (struct sockaddr *) &addr,
+                        &addr_len) < 0){
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+/*******************************************************************************
+ * Returns a random number from 0 to 1 from the generator of a direction
+ * (dir), with xorshift64*
+ *
+ * @param dir - The direction
+ * @return random - A number from 0 up to, but not including, 1
+ ******************************************************************************/
+static double next_random(impair_dir_t * dir){
+    dir->random ^= dir->random >> 12;
+    dir->random ^= dir->random << 25;
+    dir->random ^= dir->random >> 27;
+    return (double) ((dir->random * 2685821657736338717ULL) >> 11) /
+           (double) (1ULL << 53);
+}
+
+/*******************************************************************************
+ * Finds the client at addr among those the relay (relay) knows, adding it,
+ * with a socket of its own connected to the server, if it is new. Returns its
+ * index, or -1 if there is no room for another client.
+ *
+ * @param relay - The relay
+ * @param addr - The address of the client
+ * @return peer - The index of the client, or -1
+ ******************************************************************************/
+static int find_peer(impair_t * relay, struct sockaddr_in * addr){
+    impair_peer_t * p;
+    int i;
+
+    for(i = 0; i < relay->peer_count; i++){
+        p = &relay->peers[i];
+        if(p->addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+                p->addr.sin_port == addr->sin_port){
+            return i;
+        }
+    }
+    if(relay->peer_count == IMPAIR_PEERS){
+        return -1;
+    }
+    p = &relay->peers[relay->peer_count];
+    p->addr = *addr;
+    p->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(p->sockfd < 0){
+        return -1;
+    }
+    set_socket_buffers(p->sockfd, SOCKET_BUFFER);
+    if(connect(p->sockfd, (struct sockaddr *) &relay->server,
+               sizeof(relay->server)) < 0){
+        close(p->sockfd);
+        return -1;
+    }
+    return relay->peer_count++;
+}
+
+/*******************************************************************************
+ * Sends a datagram (data) of a given size (size) on in its direction (dir):
+ * to the server from the socket of its client (peer), or to the client
+ *
+ * @param relay - The relay
+ * @param dir - TO_SERVER or TO_CLIENT
+ * @param peer - The client the datagram is from or to
+ * @param data - The datagram
+ * @param size - The size of the datagram
+ ******************************************************************************/
+static void forward(impair_t * relay, int dir, int peer,
+                    const unsigned char * data, size_t size){
+    if(dir == TO_SERVER){
+        send(relay->peers[peer].sockfd, data, size, 0);
+    }
+    else {
+        sendto(relay->front, data, size, 0,
+               (struct sockaddr *) &relay->peers[peer].addr,
+               sizeof(struct sockaddr_in));
+    }
+    relay->dirs[dir].stats.sent++;
+}
+
+/*******************************************************************************
+ * Returns TRUE if held datagram a is due before held datagram b, else FALSE
+ *
+ * @param a - A held datagram
+ * @param b - Another held datagram
+ * @return TRUE or FALSE - Whether or not a is due first
+ ******************************************************************************/
+static bool due_before(const impair_held_t * a, const impair_held_t * b){
+    return a->due < b->due || (a->due == b->due && a->order < b->order) ?
+           TRUE : FALSE;
+}
+
+/*******************************************************************************
+ * Holds a datagram (data) of a given size (size) travelling in a direction
+ * (dir) to or from a client (peer) until a given time (due). Returns FALSE if
+ * it could not be allocated.
+ *
+ * @param relay - The relay
+ * @param dir - TO_SERVER or TO_CLIENT
+ * @param peer - The client the datagram is from or to
+ * @param data - The datagram
+ * @param size - The size of the datagram
+ * @param due - The time to send it (us)
+ * @return TRUE or FALSE - Whether or not the datagram is held
+ ******************************************************************************/
+static bool hold(impair_t * relay, int dir, int peer,
+                 const unsigned char * data, size_t size, u_int64_t due){
+    impair_held_t * h = malloc(sizeof(impair_held_t) + size), * tmp;
+    u_int32_t i, parent;
+
+    if(h == NULL){
+        return FALSE;
+    }
+    h->due = due;
+    h->order = relay->order++;
+    h->dir = dir;
+    h->peer = peer;
+    h->size = size;
+    memcpy(h->data, data, size);
+
+    /*Sift the datagram up the heap*/
+    i = relay->heap_len++;
+    relay->heap[i] = h;
+    while(i > 0){
+        parent = (i - 1) / 2;
+        if(!due_before(relay->heap[i], relay->heap[parent])){
+            break;
+        }
+        tmp = relay->heap[i];
+        relay->heap[i] = relay->heap[parent];
+        relay->heap[parent] = tmp;
+        i = parent;
+    }
+    relay->dirs[dir].held++;
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Removes the held datagram that is due first from the heap of a relay
+ * (relay) and returns it. The heap must not be empty.
+ *
+ * @param relay - The relay
+ * @return held - The datagram due first
+ ******************************************************************************/
+static impair_held_t * take_first(impair_t * relay){
+    impair_held_t * first = relay->heap[0], * tmp;
+    u_int32_t i = 0, child;
+
+    relay->heap[0] = relay->heap[--relay->heap_len];
+    while((child = 2 * i + 1) < relay->heap_len){
+        if(child + 1 < relay->heap_len &&
+                due_before(relay->heap[child + 1], relay->heap[child])){
+            child++;
+        }
+        if(!due_before(relay->heap[child], relay->heap[i])){
+            break;
+        }
+        tmp = relay->heap[i];
+        relay->heap[i] = relay->heap[child];
+        relay->heap[child] = tmp;
+        i = child;
+    }
+    relay->dirs[first->dir].held--;
+    return first;
+}
+
+/*******************************************************************************
+ * Impairs a datagram (data) of a given size (size) received at a given time
+ * (now) travelling in a direction (dir) to or from a client (peer): loses it,
+ * or corrupts, duplicates, delays or reorders it and sends it on once due
+ *
+ * @param relay - The relay
+ * @param dir - TO_SERVER or TO_CLIENT
+ * @param peer - The client the datagram is from or to
+ * @param data - The datagram
+ * @param size - The size of the datagram
+ * @param now - The current time (us)
+ ******************************************************************************/
+static void impair_datagram(impair_t * relay, int dir, int peer,
+                            unsigned char * data, size_t size,
+                            u_int64_t now){
+    impair_opts_t * o = &relay->opts;
+    impair_dir_t * d = &relay->dirs[dir];
+    u_int64_t due, bit;
+    int copies = 1, i;
+
+    d->stats.received++;
+    if(!o->impair[dir]){
+        forward(relay, dir, peer, data, size);
+        return;
+    }
+
+    /*Bursty loss follows a two state Markov chain, moved once per datagram*/
+    if(o->ge_p > 0){
+        if(d->bad){
+            d->bad = next_random(d) < o->ge_r ? FALSE : TRUE;
+        }
+        else {
+            d->bad = next_random(d) < o->ge_p ? TRUE : FALSE;
+        }
+        if(d->bad && next_random(d) < o->ge_loss){
+            d->stats.burst_lost++;
+            return;
+        }
+    }
+    if(o->loss > 0 && next_random(d) < o->loss){
+        d->stats.lost++;
+        return;
+    }
+    if(o->corrupt > 0 && size > 0 && next_random(d) < o->corrupt){
+        bit = (u_int64_t) (next_random(d) * (double) size * 8);
+        data[bit / 8] ^= (unsigned char) (1 << (bit % 8));
+        d->stats.corrupted++;
+    }
+    if(o->duplicate > 0 && next_random(d) < o->duplicate){
+        copies = 2;
+        d->stats.duplicated++;
+    }
+
+    for(i = 0; i < copies; i++){
+
+        /*With a rate limit, a datagram leaves once those before it have,
+         * taking as long as its bits need at the rate*/
+        due = now;
+        if(o->rate > 0){
+            if(d->next_free > due){
+                due = d->next_free;
+            }
+            due += (u_int64_t) ((double) size * 8 / o->rate);
+            d->next_free = due;
+        }
+        due += o->delay;
+        if(o->jitter > 0){
+            due += (u_int64_t) (next_random(d) * (double) (o->jitter + 1));
+        }
+
+        /*Jitter does not reorder, but a reordered datagram is held back
+         * past those after it*/
+        if(due < d->last_release){
+            due = d->last_release;
+        }
+        d->last_release = due;
+        if(o->reorder > 0 && next_random(d) < o->reorder){
+            due += o->gap;
+            d->stats.reordered++;
+        }
+
+        if(due <= now && d->held == 0){
+            forward(relay, dir, peer, data, size);
+        }
+        else if(d->held >= o->limit || !hold(relay, dir, peer, data, size,
+                                              due)){
+            d->stats.overflowed++;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Relays datagrams through a relay (relay) until it is stopped with
+ * stop_impair, or from a signal handler by setting its stop flag
+ *
+ * @param relay - The relay
+ ******************************************************************************/
+void run_impair(impair_t * relay){
+    unsigned char buf[MAX_DATAGRAM];
+    struct pollfd fds[IMPAIR_PEERS + 1];
+    struct sockaddr_in addr;
+    struct timespec wait;
+    socklen_t addr_len;
+    u_int64_t now, timeout;
+    impair_held_t * h;
+    ssize_t size;
+    int i, peer, nfds;
+
+    while(!__atomic_load_n(&relay->stop, __ATOMIC_RELAXED)){
+
+        /*Wait for a datagram, or until a held one is due*/
+        now = get_time_us();
+        timeout = IMPAIR_WAIT;
+        if(relay->heap_len > 0){
+            timeout = relay->heap[0]->due <= now ? 0 :
+                      relay->heap[0]->due - now;
+            if(timeout > IMPAIR_WAIT){
+                timeout = IMPAIR_WAIT;
+            }
+        }
+        wait.tv_sec = (time_t) (timeout / 1000000);
+        wait.tv_nsec = (long) (timeout % 1000000) * 1000;
+        fds[0].fd = relay->front;
+        fds[0].events = POLLIN;
+        for(i = 0; i < relay->peer_count; i++){
+            fds[i + 1].fd = relay->peers[i].sockfd;
+            fds[i + 1].events = POLLIN;
+        }
+        nfds = relay->peer_count + 1;
+        ppoll(fds, (nfds_t) nfds, &wait, NULL);
+        now = get_time_us();
+
+        /*From the clients to the server*/
+        while(TRUE){
+            addr_len = sizeof(addr);
+            size = recvfrom(relay->front, buf, sizeof(buf), MSG_DONTWAIT,
+                            (struct sockaddr *) &addr, &addr_len);
+            if(size < 0){
+                break;
+            }
+            peer = find_peer(relay, &addr);
+            if(peer >= 0){
+                impair_datagram(relay, TO_SERVER, peer, buf, (size_t) size,
+                                now);
+            }
+        }
+
+        /*From the server back to each client*/
+        for(peer = 0; peer < nfds - 1; peer++){
+            if(!(fds[peer + 1].revents & POLLIN)){
+                continue;
+            }
+            while((size = recv(relay->peers[peer].sockfd, buf, sizeof(buf),
+                               MSG_DONTWAIT)) >= 0){
+                impair_datagram(relay, TO_CLIENT, peer, buf, (size_t) size,
+                                now);
+            }
+        }
+
+        /*Send every held datagram that is due*/
+        while(relay->heap_len > 0 && relay->heap[0]->due <= now){
+            h = take_first(relay);
+            forward(relay, h->dir, h->peer, h->data, h->size);
+            free(h);
+        }
+    }
+}
+
+/*******************************************************************************
+ * Runs a relay (arg) in its own thread
+ *
+ * @param arg - The relay
+ * @return NULL
+ ******************************************************************************/
+static void * impair_loop(void * arg){
+    run_impair((impair_t *) arg);
+    return NULL;
+}
+
+/*******************************************************************************
+ * Runs a relay (relay) in a thread of its own. Returns FALSE if the thread
+ * could not be started.
+ *
+ * @param relay - The relay
+ * @return TRUE or FALSE - Whether or not the thread started
+ ******************************************************************************/
+bool start_impair(impair_t * relay){
+    return pthread_create(&relay->thread, NULL, impair_loop, relay) == 0 ?
+           TRUE : FALSE;
+}
+
+/*******************************************************************************
+ * Stops a relay (relay) running in its own thread and waits for it to end
+ *
+ * @param relay - The relay
+ ******************************************************************************/
+void stop_impair(impair_t * relay){
+    __atomic_store_n(&relay->stop, 1, __ATOMIC_RELAXED);
+    pthread_join(relay->thread, NULL);
+}
+
+/*******************************************************************************
+ * Prints what a relay (relay) has done in each direction to stderr
+ *
+ * @param relay - The relay
+ ******************************************************************************/
+void print_impair_stats(impair_t * relay){
+    impair_stats_t * s;
+    int dir;
+
+    for(dir = 0; dir < DIRECTIONS; dir++){
+        s = &relay->dirs[dir].stats;
+        fprintf(stderr, "%s: %llu received, %llu sent, %llu lost, "
+                "%llu lost in bursts, %llu over the limit, %llu corrupted, "
+                "%llu duplicated, %llu reordered\n", dir_names[dir],
+                (unsigned long long) s->received,
+                (unsigned long long) s->sent, (unsigned long long) s->lost,
+                (unsigned long long) s->burst_lost,
+                (unsigned long long) s->overflowed,
+                (unsigned long long) s->corrupted,
+                (unsigned long long) s->duplicated,
+                (unsigned long long) s->reordered);
+    }
+}
+
+/*******************************************************************************
+ * Closes the sockets of a relay (relay) and frees the datagrams it holds
+ *
+ * @param relay - The relay
+ ******************************************************************************/
+void free_impair(impair_t * relay){
+    int i;
+
+    while(relay->heap_len > 0){
+        free(take_first(relay));
+    }
+    free(relay->heap);
+    relay->heap = NULL;
+    for(i = 0; i < relay->peer_count; i++){
+        close(relay->peers[i].sockfd);
+    }
+    relay->peer_count = 0;
+    if(relay->front >= 0){
+        close(relay->front);
+    }
+}
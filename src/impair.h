@@ -0,0 +1,207 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * impair.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used to relay
+ * UDP datagrams between clients and a server while impairing them the way a
+ * poor network would: losing them at random or in bursts, flipping bits,
+ * duplicating, reordering and delaying them, and limiting the rate they pass
+ * at. Every random choice comes from a seeded generator, so the same traffic
+ * is impaired the same way each time. The relay is used by the rudp_proxy
+ * tool and by rudp_bench.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_IMPAIR_H
+#define PROJECT_4_IMPAIR_H
+
+#include "rudp_packet.h"
+#include <pthread.h>
+
+#define IMPAIR_PEERS 64     /*Most clients relayed at once*/
+#define IMPAIR_LIMIT 1000   /*Default most datagrams held in each direction*/
+#define IMPAIR_GAP 1000     /*Default extra delay of a reordered datagram (us)*/
+#define IMPAIR_SEED 0x2545F4914F6CDD1DULL /*Default seed*/
+
+/*Directions a datagram may travel*/
+#define TO_SERVER 0         /*From a client to the server*/
+#define TO_CLIENT 1         /*From the server to a client*/
+#define DIRECTIONS 2
+
+/*Custom struct for how datagrams are impaired. Chances are from 0 to 1*/
+struct impair_opts_t{
+    double loss;                    //Chance of losing any datagram
+    double ge_p;                    //Gilbert-Elliott chance of going from
+                                    //the good state to the bad state
+    double ge_r;                    //Chance of going from bad back to good
+    double ge_loss;                 //Chance of losing a datagram while bad
+    double corrupt;                 //Chance of flipping one bit
+    double duplicate;               //Chance of sending a datagram twice
+    double reorder;                 //Chance of holding a datagram back by gap
+    u_int64_t gap;                  //Extra delay of reordered datagrams (us)
+    u_int64_t delay;                //Delay of every datagram (us)
+    u_int64_t jitter;               //Most random delay added to delay (us)
+    double rate;                    //Rate datagrams may leave (Mbit/s), or 0
+    u_int32_t limit;                //Most datagrams held in each direction
+    u_int64_t seed;                 //Seed of the random choices
+    bool impair[DIRECTIONS];        //Whether each direction is impaired
+};
+
+/*Custom struct for what happened in one direction. Only the relay writes
+ * it, so it should be read once the relay has stopped*/
+struct impair_stats_t{
+    u_int64_t received;             //Datagrams received
+    u_int64_t sent;                 //Datagrams sent, including duplicates
+    u_int64_t lost;                 //Datagrams lost at random
+    u_int64_t burst_lost;           //Datagrams lost in the bad state
+    u_int64_t overflowed;           //Datagrams dropped with the queue full
+    u_int64_t corrupted;            //Datagrams with a bit flipped
+    u_int64_t duplicated;           //Datagrams sent twice
+    u_int64_t reordered;            //Datagrams held back past later ones
+};
+
+/*Custom struct for the state of one direction*/
+struct impair_dir_t{
+    u_int64_t random;               //State of the random number generator
+    bool bad;                       //Whether in the Gilbert-Elliott bad state
+    u_int64_t next_free;            //Time the rate limit lets the next
+                                    //datagram leave (us)
+    u_int64_t last_release;         //Latest time a datagram is due (us)
+    u_int32_t held;                 //Datagrams waiting to be sent
+    struct impair_stats_t stats;    //What happened so far
+};
+
+/*Custom struct for a client being relayed. The server sees each client as
+ * its own socket of the relay, so it keeps their sessions apart*/
+struct impair_peer_t{
+    struct sockaddr_in addr;        //Address of the client
+    int sockfd;                     //Socket connected to the server
+};
+
+/*Custom struct for a datagram held until it is due*/
+struct impair_held_t{
+    u_int64_t due;                  //Time to send it (us)
+    u_int64_t order;                //Order it was held in, to break ties
+    int dir;                        //TO_SERVER or TO_CLIENT
+    int peer;                       //The client it is to or from
+    size_t size;                    //Size of the datagram
+    unsigned char data[];           //The datagram
+};
+
+/*Custom struct for a relay. Clients send to front, and each is relayed to
+ * the server from its own socket. Datagrams that must wait are held in a
+ * heap ordered by the time they are due*/
+struct impair_t{
+    struct impair_opts_t opts;      //How datagrams are impaired
+    int front;                      //Socket the clients send to
+    struct sockaddr_in server;      //Address of the server
+    struct impair_peer_t peers[IMPAIR_PEERS]; //Clients being relayed
+    int peer_count;                 //Number of clients
+    struct impair_dir_t dirs[DIRECTIONS]; //State of each direction
+    struct impair_held_t **heap;    //Datagrams held, earliest due first
+    u_int32_t heap_len;             //Number of datagrams held
+    u_int32_t heap_cap;             //Room in the heap
+    u_int64_t order;                //Order of the next datagram held
+    int stop;                       //Set to stop the relay
+    pthread_t thread;               //Thread running the relay, if any
+};
+
+/*Typedefs*/
+typedef struct impair_opts_t impair_opts_t;
+typedef struct impair_stats_t impair_stats_t;
+typedef struct impair_dir_t impair_dir_t;
+typedef struct impair_peer_t impair_peer_t;
+typedef struct impair_held_t impair_held_t;
+typedef struct impair_t impair_t;
+
+/*******************************************************************************
+ * Sets the impairments (opts) to none: every datagram passes at once, in
+ * order, in both directions
+ *
+ * @param opts - The impairments to clear
+ ******************************************************************************/
+void init_impair_opts(impair_opts_t * opts);
+
+/*******************************************************************************
+ * Reads impairments from a comma separated list of name=value settings (spec)
+ * into opts, leaving settings that are not named as they were. Chances are in
+ * percent and times in milliseconds:
+ *
+ *   loss=P          lose each datagram with chance P
+ *   gilbert=P:R[:L] bursty loss: go bad with chance P and good again with
+ *                   chance R, losing each datagram with chance L (100)
+ *                   while bad
+ *   corrupt=P       flip one bit of each datagram with chance P
+ *   duplicate=P     send each datagram twice with chance P
+ *   reorder=P       hold each datagram back an extra gap with chance P
+ *   gap=MS          extra delay of reordered datagrams (1)
+ *   delay=MS        delay every datagram
+ *   jitter=MS       add up to MS more delay at random, keeping order
+ *   rate=MBIT       let datagrams leave at most MBIT Mbit/s
+ *   limit=N         hold at most N datagrams, dropping the rest (1000)
+ *   seed=N          seed of the random choices
+ *   dir=D           impair both directions (both), only datagrams to the
+ *                   server (up) or only those to the clients (down)
+ *
+ * Returns FALSE if a setting is unknown or its value is out of range.
+ *
+ * @param opts - The impairments
+ * @param spec - The settings
+ * @return TRUE or FALSE - Whether or not every setting was read
+ ******************************************************************************/
+bool parse_impair(impair_opts_t * opts, const char * spec);
+
+/*******************************************************************************
+ * Initializes a relay (relay) that impairs datagrams as opts says, listening
+ * on a given port (port) of every address, or any free port of loopback if
+ * port is 0, and relaying to the server at server. Returns the port it
+ * listens on, or 0 if the socket could not be opened.
+ *
+ * @param relay - The relay to initialize
+ * @param opts - How datagrams are impaired
+ * @param port - The port to listen on, or 0
+ * @param server - The address of the server
+ * @return port - The port listened on, or 0
+ ******************************************************************************/
+int init_impair(impair_t * relay, const impair_opts_t * opts, int port,
+                const struct sockaddr_in * server);
+
+/*******************************************************************************
+ * Relays datagrams through a relay (relay) until it is stopped with
+ * stop_impair, or from a signal handler by setting its stop flag
+ *
+ * @param relay - The relay
+ ******************************************************************************/
+void run_impair(impair_t * relay);
+
+/*******************************************************************************
+ * Runs a relay (relay) in a thread of its own. Returns FALSE if the thread
+ * could not be started.
+ *
+ * @param relay - The relay
+ * @return TRUE or FALSE - Whether or not the thread started
+ ******************************************************************************/
+bool start_impair(impair_t * relay);
+
+/*******************************************************************************
+ * Stops a relay (relay) running in its own thread and waits for it to end
+ *
+ * @param relay - The relay
+ ******************************************************************************/
+void stop_impair(impair_t * relay);
+
+/*******************************************************************************
+ * Prints what a relay (relay) has done in each direction to stderr
+ *
+ * @param relay - The relay
+ ******************************************************************************/
+void print_impair_stats(impair_t * relay);
+
+/*******************************************************************************
+ * Closes the sockets of a relay (relay) and frees the datagrams it holds
+ *
+ * @param relay - The relay
+ ******************************************************************************/
+void free_impair(impair_t * relay);
+
+#endif //PROJECT_4_IMPAIR_H
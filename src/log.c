@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * log.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in log.h
+ ******************************************************************************/
+
+#include "log.h"
+#include <stdarg.h>
+
+int log_level = LOG_DEFAULT;
+
+/*Names of the levels, indexed by level*/
+static const char * level_names[] = {"error", "warn", "info", "debug",
+                                     "trace"};
+
+/*******************************************************************************
+ * Chooses the level of messages to print from its name (name): error, warn,
+ * info, debug or trace. Returns FALSE, leaving the level as it was, if the
+ * name is not one of these. Levels above LOG_MAX are accepted, but print
+ * nothing more than LOG_MAX.
+ *
+ * @param name - The name of the level
+ * @return TRUE or FALSE - Whether or not the name was known
+ ******************************************************************************/
+bool set_log_level(const char * name){
+    int level;
+
+    for(level = LOG_ERROR; level <= LOG_TRACE; level++){
+        if(strcmp(name, level_names[level]) == 0){
+            log_level = level;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*******************************************************************************
+ * Chooses the level of messages to print from the RUDP_LOG environment
+ * variable, if it is set to the name of a level
+ ******************************************************************************/
+void init_log(void){
+    const char * env = getenv("RUDP_LOG");
+
+    if(env != NULL && !set_log_level(env)){
+        fprintf(stderr, "Unknown log level %s\n", env);
+    }
+}
+
+/*******************************************************************************
+ * Prints a message of a given level (level), formatted as with printf (fmt),
+ * to stderr, which is unbuffered, so nothing is lost when the server is
+ * killed. Called through log_msg, which checks the level first.
+ *
+ * @param level - The LOG_ level of the message
+ * @param fmt - The printf format of the message
+ ******************************************************************************/
+void log_printf(int level, const char * fmt, ...){
+    va_list args;
+
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
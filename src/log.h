@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * log.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and macros and declares functions used to print messages
+ * at a level chosen when the program runs. Messages about single packets are
+ * logged at LOG_TRACE, which is compiled out of release builds (NDEBUG), so
+ * in a release build they cost nothing, and otherwise only a comparison
+ * unless that level is chosen.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_LOG_H
+#define PROJECT_4_LOG_H
+
+#include "rudp_packet.h"
+
+/*Log levels, from the most to the least important. A message is printed if
+ * its level is at most the level chosen*/
+#define LOG_ERROR 0         /*Something failed*/
+#define LOG_WARN 1          /*Something went wrong but was recovered from*/
+#define LOG_INFO 2          /*Sessions and transfers starting and finishing*/
+#define LOG_DEBUG 3         /*Handshakes, acknowledgements and timeouts*/
+#define LOG_TRACE 4         /*Every packet sent and received*/
+
+#define LOG_DEFAULT LOG_INFO /*Level used unless another is chosen*/
+
+/*Highest level compiled in. Release builds leave out LOG_TRACE entirely*/
+#ifdef NDEBUG
+#define LOG_MAX LOG_DEBUG
+#else
+#define LOG_MAX LOG_TRACE
+#endif
+
+/*Level chosen with set_log_level*/
+extern int log_level;
+
+/*Whether messages of a level are printed. Constant FALSE above LOG_MAX, so
+ * code guarded by it is removed by the compiler*/
+#define log_enabled(level) ((level) <= LOG_MAX && (level) <= log_level)
+
+/*Prints a message, formatted as with printf, if its level is enabled. The
+ * arguments are not evaluated otherwise*/
+#define log_msg(level, ...) \
+    do { \
+        if(log_enabled(level)) \
+            log_printf(level, __VA_ARGS__); \
+    } while(0)
+
+/*******************************************************************************
+ * Chooses the level of messages to print from its name (name): error, warn,
+ * info, debug or trace. Returns FALSE, leaving the level as it was, if the
+ * name is not one of these. Levels above LOG_MAX are accepted, but print
+ * nothing more than LOG_MAX.
+ *
+ * @param name - The name of the level
+ * @return TRUE or FALSE - Whether or not the name was known
+ ******************************************************************************/
+bool set_log_level(const char * name);
+
+/*******************************************************************************
+ * Chooses the level of messages to print from the RUDP_LOG environment
+ * variable, if it is set to the name of a level
+ ******************************************************************************/
+void init_log(void);
+
+/*******************************************************************************
+ * Prints a message of a given level (level), formatted as with printf (fmt),
+ * to stderr, which is unbuffered, so nothing is lost when the server is
+ * killed. Called through log_msg, which checks the level first.
+ *
+ * @param level - The LOG_ level of the message
+ * @param fmt - The printf format of the message
+ ******************************************************************************/
+void log_printf(int level, const char * fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+
+#endif //PROJECT_4_LOG_H
@@ -0,0 +1,242 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * metrics.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in metrics.h
+ ******************************************************************************/
+
+#include "metrics.h"
+#include <stdarg.h>
+
+/*Reads a count that another thread may be adding to*/
+#define LOAD(field) __atomic_load_n(&metrics->field, __ATOMIC_RELAXED)
+
+/*******************************************************************************
+ * Clears the counts of a transfer (metrics) and marks it started now
+ *
+ * @param metrics - The counts to clear
+ ******************************************************************************/
+void init_metrics(metrics_t * metrics){
+    memset(metrics, 0, sizeof(metrics_t));
+    metrics->started = get_time_us();
+}
+
+/*******************************************************************************
+ * Adds a round trip time (sample) to the counts of a transfer (metrics)
+ *
+ * @param metrics - The counts of the transfer
+ * @param sample - The round trip time (us)
+ ******************************************************************************/
+void record_rtt(metrics_t * metrics, u_int64_t sample){
+    int bucket = 0;
+
+    while(bucket < RTT_BUCKETS - 1 && sample >= (u_int64_t) 2 << bucket){
+        bucket++;
+    }
+    metrics->rtt_hist[bucket]++;
+    if(metrics->rtt_samples == 0 || sample < metrics->rtt_min){
+        metrics->rtt_min = sample;
+    }
+    if(sample > metrics->rtt_max){
+        metrics->rtt_max = sample;
+    }
+    metrics->rtt_samples++;
+    metrics->rtt_total += sample;
+}
+
+/*******************************************************************************
+ * Counts an acknowledgement that was held back for a given time (latency)
+ * after the first packet it acknowledges arrived
+ *
+ * @param metrics - The counts of the transfer
+ * @param latency - How long the ACK was held back (us)
+ ******************************************************************************/
+void record_ack(metrics_t * metrics, u_int64_t latency){
+    metrics->acks++;
+    metrics->ack_latency += latency;
+    if(latency > metrics->ack_latency_max){
+        metrics->ack_latency_max = latency;
+    }
+}
+
+/*******************************************************************************
+ * Raises a running maximum (max) to a value (value), if the value is larger,
+ * with an atomic compare and swap
+ *
+ * @param max - The running maximum
+ * @param value - The value
+ ******************************************************************************/
+static void atomic_max(u_int64_t * max, u_int64_t value){
+    u_int64_t old = __atomic_load_n(max, __ATOMIC_RELAXED);
+
+    while(value > old && !__atomic_compare_exchange_n(max, &old, value, TRUE,
+                                                      __ATOMIC_RELAXED,
+                                                      __ATOMIC_RELAXED)){
+    }
+}
+
+/*******************************************************************************
+ * Adds the counts of a finished transfer (metrics) to running totals (totals)
+ * with atomic adds, so another thread may read the totals at any time. The
+ * times of the totals are left alone.
+ *
+ * @param totals - The running totals
+ * @param metrics - The counts to add
+ ******************************************************************************/
+void add_metrics(metrics_t * totals, const metrics_t * metrics){
+    u_int64_t old;
+    int i;
+
+    __atomic_fetch_add(&totals->bytes, metrics->bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->packets_sent, metrics->packets_sent,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->retransmits, metrics->retransmits,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->parity_sent, metrics->parity_sent,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->packets_received, metrics->packets_received,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->recovered, metrics->recovered,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->duplicates, metrics->duplicates,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->bad_checksums, metrics->bad_checksums,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->out_of_order, metrics->out_of_order,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->acks, metrics->acks, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->ack_latency, metrics->ack_latency,
+                       __ATOMIC_RELAXED);
+    atomic_max(&totals->ack_latency_max, metrics->ack_latency_max);
+    for(i = 0; i < RTT_BUCKETS; i++){
+        __atomic_fetch_add(&totals->rtt_hist[i], metrics->rtt_hist[i],
+                           __ATOMIC_RELAXED);
+    }
+    if(metrics->rtt_samples == 0){
+        return;
+    }
+
+    /*The minimum starts out as 0, meaning no samples yet*/
+    old = __atomic_load_n(&totals->rtt_min, __ATOMIC_RELAXED);
+    while((old == 0 || metrics->rtt_min < old) &&
+            !__atomic_compare_exchange_n(&totals->rtt_min, &old,
+                                         metrics->rtt_min, TRUE,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED)){
+    }
+    atomic_max(&totals->rtt_max, metrics->rtt_max);
+    __atomic_fetch_add(&totals->rtt_total, metrics->rtt_total,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&totals->rtt_samples, metrics->rtt_samples,
+                       __ATOMIC_RELAXED);
+}
+
+/*******************************************************************************
+ * Appends text, formatted as with printf (fmt), at a given position (pos) of
+ * a buffer (buf) of len bytes, cutting it short if the buffer is full.
+ * Returns the position after the text.
+ *
+ * @param buf - The buffer
+ * @param len - The size of the buffer
+ * @param pos - Where to append
+ * @param fmt - The printf format of the text
+ * @return pos - The position after the text
+ ******************************************************************************/
+static size_t append(char * buf, size_t len, size_t pos, const char * fmt,
+                     ...){
+    va_list args;
+    int n;
+
+    if(pos >= len){
+        return pos;
+    }
+    va_start(args, fmt);
+    n = vsnprintf(buf + pos, len - pos, fmt, args);
+    va_end(args);
+    if(n < 0){
+        return pos;
+    }
+    return pos + (size_t) n < len ? pos + (size_t) n : len - 1;
+}
+
+/*******************************************************************************
+ * Writes the counts of a transfer (metrics) as a JSON object into a buffer
+ * (buf) of len bytes, which should hold at least METRICS_JSON. The fields of
+ * the object (fields), which must be JSON members followed by a comma, or
+ * empty, are put first. The counts are read with atomic loads, so they may be
+ * written by another thread. Returns the length of the JSON.
+ *
+ * @param metrics - The counts to write
+ * @param fields - Extra JSON members to put first, each followed by a comma
+ * @param buf - The buffer to write into
+ * @param len - The size of the buffer
+ * @return length - The length of the JSON, not counting its '\0'
+ ******************************************************************************/
+int format_metrics(const metrics_t * metrics, const char * fields, char * buf,
+                   size_t len){
+    u_int64_t finished = metrics->finished, bytes = LOAD(bytes);
+    u_int64_t samples = LOAD(rtt_samples), acks = LOAD(acks), count;
+    double seconds, first_byte = 0.0;
+    size_t pos = 0;
+    bool first = TRUE;
+    int i;
+
+    /*A transfer still running is timed up to now*/
+    if(finished == 0){
+        finished = get_time_us();
+    }
+    seconds = finished > metrics->started ?
+              (double) (finished - metrics->started) / 1e6 : 0.0;
+    if(metrics->first_byte > metrics->started){
+        first_byte = (double) (metrics->first_byte - metrics->started) / 1e6;
+    }
+
+    pos = append(buf, len, pos, "{%s\"duration_s\":%.6f,"
+                 "\"first_byte_s\":%.6f,\"bytes\":%llu,"
+                 "\"goodput_mbps\":%.3f,", fields, seconds, first_byte,
+                 (unsigned long long) bytes,
+                 seconds > 0 ? bytes * 8.0 / seconds / 1e6 : 0.0);
+    pos = append(buf, len, pos, "\"packets_sent\":%llu,\"retransmits\":%llu,"
+                 "\"parity_sent\":%llu,\"packets_received\":%llu,"
+                 "\"recovered\":%llu,\"duplicates\":%llu,"
+                 "\"bad_checksums\":%llu,\"out_of_order\":%llu,",
+                 (unsigned long long) LOAD(packets_sent),
+                 (unsigned long long) LOAD(retransmits),
+                 (unsigned long long) LOAD(parity_sent),
+                 (unsigned long long) LOAD(packets_received),
+                 (unsigned long long) LOAD(recovered),
+                 (unsigned long long) LOAD(duplicates),
+                 (unsigned long long) LOAD(bad_checksums),
+                 (unsigned long long) LOAD(out_of_order));
+    pos = append(buf, len, pos, "\"acks\":%llu,\"ack_latency_us\":{"
+                 "\"mean\":%.1f,\"max\":%llu},", (unsigned long long) acks,
+                 acks > 0 ? (double) LOAD(ack_latency) / acks : 0.0,
+                 (unsigned long long) LOAD(ack_latency_max));
+    pos = append(buf, len, pos, "\"rtt_us\":{\"samples\":%llu,\"min\":%llu,"
+                 "\"mean\":%.1f,\"max\":%llu,\"histogram\":[",
+                 (unsigned long long) samples,
+                 (unsigned long long) LOAD(rtt_min),
+                 samples > 0 ? (double) LOAD(rtt_total) / samples : 0.0,
+                 (unsigned long long) LOAD(rtt_max));
+
+    /*Each non-empty bucket is [bound, count], counting samples under the
+     * bound. The last bucket has no bound*/
+    for(i = 0; i < RTT_BUCKETS; i++){
+        count = LOAD(rtt_hist[i]);
+        if(count == 0){
+            continue;
+        }
+        if(i < RTT_BUCKETS - 1){
+            pos = append(buf, len, pos, "%s[%llu,%llu]", first ? "" : ",",
+                         (unsigned long long) 2 << i,
+                         (unsigned long long) count);
+        }
+        else {
+            pos = append(buf, len, pos, "%s[null,%llu]", first ? "" : ",",
+                         (unsigned long long) count);
+        }
+        first = FALSE;
+    }
+    pos = append(buf, len, pos, "]}}");
+    return (int) pos;
+}
@@ -0,0 +1,100 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * metrics.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used to count
+ * what happened during a transfer, so a slow transfer can be explained, and
+ * to print the counts as JSON. The server and the client each keep the
+ * counts that make sense on their side and leave the rest at zero.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_METRICS_H
+#define PROJECT_4_METRICS_H
+
+#include "rudp_packet.h"
+
+#define RTT_BUCKETS 24      /*Buckets of the RTT histogram. Bucket i counts
+                             *samples under 2^(i+1) us, and the last one
+                             *everything longer*/
+#define METRICS_JSON 2048   /*Room needed by the JSON of one metrics_t*/
+
+/*Custom struct for the counts of a transfer*/
+struct metrics_t{
+    u_int64_t started;              //Time the transfer started (us)
+    u_int64_t finished;             //Time the transfer finished (us)
+    u_int64_t first_byte;           //Time the first file data was sent or
+                                    //received (us)
+    u_int64_t bytes;                //File data delivered
+    u_int64_t packets_sent;         //Data packets sent, including resends
+    u_int64_t retransmits;          //Data packets sent again
+    u_int64_t parity_sent;          //Parity packets sent
+    u_int64_t packets_received;     //Data packets received
+    u_int64_t recovered;            //Data packets rebuilt from parity
+    u_int64_t duplicates;           //Packets or SACKs that held nothing new
+    u_int64_t bad_checksums;        //Datagrams with a bad checksum
+    u_int64_t out_of_order;         //Packets or SACKs received out of order
+    u_int64_t acks;                 //Acknowledgements sent or received
+    u_int64_t ack_latency;          //Total time ACKs were held back (us)
+    u_int64_t ack_latency_max;      //Longest time an ACK was held back (us)
+    u_int64_t rtt_samples;          //Round trip times measured
+    u_int64_t rtt_total;            //Sum of the round trip times (us)
+    u_int64_t rtt_min;              //Shortest round trip time (us)
+    u_int64_t rtt_max;              //Longest round trip time (us)
+    u_int64_t rtt_hist[RTT_BUCKETS];//Round trip times by power of two
+};
+
+/*Typedefs*/
+typedef struct metrics_t metrics_t;
+
+/*******************************************************************************
+ * Clears the counts of a transfer (metrics) and marks it started now
+ *
+ * @param metrics - The counts to clear
+ ******************************************************************************/
+void init_metrics(metrics_t * metrics);
+
+/*******************************************************************************
+ * Adds a round trip time (sample) to the counts of a transfer (metrics)
+ *
+ * @param metrics - The counts of the transfer
+ * @param sample - The round trip time (us)
+ ******************************************************************************/
+void record_rtt(metrics_t * metrics, u_int64_t sample);
+
+/*******************************************************************************
+ * Counts an acknowledgement that was held back for a given time (latency)
+ * after the first packet it acknowledges arrived
+ *
+ * @param metrics - The counts of the transfer
+ * @param latency - How long the ACK was held back (us)
+ ******************************************************************************/
+void record_ack(metrics_t * metrics, u_int64_t latency);
+
+/*******************************************************************************
+ * Adds the counts of a finished transfer (metrics) to running totals (totals)
+ * with atomic adds, so another thread may read the totals at any time. The
+ * times of the totals are left alone.
+ *
+ * @param totals - The running totals
+ * @param metrics - The counts to add
+ ******************************************************************************/
+void add_metrics(metrics_t * totals, const metrics_t * metrics);
+
+/*******************************************************************************
+ * Writes the counts of a transfer (metrics) as a JSON object into a buffer
+ * (buf) of len bytes, which should hold at least METRICS_JSON. The fields of
+ * the object (fields), which must be JSON members followed by a comma, or
+ * empty, are put first. The counts are read with atomic loads, so they may be
+ * written by another thread. Returns the length of the JSON.
+ *
+ * @param metrics - The counts to write
+ * @param fields - Extra JSON members to put first, each followed by a comma
+ * @param buf - The buffer to write into
+ * @param len - The size of the buffer
+ * @return length - The length of the JSON, not counting its '\0'
+ ******************************************************************************/
+int format_metrics(const metrics_t * metrics, const char * fields, char * buf,
+                   size_t len);
+
+#endif //PROJECT_4_METRICS_H
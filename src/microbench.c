@@ -0,0 +1,923 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * Micro-benchmarks
+ * @author Mark Jannenga
+ *
+ * This program times the primitives that the server and client spend their
+ * time in, each on its own, in the style of google-benchmark: computing and
+ * checking packet checksums, making packets, multiplying regions for parity,
+ * and filling, acknowledging and advancing the sliding window. Each benchmark
+ * is a function that repeats an operation while keep_running says so, and the
+ * number of repetitions is raised until the operation has been timed for long
+ * enough to trust. Work that only sets up the next operation is left out of
+ * the timing with pause_timing and resume_timing. Checksums and parity are
+ * timed with every kernel the CPU supports, across payload sizes, and the
+ * window across window sizes, so a change to any of them can be judged before
+ * timing whole transfers with rudp_bench.
+ ******************************************************************************/
+
+#include "rudp_packet.h"
+#include "checksum.h"
+#include "crc32c.h"
+#include "window.h"
+#include "rtt.h"
+#include "congestion.h"
+#include "fec.h"
+#include <regex.h>
+
+#define MIN_TIME 0.25           /*Default time each benchmark is timed (s)*/
+#define MAX_ITERATIONS 1000000000 /*Most repetitions of one benchmark*/
+#define MAX_SWEEP 16            /*Most values of each setting swept*/
+#define NAME_LEN 96             /*Room for the name of a benchmark*/
+#define ACK_EVERY 2             /*Packets acknowledged by each SACK, as the
+                                 *client acknowledges every other packet*/
+
+#define DEFAULT_PAYLOADS "64,948,1444,8972,65479" /*Payload sizes swept*/
+#define DEFAULT_WINDOWS "64,1024,4096"  /*Window sizes swept*/
+
+/*Custom struct for a benchmark being run, like benchmark::State. The
+ * benchmark reads its arguments from range and reports what it processed in
+ * bytes and items*/
+struct state_t{
+    u_int64_t range[3];             //Arguments of the benchmark
+    u_int64_t iterations;           //Repetitions to run
+    u_int64_t done;                 //Repetitions started so far
+    u_int64_t started;              //Time timing last resumed (ns)
+    u_int64_t cpu_started;          //CPU time timing last resumed (ns)
+    u_int64_t elapsed;              //Time timed so far (ns)
+    u_int64_t cpu_elapsed;          //CPU time timed so far (ns)
+    u_int64_t bytes;                //Bytes processed by every repetition
+    u_int64_t items;                //Items processed by every repetition
+    const char *error;              //Why the benchmark failed, or NULL
+};
+
+/*Custom struct for the settings of the whole run*/
+struct micro_opts_t{
+    double min_time;                //Time each benchmark is timed for (s)
+    regex_t filter;                 //Benchmarks to run, by name
+    bool json;                      //Print JSON rather than a table
+};
+
+/*Custom struct for a window being benchmarked, with the file it sends and
+ * a socket to send its packets to, which is never read*/
+struct fixture_t{
+    window_t window;                //The window
+    FILE *file;                     //The file it sends, exactly one window
+    bool mapped;                    //Whether the file is sent from a mapping
+    rtt_t rtt;                      //RTT estimate the window is sent with
+    cc_t cc;                        //Congestion control, which allows all
+    int sockfd;                     //Socket the window is sent over
+    int sink;                       //Socket the packets are sent to
+    struct sockaddr_in addr;        //Address of sink
+};
+
+/*Typedefs*/
+typedef struct state_t state_t;
+typedef struct micro_opts_t micro_opts_t;
+typedef struct fixture_t fixture_t;
+typedef void (*bench_fn_t)(state_t * state);
+
+/*Function prototypes*/
+int parse_sizes(const char * list, u_int64_t * values);
+void run_benchmark(micro_opts_t * opts, const char * name, bench_fn_t fn,
+                   u_int64_t arg0, u_int64_t arg1, u_int64_t arg2);
+void bm_calc_checksum(state_t * state);
+void bm_check_checksum(state_t * state);
+void bm_create_rudp_packet(state_t * state);
+void bm_gf_mul_add(state_t * state);
+void bm_fill_window(state_t * state);
+void bm_process_ack(state_t * state);
+void bm_advance_window(state_t * state);
+
+/*Results are stored here so the compiler cannot leave out the work*/
+static volatile u_int64_t sink;
+
+/*Kernels of each checksum, fastest last*/
+static const char * inet_kernels[] = {"scalar", "sse2", "avx2"};
+static const char * crc_kernels[] = {"bytewise", "slice8", "sse4.2"};
+static const char * fec_kernels[] = {"scalar", "ssse3", "avx2"};
+
+/*******************************************************************************
+ * Micro-benchmark main method. The payload sizes (-p) and window sizes (-w) to
+ * sweep are each given as a comma separated list. Only the benchmarks whose
+ * names match the extended regular expression given with -f are run, and
+ * each is timed for at least the number of seconds given with -t. Results are
+ * printed as a table, or as one line of JSON each with -j.
+ *
+ * @param argc
+ * @param argv - [-p Payloads] [-w Windows] [-f Filter] [-t Min time (s)]
+ *               [-j]
+ * @return
+ ******************************************************************************/
+int main(int argc, char **argv){
+    const char * payloads = DEFAULT_PAYLOADS, * windows = DEFAULT_WINDOWS;
+    const char * filter = ".", * inet_default, * crc_default, * fec_default;
+    u_int64_t payload_list[MAX_SWEEP], window_list[MAX_SWEEP];
+    int payload_count, window_count, p, w, k, i, opt;
+    char name[NAME_LEN];
+    micro_opts_t opts;
+
+    opts.min_time = MIN_TIME;
+    opts.json = FALSE;
+
+    /*Check command line options*/
+    while((opt = getopt(argc, argv, "p:w:f:t:j")) != -1){
+        switch(opt){
+            case 'p':
+                payloads = optarg;
+                break;
+            case 'w':
+                windows = optarg;
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 't':
+                opts.min_time = atof(optarg);
+                break;
+            case 'j':
+                opts.json = TRUE;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-p Payloads] [-w Windows] "
+                        "[-f Filter] [-t Min time (s)] [-j]\n", argv[0]);
+                exit(1);
+        }
+    }
+    payload_count = parse_sizes(payloads, payload_list);
+    window_count = parse_sizes(windows, window_list);
+    if(payload_count <= 0 || window_count <= 0){
+        fprintf(stderr, "Each list must hold 1 to %d numbers\n", MAX_SWEEP);
+        exit(1);
+    }
+    for(p = 0; p < payload_count; p++){
+        if(payload_list[p] == 0 || payload_list[p] > MAX_PAYLOAD){
+            fprintf(stderr, "Payloads must be 1 to %d bytes\n", MAX_PAYLOAD);
+            exit(1);
+        }
+    }
+    for(w = 0; w < window_count; w++){
+        if(window_list[w] < ACK_EVERY || window_list[w] > MAX_WINDOW){
+            fprintf(stderr, "Windows must be %d to %d packets\n", ACK_EVERY,
+                    MAX_WINDOW);
+            exit(1);
+        }
+    }
+    if(opts.min_time <= 0){
+        fprintf(stderr, "Min time must be above 0\n");
+        exit(1);
+    }
+    if(regcomp(&opts.filter, filter, REG_EXTENDED | REG_NOSUB) != 0){
+        fprintf(stderr, "Bad filter %s\n", filter);
+        exit(1);
+    }
+
+    /*Say what the numbers were measured on*/
+    inet_default = checksum_kernel();
+    crc_default = crc32c_kernel();
+    fec_default = fec_kernel();
+    if(!opts.json){
+        fprintf(stderr, "Run on %ld CPU(s), checksum kernel %s, CRC32C "
+                "kernel %s, parity kernel %s\n",
+                sysconf(_SC_NPROCESSORS_ONLN), inet_default, crc_default,
+                fec_default);
+#ifndef NDEBUG
+        fprintf(stderr, "***WARNING*** Built without -O2 -DNDEBUG, timings "
+                "may be affected\n");
+#endif
+        printf("%-40s %14s %14s %12s %12s %12s\n", "Benchmark", "Time",
+               "CPU", "Iterations", "Bytes/s", "Items/s");
+        for(i = 0; i < 109; i++){
+            putchar('-');
+        }
+        putchar('\n');
+    }
+
+    /*Checksums with every kernel the CPU has*/
+    for(k = 0; k < (int) (sizeof(inet_kernels) / sizeof(inet_kernels[0]));
+            k++){
+        if(!set_checksum_kernel(inet_kernels[k])){
+            continue;
+        }
+        for(p = 0; p < payload_count; p++){
+            snprintf(name, sizeof(name), "calc_checksum/inet-%s/%llu",
+                     inet_kernels[k], (unsigned long long) payload_list[p]);
+            run_benchmark(&opts, name, bm_calc_checksum, payload_list[p], 0,
+                          0);
+            snprintf(name, sizeof(name), "check_checksum/inet-%s/%llu",
+                     inet_kernels[k], (unsigned long long) payload_list[p]);
+            run_benchmark(&opts, name, bm_check_checksum, payload_list[p], 0,
+                          0);
+        }
+    }
+    set_checksum_kernel(inet_default);
+    for(k = 0; k < (int) (sizeof(crc_kernels) / sizeof(crc_kernels[0])); k++){
+        if(!set_crc32c_kernel(crc_kernels[k])){
+            continue;
+        }
+        for(p = 0; p < payload_count; p++){
+            snprintf(name, sizeof(name), "calc_checksum/crc32c-%s/%llu",
+                     crc_kernels[k], (unsigned long long) payload_list[p]);
+            run_benchmark(&opts, name, bm_calc_checksum, payload_list[p],
+                          CHECK_CRC32C, 0);
+            snprintf(name, sizeof(name), "check_checksum/crc32c-%s/%llu",
+                     crc_kernels[k], (unsigned long long) payload_list[p]);
+            run_benchmark(&opts, name, bm_check_checksum, payload_list[p],
+                          CHECK_CRC32C, 0);
+        }
+    }
+    set_crc32c_kernel(crc_default);
+
+    /*Parity with every kernel the CPU has, multiplying by a constant that is
+     * not 1, so the table or shuffles are used rather than a plain XOR*/
+    for(k = 0; k < (int) (sizeof(fec_kernels) / sizeof(fec_kernels[0])); k++){
+        if(!set_fec_kernel(fec_kernels[k])){
+            continue;
+        }
+        for(p = 0; p < payload_count; p++){
+            snprintf(name, sizeof(name), "gf_mul_add/%s/%llu", fec_kernels[k],
+                     (unsigned long long) payload_list[p]);
+            run_benchmark(&opts, name, bm_gf_mul_add, payload_list[p], 0x8E,
+                          0);
+        }
+    }
+    set_fec_kernel(fec_default);
+
+    /*Packets made by create_rudp_packet only have room for RUDP_DATA*/
+    for(p = 0; p < payload_count; p++){
+        if(payload_list[p] > RUDP_DATA){
+            continue;
+        }
+        snprintf(name, sizeof(name), "create_rudp_packet/%llu",
+                 (unsigned long long) payload_list[p]);
+        run_benchmark(&opts, name, bm_create_rudp_packet, payload_list[p],
+                      0, 0);
+    }
+
+    /*Filling depends on the payload, acknowledging only on the window.
+     * Windows over MAX_WINDOW_BYTES would be shrunk, so they are left out*/
+    for(w = 0; w < window_count; w++){
+        for(p = 0; p < payload_count; p++){
+            if(window_list[w] * payload_list[p] > MAX_WINDOW_BYTES){
+                continue;
+            }
+            snprintf(name, sizeof(name), "fill_window/stdio/%llu/%llu",
+                     (unsigned long long) window_list[w],
+                     (unsigned long long) payload_list[p]);
+            run_benchmark(&opts, name, bm_fill_window, window_list[w],
+                          payload_list[p], FALSE);
+            snprintf(name, sizeof(name), "fill_window/mmap/%llu/%llu",
+                     (unsigned long long) window_list[w],
+                     (unsigned long long) payload_list[p]);
+            run_benchmark(&opts, name, bm_fill_window, window_list[w],
+                          payload_list[p], TRUE);
+        }
+    }
+    for(w = 0; w < window_count; w++){
+        snprintf(name, sizeof(name), "process_ack/cumulative/%llu",
+                 (unsigned long long) window_list[w]);
+        run_benchmark(&opts, name, bm_process_ack, window_list[w], FALSE,
+                      0);
+        snprintf(name, sizeof(name), "process_ack/selective/%llu",
+                 (unsigned long long) window_list[w]);
+        run_benchmark(&opts, name, bm_process_ack, window_list[w], TRUE,
+                      0);
+        snprintf(name, sizeof(name), "advance_window/%llu",
+                 (unsigned long long) window_list[w]);
+        run_benchmark(&opts, name, bm_advance_window, window_list[w], 0, 0);
+    }
+
+    regfree(&opts.filter);
+    return 0;
+}
+
+/*******************************************************************************
+ * Reads a comma separated list of sizes (list) into values, which holds up to
+ * MAX_SWEEP of them. A K, M or G suffix multiplies a size by 1024, 1024^2 or
+ * 1024^3. Returns the number of sizes read, or -1 if the list is malformed.
+ *
+ * @param list - The list to read
+ * @param values - The sizes read
+ * @return count - The number of sizes, or -1
+ ******************************************************************************/
+int parse_sizes(const char * list, u_int64_t * values){
+    const char * pos = list;
+    char * end;
+    int count = 0;
+
+    while(*pos != '\0'){
+        if(count == MAX_SWEEP){
+            return -1;
+        }
+        values[count] = strtoull(pos, &end, 10);
+        if(end == pos){
+            return -1;
+        }
+        switch(*end){
+            case 'K':
+                values[count] <<= 10;
+                end++;
+                break;
+            case 'M':
+                values[count] <<= 20;
+                end++;
+                break;
+            case 'G':
+                values[count] <<= 30;
+                end++;
+                break;
+        }
+        if(*end != ',' && *end != '\0'){
+            return -1;
+        }
+        count++;
+        pos = *end == ',' ? end + 1 : end;
+    }
+    return count;
+}
+
+/*******************************************************************************
+ * Returns the time of a given clock (clock) in nanoseconds
+ *
+ * @param clock - The clock to read
+ * @return time - The time (ns)
+ ******************************************************************************/
+static u_int64_t get_time_ns(clockid_t clock){
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (u_int64_t) ts.tv_sec * 1000000000 + (u_int64_t) ts.tv_nsec;
+}
+
+/*******************************************************************************
+ * Stops timing a benchmark (state) while it sets up the next repetition
+ *
+ * @param state - The benchmark
+ ******************************************************************************/
+static void pause_timing(state_t * state){
+    state->elapsed += get_time_ns(CLOCK_MONOTONIC) - state->started;
+    state->cpu_elapsed += get_time_ns(CLOCK_PROCESS_CPUTIME_ID) -
+                          state->cpu_started;
+}
+
+/*******************************************************************************
+ * Starts timing a benchmark (state) again after pause_timing
+ *
+ * @param state - The benchmark
+ ******************************************************************************/
+static void resume_timing(state_t * state){
+    state->cpu_started = get_time_ns(CLOCK_PROCESS_CPUTIME_ID);
+    state->started = get_time_ns(CLOCK_MONOTONIC);
+}
+
+/*******************************************************************************
+ * Returns TRUE while a benchmark (state) has repetitions left to run, else
+ * FALSE. Timing starts on the first call and stops on the last, so the setup
+ * before the loop and the cleanup after it are not timed.
+ *
+ * @param state - The benchmark
+ * @return TRUE or FALSE - Whether or not to run another repetition
+ ******************************************************************************/
+static bool keep_running(state_t * state){
+    if(state->done == 0){
+        resume_timing(state);
+    }
+    if(state->done < state->iterations && state->error == NULL){
+        state->done++;
+        return TRUE;
+    }
+    pause_timing(state);
+    return FALSE;
+}
+
+/*******************************************************************************
+ * Ends a benchmark (state) early because of an error (error), which is
+ * printed in place of its results. The benchmark should return right away.
+ *
+ * @param state - The benchmark
+ * @param error - What went wrong
+ ******************************************************************************/
+static void skip_with_error(state_t * state, const char * error){
+    state->error = error;
+}
+
+/*******************************************************************************
+ * Formats a rate (rate) per second with a K, M or G suffix into a buffer (buf)
+ * of len bytes
+ *
+ * @param rate - The rate
+ * @param buf - The buffer
+ * @param len - The size of the buffer
+ * @return buf - The buffer
+ ******************************************************************************/
+static char * format_rate(double rate, char * buf, size_t len){
+    const char * units = " KMGT";
+    int unit = 0;
+
+    while(rate >= 1000 && unit < 4){
+        rate /= 1000;
+        unit++;
+    }
+    if(unit == 0){
+        snprintf(buf, len, "%.3g/s", rate);
+    }
+    else {
+        snprintf(buf, len, "%.3g%c/s", rate, units[unit]);
+    }
+    return buf;
+}
+
+/*******************************************************************************
+ * Runs a benchmark (fn) named name with the arguments arg0, arg1 and arg2, if
+ * its name matches the filter. It is first run once, then with more and more
+ * repetitions until it has been timed for at least the minimum time, as
+ * google-benchmark does, and the last run is printed.
+ *
+ * @param opts - The settings of the run
+ * @param name - The name of the benchmark
+ * @param fn - The benchmark
+ * @param arg0 - Its first argument
+ * @param arg1 - Its second argument
+ * @param arg2 - Its third argument
+ ******************************************************************************/
+void run_benchmark(micro_opts_t * opts, const char * name, bench_fn_t fn,
+                   u_int64_t arg0, u_int64_t arg1, u_int64_t arg2){
+    u_int64_t iterations = 1, next;
+    char bytes_rate[32], items_rate[32];
+    double seconds, multiplier, ns, cpu_ns;
+    state_t state;
+
+    if(regexec(&opts->filter, name, 0, NULL, 0) != 0){
+        return;
+    }
+    while(TRUE){
+        memset(&state, 0, sizeof(state_t));
+        state.range[0] = arg0;
+        state.range[1] = arg1;
+        state.range[2] = arg2;
+        state.iterations = iterations;
+        fn(&state);
+        if(state.error != NULL){
+            break;
+        }
+
+        /*Grow by up to 10 times at once, aiming 40% past the minimum*/
+        seconds = (double) state.elapsed / 1e9;
+        if(seconds >= opts->min_time || iterations >= MAX_ITERATIONS){
+            break;
+        }
+        multiplier = 10;
+        if(seconds / opts->min_time > 0.1){
+            multiplier = opts->min_time * 1.4 / seconds;
+        }
+        next = (u_int64_t) ((double) iterations * multiplier);
+        iterations = next > iterations ? next : iterations + 1;
+        if(iterations > MAX_ITERATIONS){
+            iterations = MAX_ITERATIONS;
+        }
+    }
+
+    if(state.error != NULL){
+        if(opts->json){
+            printf("{\"name\":\"%s\",\"error\":\"%s\"}\n", name, state.error);
+        }
+        else {
+            printf("%-40s ERROR OCCURRED: '%s'\n", name, state.error);
+        }
+        fflush(stdout);
+        return;
+    }
+    seconds = (double) state.elapsed / 1e9;
+    ns = (double) state.elapsed / (double) state.iterations;
+    cpu_ns = (double) state.cpu_elapsed / (double) state.iterations;
+    if(opts->json){
+        printf("{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.3f,"
+               "\"cpu_ns_per_op\":%.3f,\"bytes_per_second\":%.0f,"
+               "\"items_per_second\":%.0f}\n", name,
+               (unsigned long long) state.iterations, ns, cpu_ns,
+               seconds > 0 ? (double) state.bytes / seconds : 0.0,
+               seconds > 0 ? (double) state.items / seconds : 0.0);
+    }
+    else {
+        printf("%-40s %11.1f ns %11.1f ns %12llu %12s %12s\n", name, ns,
+               cpu_ns, (unsigned long long) state.iterations,
+               state.bytes == 0 ? "" :
+               format_rate((double) state.bytes / seconds, bytes_rate,
+                           sizeof(bytes_rate)),
+               state.items == 0 ? "" :
+               format_rate((double) state.items / seconds, items_rate,
+                           sizeof(items_rate)));
+    }
+    fflush(stdout);
+}
+
+/*******************************************************************************
+ * Allocates a data packet with room for a given payload (payload) and the
+ * given flags (flags), filled with arbitrary data. Returns NULL if it could
+ * not be allocated.
+ *
+ * @param payload - The size of the data of the packet
+ * @param flags - The flags of the packet
+ * @return rudp_pkt - The packet, or NULL
+ ******************************************************************************/
+static rudp_packet_t * make_packet(u_int64_t payload, u_int8_t flags){
+    rudp_packet_t * rudp_pkt = malloc((size_t) (RUDP_HEAD + payload));
+    u_int64_t i;
+
+    if(rudp_pkt == NULL){
+        return NULL;
+    }
+    for(i = 0; i < payload; i++){
+        rudp_pkt->data[i] = (unsigned char) (i * 2654435761U >> 24);
+    }
+    init_header(rudp_pkt, DATA_PKT, 1, (u_int16_t) payload);
+    set_flags(rudp_pkt, flags);
+    return rudp_pkt;
+}
+
+/*******************************************************************************
+ * Times calc_checksum over a data packet of range[0] bytes of data, with the
+ * flags range[1], as a packet is checksummed when it is made
+ *
+ * @param state - The benchmark
+ ******************************************************************************/
+void bm_calc_checksum(state_t * state){
+    rudp_packet_t * rudp_pkt = make_packet(state->range[0],
+                                           (u_int8_t) state->range[1]);
+    int size = (int) (RUDP_HEAD + state->range[0]);
+
+    if(rudp_pkt == NULL){
+        skip_with_error(state, "could not allocate a packet");
+        return;
+    }
+    while(keep_running(state)){
+        set_checksum(rudp_pkt, 0);
+        sink = calc_checksum(rudp_pkt, size);
+    }
+    state->bytes = state->iterations * (u_int64_t) size;
+    state->items = state->iterations;
+    free(rudp_pkt);
+}
+
+/*******************************************************************************
+ * Times gf_mul_add of range[0] bytes multiplied by the constant range[1], as
+ * each data packet is added to each Reed-Solomon parity packet of its block
+ *
+ * @param state - The benchmark
+ ******************************************************************************/
+void bm_gf_mul_add(state_t * state){
+    size_t len = (size_t) state->range[0], i;
+    unsigned char * dst = calloc(len, 1), * src = malloc(len);
+
+    if(dst == NULL || src == NULL){
+        skip_with_error(state, "could not allocate the regions");
+        free(dst);
+        free(src);
+        return;
+    }
+    for(i = 0; i < len; i++){
+        src[i] = (unsigned char) (i * 2654435761U >> 24);
+    }
+    while(keep_running(state)){
+        gf_mul_add(dst, src, (u_int8_t) state->range[1], len);
+    }
+    sink = dst[len - 1];
+    state->bytes = state->iterations * (u_int64_t) len;
+    state->items = state->iterations;
+    free(dst);
+    free(src);
+}
+
+/*******************************************************************************
+ * Times check_checksum of a correct data packet of range[0] bytes of data,
+ * with the flags range[1], as every packet is checked when it arrives
+ *
+ * @param state - The benchmark
+ ******************************************************************************/
+void bm_check_checksum(state_t * state){
+    rudp_packet_t * rudp_pkt = make_packet(state->range[0],
+                                           (u_int8_t) state->range[1]);
+    int size = (int) (RUDP_HEAD + state->range[0]);
+
+    if(rudp_pkt == NULL){
+        skip_with_error(state, "could not allocate a packet");
+        return;
+    }
+    set_checksum(rudp_pkt, calc_checksum(rudp_pkt, size));
+    if(!check_checksum(rudp_pkt, size)){
+        free(rudp_pkt);
+        skip_with_error(state, "checksum of a correct packet failed");
+        return;
+    }
+    while(keep_running(state)){
+        sink = check_checksum(rudp_pkt, size);
+    }
+    state->bytes = state->iterations * (u_int64_t) size;
+    state->items = state->iterations;
+    free(rudp_pkt);
+}
+
+/*******************************************************************************
+ * Times create_rudp_packet making a packet of range[0] bytes of data,
+ * including freeing it, since every packet it makes is allocated
+ *
+ * @param state - The benchmark
+ ******************************************************************************/
+void bm_create_rudp_packet(state_t * state){
+    unsigned char data[RUDP_DATA];
+    rudp_packet_t * rudp_pkt;
+    u_int64_t seq_num = 0;
+
+    memset(data, 0xA5, sizeof(data));
+    while(keep_running(state)){
+        rudp_pkt = create_rudp_packet(data, (size_t) state->range[0],
+                                      &seq_num);
+        sink = get_checksum(rudp_pkt);
+        free(rudp_pkt);
+        seq_num++;
+    }
+    state->bytes = state->iterations * state->range[0];
+    state->items = state->iterations;
+}
+
+/*******************************************************************************
+ * Sets up a window (fx) of a given number of packets (capacity), each of a
+ * given payload (payload), sending a file of exactly one window, read with
+ * stdio or, if mapped is TRUE, from a mapping. Its packets are checked with
+ * CRC32C and a digest, as the server does by default. Returns NULL if it
+ * could not be set up, else an error message.
+ *
+ * @param fx - The window to set up
+ * @param capacity - The number of packets in the window
+ * @param payload - The size of the data of each packet
+ * @param mapped - Whether to send the file from a mapping
+ * @return error - What went wrong, or NULL
+ ******************************************************************************/
+static const char * open_fixture(fixture_t * fx, u_int32_t capacity,
+                                 u_int32_t payload, bool mapped){
+    socklen_t addr_len = sizeof(fx->addr);
+
+    memset(fx, 0, sizeof(fixture_t));
+    fx->sockfd = -1;
+    fx->sink = -1;
+    init_window(&fx->window, capacity, payload);
+    fx->window.flags = CHECK_CRC32C;
+    init_rtt(&fx->rtt, 1000000);
+    init_cc(&fx->cc, "none", fx->window.capacity, RUDP_HEAD + payload);
+
+    /*The file is sparse, so making it costs nothing*/
+    fx->file = tmpfile();
+    if(fx->file == NULL || ftruncate(fileno(fx->file),
+                                     (off_t) fx->window.capacity *
+                                     fx->window.payload) != 0){
+        return "could not make a file";
+    }
+    if(mapped && !map_file(&fx->window, fx->file)){
+        return "could not map the file";
+    }
+    fx->mapped = mapped;
+
+    /*Packets are sent to a socket of loopback that is never read, so the
+     * kernel drops them once its buffer is full*/
+    fx->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    fx->sink = socket(AF_INET, SOCK_DGRAM, 0);
+    fx->addr.sin_family = AF_INET;
+    fx->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(fx->sockfd < 0 || fx->sink < 0 ||
+            bind(fx->sink, (struct sockaddr *) &fx->addr,
+                 sizeof(fx->addr)) < 0 ||
+            getsockname(fx->sink, (struct sockaddr *) &fx->addr,
+                        &addr_len) < 0){
+        return "could not open the sockets";
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * Fills the empty window of a fixture (fx) with the whole file again
+ *
+ * @param fx - The window
+ ******************************************************************************/
+static void refill(fixture_t * fx){
+    if(fx->mapped){
+        fx->window.map_off = 0;
+    }
+    else {
+        rewind(fx->file);
+    }
+    fill_window(&fx->window, fx->file);
+}
+
+/*******************************************************************************
+ * Sends every packet in the window of a fixture (fx), so each is in flight
+ * with a retransmission timer as it would be in a transfer
+ *
+ * @param fx - The window
+ ******************************************************************************/
+static void send_all(fixture_t * fx){
+    send_window(&fx->window, fx->sockfd, (struct sockaddr *) &fx->addr,
+                &fx->rtt, &fx->cc);
+}
+
+/*******************************************************************************
+ * Makes a SACK (rudp_ack) acknowledging every packet before cum_ack plus the
+ * first bits packets after it, and returns its size
+ *
+ * @param rudp_ack - The SACK to make, with room for SACK_BYTES of bitmap
+ * @param cum_ack - The cumulative ack point
+ * @param bits - The number of packets after cum_ack acknowledged
+ * @return size - The size of the SACK
+ ******************************************************************************/
+static int make_sack(rudp_packet_t * rudp_ack, u_int64_t cum_ack,
+                     u_int32_t bits){
+    u_int32_t len = (bits + 7) / 8;
+
+    init_header(rudp_ack, SACK, cum_ack, (u_int16_t) len);
+    memset(rudp_ack->data, 0xFF, bits / 8);
+    if(bits % 8 != 0){
+        rudp_ack->data[bits / 8] = (unsigned char) ((1 << bits % 8) - 1);
+    }
+    return RUDP_HEAD + (int) len;
+}
+
+/*******************************************************************************
+ * Acknowledges every packet in the window of a fixture (fx) and advances it,
+ * leaving it empty
+ *
+ * @param fx - The window
+ ******************************************************************************/
+static void ack_all(fixture_t * fx){
+    rudp_packet_t rudp_ack;
+
+    process_ack(&fx->window, &rudp_ack, make_sack(&rudp_ack,
+                                                  fx->window.next_seq, 0));
+    advance_window(&fx->window);
+}
+
+/*******************************************************************************
+ * Frees the window of a fixture (fx) and closes its file and sockets
+ *
+ * @param fx - The window
+ ******************************************************************************/
+static void close_fixture(fixture_t * fx){
+    free_window(&fx->window);
+    if(fx->file != NULL){
+        fclose(fx->file);
+    }
+    if(fx->sockfd >= 0){
+        close(fx->sockfd);
+    }
+    if(fx->sink >= 0){
+        close(fx->sink);
+    }
+}
+
+/*******************************************************************************
+ * Times fill_window filling an empty window of range[0] packets, each of
+ * range[1] bytes of data, from a file read with stdio, or from a mapping if
+ * range[2] is TRUE. A repetition fills the whole window.
+ *
+ * @param state - The benchmark
+ ******************************************************************************/
+void bm_fill_window(state_t * state){
+    const char * error;
+    fixture_t fx;
+
+    error = open_fixture(&fx, (u_int32_t) state->range[0],
+                         (u_int32_t) state->range[1],
+                         state->range[2] ? TRUE : FALSE);
+    if(error != NULL){
+        close_fixture(&fx);
+        skip_with_error(state, error);
+        return;
+    }
+    if(fx.window.capacity != state->range[0]){
+        close_fixture(&fx);
+        skip_with_error(state, "window is over MAX_WINDOW_BYTES");
+        return;
+    }
+    while(keep_running(state)){
+        refill(&fx);
+        pause_timing(state);
+        ack_all(&fx);
+        resume_timing(state);
+    }
+    state->items = state->iterations * fx.window.capacity;
+    state->bytes = state->items * fx.window.payload;
+    close_fixture(&fx);
+}
+
+/*******************************************************************************
+ * Times process_ack taking one SACK for a window of range[0] packets that are
+ * all in flight. The SACKs each acknowledge ACK_EVERY more packets: with
+ * range[1] FALSE, by moving the cumulative ack point, and with range[1] TRUE,
+ * by marking them in a bitmap that grows behind a lost first packet, until
+ * that packet is acknowledged at last. Between windows, the window is
+ * advanced, filled and sent again without being timed.
+ *
+ * @param state - The benchmark
+ ******************************************************************************/
+void bm_process_ack(state_t * state){
+    bool selective = state->range[1] ? TRUE : FALSE;
+    rudp_packet_t ** acks;
+    u_int32_t count, next, bits, i;
+    int * sizes;
+    const char * error;
+    fixture_t fx;
+
+    error = open_fixture(&fx, (u_int32_t) state->range[0], 64, TRUE);
+    if(error != NULL){
+        close_fixture(&fx);
+        skip_with_error(state, error);
+        return;
+    }
+
+    /*One SACK for every ACK_EVERY packets, and the last one covers the
+     * rest, bitmaps are no longer than SACK_BYTES*/
+    count = (fx.window.capacity + ACK_EVERY - 1) / ACK_EVERY;
+    acks = calloc(count, sizeof(rudp_packet_t *));
+    sizes = calloc(count, sizeof(int));
+    for(i = 0; acks != NULL && sizes != NULL && i < count; i++){
+        acks[i] = malloc((size_t) (RUDP_HEAD + SACK_BYTES));
+        if(acks[i] == NULL){
+            break;
+        }
+    }
+    if(acks == NULL || sizes == NULL || i < count){
+        for(i = 0; acks != NULL && i < count; i++){
+            free(acks[i]);
+        }
+        free(acks);
+        free(sizes);
+        close_fixture(&fx);
+        skip_with_error(state, "could not allocate the SACKs");
+        return;
+    }
+
+    next = count;
+    while(keep_running(state)){
+
+        /*Set up the next window once the last one is acknowledged*/
+        if(next == count){
+            pause_timing(state);
+            advance_window(&fx.window);
+            refill(&fx);
+            send_all(&fx);
+            for(i = 0; i < count; i++){
+                bits = (i + 1) * ACK_EVERY - 1;
+                if(i == count - 1 || !selective){
+                    sizes[i] = make_sack(acks[i], fx.window.base +
+                                         (i == count - 1 ?
+                                          fx.window.capacity :
+                                          (i + 1) * ACK_EVERY), 0);
+                }
+                else {
+                    sizes[i] = make_sack(acks[i], fx.window.base,
+                                         bits < SACK_BYTES * 8 ?
+                                         bits : SACK_BYTES * 8);
+                }
+            }
+            next = 0;
+            resume_timing(state);
+        }
+        sink = (u_int64_t) process_ack(&fx.window, acks[next], sizes[next]);
+        next++;
+    }
+    state->items = state->iterations;
+
+    for(i = 0; i < count; i++){
+        free(acks[i]);
+    }
+    free(acks);
+    free(sizes);
+    close_fixture(&fx);
+}
+
+/*******************************************************************************
+ * Times advance_window stepping over a window of range[0] packets that have
+ * all been acknowledged. Filling and acknowledging the window is not timed.
+ *
+ * @param state - The benchmark
+ ******************************************************************************/
+void bm_advance_window(state_t * state){
+    rudp_packet_t rudp_ack;
+    const char * error;
+    fixture_t fx;
+
+    error = open_fixture(&fx, (u_int32_t) state->range[0], 64, TRUE);
+    if(error != NULL){
+        close_fixture(&fx);
+        skip_with_error(state, error);
+        return;
+    }
+    while(keep_running(state)){
+        pause_timing(state);
+        refill(&fx);
+        process_ack(&fx.window, &rudp_ack, make_sack(&rudp_ack,
+                                                     fx.window.next_seq, 0));
+        resume_timing(state);
+        advance_window(&fx.window);
+    }
+    state->items = state->iterations * fx.window.capacity;
+    close_fixture(&fx);
+}
@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * pool.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in pool.h
+ ******************************************************************************/
+
+#include "pool.h"
+
+/*******************************************************************************
+ * Initializes a pool (pool) holding capacity packets, all of them free. Each
+ * packet has room for size bytes, which is less than a whole rudp_packet_t
+ * when only the header of each packet is needed.
+ *
+ * @param pool - The pool to initialize
+ * @param capacity - The number of packets in the pool
+ * @param size - The number of bytes needed for each packet
+ ******************************************************************************/
+void init_pool(packet_pool_t * pool, u_int32_t capacity, size_t size){
+    u_int32_t i;
+    void *storage;
+
+    /*Round each packet up to a whole number of cache lines*/
+    pool->stride = (size + CACHE_LINE - 1) &
+                   ~((size_t) CACHE_LINE - 1);
+    pool->capacity = capacity;
+
+    if(posix_memalign(&storage, CACHE_LINE, pool->stride * capacity) != 0){
+        fprintf(stderr, "Failed to allocate packet pool\n");
+        exit(1);
+    }
+    pool->storage = storage;
+    pool->free_list = malloc(sizeof(u_int32_t) * capacity);
+    if(pool->free_list == NULL){
+        fprintf(stderr, "Failed to allocate packet pool\n");
+        exit(1);
+    }
+
+    /*Push in reverse so packets are handed out in address order*/
+    for(i = 0; i < capacity; i++){
+        pool->free_list[i] = capacity - 1 - i;
+    }
+    pool->free_count = capacity;
+}
+
+/*******************************************************************************
+ * Frees the memory held by a pool (pool). Any packets still acquired from it
+ * become invalid.
+ *
+ * @param pool - The pool to free
+ ******************************************************************************/
+void free_pool(packet_pool_t * pool){
+    free(pool->storage);
+    free(pool->free_list);
+    pool->storage = NULL;
+    pool->free_list = NULL;
+    pool->capacity = 0;
+    pool->free_count = 0;
+}
+
+/*******************************************************************************
+ * Takes a packet from the pool (pool) in O(1). The contents of the packet are
+ * left over from its last use. Returns NULL if every packet is in use.
+ *
+ * @param pool - The pool to take a packet from
+ * @return pkt - A free packet, or NULL
+ ******************************************************************************/
+rudp_packet_t * acquire_packet(packet_pool_t * pool){
+    u_int32_t index;
+
+    if(pool->free_count == 0){
+        return NULL;
+    }
+    index = pool->free_list[--pool->free_count];
+    return (rudp_packet_t *) (pool->storage + pool->stride * index);
+}
+
+/*******************************************************************************
+ * Returns a packet (pkt) taken from the pool (pool) in O(1)
+ *
+ * @param pool - The pool the packet was taken from
+ * @param pkt - The packet to return
+ ******************************************************************************/
+void release_packet(packet_pool_t * pool, rudp_packet_t * pkt){
+    size_t index = (size_t) ((unsigned char *) pkt - pool->storage) /
+                   pool->stride;
+    pool->free_list[pool->free_count++] = (u_int32_t) index;
+}
@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * pool.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used to manage a
+ * fixed-size pool of RUDP packets, so packets can be reused during a transfer
+ * instead of being allocated and freed one at a time.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_POOL_H
+#define PROJECT_4_POOL_H
+
+#include "rudp_packet.h"
+
+#define CACHE_LINE 64       /*Alignment of each packet in the pool*/
+
+/*Custom struct to define a packet pool. All packets live in one block of
+ * memory, each starting on its own cache line, and the free packets are kept
+ * on a stack of indices so the most recently released packet is reused first*/
+struct packet_pool_t{
+    unsigned char *storage;         //Memory holding every packet
+    size_t stride;                  //Distance between packets in storage
+    u_int32_t capacity;             //Number of packets in the pool
+    u_int32_t *free_list;           //Stack of indices of free packets
+    u_int32_t free_count;           //Number of free packets
+};
+
+/*Typedefs*/
+typedef struct packet_pool_t packet_pool_t;
+
+/*******************************************************************************
+ * Initializes a pool (pool) holding capacity packets, all of them free. Each
+ * packet has room for size bytes, which is less than a whole rudp_packet_t
+ * when only the header of each packet is needed.
+ *
+ * @param pool - The pool to initialize
+ * @param capacity - The number of packets in the pool
+ * @param size - The number of bytes needed for each packet
+ ******************************************************************************/
+void init_pool(packet_pool_t * pool, u_int32_t capacity, size_t size);
+
+/*******************************************************************************
+ * Frees the memory held by a pool (pool). Any packets still acquired from it
+ * become invalid.
+ *
+ * @param pool - The pool to free
+ ******************************************************************************/
+void free_pool(packet_pool_t * pool);
+
+/*******************************************************************************
+ * Takes a packet from the pool (pool) in O(1). The contents of the packet are
+ * left over from its last use. Returns NULL if every packet is in use.
+ *
+ * @param pool - The pool to take a packet from
+ * @return pkt - A free packet, or NULL
+ ******************************************************************************/
+rudp_packet_t * acquire_packet(packet_pool_t * pool);
+
+/*******************************************************************************
+ * Returns a packet (pkt) taken from the pool (pool) in O(1)
+ *
+ * @param pool - The pool the packet was taken from
+ * @param pkt - The packet to return
+ ******************************************************************************/
+void release_packet(packet_pool_t * pool, rudp_packet_t * pkt);
+
+#endif //PROJECT_4_POOL_H
@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * Impairment Proxy
+ * @author Mark Jannenga
+ *
+ * This program relays UDP datagrams between clients and a server, impairing
+ * them as a poor network would, so the server and client can be tested under
+ * loss, corruption, duplication, reordering, delay and a limited rate without
+ * any special network setup. Clients send to the port of the proxy instead of
+ * the server's. Every random choice comes from a seeded generator, so a run
+ * with the same settings and traffic is impaired the same way. The proxy runs
+ * until it is killed, then prints what it did in each direction.
+ ******************************************************************************/
+
+#include "impair.h"
+#include <signal.h>
+
+/*The relay, stopped from the signal handler*/
+static impair_t relay;
+
+/*******************************************************************************
+ * Stops the relay when the program gets a signal (sig)
+ *
+ * @param sig - The signal
+ ******************************************************************************/
+static void on_signal(int sig){
+    (void) sig;
+    __atomic_store_n(&relay.stop, 1, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************************
+ * Proxy main method. Expects the port to listen on and the IPv4 address and
+ * port of the server as command line arguments. The impairments are given
+ * with -i as a comma separated list of name=value settings, as read by
+ * parse_impair, for example -i loss=1,delay=20,jitter=5,rate=100.
+ *
+ * @param argc
+ * @param argv - [-i Impairments] [Port] [Server IPv4 address] [Server port]
+ * @return
+ ******************************************************************************/
+int main(int argc, char **argv){
+    struct sockaddr_in server;
+    struct sigaction sa;
+    impair_opts_t opts;
+    int opt;
+
+    init_impair_opts(&opts);
+
+    /*Check command line options*/
+    while((opt = getopt(argc, argv, "i:")) != -1){
+        switch(opt){
+            case 'i':
+                if(!parse_impair(&opts, optarg)){
+                    fprintf(stderr, "Bad impairments %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-i Impairments] [Port] "
+                        "[Server IPv4 address] [Server port]\n", argv[0]);
+                exit(1);
+        }
+    }
+
+    /*Check command line arguments*/
+    if(argc - optind != 3){
+        fprintf(stderr, "Usage: %s [-i Impairments] [Port] "
+                "[Server IPv4 address] [Server port]\n", argv[0]);
+        exit(1);
+    }
+    memset(&server, 0, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = inet_addr(argv[optind + 1]);
+    server.sin_port = htons((uint16_t) atoi(argv[optind + 2]));
+    if(init_impair(&relay, &opts, atoi(argv[optind]), &server) == 0){
+        fprintf(stderr, "Could not bind port %s\n", argv[optind]);
+        exit(1);
+    }
+
+    /*Relay until killed, then say what happened*/
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    fprintf(stderr, "Relaying port %s to %s:%s\n", argv[optind],
+            argv[optind + 1], argv[optind + 2]);
+    run_impair(&relay);
+    print_impair_stats(&relay);
+    free_impair(&relay);
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * ring.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in ring.h
+ ******************************************************************************/
+
+#include "ring.h"
+#include <sys/eventfd.h>
+
+/*******************************************************************************
+ * Sleeps until the eventfd (fd) is written to or the time deadline passes,
+ * then resets the eventfd. A deadline of 0 never passes.
+ *
+ * @param fd - The eventfd to sleep on
+ * @param deadline - The time to stop waiting (us), or 0
+ ******************************************************************************/
+static void sleep_on(int fd, u_int64_t deadline){
+    struct pollfd pfd;
+    struct timespec wait, *timeout = NULL;
+    u_int64_t now, count;
+
+    if(deadline != 0){
+        now = get_time_us();
+        if(deadline <= now){
+            return;
+        }
+        wait.tv_sec = (time_t) ((deadline - now) / 1000000);
+        wait.tv_nsec = (long) ((deadline - now) % 1000000) * 1000;
+        timeout = &wait;
+    }
+
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if(ppoll(&pfd, 1, timeout, NULL) > 0){
+        read(fd, &count, sizeof(count));
+    }
+}
+
+/*******************************************************************************
+ * Wakes the thread sleeping on the eventfd (fd)
+ *
+ * @param fd - The eventfd to write to
+ ******************************************************************************/
+static void wake(int fd){
+    u_int64_t one = 1;
+    write(fd, &one, sizeof(one));
+}
+
+/*******************************************************************************
+ * Initializes an empty ring (ring) of RING_SLOTS datagrams
+ *
+ * @param ring - The ring to initialize
+ ******************************************************************************/
+void init_ring(ring_t * ring){
+    memset(ring, 0, sizeof(ring_t));
+    ring->slots = malloc(sizeof(ring_slot_t) * RING_SLOTS);
+    ring->mask = RING_SLOTS - 1;
+    ring->data_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ring->space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(ring->slots == NULL || ring->data_fd < 0 || ring->space_fd < 0){
+        fprintf(stderr, "Failed to create datagram ring\n");
+        exit(1);
+    }
+}
+
+/*******************************************************************************
+ * Frees the memory and eventfds held by a ring (ring)
+ *
+ * @param ring - The ring to free
+ ******************************************************************************/
+void free_ring(ring_t * ring){
+    free(ring->slots);
+    close(ring->data_fd);
+    close(ring->space_fd);
+    ring->slots = NULL;
+}
+
+/*******************************************************************************
+ * Producer: Returns the number of free slots in the ring (ring)
+ *
+ * @param ring - The ring
+ * @return space - The number of free slots
+ ******************************************************************************/
+u_int32_t ring_space(ring_t * ring){
+    return ring->mask + 1 -
+           (ring->tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE));
+}
+
+/*******************************************************************************
+ * Producer: Returns free slot i of the ring (ring), counted from the first
+ * free slot. i must be less than ring_space.
+ *
+ * @param ring - The ring
+ * @param i - The free slot wanted
+ * @return slot - The slot
+ ******************************************************************************/
+ring_slot_t * ring_free_slot(ring_t * ring, u_int32_t i){
+    return &ring->slots[(ring->tail + i) & ring->mask];
+}
+
+/*******************************************************************************
+ * Producer: Hands the first n free slots of the ring (ring), which have been
+ * filled in, to the consumer, and wakes the consumer if it is asleep
+ *
+ * @param ring - The ring
+ * @param n - The number of slots filled in
+ ******************************************************************************/
+void ring_publish(ring_t * ring, u_int32_t n){
+    /*The consumer sets its flag before looking at tail, and tail is stored
+     * before looking at the flag, so one of the two always sees the other*/
+    __atomic_store_n(&ring->tail, ring->tail + n, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&ring->consumer_waiting, __ATOMIC_SEQ_CST) &&
+            __atomic_exchange_n(&ring->consumer_waiting, 0, __ATOMIC_SEQ_CST)){
+        wake(ring->data_fd);
+    }
+}
+
+/*******************************************************************************
+ * Producer: Sleeps until the ring (ring) has a free slot
+ *
+ * @param ring - The ring
+ ******************************************************************************/
+void ring_wait_space(ring_t * ring){
+    __atomic_store_n(&ring->producer_waiting, 1, __ATOMIC_SEQ_CST);
+    if(ring->tail - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) >
+            ring->mask){
+        sleep_on(ring->space_fd, 0);
+    }
+    __atomic_store_n(&ring->producer_waiting, 0, __ATOMIC_SEQ_CST);
+}
+
+/*******************************************************************************
+ * Consumer: Returns the number of datagrams waiting in the ring (ring)
+ *
+ * @param ring - The ring
+ * @return count - The number of datagrams waiting
+ ******************************************************************************/
+u_int32_t ring_count(ring_t * ring){
+    return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) - ring->head;
+}
+
+/*******************************************************************************
+ * Consumer: Returns waiting datagram i of the ring (ring), counted from the
+ * oldest. i must be less than ring_count.
+ *
+ * @param ring - The ring
+ * @param i - The datagram wanted
+ * @return slot - The slot holding the datagram
+ ******************************************************************************/
+ring_slot_t * ring_used_slot(ring_t * ring, u_int32_t i){
+    return &ring->slots[(ring->head + i) & ring->mask];
+}
+
+/*******************************************************************************
+ * Consumer: Returns the n oldest datagrams of the ring (ring) to the producer,
+ * and wakes the producer if it is waiting for space
+ *
+ * @param ring - The ring
+ * @param n - The number of datagrams done with
+ ******************************************************************************/
+void ring_consume(ring_t * ring, u_int32_t n){
+    if(n == 0){
+        return;
+    }
+    __atomic_store_n(&ring->head, ring->head + n, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&ring->producer_waiting, __ATOMIC_SEQ_CST) &&
+            __atomic_exchange_n(&ring->producer_waiting, 0, __ATOMIC_SEQ_CST)){
+        wake(ring->space_fd);
+    }
+}
+
+/*******************************************************************************
+ * Consumer: Sleeps until the ring (ring) has a datagram waiting or the time
+ * deadline passes. A deadline of 0 waits for a datagram however long it
+ * takes.
+ *
+ * @param ring - The ring
+ * @param deadline - The time to stop waiting (us), or 0
+ ******************************************************************************/
+void ring_wait_data(ring_t * ring, u_int64_t deadline){
+    __atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == ring->head){
+        sleep_on(ring->data_fd, deadline);
+    }
+    __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+}
@@ -0,0 +1,137 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * ring.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used to hand
+ * received datagrams from one thread to another through a lock-free ring, so
+ * the thread that receives never waits on the thread that sends.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_RING_H
+#define PROJECT_4_RING_H
+
+#include "rudp_packet.h"
+
+#define RING_SLOTS 1024     /*Datagrams held by a ring, a power of two*/
+#define RING_GAP 64         /*Bytes between the counters of the two threads,
+                             *so they are not on the same cache line*/
+
+/*A datagram in the ring, with the address it came from*/
+struct ring_slot_t{
+    unsigned char data[MAX_LINE];   //The datagram
+    struct sockaddr_in addr;        //Address of the sender
+    int len;                        //Size of the datagram
+};
+
+/*Custom struct for a single-producer, single-consumer ring of datagrams.
+ * Slot i is used for the datagram numbered i % capacity. The producer only
+ * writes tail and the consumer only writes head, so neither takes a lock:
+ * each publishes its counter with a release store and reads the other's
+ * with an acquire load. A thread that finds the ring empty (or full) sets
+ * its waiting flag and sleeps on an eventfd, which the other thread only
+ * writes to when the flag is set*/
+struct ring_t{
+    struct ring_slot_t *slots;      //The datagrams
+    u_int32_t mask;                 //Number of slots minus 1
+    int data_fd;                    //eventfd the consumer sleeps on
+    int space_fd;                   //eventfd the producer sleeps on
+    unsigned char gap1[RING_GAP];
+    u_int32_t tail;                 //Datagrams published by the producer
+    u_int32_t producer_waiting;     //Whether the producer is asleep
+    unsigned char gap2[RING_GAP];
+    u_int32_t head;                 //Datagrams consumed by the consumer
+    u_int32_t consumer_waiting;     //Whether the consumer is asleep
+    unsigned char gap3[RING_GAP];
+};
+
+/*Typedefs*/
+typedef struct ring_slot_t ring_slot_t;
+typedef struct ring_t ring_t;
+
+/*******************************************************************************
+ * Initializes an empty ring (ring) of RING_SLOTS datagrams
+ *
+ * @param ring - The ring to initialize
+ ******************************************************************************/
+void init_ring(ring_t * ring);
+
+/*******************************************************************************
+ * Frees the memory and eventfds held by a ring (ring)
+ *
+ * @param ring - The ring to free
+ ******************************************************************************/
+void free_ring(ring_t * ring);
+
+/*******************************************************************************
+ * Producer: Returns the number of free slots in the ring (ring)
+ *
+ * @param ring - The ring
+ * @return space - The number of free slots
+ ******************************************************************************/
+u_int32_t ring_space(ring_t * ring);
+
+/*******************************************************************************
+ * Producer: Returns free slot i of the ring (ring), counted from the first
+ * free slot. i must be less than ring_space.
+ *
+ * @param ring - The ring
+ * @param i - The free slot wanted
+ * @return slot - The slot
+ ******************************************************************************/
+ring_slot_t * ring_free_slot(ring_t * ring, u_int32_t i);
+
+/*******************************************************************************
+ * Producer: Hands the first n free slots of the ring (ring), which have been
+ * filled in, to the consumer, and wakes the consumer if it is asleep
+ *
+ * @param ring - The ring
+ * @param n - The number of slots filled in
+ ******************************************************************************/
+void ring_publish(ring_t * ring, u_int32_t n);
+
+/*******************************************************************************
+ * Producer: Sleeps until the ring (ring) has a free slot
+ *
+ * @param ring - The ring
+ ******************************************************************************/
+void ring_wait_space(ring_t * ring);
+
+/*******************************************************************************
+ * Consumer: Returns the number of datagrams waiting in the ring (ring)
+ *
+ * @param ring - The ring
+ * @return count - The number of datagrams waiting
+ ******************************************************************************/
+u_int32_t ring_count(ring_t * ring);
+
+/*******************************************************************************
+ * Consumer: Returns waiting datagram i of the ring (ring), counted from the
+ * oldest. i must be less than ring_count.
+ *
+ * @param ring - The ring
+ * @param i - The datagram wanted
+ * @return slot - The slot holding the datagram
+ ******************************************************************************/
+ring_slot_t * ring_used_slot(ring_t * ring, u_int32_t i);
+
+/*******************************************************************************
+ * Consumer: Returns the n oldest datagrams of the ring (ring) to the producer,
+ * and wakes the producer if it is waiting for space
+ *
+ * @param ring - The ring
+ * @param n - The number of datagrams done with
+ ******************************************************************************/
+void ring_consume(ring_t * ring, u_int32_t n);
+
+/*******************************************************************************
+ * Consumer: Sleeps until the ring (ring) has a datagram waiting or the time
+ * deadline passes. A deadline of 0 waits for a datagram however long it
+ * takes.
+ *
+ * @param ring - The ring
+ * @param deadline - The time to stop waiting (us), or 0
+ ******************************************************************************/
+void ring_wait_data(ring_t * ring, u_int64_t deadline);
+
+#endif //PROJECT_4_RING_H
@@ -0,0 +1,105 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * rtt.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in rtt.h
+ ******************************************************************************/
+
+#include "rtt.h"
+
+/*******************************************************************************
+ * Initializes an RTT estimate (rtt) with no samples, using the given timeout
+ * (initial_rto) until the first round trip is measured
+ *
+ * @param rtt - The RTT estimate to initialize
+ * @param initial_rto - The timeout to use before any samples (us)
+ ******************************************************************************/
+void init_rtt(rtt_t * rtt, u_int64_t initial_rto){
+    if(initial_rto == 0){
+        initial_rto = RTO_INITIAL;
+    }
+    rtt->srtt = 0;
+    rtt->rttvar = 0;
+    rtt->rto = initial_rto;
+    rtt->backoff = 0;
+    rtt->has_sample = FALSE;
+}
+
+/*******************************************************************************
+ * Updates the RTT estimate (rtt) with a new round trip measurement (sample),
+ * recomputes the timeout, and clears any backoff.
+ *
+ * @param rtt - The RTT estimate to update
+ * @param sample - The measured round trip time (us)
+ ******************************************************************************/
+void update_rtt(rtt_t * rtt, u_int64_t sample){
+    u_int64_t delta;
+
+    if(!rtt->has_sample){
+        rtt->srtt = sample;
+        rtt->rttvar = sample / 2;
+        rtt->has_sample = TRUE;
+    }
+    else{
+        /*RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|, SRTT = 7/8 SRTT + 1/8 R*/
+        delta = rtt->srtt > sample ? rtt->srtt - sample : sample - rtt->srtt;
+        rtt->rttvar = (3 * rtt->rttvar + delta) / 4;
+        rtt->srtt = (7 * rtt->srtt + sample) / 8;
+    }
+
+    /*RTO = SRTT + 4 RTTVAR, kept within sensible bounds*/
+    rtt->rto = rtt->srtt + 4 * rtt->rttvar;
+    if(rtt->rto < RTO_MIN){
+        rtt->rto = RTO_MIN;
+    }
+    if(rtt->rto > RTO_MAX){
+        rtt->rto = RTO_MAX;
+    }
+    rtt->backoff = 0;
+}
+
+/*******************************************************************************
+ * Updates the RTT estimate (rtt) from the timestamp echoed in an
+ * acknowledgement (echo), which is the time the acknowledged packet was sent.
+ * Returns the measured round trip, or 0 if the echo could not be used.
+ *
+ * @param rtt - The RTT estimate to update
+ * @param echo - The timestamp echoed by the acknowledgement
+ * @return sample - The measured round trip time (us)
+ ******************************************************************************/
+u_int64_t update_rtt_echo(rtt_t * rtt, u_int32_t echo){
+    /*Timestamps are the low 32 bits of the clock, so this survives wrapping*/
+    u_int32_t sample = (u_int32_t) get_time_us() - echo;
+
+    /*Ignore echoes that are corrupt or older than any sensible timeout*/
+    if(echo == 0 || sample > RTO_MAX){
+        return 0;
+    }
+    update_rtt(rtt, sample);
+    return sample;
+}
+
+/*******************************************************************************
+ * Doubles the timeout of the RTT estimate (rtt) after a retransmission, up to
+ * MAX_BACKOFF times
+ *
+ * @param rtt - The RTT estimate to back off
+ ******************************************************************************/
+void backoff_rto(rtt_t * rtt){
+    if(rtt->backoff < MAX_BACKOFF){
+        rtt->backoff++;
+    }
+}
+
+/*******************************************************************************
+ * Returns the current retransmission timeout of the RTT estimate (rtt),
+ * including any backoff
+ *
+ * @param rtt - The RTT estimate
+ * @return rto - The retransmission timeout (us)
+ ******************************************************************************/
+u_int64_t get_rto(rtt_t * rtt){
+    u_int64_t rto = rtt->rto << rtt->backoff;
+    return rto > RTO_MAX ? RTO_MAX : rto;
+}
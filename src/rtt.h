@@ -0,0 +1,79 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * rtt.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used to estimate
+ * the round trip time of a connection and derive the retransmission timeout
+ * (RTO) from it, using the smoothed RTT and RTT variance of RFC 6298.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_RTT_H
+#define PROJECT_4_RTT_H
+
+#include "rudp_packet.h"
+
+#define RTO_INITIAL 1000000 /*Timeout before any RTT is measured (us)*/
+#define RTO_MIN 5000        /*Smallest timeout ever used (us)*/
+#define RTO_MAX 10000000    /*Largest timeout ever used (us)*/
+#define MAX_BACKOFF 6       /*Most times the timeout may be doubled*/
+
+/*Custom struct to hold the RTT estimate of a connection*/
+struct rtt_t{
+    u_int64_t srtt;                 //Smoothed round trip time (us)
+    u_int64_t rttvar;               //Round trip time variance (us)
+    u_int64_t rto;                  //Retransmission timeout (us)
+    u_int32_t backoff;              //Times the timeout has been doubled
+    bool has_sample;                //Whether any RTT has been measured yet
+};
+
+/*Typedefs*/
+typedef struct rtt_t rtt_t;
+
+/*******************************************************************************
+ * Initializes an RTT estimate (rtt) with no samples, using the given timeout
+ * (initial_rto) until the first round trip is measured
+ *
+ * @param rtt - The RTT estimate to initialize
+ * @param initial_rto - The timeout to use before any samples (us)
+ ******************************************************************************/
+void init_rtt(rtt_t * rtt, u_int64_t initial_rto);
+
+/*******************************************************************************
+ * Updates the RTT estimate (rtt) with a new round trip measurement (sample),
+ * recomputes the timeout, and clears any backoff.
+ *
+ * @param rtt - The RTT estimate to update
+ * @param sample - The measured round trip time (us)
+ ******************************************************************************/
+void update_rtt(rtt_t * rtt, u_int64_t sample);
+
+/*******************************************************************************
+ * Updates the RTT estimate (rtt) from the timestamp echoed in an
+ * acknowledgement (echo), which is the time the acknowledged packet was sent.
+ * Returns the measured round trip, or 0 if the echo could not be used.
+ *
+ * @param rtt - The RTT estimate to update
+ * @param echo - The timestamp echoed by the acknowledgement
+ * @return sample - The measured round trip time (us)
+ ******************************************************************************/
+u_int64_t update_rtt_echo(rtt_t * rtt, u_int32_t echo);
+
+/*******************************************************************************
+ * Doubles the timeout of the RTT estimate (rtt) after a retransmission, up to
+ * MAX_BACKOFF times
+ *
+ * @param rtt - The RTT estimate to back off
+ ******************************************************************************/
+void backoff_rto(rtt_t * rtt);
+
+/*******************************************************************************
+ * Returns the current retransmission timeout of the RTT estimate (rtt),
+ * including any backoff
+ *
+ * @param rtt - The RTT estimate
+ * @return rto - The retransmission timeout (us)
+ ******************************************************************************/
+u_int64_t get_rto(rtt_t * rtt);
+
+#endif //PROJECT_4_RTT_H
@@ -7,6 +7,10 @@
  ******************************************************************************/
 
 #include "rudp_packet.h"
+#include "rtt.h"
+#include "checksum.h"
+#include "crc32c.h"
+#include "log.h"
 
 /*******************************************************************************
  * Allocates memory for a new RUDP packet. Sets the data portion of the RUDP
@@ -16,89 +20,190 @@
  * @param size - The size of the data parameter
  * @return pkt - A newly allocated pointer to an RUDP packet
  ******************************************************************************/
-rudp_packet_t * create_rudp_packet(void *data, size_t size, u_int32_t *seq_num){
-    static u_int32_t seq;
-    u_int16_t checksum;
+rudp_packet_t * create_rudp_packet(void *data, size_t size, u_int64_t *seq_num){
+    static u_int64_t seq;
 
     /*Allocate memory for the new RUDP packet*/
     rudp_packet_t * pkt = malloc(sizeof(rudp_packet_t));
-    memset(pkt->data, 0, RUDP_DATA);
 
     /*Initialize the packet with passed parameter*/
     if(seq_num != NULL){
-        pkt->seq_num = *seq_num;
+        init_rudp_packet(pkt, data, size, *seq_num);
     }
     else {
-        pkt->seq_num = seq++;
+        init_rudp_packet(pkt, data, size, seq++);
     }
-    pkt->checksum = 0;
-    pkt->type = DATA_PKT;
-    memcpy(pkt->data, data, size);
-
-    /*Calculate RUDP checksum*/
-    checksum = calc_checksum(pkt);
-    pkt->checksum = checksum;
 
     return pkt;
 }
 
 /*******************************************************************************
- * Computes the internet checksum for the entire RUDP packet. Assumes that the
- * checksum of the packet has been initialized to zero. If an RUDP packet with
- * and existing checksum is passed, this function returns 0 if the checksum is
- * correct.
+ * Initializes an existing RUDP packet (pkt) as a data packet with sequence
+ * number seq_num, holding the first size bytes of data. data may already be
+ * the data portion of the packet, in which case it is not copied. The rest of
+ * the data portion is left as it was, since it is neither sent nor covered by
+ * the checksum.
  *
- * @param rudp_pk - The packet to calculate the checksum for
- * @return checksum - The internet checksum for the entire packet
+ * @param pkt - The packet to initialize
+ * @param data - The binary data to be included in the RUDP packet
+ * @param size - The size of the data parameter
+ * @param seq_num - The sequence number of the packet
+ ******************************************************************************/
+void init_rudp_packet(rudp_packet_t * pkt, void *data, size_t size,
+                      u_int64_t seq_num){
+    init_header(pkt, DATA_PKT, seq_num, (u_int16_t) size);
+    if(data != pkt->data){
+        memcpy(pkt->data, data, size);
+    }
+
+    /*Calculate RUDP checksum*/
+    set_checksum(pkt, calc_checksum(pkt, RUDP_HEAD + (int) size));
+}
+
+/*******************************************************************************
+ * Writes a complete header into an RUDP packet (pkt): the current version, no
+ * flags, a given type (type), sequence number (seq_num) and data length
+ * (length), and zero for the session, checksum, timestamp and echo
+ *
+ * @param pkt - The packet whose header is written
+ * @param type - The RUDP type
+ * @param seq_num - The sequence number
+ * @param length - The number of bytes of data after the header
  ******************************************************************************/
-u_int16_t calc_checksum(rudp_packet_t * rudp_pk){
-    u_int16_t *data = (u_int16_t *)rudp_pk;
-    int i;
-    u_int32_t sum = 0;
-    u_int16_t checksum;
+void init_header(rudp_packet_t * pkt, u_int8_t type, u_int64_t seq_num,
+                 u_int16_t length){
+    memset(pkt->head, 0, RUDP_HEAD);
+    pkt->head[OFF_VERSION] = RUDP_VERSION << 4;
+    set_type(pkt, type);
+    set_length(pkt, length);
+    set_seq_num(pkt, seq_num);
+}
 
-    /*Loop through the data 2 bytes at a time and add it up*/
-    for(i = 0; i < sizeof(rudp_packet_t) / 2; i++){
-        sum += data[i];
+/*******************************************************************************
+ * Computes the part of a packet's checksum that covers its data (data) of a
+ * given length (len), for a packet with the given flags (flags). A sender that
+ * resends the same data can keep this and only checksum the header each time.
+ *
+ * @param flags - The flags of the packet
+ * @param data - The data of the packet
+ * @param len - The length of the data
+ * @return check - The sum or CRC32C of the data
+ ******************************************************************************/
+u_int32_t payload_check(u_int8_t flags, const void * data, size_t len){
+    if(flags & CHECK_CRC32C){
+        return crc32c(0, data, len);
     }
+    return sum_words(data, len);
+}
 
-    /*Initialize checksum to be the lower 16 bits of sum*/
-    checksum = sum & 0xFFFF;
+/*******************************************************************************
+ * Computes the checksum of an RUDP packet (rudp_pk) from its header and the
+ * payload_check of its data (payload), which need not follow the header in
+ * memory. Assumes that the checksum of the packet has been initialized to
+ * zero.
+ *
+ * @param rudp_pk - The packet to calculate the checksum for
+ * @param payload - The payload_check of the packet's data
+ * @return checksum - The checksum for the packet
+ ******************************************************************************/
+u_int32_t header_checksum(rudp_packet_t * rudp_pk, u_int32_t payload){
 
-    /*Shift sum right 16 bits, leaving only the remainder (i.e. over flow)*/
-    sum = sum >> 16;
+    /*The CRC of the data is continued over the header, while the sums of the
+     * two simply add up since the header is a whole number of words*/
+    if(get_flags(rudp_pk) & CHECK_CRC32C){
+        return crc32c(payload, rudp_pk->head, (size_t) RUDP_HEAD);
+    }
 
-    /*Add the remainder*/
-    checksum += sum;
+    /*The sum of words in host order is the byte swapped sum of words in
+     * network order, so swap it to store it in network order*/
+    return ntohs(fold_checksum(sum_words(rudp_pk->head, (size_t) RUDP_HEAD) +
+                               payload));
+}
 
-    /*Takes two's complement to get final checksum value*/
-    checksum = ~checksum;
+/*******************************************************************************
+ * Computes the checksum over the first size bytes of an RUDP packet
+ * (rudp_pk), which are the bytes that are actually sent. The internet checksum
+ * is used unless the packet has the CHECK_CRC32C flag. Assumes that the
+ * checksum of the packet has been initialized to zero.
+ *
+ * @param rudp_pk - The packet to calculate the checksum for
+ * @param size - The size of the packet as sent
+ * @return checksum - The checksum for the packet
+ ******************************************************************************/
+u_int32_t calc_checksum(rudp_packet_t * rudp_pk, int size){
+    return header_checksum(rudp_pk, payload_check(get_flags(rudp_pk),
+                                                  rudp_pk->data,
+                                                  (size_t) (size - RUDP_HEAD)));
+}
 
-    return checksum;
+/*******************************************************************************
+ * Checks if a received datagram (rudp_pkt) of a given size (size) is a packet
+ * of this version whose length matches the datagram and whose checksum is
+ * correct, without changing the packet. Returns TRUE if so, else FALSE.
+ *
+ * @param rudp_pkt - The RUDP packet to check
+ * @param size - The size of the packet as received
+ * @return TRUE or FALSE - Whether or not the checksum is correct
+ ******************************************************************************/
+bool check_checksum(const rudp_packet_t * rudp_pkt, int size){
+    return check_packet(rudp_pkt, size, NULL);
 }
 
 /*******************************************************************************
- * Checks if the checksum of rudp_pkt is correct. Returns TRUE if so, else FALSE
+ * Checks a received packet (rudp_pkt) like check_checksum. If
+ * the packet has the CHECK_CRC32C flag and data_crc is not NULL, the CRC32C of
+ * the packet's data alone is also stored in data_crc, so that the receiver
+ * can build a digest of the file without reading the data again.
  *
  * @param rudp_pkt - The RUDP packet to check
+ * @param size - The size of the packet as received
+ * @param data_crc - The location to store the CRC32C of the data, or NULL
  * @return TRUE or FALSE - Whether or not the checksum is correct
  ******************************************************************************/
-bool check_checksum(rudp_packet_t * rudp_pkt){
-    bool is_good = FALSE;
+bool check_packet(const rudp_packet_t * rudp_pkt, int size,
+                  u_int32_t * data_crc){
+    unsigned char head[RUDP_HEAD];
+    u_int32_t crc;
 
-    u_int16_t tmp = rudp_pkt->checksum;
-    rudp_pkt->checksum = 0;
-    int checksum = calc_checksum(rudp_pkt);
-    if(checksum == tmp){
-        is_good = TRUE;
+    if(size < RUDP_HEAD || get_version(rudp_pkt) != RUDP_VERSION ||
+            get_length(rudp_pkt) != size - RUDP_HEAD){
+        return FALSE;
     }
-    rudp_pkt->checksum = tmp;
 
-    return is_good;
+    /*Summed with its checksum included, a correct packet folds to zero*/
+    if(!(get_flags(rudp_pkt) & CHECK_CRC32C)){
+        return fold_checksum(sum_words(rudp_pkt, (size_t) size)) == 0 ?
+               TRUE : FALSE;
+    }
+
+    /*The CRC covers the data, then the header as it was with no checksum*/
+    crc = crc32c(0, rudp_pkt->data, (size_t) (size - RUDP_HEAD));
+    if(data_crc != NULL){
+        *data_crc = crc;
+    }
+    memcpy(head, rudp_pkt->head, (size_t) RUDP_HEAD);
+    store32(head, OFF_CHECKSUM, 0);
+    return crc32c(crc, head, (size_t) RUDP_HEAD) == get_checksum(rudp_pkt) ?
+           TRUE : FALSE;
 }
 
 /*******************************************************************************
- * Sends an acknowledgment for the packet designated by seq_num to the server.
+ * Sets the timestamp of an RUDP packet (rudp_pkt) of a given size (size) to
+ * the current time and recalculates its checksum. Called each time a packet
+ * is (re)transmitted.
+ *
+ * @param rudp_pkt - The packet to stamp
+ * @param size - The size of the packet as sent
+ ******************************************************************************/
+void stamp_packet(rudp_packet_t * rudp_pkt, int size){
+    set_timestamp(rudp_pkt, (u_int32_t) get_time_us());
+    set_checksum(rudp_pkt, 0);
+    set_checksum(rudp_pkt, calc_checksum(rudp_pkt, size));
+}
+
+/*******************************************************************************
+ * Sends an acknowledgment for the packet designated by seq_num to the server,
+ * echoing the timestamp and session of the packet.
  *
  * @param sockfd - The socket to send over
  * @param serveraddr - The address of the server
@@ -107,46 +212,52 @@ bool check_checksum(rudp_packet_t * rudp_pkt){
 void send_rudp_ack(int sockfd, struct sockaddr *serveraddr,
                    rudp_packet_t * rudp_pkt){
     rudp_packet_t ack;
-    memset(&ack, 0, sizeof(rudp_packet_t));
-    ack.type = ACK;
-    ack.checksum = 0;
-    ack.seq_num = rudp_pkt->seq_num;
-    ack.checksum = calc_checksum(&ack);
+    init_header(&ack, ACK, get_seq_num(rudp_pkt), 0);
+    set_session(&ack, get_session(rudp_pkt));
+    set_echo(&ack, get_timestamp(rudp_pkt));
+    set_checksum(&ack, calc_checksum(&ack, RUDP_HEAD));
 
     sendto(sockfd, &ack, RUDP_HEAD, 0, serveraddr, sizeof(struct sockaddr_in));
 }
 
 /*******************************************************************************
  * Sends an RUDP packet (rudp_pkt) of a given size (size) to the destination
- * specified (destaddr) over the specified socket (sockfd). Waits a specified
- * amount of time (req) for an acknowledgement, then resends if no
- * acknowledgement was received. Attempts to send MAX_ATTEMPTS times, then
- * aborts if no acknowledgement was received. If an acknowledgement is received,
- * if is stored in the specified location (ack_pkt).
+ * specified (destaddr) over the specified socket (sockfd). Waits for the
+ * retransmission timeout of the connection's RTT estimate (rtt) for an
+ * acknowledgement, then doubles the timeout and resends if no acknowledgement
+ * was received. Attempts to send MAX_ATTEMPTS times, then gives up if no
+ * acknowledgement was received. If an acknowledgement is received, it updates
+ * the RTT estimate and is stored in the specified location (ack_pkt).
+ * Packets from any other address, or larger than a rudp_packet_t, are
+ * ignored. If rtt is NULL, a fresh estimate starting at RTO_INITIAL is
+ * used. Returns TRUE if the acknowledgement was received, else FALSE, in
+ * which case ack_pkt is left untouched.
  *
  * @param sockfd - The soocket to send the message one
  * @param destaddr - The address of the destination to send to
  * @param rudp_pkt - The packet to send
  * @param size - The size of the packet to send
  * @param ack_pkt - The location to store the acknoowledgement
- * @param req - The amount of time to wait for an acknowledgement
+ * @param rtt - The RTT estimate of the connection
+ * @return TRUE or FALSE - Whether or not the packet was acknowledged
  ******************************************************************************/
-void send_and_wait(int sockfd, struct sockaddr *destaddr,
+bool send_and_wait(int sockfd, struct sockaddr *destaddr,
                    rudp_packet_t *rudp_pkt, size_t size,
-                   rudp_packet_t * ack_pkt, struct timespec * req){
+                   rudp_packet_t * ack_pkt, struct rtt_t * rtt){
     struct pollfd fd;
     int err = 0, buf_len, timeout_ms, attempts = 0;
     unsigned char buffer[MAX_LINE];
     socklen_t len = sizeof(struct sockaddr_in);
+    struct sockaddr_in * dest = (struct sockaddr_in *) destaddr;
+    struct sockaddr_in from;
     rudp_packet_t * ack;
     bool good_checksum;
+    rtt_t default_rtt;
 
-    /*Convert timespec to milliseconds*/
-    if(req != NULL) {
-        timeout_ms = (int) (req->tv_sec * 1000 + req->tv_nsec / 1000000);
-    }
-    else{
-        timeout_ms = 1000;      /*Default 1 second*/
+    /*Without an existing estimate, start from the initial timeout*/
+    if(rtt == NULL){
+        init_rtt(&default_rtt, RTO_INITIAL);
+        rtt = &default_rtt;
     }
 
     fd.fd = sockfd;
@@ -154,20 +265,25 @@ void send_and_wait(int sockfd, struct sockaddr *destaddr,
 
     /*May be waiting for either ACK or SYN_ACK*/
     u_int8_t expected = ACK;
-    if(rudp_pkt->type == SYN){
+    if(get_type(rudp_pkt) == SYN){
         expected = SYN_ACK;
     }
 
     while(attempts < MAX_ATTEMPTS){
         /*Send packet to destination*/
-        fprintf(stdout, "\nSending %d byte packet\n", (int) size);
-        print_rudp_packet(rudp_pkt);
+        stamp_packet(rudp_pkt, (int) size);
+        log_msg(LOG_DEBUG, "\nSending %d byte packet\n", (int) size);
+        if(log_enabled(LOG_DEBUG)){
+            print_rudp_packet(rudp_pkt, (int) size);
+        }
         sendto(sockfd, rudp_pkt, size, 0, destaddr, len);
 
-        /*Wait up to specified time for ACK*/
+        /*Wait up to the retransmission timeout for ACK, rounded up to ms*/
+        timeout_ms = (int) ((get_rto(rtt) + 999) / 1000);
         err = poll(&fd, 1, timeout_ms);
         if(err == 0){
-            fprintf(stdout,"\nTimeout, no ACK received\n");
+            log_msg(LOG_DEBUG, "\nTimeout, no ACK received\n");
+            backoff_rto(rtt);
         }
         else if(err < 0){
             fprintf(stderr, "\nPoll error\n");
@@ -176,19 +292,29 @@ void send_and_wait(int sockfd, struct sockaddr *destaddr,
 
         /*If fd was data to be read, read it in*/
         else{
-            memset(buffer, 0, MAX_LINE);
-            buf_len = (int)recvfrom(sockfd, buffer, MAX_LINE, 0, destaddr, &len);
+            len = sizeof(struct sockaddr_in);
+            buf_len = (int)recvfrom(sockfd, buffer, MAX_LINE, 0,
+                                    (struct sockaddr *) &from, &len);
             ack = (rudp_packet_t *)buffer;
-            good_checksum = check_checksum(rudp_pkt);
+
+            /*Only a packet from the destination that fits ack_pkt can be the
+             * acknowledgement*/
+            good_checksum = buf_len <= (int) sizeof(rudp_packet_t) &&
+                            from.sin_addr.s_addr == dest->sin_addr.s_addr &&
+                            from.sin_port == dest->sin_port &&
+                            check_checksum(ack, buf_len);
 
             /*If checksum is good, the seq_num is correct, and the acknowledgement
              * is the expected type, break from the loop*/
             if(good_checksum &&
-                    ack->seq_num == rudp_pkt->seq_num &&
-                    ack->type == expected){
-                fprintf(stdout, "\t|-RECEIVED ACKNOWLEDGEMENT\n");
-                fprintf(stdout, "\nGot %d byte packet\n", buf_len);
-                print_rudp_packet( (rudp_packet_t *)buffer );
+                    get_seq_num(ack) == get_seq_num(rudp_pkt) &&
+                    get_type(ack) == expected){
+                log_msg(LOG_DEBUG, "\t|-RECEIVED ACKNOWLEDGEMENT\n");
+                update_rtt_echo(rtt, get_echo(ack));
+                log_msg(LOG_DEBUG, "\nGot %d byte packet\n", buf_len);
+                if(log_enabled(LOG_DEBUG)){
+                    print_rudp_packet( (rudp_packet_t *)buffer, buf_len );
+                }
                 if(ack_pkt != NULL){
                     memset(ack_pkt, 0, sizeof(rudp_packet_t));
                     memcpy(ack_pkt, ack, (size_t) buf_len);
@@ -196,39 +322,161 @@ void send_and_wait(int sockfd, struct sockaddr *destaddr,
                 break;
             }
             else{
-                fprintf(stdout, "\t|-RESENDING (%d)\n", attempts + 1);
+                log_msg(LOG_DEBUG, "\t|-RESENDING (%d)\n", attempts + 1);
             }
         }
         attempts++;
     }
     
     if(attempts >= MAX_ATTEMPTS){
-        fprintf(stdout, "\t|-MAX ATTEMPTS REACHED, ABORTING\n");
+        log_msg(LOG_ERROR, "\t|-MAX ATTEMPTS REACHED, ABORTING\n");
+        return FALSE;
     }
+    return TRUE;
 }
 
 /*******************************************************************************
- * Prints data from the RUDP header to stdout. Checks the checksum and returns
- * TRUE if it is correct, else FALSE
+ * Returns the current time in microseconds from a monotonic clock, for use in
+ * retransmission timers
  *
- * @param rudp_pkt - The packet to print
- * @return TRUE or FALSE - Whether or not the checksum is correct
+ * @return time - The current monotonic time in microseconds
  ******************************************************************************/
-bool print_rudp_packet(rudp_packet_t * rudp_pkt){
-    bool checksum = check_checksum(rudp_pkt);
+u_int64_t get_time_us(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u_int64_t) ts.tv_sec * 1000000 + (u_int64_t) ts.tv_nsec / 1000;
+}
 
-    fprintf(stdout, "\t|-TYPE:     0x%02x", rudp_pkt->type);
-    switch(rudp_pkt->type){
-        case DATA_PKT: fprintf(stdout, " (DATA_PKT)\n"); break;
-        case END_SEQ: fprintf(stdout, " (END_SEQ)\n"); break;
-        case ACK: fprintf(stdout, " (ACK)\n"); break;
-        case SYN: fprintf(stdout, " (SYN)\n"); break;
-        case SYN_ACK: fprintf(stdout, " (SYN_ACK)\n"); break;
-        default: fprintf(stdout, " (UNKNOWN)\n"); break;
+/*******************************************************************************
+ * Requests send and receive buffers of a given size (bytes) for the specified
+ * socket (sockfd), so that a large window of packets can be in flight without
+ * the kernel dropping them. The kernel may cap the size it actually grants.
+ *
+ * @param sockfd - The socket to size the buffers of
+ * @param bytes - The requested size of each buffer
+ ******************************************************************************/
+void set_socket_buffers(int sockfd, int bytes){
+    /*Try to exceed the system limit first, which is allowed for root*/
+    if(setsockopt(sockfd, SOL_SOCKET, SO_SNDBUFFORCE, &bytes, sizeof(int)) < 0){
+        setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &bytes, sizeof(int));
     }
-    fprintf(stdout, "\t|-SEQ NUM:  %d\n", rudp_pkt->seq_num);
-    fprintf(stdout, "\t|-CHECKSUM: 0x%04x ", rudp_pkt->checksum);
-    fprintf(stdout, "(%s)\n", checksum ? "correct" : "incorrect");
+    if(setsockopt(sockfd, SOL_SOCKET, SO_RCVBUFFORCE, &bytes, sizeof(int)) < 0){
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVBUF, &bytes, sizeof(int));
+    }
+}
+
+/*******************************************************************************
+ * Returns the MTU of the route to a destination (addr), as the kernel knows it
+ * from the outgoing interface and any path MTU discovery so far, or 0 if it
+ * cannot be found
+ *
+ * @param addr - The destination
+ * @return mtu - The path MTU in bytes, or 0
+ ******************************************************************************/
+int path_mtu(const struct sockaddr_in * addr){
+    int sockfd, mtu = 0;
+    socklen_t len = sizeof(int);
+
+    /*Connecting a UDP socket only looks up the route, sending nothing*/
+    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(sockfd < 0){
+        return 0;
+    }
+    if(connect(sockfd, (const struct sockaddr *) addr,
+               sizeof(struct sockaddr_in)) != 0 ||
+            getsockopt(sockfd, IPPROTO_IP, IP_MTU, &mtu, &len) != 0){
+        mtu = 0;
+    }
+    close(sockfd);
+    return mtu;
+}
+
+/*******************************************************************************
+ * Returns the largest data segment that fits in one datagram on a path with
+ * the given MTU (mtu) without IP fragmentation, capped at MAX_PAYLOAD. An
+ * unknown MTU (0) gives RUDP_DATA.
+ *
+ * @param mtu - The path MTU in bytes, or 0
+ * @return payload - The size of the data segment
+ ******************************************************************************/
+u_int32_t mtu_payload(int mtu){
+    if(mtu <= UDP_OVERHEAD + RUDP_HEAD){
+        return RUDP_DATA;
+    }
+    if(mtu - UDP_OVERHEAD - RUDP_HEAD > MAX_PAYLOAD){
+        return MAX_PAYLOAD;
+    }
+    return (u_int32_t) (mtu - UDP_OVERHEAD - RUDP_HEAD);
+}
 
+/*******************************************************************************
+ * Records in the statistics (stats) that one system call moved packets
+ * datagrams
+ *
+ * @param stats - The statistics to update
+ * @param packets - The number of datagrams moved by the call
+ ******************************************************************************/
+void record_io(io_stats_t * stats, int packets){
+    stats->calls++;
+    stats->packets += packets;
+}
+
+/*******************************************************************************
+ * Prints the statistics (stats) of one direction of I/O, labelled label, to
+ * stderr at LOG_INFO, including the average number of packets per system call
+ *
+ * @param label - What the statistics count
+ * @param stats - The statistics to print
+ ******************************************************************************/
+void print_io_stats(const char * label, io_stats_t * stats){
+    log_msg(LOG_INFO, "%s: %llu packets in %llu calls (%.2f per call)\n",
+            label, (unsigned long long) stats->packets,
+            (unsigned long long) stats->calls,
+            stats->calls == 0 ? 0.0 :
+            (double) stats->packets / (double) stats->calls);
+}
+
+/*******************************************************************************
+ * Prints data from the RUDP header to stderr. Checks the checksum over the
+ * size bytes of the packet and returns TRUE if it is correct, else FALSE
+ *
+ * @param rudp_pkt - The packet to print
+ * @param size - The size of the packet
+ * @return TRUE or FALSE - Whether or not the checksum is correct
+ ******************************************************************************/
+bool print_rudp_packet(rudp_packet_t * rudp_pkt, int size){
+    bool checksum = check_checksum(rudp_pkt, size);
+
+    print_rudp_header(rudp_pkt, checksum);
     return checksum;
+}
+
+/*******************************************************************************
+ * Prints data from the RUDP header to stderr, along with whether its checksum
+ * was found to be correct (good_checksum)
+ *
+ * @param rudp_pkt - The packet to print
+ * @param good_checksum - Whether or not the checksum is correct
+ ******************************************************************************/
+void print_rudp_header(rudp_packet_t * rudp_pkt, bool good_checksum){
+    fprintf(stderr, "\t|-TYPE:     0x%02x", get_type(rudp_pkt));
+    switch(get_type(rudp_pkt)){
+        case DATA_PKT: fprintf(stderr, " (DATA_PKT)\n"); break;
+        case END_SEQ: fprintf(stderr, " (END_SEQ)\n"); break;
+        case ACK: fprintf(stderr, " (ACK)\n"); break;
+        case SYN: fprintf(stderr, " (SYN)\n"); break;
+        case SYN_ACK: fprintf(stderr, " (SYN_ACK)\n"); break;
+        case SACK: fprintf(stderr, " (SACK)\n"); break;
+        case PARITY: fprintf(stderr, " (PARITY)\n"); break;
+        default: fprintf(stderr, " (UNKNOWN)\n"); break;
+    }
+    fprintf(stderr, "\t|-SESSION:  0x%08x\n", get_session(rudp_pkt));
+    fprintf(stderr, "\t|-SEQ NUM:  %llu\n",
+            (unsigned long long) get_seq_num(rudp_pkt));
+    fprintf(stderr, "\t|-CHECKSUM: 0x%0*x ",
+            get_flags(rudp_pkt) & CHECK_CRC32C ? 8 : 4,
+            get_checksum(rudp_pkt));
+    fprintf(stderr, "(%s%s)\n",
+            get_flags(rudp_pkt) & CHECK_CRC32C ? "CRC32C, " : "",
+            good_checksum ? "correct" : "incorrect");
 }
\ No newline at end of file
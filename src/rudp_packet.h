@@ -18,12 +18,21 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <poll.h>
+#include <time.h>
+#include <stddef.h>
+#include <endian.h>
 
-#define RUDP_HEAD 56        /*Size of RUDP header*/
-#define RUDP_DATA 948       /*Size of RUDP data segment*/
+#define RUDP_VERSION 2      /*Version of the wire format*/
+#define RUDP_HEAD 28        /*Size of the RUDP header on the wire*/
+#define RUDP_DATA 948       /*Size of RUDP data segment, unless another
+                             *payload size is negotiated*/
+#define UDP_OVERHEAD 28     /*Bytes of IPv4 and UDP header per datagram*/
+#define MAX_DATAGRAM 65507  /*Largest UDP payload over IPv4*/
+#define MAX_PAYLOAD (MAX_DATAGRAM - RUDP_HEAD) /*Largest negotiable payload*/
 #define MAX_LINE 1024       /*Maximum input buffer size*/
-#define WINDOW_SIZE 5       /*Size of sliding window*/
 #define MAX_ATTEMPTS 5      /*Maximum number of times to resend*/
+#define SOCKET_BUFFER 8388608 /*Requested socket send/receive buffer size*/
+#define BATCH_SIZE 64       /*Most datagrams moved by one system call*/
 
 /*RUDP types*/
 #define DATA_PKT 0          /*Normal data packet*/
@@ -31,24 +40,272 @@
 #define ACK 2               /*Acknowledgement*/
 #define SYN 3               /*Initialize connection*/
 #define SYN_ACK 4           /*Acknowledge open connection*/
+#define SACK 5              /*Cumulative and selective data acknowledgement*/
+#define PARITY 6            /*Forward error correction parity of a block*/
 
-/*Reliable UDP (RUDP) file transfer packet*/
+/*RUDP flags, of which there is room for 4*/
+#define CHECK_CRC32C 0x01   /*Checksum is a CRC32C rather than the internet
+                             *checksum*/
+
+/*Offsets of the fields of the RUDP header. Every field is stored in network
+ * byte order with no padding, so the header means the same on any host:
+ *
+ *    0       1       2               4               8
+ *    +-------+-------+---------------+---------------+
+ *    |ver|flg| type  |    length     |    session    |
+ *    +-------+-------+---------------+---------------+
+ *    8                               16              20
+ *    +-------------------------------+---------------+
+ *    |            seq_num            |   checksum    |
+ *    +-------------------------------+---------------+
+ *    20              24              28
+ *    +---------------+---------------+
+ *    |   timestamp   |     echo      |
+ *    +---------------+---------------+
+ *
+ * The sequence number is 64 bits, so the byte offset seq_num * payload of a
+ * data packet cannot overflow for any file the filesystem can hold.
+ */
+#define OFF_VERSION 0       /*Version in the high 4 bits, flags in the low 4*/
+#define OFF_TYPE 1          /*RUDP type*/
+#define OFF_LENGTH 2        /*Bytes of data after the header (16 bits)*/
+#define OFF_SESSION 4       /*Session chosen by the server, 0 in a SYN*/
+#define OFF_SEQ_NUM 8       /*RUDP sequence number (64 bits)*/
+#define OFF_CHECKSUM 16     /*RUDP checksum*/
+#define OFF_TIMESTAMP 20    /*Time the packet was sent (us)*/
+#define OFF_ECHO 24         /*Timestamp of the acknowledged packet*/
+
+/*Integrity checks a client may offer in its SYN, one bit each*/
+#define INTEGRITY_INET 0x01 /*16-bit internet checksum*/
+#define INTEGRITY_CRC32C 0x02 /*CRC32C, plus a digest of the whole file*/
+
+/*Forward error correction codes a client may offer in its SYN, one bit each.
+ * The server may pick one, and then follows each block of data packets with
+ * parity packets the client can rebuild lost packets of the block from*/
+#define FEC_XOR 0x01        /*Interleaved XOR parity*/
+#define FEC_RS 0x02         /*Reed-Solomon parity over GF(2^8)*/
+
+/*A SACK packet acknowledges every packet before its seq_num (the cumulative
+ * ack point). Its data is a bitmap, least significant bit first, where bit i
+ * is set if packet seq_num + 1 + i has also been received. The length of the
+ * bitmap is the length of the packet*/
+#define SACK_BYTES 512      /*Maximum size of the selective ack bitmap*/
+
+/*Reliable UDP (RUDP) file transfer packet, exactly as it is sent. The header
+ * is only read and written through the get_ and set_ functions below, which
+ * load and store its fields in place, so a received datagram is parsed
+ * without copying it. The timestamp of a packet is the time it was sent.
+ * Acknowledgements (ACK, SACK and SYN_ACK) echo the timestamp of the packet
+ * they acknowledge, so that the sender can measure the round trip time. The
+ * checksum is the internet checksum of the packet, or, with the CHECK_CRC32C
+ * flag, the CRC32C of its data followed by its header with the checksum
+ * zeroed*/
 struct rudp_packet_t{
-    u_int32_t seq_num;              /*RUDP sequence number*/
-    u_int8_t type;                  /*RUDP type*/
-    u_int16_t checksum;             /*RUDP checksum*/
-    unsigned char data[RUDP_DATA];  /*Binary data*/
+    unsigned char head[RUDP_HEAD];  /*Header, laid out as above*/
+    unsigned char data[RUDP_DATA];  /*Binary data. Data packets of a larger
+                                     *negotiated payload are given room for
+                                     *it wherever they are allocated*/
+};
+
+/*The bodies below are also sent in network byte order, and are converted as
+ * they are filled in and read*/
+
+/*Start of the body of a SYN packet, followed by the name of the file*/
+struct syn_t{
+    u_int32_t integrity;            /*INTEGRITY_ checks the client supports*/
+    u_int32_t payload;              /*Largest data segment the client takes*/
+    u_int32_t fec;                  /*FEC_ codes the client supports*/
+};
+
+/*Body of a SYN_ACK packet, telling the client whether the requested file was
+ * opened, how large it is, and which integrity check, payload size and
+ * forward error correction the server chose. Every data packet but the last
+ * holds exactly payload bytes*/
+struct syn_ack_t{
+    u_int32_t is_open;              /*Whether the server opened the file*/
+    u_int32_t integrity;            /*INTEGRITY_ check used for the data*/
+    u_int64_t file_size;            /*Size of the file in bytes*/
+    u_int32_t payload;              /*Size of the data segment of a packet*/
+    u_int32_t fec;                  /*FEC_ code used, or 0 for none*/
+    u_int32_t fec_block;            /*Data packets in each block*/
+    u_int32_t reserved;             /*Always zero*/
+};
+
+/*Body of an END_SEQ packet*/
+struct end_seq_t{
+    u_int32_t digest;               /*CRC32C of the whole file, if chosen*/
+    u_int32_t reserved;             /*Always zero*/
 };
 
+/*Start of the body of a PARITY packet, followed by payload bytes of parity.
+ * The seq_num of the packet is that of the first data packet of its block,
+ * and the data packets of a block are the count that follow it. Shorter data
+ * packets are taken as padded with zeros*/
+struct parity_t{
+    u_int16_t index;                /*Row of the parity in its block*/
+    u_int16_t count;                /*Data packets in the block*/
+    u_int16_t parity;               /*Parity packets of the block*/
+    u_int16_t code;                 /*FEC_ code of the parity*/
+};
+
+/*End of the body of a SACK, after the bitmap, when forward error correction
+ * is in use. The counts are of every block the client has stopped waiting
+ * for, so the server can tell the loss rate even of packets that were
+ * rebuilt. They wrap around*/
+struct fec_report_t{
+    u_int32_t expected;             /*Data and parity packets of the blocks*/
+    u_int32_t lost;                 /*Of those, packets that never arrived*/
+};
+
+/*Round trip time estimate, defined in rtt.h*/
+struct rtt_t;
+
 /*Simple boolean enum*/
 enum bool{
     FALSE, TRUE
 };
 
+/*Counts of datagrams moved per system call, to check that batching works*/
+struct io_stats_t{
+    u_int64_t calls;                /*Number of system calls made*/
+    u_int64_t packets;              /*Number of datagrams they moved*/
+};
+
 /*Typedefs*/
 typedef struct rudp_packet_t rudp_packet_t;
+typedef struct io_stats_t io_stats_t;
+typedef struct syn_t syn_t;
+typedef struct syn_ack_t syn_ack_t;
+typedef struct end_seq_t end_seq_t;
+typedef struct parity_t parity_t;
+typedef struct fec_report_t fec_report_t;
 typedef enum bool bool;
 
+/*******************************************************************************
+ * Loads and stores a 16, 32 or 64 bit field in network byte order at a given
+ * offset (off) of an RUDP header (head). The header need not be aligned.
+ ******************************************************************************/
+static inline u_int16_t load16(const unsigned char * head, int off){
+    u_int16_t v;
+    memcpy(&v, head + off, sizeof(v));
+    return ntohs(v);
+}
+
+static inline u_int32_t load32(const unsigned char * head, int off){
+    u_int32_t v;
+    memcpy(&v, head + off, sizeof(v));
+    return ntohl(v);
+}
+
+static inline u_int64_t load64(const unsigned char * head, int off){
+    u_int64_t v;
+    memcpy(&v, head + off, sizeof(v));
+    return be64toh(v);
+}
+
+static inline void store16(unsigned char * head, int off, u_int16_t v){
+    v = htons(v);
+    memcpy(head + off, &v, sizeof(v));
+}
+
+static inline void store32(unsigned char * head, int off, u_int32_t v){
+    v = htonl(v);
+    memcpy(head + off, &v, sizeof(v));
+}
+
+static inline void store64(unsigned char * head, int off, u_int64_t v){
+    v = htobe64(v);
+    memcpy(head + off, &v, sizeof(v));
+}
+
+/*******************************************************************************
+ * Get and set each field of the header of an RUDP packet (pkt). The version is
+ * only set by init_header.
+ ******************************************************************************/
+static inline u_int8_t get_version(const struct rudp_packet_t * pkt){
+    return pkt->head[OFF_VERSION] >> 4;
+}
+
+static inline u_int8_t get_flags(const struct rudp_packet_t * pkt){
+    return pkt->head[OFF_VERSION] & 0x0F;
+}
+
+static inline void set_flags(struct rudp_packet_t * pkt, u_int8_t flags){
+    pkt->head[OFF_VERSION] = (u_int8_t) ((pkt->head[OFF_VERSION] & 0xF0) |
+                                         (flags & 0x0F));
+}
+
+static inline u_int8_t get_type(const struct rudp_packet_t * pkt){
+    return pkt->head[OFF_TYPE];
+}
+
+static inline void set_type(struct rudp_packet_t * pkt, u_int8_t type){
+    pkt->head[OFF_TYPE] = type;
+}
+
+static inline u_int16_t get_length(const struct rudp_packet_t * pkt){
+    return load16(pkt->head, OFF_LENGTH);
+}
+
+static inline void set_length(struct rudp_packet_t * pkt, u_int16_t length){
+    store16(pkt->head, OFF_LENGTH, length);
+}
+
+static inline u_int32_t get_session(const struct rudp_packet_t * pkt){
+    return load32(pkt->head, OFF_SESSION);
+}
+
+static inline void set_session(struct rudp_packet_t * pkt, u_int32_t session){
+    store32(pkt->head, OFF_SESSION, session);
+}
+
+static inline u_int64_t get_seq_num(const struct rudp_packet_t * pkt){
+    return load64(pkt->head, OFF_SEQ_NUM);
+}
+
+static inline void set_seq_num(struct rudp_packet_t * pkt, u_int64_t seq_num){
+    store64(pkt->head, OFF_SEQ_NUM, seq_num);
+}
+
+static inline u_int32_t get_checksum(const struct rudp_packet_t * pkt){
+    return load32(pkt->head, OFF_CHECKSUM);
+}
+
+static inline void set_checksum(struct rudp_packet_t * pkt,
+                                u_int32_t checksum){
+    store32(pkt->head, OFF_CHECKSUM, checksum);
+}
+
+static inline u_int32_t get_timestamp(const struct rudp_packet_t * pkt){
+    return load32(pkt->head, OFF_TIMESTAMP);
+}
+
+static inline void set_timestamp(struct rudp_packet_t * pkt,
+                                 u_int32_t timestamp){
+    store32(pkt->head, OFF_TIMESTAMP, timestamp);
+}
+
+static inline u_int32_t get_echo(const struct rudp_packet_t * pkt){
+    return load32(pkt->head, OFF_ECHO);
+}
+
+static inline void set_echo(struct rudp_packet_t * pkt, u_int32_t echo){
+    store32(pkt->head, OFF_ECHO, echo);
+}
+
+/*******************************************************************************
+ * Writes a complete header into an RUDP packet (pkt): the current version, no
+ * flags, a given type (type), sequence number (seq_num) and data length
+ * (length), and zero for the session, checksum, timestamp and echo
+ *
+ * @param pkt - The packet whose header is written
+ * @param type - The RUDP type
+ * @param seq_num - The sequence number
+ * @param length - The number of bytes of data after the header
+ ******************************************************************************/
+void init_header(rudp_packet_t * pkt, u_int8_t type, u_int64_t seq_num,
+                 u_int16_t length);
+
 /*******************************************************************************
  * Allocates memory for a new RUDP packet. Sets the data portion of the RUDP
  * packet to be equal top the first size bytes of the passed array of data.
@@ -57,29 +314,97 @@ typedef enum bool bool;
  * @param size - The size of the data parameter
  * @return pkt - A newly allocated pointer to an RUDP packet
  ******************************************************************************/
-rudp_packet_t * create_rudp_packet(void *data, size_t size, u_int32_t *seq_num);
+rudp_packet_t * create_rudp_packet(void *data, size_t size, u_int64_t *seq_num);
+
+/*******************************************************************************
+ * Initializes an existing RUDP packet (pkt) as a data packet with sequence
+ * number seq_num, holding the first size bytes of data. data may already be
+ * the data portion of the packet, in which case it is not copied. The rest of
+ * the data portion is left as it was, since it is neither sent nor covered by
+ * the checksum.
+ *
+ * @param pkt - The packet to initialize
+ * @param data - The binary data to be included in the RUDP packet
+ * @param size - The size of the data parameter
+ * @param seq_num - The sequence number of the packet
+ ******************************************************************************/
+void init_rudp_packet(rudp_packet_t * pkt, void *data, size_t size,
+                      u_int64_t seq_num);
+
+/*******************************************************************************
+ * Computes the part of a packet's checksum that covers its data (data) of a
+ * given length (len), for a packet with the given flags (flags). A sender that
+ * resends the same data can keep this and only checksum the header each time.
+ *
+ * @param flags - The flags of the packet
+ * @param data - The data of the packet
+ * @param len - The length of the data
+ * @return check - The sum or CRC32C of the data
+ ******************************************************************************/
+u_int32_t payload_check(u_int8_t flags, const void * data, size_t len);
+
+/*******************************************************************************
+ * Computes the checksum of an RUDP packet (rudp_pk) from its header and the
+ * payload_check of its data (payload), which need not follow the header in
+ * memory. Assumes that the checksum of the packet has been initialized to
+ * zero.
+ *
+ * @param rudp_pk - The packet to calculate the checksum for
+ * @param payload - The payload_check of the packet's data
+ * @return checksum - The checksum for the packet
+ ******************************************************************************/
+u_int32_t header_checksum(rudp_packet_t * rudp_pk, u_int32_t payload);
 
 /*******************************************************************************
- * Computes the internet checksum for the entire RUDP packet. Assumes that the
- * checksum of the packet has been initialized to zero. If an RUDP packet with
- * and existing checksum is passed, this function returns 0 if the checksum is
- * correct.
+ * Computes the checksum over the first size bytes of an RUDP packet
+ * (rudp_pk), which are the bytes that are actually sent. The internet checksum
+ * is used unless the packet has the CHECK_CRC32C flag. Assumes that the
+ * checksum of the packet has been initialized to zero.
  *
  * @param rudp_pk - The packet to calculate the checksum for
- * @return checksum - The internet checksum for the entire packet
+ * @param size - The size of the packet as sent
+ * @return checksum - The checksum for the packet
  ******************************************************************************/
-u_int16_t calc_checksum(rudp_packet_t * rudp_pk);
+u_int32_t calc_checksum(rudp_packet_t * rudp_pk, int size);
 
 /*******************************************************************************
- * Checks if the checksum of rudp_pkt is correct. Returns TRUE if so, else FALSE
+ * Checks if a received datagram (rudp_pkt) of a given size (size) is a packet
+ * of this version whose length matches the datagram and whose checksum is
+ * correct, without changing the packet. Returns TRUE if so, else FALSE.
  *
  * @param rudp_pkt - The RUDP packet to check
+ * @param size - The size of the packet as received
  * @return TRUE or FALSE - Whether or not the checksum is correct
  ******************************************************************************/
-bool check_checksum(rudp_packet_t * rudp_pkt);
+bool check_checksum(const rudp_packet_t * rudp_pkt, int size);
 
 /*******************************************************************************
- * Sends an acknowledgment for the packet designated by seq_num to the server.
+ * Checks a received packet (rudp_pkt) like check_checksum. If
+ * the packet has the CHECK_CRC32C flag and data_crc is not NULL, the CRC32C of
+ * the packet's data alone is also stored in data_crc, so that the receiver
+ * can build a digest of the file without reading the data again.
+ *
+ * @param rudp_pkt - The RUDP packet to check
+ * @param size - The size of the packet as received
+ * @param data_crc - The location to store the CRC32C of the data, or NULL
+ * @return TRUE or FALSE - Whether or not the checksum is correct
+ ******************************************************************************/
+bool check_packet(const rudp_packet_t * rudp_pkt, int size,
+                  u_int32_t * data_crc);
+
+/*******************************************************************************
+ * Sets the timestamp of an RUDP packet (rudp_pkt) of a given size (size) to
+ * the current time and recalculates its checksum. Called each time a packet
+ * is (re)transmitted.
+ *
+ * @param rudp_pkt - The packet to stamp
+ * @param size - The size of the packet as sent
+ ******************************************************************************/
+void stamp_packet(rudp_packet_t * rudp_pkt, int size);
+
+/*******************************************************************************
+ * Sends an acknowledgment for the packet designated by seq_num to the server,
+ * echoing the timestamp of the packet.
  *
  * @param sockfd - The socket to send over
  * @param serveraddr - The address of the server
@@ -90,30 +415,102 @@ void send_rudp_ack(int sockfd, struct sockaddr *serveraddr,
 
 /*******************************************************************************
  * Sends an RUDP packet (rudp_pkt) of a given size (size) to the destination
- * specified (destaddr) over the specified socket (sockfd). Waits a specified
- * amount of time (req) for an acknowledgement, then resends if no
- * acknowledgement was received. Attempts to send MAX_ATTEMPTS times, then
- * aborts if no acknowledgement was received. If an acknowledgement is received,
- * if is stored in the specified location (ack_pkt).
+ * specified (destaddr) over the specified socket (sockfd). Waits for the
+ * retransmission timeout of the connection's RTT estimate (rtt) for an
+ * acknowledgement, then doubles the timeout and resends if no acknowledgement
+ * was received. Attempts to send MAX_ATTEMPTS times, then gives up if no
+ * acknowledgement was received. If an acknowledgement is received, it updates
+ * the RTT estimate and is stored in the specified location (ack_pkt).
+ * Packets from any other address, or larger than a rudp_packet_t, are
+ * ignored. If rtt is NULL, a fresh estimate starting at RTO_INITIAL is
+ * used. Returns TRUE if the acknowledgement was received, else FALSE, in
+ * which case ack_pkt is left untouched.
  *
  * @param sockfd - The soocket to send the message one
  * @param destaddr - The address of the destination to send to
  * @param rudp_pkt - The packet to send
  * @param size - The size of the packet to send
  * @param ack_pkt - The location to store the acknoowledgement
- * @param req - The amount of time to wait for an acknowledgement
+ * @param rtt - The RTT estimate of the connection
+ * @return TRUE or FALSE - Whether or not the packet was acknowledged
  ******************************************************************************/
-void send_and_wait(int sockfd, struct sockaddr *destaddr,
+bool send_and_wait(int sockfd, struct sockaddr *destaddr,
                    rudp_packet_t * rudp_pkt, size_t size,
-                   rudp_packet_t * ack_pkt, struct timespec * req);
+                   rudp_packet_t * ack_pkt, struct rtt_t * rtt);
 
 /*******************************************************************************
- * Prints data from the RUDP header to stdout. Checks the checksum and returns
- * TRUE if it is correct, else FALSE
+ * Returns the current time in microseconds from a monotonic clock, for use in
+ * retransmission timers
+ *
+ * @return time - The current monotonic time in microseconds
+ ******************************************************************************/
+u_int64_t get_time_us(void);
+
+/*******************************************************************************
+ * Requests send and receive buffers of a given size (bytes) for the specified
+ * socket (sockfd), so that a large window of packets can be in flight without
+ * the kernel dropping them. The kernel may cap the size it actually grants.
+ *
+ * @param sockfd - The socket to size the buffers of
+ * @param bytes - The requested size of each buffer
+ ******************************************************************************/
+void set_socket_buffers(int sockfd, int bytes);
+
+/*******************************************************************************
+ * Returns the MTU of the route to a destination (addr), as the kernel knows it
+ * from the outgoing interface and any path MTU discovery so far, or 0 if it
+ * cannot be found
+ *
+ * @param addr - The destination
+ * @return mtu - The path MTU in bytes, or 0
+ ******************************************************************************/
+int path_mtu(const struct sockaddr_in * addr);
+
+/*******************************************************************************
+ * Returns the largest data segment that fits in one datagram on a path with
+ * the given MTU (mtu) without IP fragmentation, capped at MAX_PAYLOAD. An
+ * unknown MTU (0) gives RUDP_DATA.
+ *
+ * @param mtu - The path MTU in bytes, or 0
+ * @return payload - The size of the data segment
+ ******************************************************************************/
+u_int32_t mtu_payload(int mtu);
+
+/*******************************************************************************
+ * Records in the statistics (stats) that one system call moved packets
+ * datagrams
+ *
+ * @param stats - The statistics to update
+ * @param packets - The number of datagrams moved by the call
+ ******************************************************************************/
+void record_io(io_stats_t * stats, int packets);
+
+/*******************************************************************************
+ * Prints the statistics (stats) of one direction of I/O, labelled label, to
+ * stderr at LOG_INFO, including the average number of packets per system call
+ *
+ * @param label - What the statistics count
+ * @param stats - The statistics to print
+ ******************************************************************************/
+void print_io_stats(const char * label, io_stats_t * stats);
+
+/*******************************************************************************
+ * Prints data from the RUDP header to stderr. Checks the checksum over the
+ * size bytes of the packet and returns TRUE if it is correct, else FALSE
  *
  * @param rudp_pkt - The packet to print
+ * @param size - The size of the packet
  * @return TRUE or FALSE - Whether or not the checksum is correct
  ******************************************************************************/
-bool print_rudp_packet(rudp_packet_t * rudp_pkt);
+bool print_rudp_packet(rudp_packet_t * rudp_pkt, int size);
+
+/*******************************************************************************
+ * Prints data from the RUDP header to stderr, along with whether its checksum
+ * was found to be correct (good_checksum)
+ *
+ * @param rudp_pkt - The packet to print
+ * @param good_checksum - Whether or not the checksum is correct
+ ******************************************************************************/
+void print_rudp_header(rudp_packet_t * rudp_pkt, bool good_checksum);
 
 #endif //PROJECT_4_UDP_PACKET_H
@@ -0,0 +1,166 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * sack.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in sack.h
+ ******************************************************************************/
+
+#include "sack.h"
+#include "trace.h"
+
+/*Bit operations on the ring buffer of received flags*/
+#define BIT_INDEX(sack, seq) ((seq) % (sack)->capacity)
+#define TEST_BIT(sack, seq) \
+    ((sack)->bitmap[BIT_INDEX(sack, seq) / 8] & (1 << BIT_INDEX(sack, seq) % 8))
+#define SET_BIT(sack, seq) \
+    ((sack)->bitmap[BIT_INDEX(sack, seq) / 8] |= 1 << BIT_INDEX(sack, seq) % 8)
+#define CLEAR_BIT(sack, seq) \
+    ((sack)->bitmap[BIT_INDEX(sack, seq) / 8] &= \
+        ~(1 << BIT_INDEX(sack, seq) % 8))
+
+/*******************************************************************************
+ * Initializes the receive state (sack) to track up to capacity packets past
+ * the cumulative ack point
+ *
+ * @param sack - The receive state to initialize
+ * @param capacity - The number of packets that can be tracked
+ ******************************************************************************/
+void init_sack(sack_t * sack, u_int32_t capacity){
+    /*Keep the bitmap a whole number of bytes*/
+    capacity = (capacity + 7) & ~7u;
+
+    sack->bitmap = calloc(capacity / 8, 1);
+    if(sack->bitmap == NULL){
+        fprintf(stderr, "Could not allocate receive bitmap\n");
+        exit(1);
+    }
+    sack->capacity = capacity;
+    sack->cum_ack = 0;
+    sack->highest = 0;
+    sack->pending = 0;
+    sack->deadline = 0;
+    sack->echo = 0;
+    sack->flags = 0;
+    sack->session = 0;
+    sack->fec = FALSE;
+    sack->fec_expected = 0;
+    sack->fec_lost = 0;
+}
+
+/*******************************************************************************
+ * Frees the bitmap of the receive state (sack)
+ *
+ * @param sack - The receive state to free
+ ******************************************************************************/
+void free_sack(sack_t * sack){
+    free(sack->bitmap);
+    sack->bitmap = NULL;
+}
+
+/*******************************************************************************
+ * Records that packet seq_num, sent at a given time (timestamp), was received,
+ * like record_packet. Also used for packets rebuilt from parity, which are
+ * given the timestamp of the packet that completed them.
+ *
+ * @param sack - The receive state to update
+ * @param seq_num - The sequence number of the packet
+ * @param timestamp - The timestamp of the packet
+ * @return TRUE or FALSE - Whether or not the packet should be kept
+ ******************************************************************************/
+bool record_seq(sack_t * sack, u_int64_t seq_num, u_int32_t timestamp){
+    u_int64_t offset = seq_num - sack->cum_ack;
+
+    if(sack->pending == 0){
+        sack->echo = timestamp;
+    }
+
+    /*Packets before the ack point have already been received*/
+    if(offset >= sack->capacity || TEST_BIT(sack, seq_num)){
+        return FALSE;
+    }
+
+    SET_BIT(sack, seq_num);
+    if(offset >= sack->highest - sack->cum_ack){
+        sack->highest = seq_num + 1;
+    }
+
+    /*Advance the ack point past every packet received in order*/
+    while(sack->cum_ack != sack->highest && TEST_BIT(sack, sack->cum_ack)){
+        CLEAR_BIT(sack, sack->cum_ack);
+        sack->cum_ack++;
+    }
+
+    /*Start the delayed ACK timer on the first unacknowledged packet*/
+    if(sack->pending++ == 0){
+        sack->deadline = get_time_us() + ACK_DELAY;
+    }
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Records that a packet (rudp_pkt) was received, advancing the cumulative ack
+ * point if possible. The timestamp of the first packet received since the last
+ * ACK is kept to be echoed, so the measured round trip includes any delay in
+ * acknowledging it. Returns TRUE if the packet is new, or FALSE if it is a
+ * duplicate or too far ahead of the ack point to be tracked.
+ *
+ * @param sack - The receive state to update
+ * @param rudp_pkt - The received packet
+ * @return TRUE or FALSE - Whether or not the packet should be kept
+ ******************************************************************************/
+bool record_packet(sack_t * sack, rudp_packet_t * rudp_pkt){
+    return record_seq(sack, get_seq_num(rudp_pkt), get_timestamp(rudp_pkt));
+}
+
+/*******************************************************************************
+ * Sends a SACK packet describing the receive state (sack) to the server
+ * (serveraddr) over the specified socket (sockfd), and clears the count of
+ * packets waiting to be acknowledged. With fec set, the loss counts of the
+ * client's blocks follow the bitmap.
+ *
+ * @param sockfd - The socket to send over
+ * @param serveraddr - The address of the server
+ * @param sack - The receive state to acknowledge
+ ******************************************************************************/
+void send_sack(int sockfd, struct sockaddr *serveraddr, sack_t * sack){
+    rudp_packet_t ack;
+    fec_report_t report;
+    u_int32_t i, bits, length;
+
+    memset(&ack, 0, sizeof(rudp_packet_t));
+    init_header(&ack, SACK, sack->cum_ack, 0);
+    set_flags(&ack, sack->flags);
+    set_session(&ack, sack->session);
+    set_echo(&ack, sack->echo);
+
+    /*Describe the packets received past the ack point, if any*/
+    bits = 0;
+    if(sack->highest - sack->cum_ack > 1){
+        bits = SACK_BYTES * 8;
+        if(sack->highest - sack->cum_ack - 1 < bits){
+            bits = (u_int32_t) (sack->highest - sack->cum_ack - 1);
+        }
+    }
+    for(i = 0; i < bits; i++){
+        if(TEST_BIT(sack, sack->cum_ack + 1 + i)){
+            ack.data[i / 8] |= 1 << i % 8;
+        }
+    }
+    length = (bits + 7) / 8;
+    if(sack->fec){
+        report.expected = htonl((u_int32_t) sack->fec_expected);
+        report.lost = htonl((u_int32_t) sack->fec_lost);
+        memcpy(ack.data + length, &report, sizeof(fec_report_t));
+        length += (u_int32_t) sizeof(fec_report_t);
+    }
+
+    set_length(&ack, (u_int16_t) length);
+    set_checksum(&ack, calc_checksum(&ack, RUDP_HEAD + (int) length));
+    sendto(sockfd, &ack, RUDP_HEAD + length, 0, serveraddr,
+           sizeof(struct sockaddr_in));
+    trace_event(TRACE_ACK, sack->session, sack->cum_ack,
+                RUDP_HEAD + (int) length);
+
+    sack->pending = 0;
+}
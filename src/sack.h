@@ -0,0 +1,94 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * sack.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used by the
+ * client to keep track of which packets have been received, and to send
+ * cumulative and selective acknowledgements (SACK packets) for them.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_SACK_H
+#define PROJECT_4_SACK_H
+
+#include "rudp_packet.h"
+
+#define RECV_WINDOW 1048576 /*Packets past the ack point that can be tracked*/
+#define ACK_EVERY 16        /*Packets received before an ACK must be sent*/
+#define ACK_DELAY 2000      /*Longest time an ACK may be delayed (us)*/
+#define RECV_IDLE 10000000  /*Silence from the server before giving up (us)*/
+
+/*Custom struct to track received packets. Bit seq % capacity of the bitmap is
+ * set once packet seq has been received, for packets from cum_ack onward*/
+struct sack_t{
+    unsigned char *bitmap;          //Ring buffer of received flags
+    u_int32_t capacity;             //Number of bits in the bitmap
+    u_int64_t cum_ack;              //First packet not yet received
+    u_int64_t highest;              //One past the highest packet received
+    u_int32_t pending;              //Packets received since the last ACK
+    u_int64_t deadline;             //Time the pending ACK must be sent by (us)
+    u_int32_t echo;                 //Timestamp to echo in the next ACK
+    u_int8_t flags;                 //Flags of the SACKs, e.g. CHECK_CRC32C
+    u_int32_t session;              //Session of the SACKs
+    bool fec;                       //Whether the SACKs carry loss counts
+    u_int64_t fec_expected;         //Packets of the blocks closed so far
+    u_int64_t fec_lost;             //Of those, packets that never arrived
+};
+
+/*Typedefs*/
+typedef struct sack_t sack_t;
+
+/*******************************************************************************
+ * Initializes the receive state (sack) to track up to capacity packets past
+ * the cumulative ack point
+ *
+ * @param sack - The receive state to initialize
+ * @param capacity - The number of packets that can be tracked
+ ******************************************************************************/
+void init_sack(sack_t * sack, u_int32_t capacity);
+
+/*******************************************************************************
+ * Frees the bitmap of the receive state (sack)
+ *
+ * @param sack - The receive state to free
+ ******************************************************************************/
+void free_sack(sack_t * sack);
+
+/*******************************************************************************
+ * Records that a packet (rudp_pkt) was received, advancing the cumulative ack
+ * point if possible. The timestamp of the first packet received since the last
+ * ACK is kept to be echoed, so the measured round trip includes any delay in
+ * acknowledging it. Returns TRUE if the packet is new, or FALSE if it is a
+ * duplicate or too far ahead of the ack point to be tracked.
+ *
+ * @param sack - The receive state to update
+ * @param rudp_pkt - The received packet
+ * @return TRUE or FALSE - Whether or not the packet should be kept
+ ******************************************************************************/
+bool record_packet(sack_t * sack, rudp_packet_t * rudp_pkt);
+
+/*******************************************************************************
+ * Records that packet seq_num, sent at a given time (timestamp), was received,
+ * like record_packet. Also used for packets rebuilt from parity, which are
+ * given the timestamp of the packet that completed them.
+ *
+ * @param sack - The receive state to update
+ * @param seq_num - The sequence number of the packet
+ * @param timestamp - The timestamp of the packet
+ * @return TRUE or FALSE - Whether or not the packet should be kept
+ ******************************************************************************/
+bool record_seq(sack_t * sack, u_int64_t seq_num, u_int32_t timestamp);
+
+/*******************************************************************************
+ * Sends a SACK packet describing the receive state (sack) to the server
+ * (serveraddr) over the specified socket (sockfd), and clears the count of
+ * packets waiting to be acknowledged. With fec set, the loss counts of the
+ * client's blocks follow the bitmap.
+ *
+ * @param sockfd - The socket to send over
+ * @param serveraddr - The address of the server
+ * @param sack - The receive state to acknowledge
+ ******************************************************************************/
+void send_sack(int sockfd, struct sockaddr *serveraddr, sack_t * sack);
+
+#endif //PROJECT_4_SACK_H
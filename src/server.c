@@ -5,265 +5,659 @@
  *
  * This program implements a file transfer server using UDP packets with added
  * reliability functionality, similar to that of TCP. Once started, the server
- * waits for a Reliable UDP (RUDP) packet of type SYN with a requested file in
- * the packet body. Once connected, the server sends the file using a sliding
- * window of RUDP packets.
+ * waits for Reliable UDP (RUDP) packets of type SYN with a requested file in
+ * the packet body. Each client that connects gets its own session, and the
+ * server sends every requested file at once using a sliding window of RUDP
+ * packets per session. Sessions may be spread over several worker threads,
+ * each with its own socket bound to the same port with SO_REUSEPORT, so the
+ * kernel divides clients between the workers. The server runs until it is
+ * killed.
+ *
+ * Each worker either receives and sends from a pair of threads joined by a
+ * lock-free ring (the default), or, when built with EVENT_ENGINE, from a
+ * single thread that waits on its socket and a timer with epoll.
  ******************************************************************************/
 
 #include "rudp_packet.h"
-#include "window.h"
+#include "session.h"
+#include "ring.h"
+#include "log.h"
+#include "trace.h"
 #include <pthread.h>
-
-#define SEC_TO_NSEC 1000000000          /*Number of nanoseconds in 1 second*/
-#define DEFAULT_TIMEOUT 100000000       /*Default timeout is 0.1 seconds*/
-
-/*Custom struct for passing needed information to child thread*/
-struct thread_arg_t{
-    window_t * window;
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <sys/un.h>
+
+#define SEC_TO_USEC 1000000             /*Number of microseconds in 1 second*/
+#define MAX_WORKERS 64                  /*Most worker threads*/
+#define STATS_INTERVAL 5                /*Seconds between worker statistics*/
+#define STATS_BACKLOG 8                 /*Stats requests queued at once*/
+
+/*Custom struct for the state of a worker. The thread that receives datagrams
+ * only passes them through the ring to the thread that sends, which alone
+ * touches the sessions, so no lock is needed. The event engine has no ring, as
+ * one thread does both. Workers share nothing with each other*/
+struct server_t{
+    int id;
     int sockfd;
+    session_table_t sessions;
+#ifndef EVENT_ENGINE
+    ring_t ring;
+#endif
+    io_stats_t recv_stats;
 };
 
 /*Typedef*/
-typedef struct thread_arg_t thread_arg_t;
+typedef struct server_t server_t;
 
 /*Function prototypes*/
-void send_file(int sockfd, struct sockaddr* clientaddr, FILE *file,
-               struct timespec * req);
-void * get_acks(void * arg);
-
-/*Global semaphores for thread operations*/
-pthread_mutex_t window_lock;
-pthread_mutex_t flag_lock;
-bool file_finished;
+void start_worker(server_t * server, int id, struct sockaddr_in * addr,
+                  const session_opts_t * opts);
+int open_stats_socket(const char * path);
+void send_stats(server_t * workers, int count, int connfd);
+void report_workers(server_t * workers, int count, int stats_fd);
+#ifdef EVENT_ENGINE
+void * event_loop(void * arg);
+#else
+void * send_loop(void * arg);
+void * receive_loop(void * arg);
+#endif
 
 /*******************************************************************************
  * Server main method. Expects a port number and an optional time parameter
  * defining how long to wait for acknowledgements as command line arguments.
+ * The number of packets in the sliding window may be set with -w, and the
+ * congestion control algorithm (reno, bbr or none) with -c. Files are sent
+ * from a memory mapping unless -r asks for them to be read with stdio. The
+ * number of worker threads may be set with -t, and the level of messages to
+ * print (error, warn, info, debug or trace) with -l or RUDP_LOG. Packet events
+ * are traced to the file named by RUDP_TRACE. With -s, the counts of every
+ * worker are sent as JSON to each connection to a UNIX socket at the given
+ * path. With -f xor or -f rs, each block of data packets is followed by
+ * parity packets of that code, for clients that support it. The number of
+ * data packets per block may follow the code after a colon.
  *
  * @param argc
- * @param argv - [Port] [Timeout(s) (optional)]
+ * @param argv - [-w Window] [-c Congestion control] [-r] [-t Workers]
+ *               [-i Integrity check] [-m MTU] [-f FEC[:Block]]
+ *               [-l Log level] [-s Stats socket] [Port]
+ *               [Timeout(s) (optional)]
  * @return
  ******************************************************************************/
 int main(int argc, char **argv){
-    int sockfd, len;
-    ssize_t bytes_read;
-    struct sockaddr_in serveraddr, clientaddr;
-    char filename[MAX_LINE], buffer[MAX_LINE];
-    FILE *file;
-    rudp_packet_t *rudp_pkt;
-    bool good_checksum, is_open;
-    struct timespec req;
-
-    /*Check command line arguments*/
-    if(argc < 2 || argc > 3){
-        fprintf(stderr, "Usage: %s [Port] [Timeout(s) (optional)]\n", argv[0]);
-        exit(1);
-    }
-
-    /*If timeout parameter specified, set timespec accordingly*/
-    if(argc == 3){
-        if( atof(argv[2]) >= 1 ){
-            req.tv_sec = (int)(atof(argv[2]));
-            req.tv_nsec = (int)((atof(argv[2]) - req.tv_sec) * SEC_TO_NSEC);
-        }
-        else{
-            req.tv_sec = 0;
-            req.tv_nsec = (int)(atof(argv[2]) * SEC_TO_NSEC);
+    int opt, i, workers = 1, stats_fd = -1;
+    const char * stats_path = NULL;
+    cc_t cc;
+    struct sockaddr_in serveraddr;
+    session_opts_t opts;
+    server_t * servers;
+
+    opts.window_size = DEFAULT_WINDOW;
+    opts.cc_name = DEFAULT_CC;
+    opts.use_map = TRUE;
+    opts.initial_rto = RTO_INITIAL;
+    opts.integrity = INTEGRITY_INET | INTEGRITY_CRC32C;
+    opts.mtu = 0;
+    opts.fec = 0;
+    opts.fec_block = FEC_BLOCK;
+    init_log();
+    init_trace();
+
+    /*Check command line options*/
+    while((opt = getopt(argc, argv, "w:c:rt:i:m:f:l:s:")) != -1){
+        switch(opt){
+            case 'w':
+                opts.window_size = (u_int32_t) strtoul(optarg, NULL, 10);
+                if(opts.window_size == 0 || opts.window_size > MAX_WINDOW){
+                    fprintf(stderr, "Window must be 1 to %d packets\n",
+                            MAX_WINDOW);
+                    exit(1);
+                }
+                break;
+            case 'c':
+                if(!init_cc(&cc, optarg, 1, RUDP_HEAD + RUDP_DATA)){
+                    fprintf(stderr, "Unknown congestion control %s\n",
+                            optarg);
+                    exit(1);
+                }
+                opts.cc_name = optarg;
+                break;
+            case 'r':
+                opts.use_map = FALSE;
+                break;
+            case 't':
+                workers = atoi(optarg);
+                if(workers < 1 || workers > MAX_WORKERS){
+                    fprintf(stderr, "Workers must be 1 to %d\n",
+                            MAX_WORKERS);
+                    exit(1);
+                }
+                break;
+            case 'i':
+                if(strcmp(optarg, "inet") == 0){
+                    opts.integrity = INTEGRITY_INET;
+                }
+                else if(strcmp(optarg, "crc32c") == 0){
+                    opts.integrity = INTEGRITY_INET | INTEGRITY_CRC32C;
+                }
+                else {
+                    fprintf(stderr, "Unknown integrity check %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'm':
+                opts.mtu = atoi(optarg);
+                if(opts.mtu < 576 || opts.mtu > MAX_DATAGRAM + UDP_OVERHEAD){
+                    fprintf(stderr, "MTU must be 576 to %d bytes\n",
+                            MAX_DATAGRAM + UDP_OVERHEAD);
+                    exit(1);
+                }
+                break;
+            case 'f':
+                opts.fec = parse_fec(optarg, &opts.fec_block);
+                if(opts.fec == 0){
+                    fprintf(stderr, "FEC must be xor or rs, with 2 to %d "
+                            "packets per block\n", FEC_MAX_DATA);
+                    exit(1);
+                }
+                break;
+            case 'l':
+                if(!set_log_level(optarg)){
+                    fprintf(stderr, "Unknown log level %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 's':
+                stats_path = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-w Window] [-c reno|bbr|none] "
+                        "[-r] [-t Workers] [-i inet|crc32c] [-m MTU] "
+                        "[-f xor|rs[:Block]] [-l Level] [-s Stats socket] "
+                        "[Port] [Timeout(s) (optional)]\n", argv[0]);
+                exit(1);
         }
     }
 
-    /*Otherwise, set default timeout to 0.1 seconds*/
-    else{
-        req.tv_sec = 0;
-        req.tv_nsec = DEFAULT_TIMEOUT;
+    /*Check command line arguments*/
+    if(argc - optind < 1 || argc - optind > 2){
+        fprintf(stderr, "Usage: %s [-w Window] [-c reno|bbr|none] "
+                "[-r] [-t Workers] [-i inet|crc32c] [-m MTU] "
+                "[-f xor|rs[:Block]] [-l Level] [-s Stats socket] [Port] "
+                "[Timeout(s) (optional)]\n", argv[0]);
+        exit(1);
     }
 
-    /*Create UDP socket*/
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if(sockfd < 0){
-        printf("There was an error creating the socket\n");
-        exit(1);
+    /*If timeout parameter specified, use it until the RTT is measured*/
+    if(argc - optind == 2){
+        opts.initial_rto = (u_int64_t)(atof(argv[optind + 1]) * SEC_TO_USEC);
     }
 
     /*Set up server address and port*/
     serveraddr.sin_family=AF_INET;
-    serveraddr.sin_port = htons( (uint16_t)atoi(argv[1]) );
+    serveraddr.sin_port = htons( (uint16_t)atoi(argv[optind]) );
     serveraddr.sin_addr.s_addr = INADDR_ANY;
 
-    /*Bind server address and port to the socket*/
-    bind(sockfd, (struct sockaddr*)&serveraddr, sizeof(struct sockaddr) );
-
-    /*Listen for up to 10 clients*/
-    listen(sockfd, 10);
-
-    /*Wait for SYN*/
-    len = sizeof(struct sockaddr_in);
-    do {
-        memset(buffer, 0, MAX_LINE);
-        bytes_read = recvfrom(sockfd, buffer, MAX_LINE, 0,
-                              (struct sockaddr *) &clientaddr,
-                              (socklen_t *) &len);
-        printf("Got %d byte packet\n", (int)bytes_read);
-        good_checksum = print_rudp_packet( (rudp_packet_t*)buffer );
-    }while( !good_checksum || ((rudp_packet_t *)buffer)->type != SYN);
-
-    /*Attempt to open file*/
-    memcpy(filename, ((rudp_packet_t*)buffer)->data,
-           (size_t)(bytes_read - RUDP_HEAD));
-    filename[bytes_read - RUDP_HEAD] = '\0';
-    fprintf(stdout, "\nRequested file: %s\n", filename);
-
-    file = fopen(filename, "r");
-    if(file == NULL){
-        fprintf(stderr, "Could not locate %s\n", filename);
-        is_open = FALSE;
+    /*Start the workers, then report on them until killed*/
+    servers = calloc((size_t) workers, sizeof(server_t));
+    if(servers == NULL){
+        fprintf(stderr, "Could not allocate workers\n");
+        exit(1);
     }
-    else {
-        fprintf(stdout, "Successfully opened %s\n", filename);
-        is_open = TRUE;
+    for(i = 0; i < workers; i++){
+        start_worker(&servers[i], i, &serveraddr, &opts);
     }
-
-    /*Create SYN_ACK packet*/
-    u_int32_t seq_num = 0;
-    rudp_pkt = create_rudp_packet(&is_open, sizeof(bool), &seq_num);
-    rudp_pkt->type = SYN_ACK;
-    rudp_pkt->checksum = 0;
-    rudp_pkt->checksum = calc_checksum(rudp_pkt);
-
-    /*Send SYN_ACK with status of file*/
-    fprintf(stdout, "\nSending %d byte packet\n",
-            (int)(sizeof(bool) + RUDP_HEAD) );
-    print_rudp_packet(rudp_pkt);
-    send_and_wait(sockfd, (struct sockaddr *) &clientaddr, rudp_pkt,
-                  sizeof(bool) + RUDP_HEAD, NULL, &req);
-
-    free(rudp_pkt);
-
-    /*Read in file from disk*/
-    if(is_open){
-        send_file(sockfd, (struct sockaddr *) &clientaddr, file, &req);
+    if(stats_path != NULL){
+        stats_fd = open_stats_socket(stats_path);
     }
-
-    close(sockfd);
+    report_workers(servers, workers, stats_fd);
 
     exit(0);
 }
 
 /*******************************************************************************
- * Sends a file (file) to the client (clientaddr) over the specified socket
- * (sockfd). Takes additional time parameter (req) to specify how long to wait
- * between sending windows.
+ * Starts a worker (server) with its own UDP socket bound to addr, its own
+ * sessions using the settings opts, and a thread each to receive and to send,
+ * or a single thread for both with the event engine. The socket is bound with
+ * SO_REUSEPORT, so every worker can share the port and the kernel sends all
+ * of the datagrams of a client to the same worker.
  *
- * @param sockfd - The socket to send the file over
- * @param clientaddr - The client to send the file to
- * @param file - The file to send
+ * @param server - The worker to start
+ * @param id - The number of the worker
+ * @param addr - The address to bind the socket to
+ * @param opts - The settings for new sessions
  ******************************************************************************/
-void send_file(int sockfd, struct sockaddr* clientaddr, FILE *file,
-               struct timespec * req){
+void start_worker(server_t * server, int id, struct sockaddr_in * addr,
+                  const session_opts_t * opts){
     pthread_t child;
-    thread_arg_t arg;
-    window_t window;
+    int on = 1;
+
+    /*Create UDP socket*/
+    server->id = id;
+    server->sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if(server->sockfd < 0){
+        printf("There was an error creating the socket\n");
+        exit(1);
+    }
+    set_socket_buffers(server->sockfd, SOCKET_BUFFER);
+    if(setsockopt(server->sockfd, SOL_SOCKET, SO_REUSEPORT, &on,
+                  sizeof(on)) < 0){
+        fprintf(stderr, "Could not set SO_REUSEPORT\n");
+        exit(1);
+    }
 
-    /*Initialize the sliding window*/
-    init_window(&window);
+    /*Bind server address and port to the socket*/
+    if(bind(server->sockfd, (struct sockaddr*) addr,
+            sizeof(struct sockaddr)) < 0){
+        fprintf(stderr, "Could not bind port %d\n", ntohs(addr->sin_port));
+        exit(1);
+    }
 
-    /*Set flag to indicate file not yet sent*/
-    file_finished = FALSE;
+    init_sessions(&server->sessions, opts);
+    memset(&server->recv_stats, 0, sizeof(io_stats_t));
 
-    /*Detach thread to listen for ACKs*/
-    arg.sockfd = sockfd;
-    arg.window = &window;
-    if( pthread_create(&child, NULL, get_acks, &arg) != 0) {
+#ifdef EVENT_ENGINE
+    /*Receive and send datagrams from the same thread*/
+    if( pthread_create(&child, NULL, event_loop, server) != 0 ||
+            pthread_detach(child) != 0) {
         printf("Failed to create thread\n");
         exit(1);
     }
-    pthread_detach(child);
+#else
+    /*Receive datagrams in one thread, and send from another. Finished file
+     * reads wake the sending thread the same way datagrams do*/
+    init_ring(&server->ring);
+    uring_notify(&server->sessions.ring, server->ring.data_fd);
+    if( pthread_create(&child, NULL, receive_loop, server) != 0 ||
+            pthread_detach(child) != 0 ||
+            pthread_create(&child, NULL, send_loop, server) != 0 ||
+            pthread_detach(child) != 0) {
+        printf("Failed to create thread\n");
+        exit(1);
+    }
+#endif
+}
+
+/*******************************************************************************
+ * Creates a UNIX stream socket listening at a given path (path), replacing
+ * whatever was left there by an earlier server. Returns the socket.
+ *
+ * @param path - The path of the socket
+ * @return sockfd - The listening socket
+ ******************************************************************************/
+int open_stats_socket(const char * path){
+    struct sockaddr_un addr;
+    int sockfd;
+
+    if(strlen(path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "Stats socket path %s is too long\n", path);
+        exit(1);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    /*Connections are accepted between reports, so they must never block*/
+    sockfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(sockfd < 0 || bind(sockfd, (struct sockaddr *) &addr,
+                          sizeof(addr)) < 0 ||
+            listen(sockfd, STATS_BACKLOG) < 0){
+        fprintf(stderr, "Could not open stats socket %s\n", path);
+        exit(1);
+    }
+    log_msg(LOG_INFO, "Stats available at %s\n", path);
+    return sockfd;
+}
 
+/*******************************************************************************
+ * Sends the counts of each of the workers (workers) as one JSON object over a
+ * connection to the stats socket (connfd): the sessions each is serving, what
+ * it has sent so far, and the counts of the sessions it has closed. Per
+ * session counts are only read by the thread that owns the session, so
+ * sessions still running show up in the closed counts once they finish.
+ *
+ * @param workers - The workers
+ * @param count - The number of workers
+ * @param connfd - The connection to send over
+ ******************************************************************************/
+void send_stats(server_t * workers, int count, int connfd){
+    char json[METRICS_JSON + MAX_LINE];
+    session_table_t * table;
+    u_int64_t served, bytes, packets;
+    u_int32_t active;
+    int i, len;
+
+    send(connfd, "{\"workers\":[", 12, MSG_NOSIGNAL);
+    for(i = 0; i < count; i++){
+        table = &workers[i].sessions;
+        active = __atomic_load_n(&table->count, __ATOMIC_RELAXED);
+        served = __atomic_load_n(&table->served, __ATOMIC_RELAXED);
+        bytes = __atomic_load_n(&table->bytes_sent, __ATOMIC_RELAXED);
+        packets = __atomic_load_n(&table->packets_sent, __ATOMIC_RELAXED);
+        len = snprintf(json, sizeof(json), "%s{\"id\":%d,\"active\":%u,"
+                       "\"served\":%llu,\"bytes_sent\":%llu,"
+                       "\"packets_sent\":%llu,\"closed\":",
+                       i > 0 ? "," : "", workers[i].id, active,
+                       (unsigned long long) served, (unsigned long long) bytes,
+                       (unsigned long long) packets);
+        len += format_metrics(&table->totals, "", json + len,
+                              sizeof(json) - (size_t) len - 1);
+        json[len++] = '}';
+        send(connfd, json, (size_t) len, MSG_NOSIGNAL);
+    }
+    send(connfd, "]}\n", 3, MSG_NOSIGNAL);
+}
+
+/*******************************************************************************
+ * Prints what each of the workers (workers) has done every STATS_INTERVAL
+ * seconds, so an uneven spread of clients between them shows up. Nothing is
+ * printed while the server is idle. In between, each connection to the stats
+ * socket (stats_fd), if there is one, is sent the counts of the workers and
+ * closed. Never returns.
+ *
+ * @param workers - The workers
+ * @param count - The number of workers
+ * @param stats_fd - The listening stats socket, or -1
+ ******************************************************************************/
+void report_workers(server_t * workers, int count, int stats_fd){
+    u_int64_t last_bytes[MAX_WORKERS], last_total = 0;
+    u_int64_t bytes, packets, served, total, next, now;
+    struct pollfd fd;
+    int i, connfd;
+
+    memset(last_bytes, 0, sizeof(last_bytes));
+    fd.fd = stats_fd;
+    fd.events = POLLIN;
+    next = get_time_us();
     while(TRUE){
-        pthread_mutex_lock(&window_lock);
 
-        /*Check exit conditions*/
-        if(feof(file) && is_empty(&window)) {
-            pthread_mutex_unlock(&window_lock);
-            break;
+        /*Answer the stats socket until the next report is due. A negative
+         * fd is ignored by poll, which then only waits*/
+        next += (u_int64_t) STATS_INTERVAL * SEC_TO_USEC;
+        while((now = get_time_us()) < next){
+            if(poll(&fd, 1, (int) ((next - now + 999) / 1000)) <= 0 ||
+                    !(fd.revents & POLLIN)){
+                continue;
+            }
+            while((connfd = accept(stats_fd, NULL, NULL)) >= 0){
+                send_stats(workers, count, connfd);
+                close(connfd);
+            }
         }
 
-        /*Update window and send*/
-        advance_window(&window);
-        fill_window(&window, file);
-        send_window(&window, sockfd, clientaddr);
+        /*The counters are only added to, so unchanged totals mean idle*/
+        total = 0;
+        for(i = 0; i < count; i++){
+            total += __atomic_load_n(&workers[i].sessions.bytes_sent,
+                                     __ATOMIC_RELAXED);
+        }
+        if(total == last_total){
+            continue;
+        }
 
-        pthread_mutex_unlock(&window_lock);
+        for(i = 0; i < count; i++){
+            bytes = __atomic_load_n(&workers[i].sessions.bytes_sent,
+                                    __ATOMIC_RELAXED);
+            packets = __atomic_load_n(&workers[i].sessions.packets_sent,
+                                      __ATOMIC_RELAXED);
+            served = __atomic_load_n(&workers[i].sessions.served,
+                                     __ATOMIC_RELAXED);
+            log_msg(LOG_INFO, "Worker %d: %llu sessions, %llu bytes, "
+                    "%llu packets, %.1f Mbit/s\n", workers[i].id,
+                    (unsigned long long) served, (unsigned long long) bytes,
+                    (unsigned long long) packets,
+                    (bytes - last_bytes[i]) * 8.0 / STATS_INTERVAL / 1e6);
+            last_bytes[i] = bytes;
+        }
+        if(count > 1){
+            log_msg(LOG_INFO, "All workers: %.1f Mbit/s\n",
+                    (total - last_total) * 8.0 / STATS_INTERVAL / 1e6);
+        }
+        last_total = total;
+    }
+}
+
+#ifdef EVENT_ENGINE
+
+/*******************************************************************************
+ * Runs in its own thread to serve every session of a worker (arg). A single
+ * epoll loop waits on both the socket and a timerfd set to the earliest
+ * deadline of any session, so acknowledgements are handled as soon as they
+ * arrive, and packets are resent or paced out when they are due, with no
+ * second thread to hand datagrams to. Queued datagrams are drained up to
+ * BATCH_SIZE at a time with recvmmsg and passed to the session of the client
+ * that sent each one. The sessions are run whenever one of them has something
+ * new to send, the timer fires, or file reads on the io_uring of the sessions
+ * complete, which the loop learns of through an eventfd.
+ *
+ * @param arg - The state of the worker
+ * @return
+ ******************************************************************************/
+void * event_loop(void * arg){
+    server_t * server = (server_t *) arg;
+    unsigned char buffers[BATCH_SIZE][MAX_LINE];
+    struct sockaddr_in addrs[BATCH_SIZE];
+    struct mmsghdr msgs[BATCH_SIZE];
+    struct iovec iov[BATCH_SIZE];
+    struct epoll_event ev, events[3];
+    struct itimerspec timer;
+    u_int64_t deadline = 0, armed = 0, expirations;
+    int epfd, tfd, efd, ready, i, j, n;
+    bool run;
+
+    memset(msgs, 0, sizeof(msgs));
+    for(i = 0; i < BATCH_SIZE; i++){
+        iov[i].iov_base = buffers[i];
+        iov[i].iov_len = MAX_LINE;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &addrs[i];
+    }
 
-        /*Wait for acknowledgements*/
-        struct timespec rem;
-        nanosleep(req, &rem);
+    /*Deadlines come from the monotonic clock, so the timer must use it*/
+    epfd = epoll_create1(0);
+    tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(epfd < 0 || tfd < 0){
+        fprintf(stderr, "Could not create epoll instance\n");
+        exit(1);
+    }
+    ev.events = EPOLLIN;
+    ev.data.fd = server->sockfd;
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, server->sockfd, &ev) < 0){
+        fprintf(stderr, "Could not create epoll instance\n");
+        exit(1);
+    }
+    ev.data.fd = tfd;
+    if(epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0){
+        fprintf(stderr, "Could not create epoll instance\n");
+        exit(1);
+    }
+    memset(&timer, 0, sizeof(timer));
+
+    /*Finished file reads are announced on an eventfd, if files are read
+     * through an io_uring at all*/
+    efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ev.data.fd = efd;
+    if(efd >= 0 && (!uring_notify(&server->sessions.ring, efd) ||
+            epoll_ctl(epfd, EPOLL_CTL_ADD, efd, &ev) < 0)){
+        close(efd);
+        efd = -1;
     }
 
-    /*Send END_SEQ packet*/
-    rudp_packet_t end_seq;
-    memset(&end_seq, 0, sizeof(rudp_packet_t));
-    end_seq.type = END_SEQ;
-    end_seq.checksum = calc_checksum(&end_seq);
-    send_and_wait(sockfd, clientaddr, &end_seq, RUDP_HEAD, NULL, req);
+    while(TRUE){
+        ready = epoll_wait(epfd, events, 3, -1);
+        run = FALSE;
+
+        for(j = 0; j < ready; j++){
+            /*The timer is one-shot, so it is disarmed once it fires*/
+            if(events[j].data.fd == tfd){
+                read(tfd, &expirations, sizeof(expirations));
+                armed = 0;
+                run = TRUE;
+                continue;
+            }
+            if(events[j].data.fd == efd){
+                read(efd, &expirations, sizeof(expirations));
+                run = TRUE;
+                continue;
+            }
+
+            /*Take every datagram that is queued, a batch at a time*/
+            do {
+                for(i = 0; i < BATCH_SIZE; i++){
+                    msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+                }
+                n = recvmmsg(server->sockfd, msgs, BATCH_SIZE, MSG_DONTWAIT,
+                             NULL);
+                if(n <= 0){
+                    break;
+                }
+
+                record_io(&server->recv_stats, n);
+                for(i = 0; i < n; i++){
+                    if(handle_packet(&server->sessions, &addrs[i],
+                                     (rudp_packet_t *) buffers[i],
+                                     (int) msgs[i].msg_len)){
+                        run = TRUE;
+                    }
+                }
+            } while(n == BATCH_SIZE);
+        }
 
-    pthread_mutex_lock(&flag_lock);
-    file_finished = TRUE;
-    pthread_mutex_unlock(&flag_lock);
+        if(!run && (deadline == 0 || get_time_us() < deadline)){
+            continue;
+        }
+        deadline = run_sessions(&server->sessions, server->sockfd);
+
+        /*Set the timer to the earliest deadline, or stop it if there is none*/
+        if(deadline != armed){
+            timer.it_value.tv_sec = (time_t) (deadline / SEC_TO_USEC);
+            timer.it_value.tv_nsec = (long) (deadline % SEC_TO_USEC) * 1000;
+            timerfd_settime(tfd, TFD_TIMER_ABSTIME, &timer, NULL);
+            armed = deadline;
+        }
+    }
 
-    /*Clean up*/
-    fclose(file);
+    return NULL;
 }
 
+#else
+
 /*******************************************************************************
- * Runs in parallel to the main thread to listen for acknowledgement packets.
- * Gets pointers to the sliding window and the socket as a pointer to a
- * thread_arg_t struct (arg). Uses mutex semaphores when accessing the window.
+ * Runs in its own thread to send the files of every session of a worker
+ * (arg). Each datagram the receive thread has put in the ring is passed to the
+ * session of the client that sent it, and whenever one of them gives a
+ * session something new to send, or the earliest deadline of any session
+ * passes, each session is given a chance to send whatever it has due. The
+ * thread then sleeps until either the ring has more datagrams, the earliest
+ * deadline passes, or the pacing rate of a session allows its next packet.
  *
- * @param arg - Sliding window and socket
+ * @param arg - The state of the worker
  * @return
  ******************************************************************************/
-void * get_acks(void * arg){
-    unsigned char buffer[MAX_LINE];
-    struct sockaddr_in clientaddr;
-    int buf_len, len;
-    int sockfd = ((thread_arg_t *)arg)->sockfd;
-    window_t * window = ((thread_arg_t *)arg)->window;
+void * send_loop(void * arg){
+    server_t * server = (server_t *) arg;
+    u_int64_t deadline = 0;
+    ring_slot_t * slot;
+    u_int32_t i, n;
+    bool run = TRUE;
 
-    while(TRUE) {
-
-        /*If parent thread has finished sending the file, exit*/
-        pthread_mutex_lock(&flag_lock);
-        if(file_finished){
-            pthread_mutex_unlock(&flag_lock);
-            break;
+    while(TRUE){
+        /*Hand each received datagram to its session*/
+        n = ring_count(&server->ring);
+        for(i = 0; i < n; i++){
+            slot = ring_used_slot(&server->ring, i);
+            if(handle_packet(&server->sessions, &slot->addr,
+                             (rudp_packet_t *) slot->data, slot->len)){
+                run = TRUE;
+            }
         }
-        else {
-            pthread_mutex_unlock(&flag_lock);
+        ring_consume(&server->ring, n);
+
+        if(run || sessions_ready(&server->sessions) ||
+                (deadline != 0 && get_time_us() >= deadline)){
+            deadline = run_sessions(&server->sessions, server->sockfd);
+            run = FALSE;
         }
 
-        /*If the window is empty, do not block to wait for ACKs*/
-        pthread_mutex_lock(&window_lock);
-        if( is_empty(window) ){
-            pthread_mutex_unlock(&window_lock);
+        /*Wait for acknowledgements until the next packet is due*/
+        ring_wait_data(&server->ring, deadline);
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * Runs in its own thread to receive every datagram sent to a worker (arg). An
+ * epoll loop waits for the socket to become readable, then up to BATCH_SIZE
+ * datagrams are drained with each recvmmsg call, straight into free slots of
+ * the ring, and handed to the sending thread. If the sending thread falls so
+ * far behind that the ring is full, this thread sleeps until it has room,
+ * leaving datagrams queued in the socket.
+ *
+ * @param arg - The state of the worker
+ * @return
+ ******************************************************************************/
+void * receive_loop(void * arg){
+    server_t * server = (server_t *) arg;
+    struct mmsghdr msgs[BATCH_SIZE];
+    struct iovec iov[BATCH_SIZE];
+    struct epoll_event ev;
+    ring_slot_t * slot;
+    u_int32_t space;
+    int epfd, batch, i, n;
+
+    memset(msgs, 0, sizeof(msgs));
+    for(i = 0; i < BATCH_SIZE; i++){
+        iov[i].iov_len = MAX_LINE;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    epfd = epoll_create1(0);
+    ev.events = EPOLLIN;
+    ev.data.fd = server->sockfd;
+    if(epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, server->sockfd, &ev) < 0){
+        fprintf(stderr, "Could not create epoll instance\n");
+        exit(1);
+    }
+
+    while(TRUE) {
+
+        /*Block until a datagram arrives*/
+        if(epoll_wait(epfd, &ev, 1, -1) <= 0){
             continue;
         }
-        pthread_mutex_unlock(&window_lock);
-
-        /*Block and wait for ACKs*/
-        buf_len = (int) recvfrom(sockfd, buffer, MAX_LINE, 0,
-                                 (struct sockaddr *) &clientaddr,
-                                 (socklen_t *) &len);
-
-        /*If ACK received, try to remove it from the window*/
-        if (((rudp_packet_t *) buffer)->type == ACK) {
-            fprintf(stdout, "Received %d byte acknowledgement for packet %d\n",
-                    buf_len, ((rudp_packet_t *) buffer)->seq_num);
-            pthread_mutex_lock(&window_lock);
-            process_ack(window, (rudp_packet_t *) buffer);
-            pthread_mutex_unlock(&window_lock);
-        }
+
+        /*Take every datagram that is queued, a batch at a time*/
+        do {
+            while((space = ring_space(&server->ring)) == 0){
+                ring_wait_space(&server->ring);
+            }
+            batch = space < BATCH_SIZE ? (int) space : BATCH_SIZE;
+            for(i = 0; i < batch; i++){
+                slot = ring_free_slot(&server->ring, (u_int32_t) i);
+                iov[i].iov_base = slot->data;
+                msgs[i].msg_hdr.msg_name = &slot->addr;
+                msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            }
+            n = recvmmsg(server->sockfd, msgs, (unsigned int) batch,
+                         MSG_DONTWAIT, NULL);
+            if(n <= 0){
+                break;
+            }
+
+            record_io(&server->recv_stats, n);
+            for(i = 0; i < n; i++){
+                slot = ring_free_slot(&server->ring, (u_int32_t) i);
+                slot->len = (int) msgs[i].msg_len;
+            }
+            ring_publish(&server->ring, (u_int32_t) n);
+        } while(n == batch);
     }
 
     return NULL;
-}
\ No newline at end of file
+}
+
+#endif //EVENT_ENGINE
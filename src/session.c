@@ -0,0 +1,601 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * session.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in session.h
+ ******************************************************************************/
+
+#include "session.h"
+#include "crc32c.h"
+#include "log.h"
+#include "trace.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+
+/*******************************************************************************
+ * Hashes a client address (addr) to a bucket of the session table
+ *
+ * @param addr - The address of the client
+ * @return bucket - The index of the bucket
+ ******************************************************************************/
+static u_int32_t hash_addr(struct sockaddr_in * addr){
+    u_int32_t h = (u_int32_t) addr->sin_addr.s_addr * 2654435761u;
+    h ^= (u_int32_t) addr->sin_port * 40503u;
+    return (h ^ (h >> 16)) % SESSION_BUCKETS;
+}
+
+/*******************************************************************************
+ * Initializes an empty session table (table) whose sessions use the settings
+ * opts
+ *
+ * @param table - The table to initialize
+ * @param opts - The settings for new sessions
+ ******************************************************************************/
+void init_sessions(session_table_t * table, const session_opts_t * opts){
+    memset(table->buckets, 0, sizeof(table->buckets));
+    table->head = NULL;
+    table->count = 0;
+    table->next_id = (u_int32_t) get_time_us();
+    table->opts = *opts;
+    table->served = 0;
+    table->bytes_sent = 0;
+    table->packets_sent = 0;
+    init_metrics(&table->totals);
+    init_uring(&table->ring);
+}
+
+/*******************************************************************************
+ * Passes the result of every completed file read on the ring of the table
+ * (table) to the window that queued it
+ *
+ * @param table - The sessions of the server
+ ******************************************************************************/
+static void reap_reads(session_table_t * table){
+    u_int64_t user_data;
+    int res;
+
+    while(uring_reap(&table->ring, &user_data, &res)){
+        complete_read(user_data, res);
+    }
+}
+
+/*******************************************************************************
+ * Finds the session of the client at addr in the table (table). Returns the
+ * session, or NULL if the client has none.
+ *
+ * @param table - The table to search
+ * @param addr - The address of the client
+ * @return session - The session of the client, or NULL
+ ******************************************************************************/
+session_t * find_session(session_table_t * table, struct sockaddr_in * addr){
+    session_t * s = table->buckets[hash_addr(addr)];
+
+    while(s != NULL){
+        if(s->addr.sin_addr.s_addr == addr->sin_addr.s_addr &&
+                s->addr.sin_port == addr->sin_port){
+            return s;
+        }
+        s = s->hash_next;
+    }
+    return NULL;
+}
+
+/*******************************************************************************
+ * Sends the handshake or teardown packet of a session (s) and starts its
+ * timer. Every resend doubles the timeout, as send_and_wait does.
+ *
+ * @param s - The session
+ * @param sockfd - The socket to send over
+ * @param now - The current time (us)
+ ******************************************************************************/
+static void send_ctrl(session_t * s, int sockfd, u_int64_t now){
+    if(s->ctrl_attempts > 0){
+        log_msg(LOG_DEBUG, "\nTimeout, no ACK received\n");
+        backoff_rto(&s->rtt);
+    }
+    stamp_packet(&s->ctrl, s->ctrl_size);
+    log_msg(LOG_DEBUG, "\nSending %d byte packet\n", s->ctrl_size);
+    if(log_enabled(LOG_DEBUG)){
+        print_rudp_packet(&s->ctrl, s->ctrl_size);
+    }
+    sendto(sockfd, &s->ctrl, (size_t) s->ctrl_size, 0,
+           (struct sockaddr *) &s->addr, sizeof(struct sockaddr_in));
+    s->ctrl_attempts++;
+    s->ctrl_deadline = now + get_rto(&s->rtt);
+}
+
+/*******************************************************************************
+ * Starts a session for a client (addr) that sent a SYN (rudp_pkt) of a given
+ * size (size). Opens the requested file, if it is a regular file, and
+ * prepares a SYN_ACK telling the client whether it was opened and which
+ * integrity check the data will carry: CRC32C if both sides support it, else
+ * the internet checksum. Each data packet carries as much of the file as the
+ * client accepts and the path MTU allows without fragmentation. Returns the
+ * session, or NULL if the SYN is malformed or the server is already serving
+ * MAX_SESSIONS clients.
+ *
+ * @param table - The sessions of the server
+ * @param addr - The address of the client
+ * @param rudp_pkt - The SYN
+ * @param size - The size of the SYN
+ * @return session - The new session, or NULL
+ ******************************************************************************/
+static session_t * open_session(session_table_t * table,
+                                struct sockaddr_in * addr,
+                                rudp_packet_t * rudp_pkt, int size){
+    char filename[MAX_LINE];
+    syn_t syn;
+    syn_ack_t syn_ack;
+    struct stat st;
+    session_t * s;
+    u_int32_t bucket, payload;
+    int len, fd;
+
+    if(table->count >= MAX_SESSIONS){
+        log_msg(LOG_WARN, "Too many sessions, ignoring SYN\n");
+        return NULL;
+    }
+    len = size - RUDP_HEAD - (int) sizeof(syn_t);
+    if(len < 0){
+        log_msg(LOG_WARN, "Malformed SYN, ignoring it\n");
+        return NULL;
+    }
+    memcpy(&syn, rudp_pkt->data, sizeof(syn_t));
+    syn.integrity = ntohl(syn.integrity);
+    syn.payload = ntohl(syn.payload);
+    syn.fec = ntohl(syn.fec);
+    s = calloc(1, sizeof(session_t));
+    if(s == NULL){
+        log_msg(LOG_ERROR, "Could not allocate session\n");
+        return NULL;
+    }
+    s->addr = *addr;
+
+    /*Packets left over from an earlier session of the same client carry a
+     * different id, so they are not mistaken for this session's*/
+    s->id = table->next_id++;
+    if(s->id == 0){
+        s->id = table->next_id++;
+    }
+    s->state = SYN_RCVD;
+    init_metrics(&s->metrics);
+    s->last_heard = s->metrics.started;
+    init_rtt(&s->rtt, table->opts.initial_rto);
+
+    /*Attempt to open file, whose name follows the SYN body*/
+    if(len > RUDP_DATA - (int) sizeof(syn_t)){
+        len = RUDP_DATA - (int) sizeof(syn_t);
+    }
+    memcpy(filename, rudp_pkt->data + sizeof(syn_t), (size_t) len);
+    filename[len] = '\0';
+    log_msg(LOG_INFO, "\nRequested file: %s\n", filename);
+
+    memset(&syn_ack, 0, sizeof(syn_ack_t));
+    syn_ack.integrity = INTEGRITY_INET;
+    if(syn.integrity & table->opts.integrity & INTEGRITY_CRC32C){
+        syn_ack.integrity = INTEGRITY_CRC32C;
+    }
+    payload = mtu_payload(table->opts.mtu != 0 ? table->opts.mtu :
+                          path_mtu(addr));
+    if(syn.payload != 0 && syn.payload < payload){
+        payload = syn.payload;
+    }
+
+    /*Parity packets hold a parity_t besides a full payload, and must fit the
+     * smaller of the two MTUs as well*/
+    if((syn.fec & table->opts.fec) && payload > sizeof(parity_t)){
+        syn_ack.fec = table->opts.fec;
+        syn_ack.fec_block = table->opts.fec_block;
+        payload -= (u_int32_t) sizeof(parity_t);
+    }
+
+    /*Only regular files are sent. Opening without blocking keeps a FIFO
+     * from stalling the worker, and the flag is cleared again so reads of
+     * the file still wait for the disk*/
+    fd = open(filename, O_RDONLY | O_NONBLOCK);
+    if(fd < 0 || fstat(fd, &st) != 0){
+        log_msg(LOG_WARN, "Could not locate %s\n", filename);
+    }
+    else if(!S_ISREG(st.st_mode)){
+        log_msg(LOG_WARN, "%s is not a regular file\n", filename);
+    }
+    else if(fcntl(fd, F_SETFL, 0) == 0){
+        s->file = fdopen(fd, "r");
+    }
+    if(s->file == NULL && fd >= 0){
+        close(fd);
+    }
+    if(s->file != NULL){
+        log_msg(LOG_INFO, "Successfully opened %s\n", filename);
+        syn_ack.is_open = 1;
+        syn_ack.file_size = (u_int64_t) st.st_size;
+        /*Initialize the sliding window*/
+        init_window(&s->window, table->opts.window_size, payload);
+        s->window.session = s->id;
+        syn_ack.payload = s->window.payload;
+        log_msg(LOG_DEBUG, "Sending %u byte packets\n", s->window.payload);
+        if(syn_ack.fec != 0){
+            add_fec(&s->window, syn_ack.fec, syn_ack.fec_block);
+            log_msg(LOG_DEBUG, "Sending %s parity after every %u packets\n",
+                    fec_name(syn_ack.fec), syn_ack.fec_block);
+        }
+        if(syn_ack.integrity == INTEGRITY_CRC32C){
+            s->window.flags = CHECK_CRC32C;
+        }
+        if(table->opts.use_map && !map_file(&s->window, s->file)){
+            log_msg(LOG_WARN, "Could not map file, reading it instead\n");
+        }
+        if(s->window.map == NULL &&
+                read_with_uring(&s->window, &table->ring, s->file)){
+            log_msg(LOG_DEBUG, "Reading file through io_uring\n");
+        }
+        init_cc(&s->cc, table->opts.cc_name, s->window.capacity,
+                RUDP_HEAD + s->window.payload);
+    }
+
+    /*Create SYN_ACK packet with the status and size of the file, to be sent
+     * at once*/
+    syn_ack.is_open = htonl(syn_ack.is_open);
+    syn_ack.integrity = htonl(syn_ack.integrity);
+    syn_ack.file_size = htobe64(syn_ack.file_size);
+    syn_ack.payload = htonl(syn_ack.payload);
+    syn_ack.fec = htonl(syn_ack.fec);
+    syn_ack.fec_block = htonl(syn_ack.fec_block);
+    init_rudp_packet(&s->ctrl, &syn_ack, sizeof(syn_ack_t), 0);
+    set_type(&s->ctrl, SYN_ACK);
+    set_session(&s->ctrl, s->id);
+    set_echo(&s->ctrl, get_timestamp(rudp_pkt));
+    s->ctrl_size = (int) sizeof(syn_ack_t) + RUDP_HEAD;
+    s->ctrl_attempts = 0;
+    s->ctrl_deadline = 0;
+
+    /*Add the session to the table*/
+    bucket = hash_addr(addr);
+    s->hash_next = table->buckets[bucket];
+    table->buckets[bucket] = s;
+    s->next = table->head;
+    table->head = s;
+    __atomic_fetch_add(&table->count, 1, __ATOMIC_RELAXED);
+    return s;
+}
+
+/*******************************************************************************
+ * Removes a session (s) from the hash table (table) and frees it. The session
+ * must already have been taken off the list of sessions.
+ *
+ * @param table - The sessions of the server
+ * @param s - The session to free
+ ******************************************************************************/
+static void free_session(session_table_t * table, session_t * s){
+    session_t ** pp = &table->buckets[hash_addr(&s->addr)];
+    char ip[INET_ADDRSTRLEN], fields[MAX_LINE], json[METRICS_JSON];
+
+    while(*pp != NULL && *pp != s){
+        pp = &(*pp)->hash_next;
+    }
+    if(*pp == s){
+        *pp = s->hash_next;
+    }
+    __atomic_fetch_sub(&table->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&table->served, 1, __ATOMIC_RELAXED);
+
+    /*Print the counts of the transfer and add them to the totals*/
+    s->metrics.finished = get_time_us();
+    s->metrics.bytes = s->window.bytes_sent;
+    s->metrics.packets_sent = s->window.send_stats.packets -
+                              s->window.parity_sent;
+    s->metrics.retransmits = s->window.retransmits;
+    s->metrics.parity_sent = s->window.parity_sent;
+    add_metrics(&table->totals, &s->metrics);
+    if(log_enabled(LOG_INFO)){
+        inet_ntop(AF_INET, &s->addr.sin_addr, ip, sizeof(ip));
+        snprintf(fields, sizeof(fields), "\"role\":\"server\","
+                 "\"session\":\"0x%08x\",\"peer\":\"%s:%d\",", s->id, ip,
+                 ntohs(s->addr.sin_port));
+        format_metrics(&s->metrics, fields, json, sizeof(json));
+        log_printf(LOG_INFO, "Session closed: %s\n", json);
+    }
+    if(s->file != NULL){
+        print_io_stats("Data sent", &s->window.send_stats);
+
+        /*Reads in flight still point into the window's packets*/
+        while(s->window.reads > 0){
+            uring_submit(&table->ring, TRUE);
+            reap_reads(table);
+        }
+        free_window(&s->window);
+        fclose(s->file);
+    }
+    free(s);
+}
+
+/*******************************************************************************
+ * Processes a SACK (rudp_ack) of a given size (size) for a session (s):
+ * updates the RTT estimate and congestion controller and removes the
+ * acknowledged packets from the window. With forward error correction, the
+ * loss counts at the end of the SACK are passed to the parity of the window.
+ * Returns the number of packets removed.
+ *
+ * @param s - The session
+ * @param rudp_ack - The SACK
+ * @param size - The size of the SACK
+ * @return removed - The number of acknowledged packets removed
+ ******************************************************************************/
+static int handle_sack(session_t * s, rudp_packet_t * rudp_ack, int size){
+    fec_report_t report;
+    u_int64_t sample;
+    int removed;
+
+    /*An older cumulative ack than one already processed was reordered*/
+    if((int64_t) (get_seq_num(rudp_ack) - s->window.cum_ack) < 0){
+        s->metrics.out_of_order++;
+    }
+    trace_event(TRACE_ACK, s->id, get_seq_num(rudp_ack), size);
+    log_msg(LOG_TRACE, "Received %d byte acknowledgement up to packet %llu\n",
+            size, (unsigned long long) get_seq_num(rudp_ack));
+    sample = update_rtt_echo(&s->rtt, get_echo(rudp_ack));
+    if(sample != 0){
+        record_rtt(&s->metrics, sample);
+        cc_on_rtt_sample(&s->cc, sample, s->rtt.srtt);
+    }
+    if(s->window.fec != NULL &&
+            size >= RUDP_HEAD + (int) sizeof(fec_report_t)){
+        size -= (int) sizeof(fec_report_t);
+        memcpy(&report, rudp_ack->data + (size - RUDP_HEAD),
+               sizeof(fec_report_t));
+        fec_feedback(s->window.fec, ntohl(report.expected),
+                     ntohl(report.lost));
+    }
+    removed = process_ack(&s->window, rudp_ack, size);
+    if(removed == 0){
+        s->metrics.duplicates++;
+    }
+    else {
+        cc_on_ack(&s->cc, (u_int32_t) removed, s->window.in_flight);
+
+        /*Packets sent well before one that was acked are lost*/
+        if(detect_losses(&s->window, s->rtt.srtt / 4) > 0){
+            cc_on_loss(&s->cc, FALSE);
+        }
+    }
+    return removed;
+}
+
+/*******************************************************************************
+ * Handles a datagram (rudp_pkt) of a given size (size) received from the
+ * client at addr. A SYN from a new client opens its file and starts a session,
+ * and any other packet is passed to the client's session: an ACK completes
+ * the handshake or teardown, and a SACK acknowledges data in the window.
+ * Packets that belong to no session, or that carry the id of another session,
+ * are dropped. Returns TRUE if the session has something new to send, else
+ * FALSE.
+ *
+ * @param table - The sessions of the server
+ * @param addr - The address the datagram came from
+ * @param rudp_pkt - The datagram
+ * @param size - The size of the datagram
+ * @return TRUE or FALSE - Whether or not the sender should run
+ ******************************************************************************/
+bool handle_packet(session_table_t * table, struct sockaddr_in * addr,
+                   rudp_packet_t * rudp_pkt, int size){
+    session_t * s;
+    u_int64_t sample;
+
+    if(!check_checksum(rudp_pkt, size)){
+        trace_event(TRACE_BAD_SUM, get_session(rudp_pkt),
+                    get_seq_num(rudp_pkt), size);
+        s = find_session(table, addr);
+        if(s != NULL){
+            s->metrics.bad_checksums++;
+        }
+        return FALSE;
+    }
+    s = find_session(table, addr);
+
+    /*A SYN starts a new session. A repeated SYN means the SYN_ACK was lost*/
+    if(get_type(rudp_pkt) == SYN){
+        if(s == NULL){
+            return open_session(table, addr, rudp_pkt, size) != NULL ?
+                   TRUE : FALSE;
+        }
+        if(s->state == SYN_RCVD){
+            s->ctrl_deadline = 0;
+            return TRUE;
+        }
+        return FALSE;
+    }
+    if(s == NULL || get_session(rudp_pkt) != s->id){
+        trace_event(TRACE_DROP, get_session(rudp_pkt), get_seq_num(rudp_pkt),
+                    size);
+        return FALSE;
+    }
+    s->last_heard = get_time_us();
+    s->metrics.acks++;
+
+    switch(get_type(rudp_pkt)){
+        case ACK:
+            if((s->state != SYN_RCVD && s->state != FIN_WAIT) ||
+                    get_seq_num(rudp_pkt) != get_seq_num(&s->ctrl)){
+                return FALSE;
+            }
+            log_msg(LOG_DEBUG, "\t|-RECEIVED ACKNOWLEDGEMENT\n");
+            sample = update_rtt_echo(&s->rtt, get_echo(rudp_pkt));
+            if(sample != 0){
+                record_rtt(&s->metrics, sample);
+            }
+
+            /*The handshake is complete, so start sending the file, unless
+             * there is no file to send*/
+            if(s->state == SYN_RCVD && s->file != NULL){
+                s->state = TRANSFER;
+                if(s->rtt.has_sample){
+                    cc_on_rtt_sample(&s->cc, s->rtt.srtt, s->rtt.srtt);
+                }
+            }
+            else {
+                s->state = CLOSED;
+            }
+            return TRUE;
+        case SACK:
+            if(s->state != TRANSFER){
+                return FALSE;
+            }
+            return handle_sack(s, rudp_pkt, size) > 0 ? TRUE : FALSE;
+        default:
+            return FALSE;
+    }
+}
+
+/*******************************************************************************
+ * Sends whatever a session (s) has due over the socket (sockfd): the SYN_ACK
+ * or END_SEQ if its timer expired, or the packets in the window. Once the
+ * whole file has been acknowledged, the END_SEQ is sent. Returns the next time
+ * the session has something due, or 0 if it is waiting on the client.
+ *
+ * @param table - The sessions of the server, whose totals are updated
+ * @param s - The session
+ * @param sockfd - The socket to send over
+ * @return deadline - The next time the session must be run (us)
+ ******************************************************************************/
+static u_int64_t run_session(session_table_t * table, session_t * s,
+                             int sockfd){
+    u_int64_t now = get_time_us(), deadline = 0;
+    u_int64_t bytes, packets;
+    char ip[INET_ADDRSTRLEN];
+    end_seq_t end_seq;
+
+    /*Give up on clients that stop answering*/
+    if(s->state != CLOSED && now - s->last_heard > SESSION_IDLE){
+        inet_ntop(AF_INET, &s->addr.sin_addr, ip, sizeof(ip));
+        log_msg(LOG_WARN, "Session %s:%d timed out\n", ip,
+                ntohs(s->addr.sin_port));
+        s->state = CLOSED;
+    }
+
+    if(s->state == TRANSFER){
+
+        /*Update window and send any packets that are due*/
+        advance_window(&s->window);
+        if(!fill_window(&s->window, s->file)){
+            inet_ntop(AF_INET, &s->addr.sin_addr, ip, sizeof(ip));
+            log_msg(LOG_WARN, "Session %s:%d ended, its file could not be "
+                    "read\n", ip, ntohs(s->addr.sin_port));
+            s->state = CLOSED;
+            return 0;
+        }
+        bytes = s->window.bytes_sent;
+        packets = s->window.send_stats.packets;
+        deadline = send_window(&s->window, sockfd,
+                               (struct sockaddr *) &s->addr, &s->rtt, &s->cc);
+        if(s->metrics.first_byte == 0 && s->window.bytes_sent > 0){
+            s->metrics.first_byte = get_time_us();
+        }
+        __atomic_fetch_add(&table->bytes_sent, s->window.bytes_sent - bytes,
+                           __ATOMIC_RELAXED);
+        __atomic_fetch_add(&table->packets_sent,
+                           s->window.send_stats.packets - packets,
+                           __ATOMIC_RELAXED);
+
+        /*Once everything is acknowledged, send END_SEQ packet with the
+         * digest of the file*/
+        if(s->window.eof && is_empty(&s->window)){
+            memset(&end_seq, 0, sizeof(end_seq_t));
+            if(s->window.flags & CHECK_CRC32C){
+                end_seq.digest = htonl(s->window.digest);
+            }
+            init_rudp_packet(&s->ctrl, &end_seq, sizeof(end_seq_t),
+                             s->window.next_seq);
+            set_type(&s->ctrl, END_SEQ);
+            set_session(&s->ctrl, s->id);
+            s->ctrl_size = RUDP_HEAD + (int) sizeof(end_seq_t);
+            s->ctrl_attempts = 0;
+            s->ctrl_deadline = 0;
+            s->state = FIN_WAIT;
+        }
+    }
+
+    if(s->state == SYN_RCVD || s->state == FIN_WAIT){
+        if(s->ctrl_deadline <= now){
+            if(s->ctrl_attempts >= MAX_ATTEMPTS){
+                log_msg(LOG_WARN, "No acknowledgement after %d attempts\n",
+                        MAX_ATTEMPTS);
+                s->state = CLOSED;
+                return 0;
+            }
+            send_ctrl(s, sockfd, now);
+        }
+        deadline = s->ctrl_deadline;
+    }
+
+    /*Wake up in time to notice a silent client*/
+    if(s->state != CLOSED &&
+            (deadline == 0 || deadline > s->last_heard + SESSION_IDLE)){
+        deadline = s->last_heard + SESSION_IDLE;
+    }
+    return deadline;
+}
+
+/*******************************************************************************
+ * Returns TRUE if file reads of some session in the table (table) have
+ * completed since the sessions were last run, so they should be run again,
+ * else FALSE
+ *
+ * @param table - The sessions of the server
+ * @return TRUE or FALSE - Whether or not the sessions should run
+ ******************************************************************************/
+bool sessions_ready(session_table_t * table){
+    return uring_ready(&table->ring);
+}
+
+/*******************************************************************************
+ * Sends whatever each session in the table (table) has due over the socket
+ * (sockfd), and removes sessions that have finished or whose client has gone
+ * silent. The file reads completed since the last run are put into their
+ * windows first, and the reads queued while filling the windows are submitted
+ * together at the end. Returns the earliest time any session has something
+ * due, or 0 if every session is waiting on its client.
+ *
+ * @param table - The sessions of the server
+ * @param sockfd - The socket to send over
+ * @return deadline - The next time the sessions must be run (us)
+ ******************************************************************************/
+u_int64_t run_sessions(session_table_t * table, int sockfd){
+    session_t ** pp = &table->head;
+    session_t * s;
+    u_int64_t deadline, earliest = 0;
+
+    reap_reads(table);
+
+    while(*pp != NULL){
+        s = *pp;
+        deadline = run_session(table, s, sockfd);
+        if(s->state == CLOSED){
+            *pp = s->next;
+            free_session(table, s);
+            continue;
+        }
+        if(deadline != 0 && (earliest == 0 || deadline < earliest)){
+            earliest = deadline;
+        }
+        pp = &s->next;
+    }
+    uring_submit(&table->ring, FALSE);
+    return earliest;
+}
+
+/*******************************************************************************
+ * Closes every session in the table (table) and frees them
+ *
+ * @param table - The table to empty
+ ******************************************************************************/
+void free_sessions(session_table_t * table){
+    session_t * s;
+
+    while(table->head != NULL){
+        s = table->head;
+        table->head = s->next;
+        free_session(table, s);
+    }
+    free_uring(&table->ring);
+}
@@ -0,0 +1,158 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * session.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used by the
+ * server to keep the state of each file transfer (a session) and to find the
+ * session a datagram belongs to from the address of the client that sent it.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_SESSION_H
+#define PROJECT_4_SESSION_H
+
+#include "rudp_packet.h"
+#include "window.h"
+#include "rtt.h"
+#include "congestion.h"
+#include "metrics.h"
+
+#define MAX_SESSIONS 1024   /*Most transfers served at once*/
+#define SESSION_BUCKETS 4096 /*Size of the hash table of sessions*/
+#define SESSION_IDLE 10000000 /*Silence from a client before giving up (us)*/
+
+/*Session states*/
+#define SYN_RCVD 0          /*SYN_ACK sent, waiting for its ACK*/
+#define TRANSFER 1          /*Sending the file*/
+#define FIN_WAIT 2          /*END_SEQ sent, waiting for its ACK*/
+#define CLOSED 3            /*Finished, waiting to be removed*/
+
+/*Settings shared by every session of a server*/
+struct session_opts_t{
+    u_int32_t window_size;          //Number of packets in each window
+    const char *cc_name;            //Congestion control algorithm
+    bool use_map;                   //Send files from a memory mapping
+    u_int64_t initial_rto;          //Timeout before the RTT is measured (us)
+    u_int32_t integrity;            //INTEGRITY_ checks the server may choose
+    int mtu;                        //MTU of every path, or 0 to look up the
+                                    //path MTU to each client
+    u_int32_t fec;                  //FEC_ code to use if the client has it,
+                                    //or 0 for none
+    u_int32_t fec_block;            //Data packets per block of parity
+};
+
+/*Custom struct for a single file transfer. Handshake and teardown packets
+ * (ctrl) are resent on their own timer, while data packets are resent by the
+ * window*/
+struct session_t{
+    struct sockaddr_in addr;        //Address of the client
+    u_int32_t id;                   //Session carried by every packet but
+                                    //the SYN
+    int state;                      //SYN_RCVD, TRANSFER, FIN_WAIT or CLOSED
+    FILE *file;                     //The requested file, or NULL
+    window_t window;                //Data packets being sent
+    rtt_t rtt;                      //RTT estimate of the connection
+    cc_t cc;                        //Congestion controller
+    rudp_packet_t ctrl;             //SYN_ACK or END_SEQ being sent
+    int ctrl_size;                  //Size of the ctrl packet
+    int ctrl_attempts;              //Times the ctrl packet was sent
+    u_int64_t ctrl_deadline;        //Time to resend the ctrl packet (us)
+    u_int64_t last_heard;           //Time the client was last heard from (us)
+    metrics_t metrics;              //Counts of the transfer, started when
+                                    //the SYN arrived
+    struct session_t *hash_next;    //Next session in the same bucket
+    struct session_t *next;         //Next session in the table
+};
+
+/*Custom struct to find sessions by client address. Every session is also on
+ * a single list so the sender can visit each of them. The count and totals
+ * are only changed by the sending thread, with atomic adds, so they may be
+ * read at any time with atomic loads. Files that are not mapped are read
+ * through one io_uring shared by every session, when the kernel has it*/
+struct session_table_t{
+    struct session_t *buckets[SESSION_BUCKETS]; //Sessions by address hash
+    struct session_t *head;         //List of every session
+    u_int32_t count;                //Number of sessions
+    u_int32_t next_id;              //Id of the next session
+    struct session_opts_t opts;     //Settings for new sessions
+    uring_t ring;                   //File reads of every session
+    u_int64_t served;               //Sessions closed so far
+    u_int64_t bytes_sent;           //File data sent by every session
+    u_int64_t packets_sent;         //Datagrams sent by every session
+    metrics_t totals;               //Counts of every closed session
+};
+
+/*Typedefs*/
+typedef struct session_opts_t session_opts_t;
+typedef struct session_t session_t;
+typedef struct session_table_t session_table_t;
+
+/*******************************************************************************
+ * Initializes an empty session table (table) whose sessions use the settings
+ * opts
+ *
+ * @param table - The table to initialize
+ * @param opts - The settings for new sessions
+ ******************************************************************************/
+void init_sessions(session_table_t * table, const session_opts_t * opts);
+
+/*******************************************************************************
+ * Finds the session of the client at addr in the table (table). Returns the
+ * session, or NULL if the client has none.
+ *
+ * @param table - The table to search
+ * @param addr - The address of the client
+ * @return session - The session of the client, or NULL
+ ******************************************************************************/
+session_t * find_session(session_table_t * table, struct sockaddr_in * addr);
+
+/*******************************************************************************
+ * Handles a datagram (rudp_pkt) of a given size (size) received from the
+ * client at addr. A SYN from a new client opens its file and starts a session,
+ * and any other packet is passed to the client's session: an ACK completes
+ * the handshake or teardown, and a SACK acknowledges data in the window.
+ * Packets that belong to no session, or that carry the id of another session,
+ * are dropped. Returns TRUE if the session has something new to send, else
+ * FALSE.
+ *
+ * @param table - The sessions of the server
+ * @param addr - The address the datagram came from
+ * @param rudp_pkt - The datagram
+ * @param size - The size of the datagram
+ * @return TRUE or FALSE - Whether or not the sender should run
+ ******************************************************************************/
+bool handle_packet(session_table_t * table, struct sockaddr_in * addr,
+                   rudp_packet_t * rudp_pkt, int size);
+
+/*******************************************************************************
+ * Returns TRUE if file reads of some session in the table (table) have
+ * completed since the sessions were last run, so they should be run again,
+ * else FALSE
+ *
+ * @param table - The sessions of the server
+ * @return TRUE or FALSE - Whether or not the sessions should run
+ ******************************************************************************/
+bool sessions_ready(session_table_t * table);
+
+/*******************************************************************************
+ * Sends whatever each session in the table (table) has due over the socket
+ * (sockfd), and removes sessions that have finished or whose client has gone
+ * silent. The file reads completed since the last run are put into their
+ * windows first, and the reads queued while filling the windows are submitted
+ * together at the end. Returns the earliest time any session has something
+ * due, or 0 if every session is waiting on its client.
+ *
+ * @param table - The sessions of the server
+ * @param sockfd - The socket to send over
+ * @return deadline - The next time the sessions must be run (us)
+ ******************************************************************************/
+u_int64_t run_sessions(session_table_t * table, int sockfd);
+
+/*******************************************************************************
+ * Closes every session in the table (table) and frees them
+ *
+ * @param table - The table to empty
+ ******************************************************************************/
+void free_sessions(session_table_t * table);
+
+#endif //PROJECT_4_SESSION_H
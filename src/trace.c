@@ -0,0 +1,148 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * trace.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in trace.h
+ ******************************************************************************/
+
+#include "trace.h"
+#include <fcntl.h>
+#include <signal.h>
+
+trace_ring_t trace_ring;
+
+/*******************************************************************************
+ * Writes len bytes of a buffer (buf) to a file (fd), continuing after short
+ * writes. Gives up on an error.
+ *
+ * @param fd - The file to write
+ * @param buf - The bytes to write
+ * @param len - The number of bytes
+ ******************************************************************************/
+static void write_all(int fd, const void * buf, size_t len){
+    const unsigned char * p = buf;
+    ssize_t written;
+
+    while(len > 0){
+        written = write(fd, p, len);
+        if(written <= 0){
+            return;
+        }
+        p += written;
+        len -= (size_t) written;
+    }
+}
+
+/*******************************************************************************
+ * Writes out the trace when the process gets a signal (sig). SIGUSR1 only
+ * writes it, and any other signal then ends the process as it would have.
+ *
+ * @param sig - The signal
+ ******************************************************************************/
+static void on_signal(int sig){
+    dump_trace();
+    if(sig != SIGUSR1){
+        signal(sig, SIG_DFL);
+        raise(sig);
+    }
+}
+
+/*******************************************************************************
+ * Turns tracing on if RUDP_TRACE is set in the environment, naming the file to
+ * write events to. The file is written when the process exits normally, is
+ * interrupted (SIGINT) or terminated (SIGTERM), and whenever it gets SIGUSR1.
+ ******************************************************************************/
+void init_trace(void){
+    const char * env = getenv("RUDP_TRACE");
+    struct sigaction sa;
+
+    if(env == NULL || env[0] == '\0'){
+        return;
+    }
+    trace_ring.events = calloc(TRACE_EVENTS, sizeof(trace_event_t));
+    if(trace_ring.events == NULL){
+        fprintf(stderr, "Could not allocate trace ring\n");
+        exit(1);
+    }
+    trace_ring.mask = TRACE_EVENTS - 1;
+    trace_ring.next = 0;
+    snprintf(trace_ring.path, sizeof(trace_ring.path), "%s", env);
+
+    atexit(dump_trace);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+}
+
+/*******************************************************************************
+ * Records an event of a given type (type) for the packet numbered seq, of size
+ * bytes, in a session (session). Called through trace_event, which checks
+ * that tracing is on.
+ *
+ * @param type - The TRACE_ type of the event
+ * @param session - The session of the packet
+ * @param seq - The sequence number of the packet
+ * @param size - The size of the datagram
+ ******************************************************************************/
+void record_event(u_int8_t type, u_int32_t session, u_int64_t seq, int size){
+    u_int64_t i = __atomic_fetch_add(&trace_ring.next, 1, __ATOMIC_RELAXED);
+    trace_event_t * e = &trace_ring.events[i & trace_ring.mask];
+
+    e->time = get_time_us();
+    e->seq = seq;
+    e->session = session;
+    e->size = (u_int16_t) size;
+    e->type = type;
+    e->reserved = 0;
+}
+
+/*******************************************************************************
+ * Writes the events in the ring to the trace file, oldest first, replacing the
+ * file if it exists. Uses only system calls that are safe in a signal
+ * handler.
+ ******************************************************************************/
+void dump_trace(void){
+    trace_header_t head;
+    u_int64_t next, first;
+    u_int32_t start;
+    int fd;
+
+    if(trace_ring.events == NULL){
+        return;
+    }
+    fd = open(trace_ring.path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0){
+        return;
+    }
+
+    /*Once the ring has wrapped, only the newest TRACE_EVENTS are left*/
+    next = __atomic_load_n(&trace_ring.next, __ATOMIC_ACQUIRE);
+    first = next > TRACE_EVENTS ? next - TRACE_EVENTS : 0;
+    memset(&head, 0, sizeof(head));
+    memcpy(head.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    head.version = TRACE_VERSION;
+    head.event_size = sizeof(trace_event_t);
+    head.count = next - first;
+    head.lost = first;
+    write_all(fd, &head, sizeof(head));
+
+    /*The oldest event may be anywhere in the ring, so write up to the end of
+     * the ring, then from its start*/
+    start = (u_int32_t) (first & trace_ring.mask);
+    if(start + head.count > TRACE_EVENTS){
+        write_all(fd, &trace_ring.events[start],
+                  (TRACE_EVENTS - start) * sizeof(trace_event_t));
+        write_all(fd, trace_ring.events,
+                  (start + head.count - TRACE_EVENTS) * sizeof(trace_event_t));
+    }
+    else {
+        write_all(fd, &trace_ring.events[start],
+                  head.count * sizeof(trace_event_t));
+    }
+    close(fd);
+}
@@ -0,0 +1,106 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * trace.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used to record
+ * what happens to each packet as fixed-size binary events in an in-memory
+ * ring, which is far cheaper than printing it. The ring is written to a file
+ * on exit or on SIGUSR1, and the file is turned back into text offline by
+ * trace_decode. Tracing is off unless RUDP_TRACE is set to the file to write.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_TRACE_H
+#define PROJECT_4_TRACE_H
+
+#include "rudp_packet.h"
+
+#define TRACE_EVENTS 65536  /*Events kept in the ring, a power of two*/
+#define TRACE_MAGIC "RUDPTRC" /*Start of a trace file, with its '\0'*/
+#define TRACE_VERSION 1     /*Version of the trace file format*/
+
+/*Trace event types*/
+#define TRACE_SEND 1        /*Data packet sent for the first time*/
+#define TRACE_RETRANSMIT 2  /*Data packet sent again*/
+#define TRACE_ACK 3         /*SACK sent or received, seq is the ack point*/
+#define TRACE_DROP 4        /*Datagram dropped unsent, or received and
+                             *ignored*/
+#define TRACE_BAD_SUM 5     /*Datagram received with a bad checksum*/
+#define TRACE_RECV 6        /*Data packet received*/
+#define TRACE_PARITY 7      /*Parity packet sent, seq is the block's first*/
+#define TRACE_REBUILD 8     /*Data packet rebuilt from parity*/
+
+/*An event, as kept in the ring and written to the file*/
+struct trace_event_t{
+    u_int64_t time;                 //Time of the event (us)
+    u_int64_t seq;                  //Sequence number of the packet
+    u_int32_t session;              //Session of the packet
+    u_int16_t size;                 //Size of the datagram
+    u_int8_t type;                  //TRACE_ event type
+    u_int8_t reserved;              //Always zero
+};
+
+/*Start of a trace file, followed by count events, oldest first. Everything
+ * is in the byte order of the host that wrote it*/
+struct trace_header_t{
+    char magic[8];                  //TRACE_MAGIC
+    u_int32_t version;              //TRACE_VERSION
+    u_int32_t event_size;           //Size of a trace_event_t
+    u_int64_t count;                //Number of events in the file
+    u_int64_t lost;                 //Older events overwritten in the ring
+};
+
+/*Custom struct for the ring of events. Any thread may record an event: it
+ * claims the next slot with an atomic add and fills it in, so no lock is
+ * taken, and once the ring is full the oldest events are overwritten. An
+ * event being filled in while the ring is written out may be torn*/
+struct trace_ring_t{
+    struct trace_event_t *events;   //The events, or NULL if not tracing
+    u_int64_t next;                 //Number of events ever recorded
+    u_int32_t mask;                 //Number of slots minus 1
+    char path[MAX_LINE];            //File the events are written to
+};
+
+/*Typedefs*/
+typedef struct trace_event_t trace_event_t;
+typedef struct trace_header_t trace_header_t;
+typedef struct trace_ring_t trace_ring_t;
+
+/*The ring of the process*/
+extern trace_ring_t trace_ring;
+
+/*Records an event if tracing is on. The arguments are not evaluated
+ * otherwise*/
+#define trace_event(type, session, seq, size) \
+    do { \
+        if(trace_ring.events != NULL) \
+            record_event(type, session, seq, size); \
+    } while(0)
+
+/*******************************************************************************
+ * Turns tracing on if RUDP_TRACE is set in the environment, naming the file to
+ * write events to. The file is written when the process exits normally, is
+ * interrupted (SIGINT) or terminated (SIGTERM), and whenever it gets SIGUSR1.
+ ******************************************************************************/
+void init_trace(void);
+
+/*******************************************************************************
+ * Records an event of a given type (type) for the packet numbered seq, of size
+ * bytes, in a session (session). Called through trace_event, which checks
+ * that tracing is on.
+ *
+ * @param type - The TRACE_ type of the event
+ * @param session - The session of the packet
+ * @param seq - The sequence number of the packet
+ * @param size - The size of the datagram
+ ******************************************************************************/
+void record_event(u_int8_t type, u_int32_t session, u_int64_t seq, int size);
+
+/*******************************************************************************
+ * Writes the events in the ring to the trace file, oldest first, replacing the
+ * file if it exists. Uses only system calls that are safe in a signal
+ * handler.
+ ******************************************************************************/
+void dump_trace(void);
+
+#endif //PROJECT_4_TRACE_H
@@ -0,0 +1,97 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * Trace Decoder
+ * @author Mark Jannenga
+ *
+ * This program prints a trace file written by the server or client when run
+ * with RUDP_TRACE set, one line per event, with times in seconds from the
+ * first event. A count of each type of event follows. The file must have
+ * been written on a host of the same byte order.
+ ******************************************************************************/
+
+#include "trace.h"
+#include <stdint.h>
+
+#define EVENT_TYPES 9       /*One more than the highest TRACE_ type*/
+
+/*Names of the event types, indexed by type*/
+static const char * event_names[EVENT_TYPES] = {"UNKNOWN", "SEND",
+                                                "RETRANSMIT", "ACK", "DROP",
+                                                "BAD_CHECKSUM", "RECV",
+                                                "PARITY", "REBUILD"};
+
+/*******************************************************************************
+ * Trace decoder main method. Expects the name of a trace file as a command
+ * line argument.
+ *
+ * @param argc
+ * @param argv - [Trace file]
+ * @return
+ ******************************************************************************/
+int main(int argc, char **argv){
+    FILE * fd;
+    trace_header_t head;
+    trace_event_t event;
+    u_int64_t counts[EVENT_TYPES], i, first = 0;
+    int type;
+
+    /*Check command line arguments*/
+    if(argc != 2){
+        fprintf(stderr, "Usage: %s [Trace file]\n", argv[0]);
+        exit(1);
+    }
+    fd = fopen(argv[1], "rb");
+    if(fd == NULL){
+        fprintf(stderr, "Could not open %s\n", argv[1]);
+        exit(1);
+    }
+
+    /*Check that this is a trace file this program can read*/
+    if(fread(&head, sizeof(head), 1, fd) != 1 ||
+            memcmp(head.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0){
+        fprintf(stderr, "%s is not a trace file\n", argv[1]);
+        exit(1);
+    }
+    if(head.version != TRACE_VERSION ||
+            head.event_size != sizeof(trace_event_t)){
+        fprintf(stderr, "%s is trace version %u with %u byte events, "
+                "expected version %d with %d byte events\n", argv[1],
+                head.version, head.event_size, TRACE_VERSION,
+                (int) sizeof(trace_event_t));
+        exit(1);
+    }
+    if(head.lost > 0){
+        fprintf(stdout, "%llu older events were overwritten\n",
+                (unsigned long long) head.lost);
+    }
+
+    /*Print each event*/
+    memset(counts, 0, sizeof(counts));
+    for(i = 0; i < head.count; i++){
+        if(fread(&event, sizeof(event), 1, fd) != 1){
+            fprintf(stderr, "Trace ends after %llu of %llu events\n",
+                    (unsigned long long) i, (unsigned long long) head.count);
+            break;
+        }
+        if(i == 0){
+            first = event.time;
+        }
+        type = event.type < EVENT_TYPES ? event.type : 0;
+        counts[type]++;
+        fprintf(stdout, "%12.6f %-12s session 0x%08x seq %llu, %u bytes\n",
+                (double) (int64_t) (event.time - first) / 1e6,
+                event_names[type], event.session,
+                (unsigned long long) event.seq, event.size);
+    }
+
+    /*Summarize*/
+    fprintf(stdout, "\n");
+    for(type = 0; type < EVENT_TYPES; type++){
+        if(counts[type] > 0){
+            fprintf(stdout, "%-12s %llu\n", event_names[type],
+                    (unsigned long long) counts[type]);
+        }
+    }
+    fclose(fd);
+    return 0;
+}
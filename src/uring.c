@@ -0,0 +1,348 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * uring.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in uring.h
+ ******************************************************************************/
+
+#include "uring.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <stdint.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+/*******************************************************************************
+ * Maps a region (offset) of the io_uring (fd) of len bytes. Returns the
+ * mapping, or NULL if it failed.
+ *
+ * @param fd - The io_uring
+ * @param len - The size of the region
+ * @param offset - The IORING_OFF_ region to map
+ * @return map - The mapping, or NULL
+ ******************************************************************************/
+static void * map_region(int fd, size_t len, off_t offset){
+    void * map = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, offset);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+/*******************************************************************************
+ * Creates an io_uring (ring) with room for URING_ENTRIES operations. Returns
+ * TRUE if the ring can be used, or FALSE if the kernel lacks io_uring, does
+ * not allow it, or RUDP_IO_URING=0 is set in the environment, in which case
+ * the ring is left unused and the caller should use ordinary I/O.
+ *
+ * @param ring - The ring to create
+ * @return TRUE or FALSE - Whether or not the ring can be used
+ ******************************************************************************/
+bool init_uring(uring_t * ring){
+    const char * env = getenv("RUDP_IO_URING");
+    struct io_uring_params p;
+    unsigned char *sq, *cq;
+
+    memset(ring, 0, sizeof(uring_t));
+    ring->fd = -1;
+    if(env != NULL && strcmp(env, "0") == 0){
+        return FALSE;
+    }
+
+    memset(&p, 0, sizeof(p));
+    ring->fd = (int) syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if(ring->fd < 0){
+        ring->fd = -1;
+        return FALSE;
+    }
+
+    /*Newer kernels put both queues in one mapping*/
+    ring->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_map_len = p.cq_off.cqes +
+                       p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP){
+        if(ring->cq_map_len > ring->sq_map_len){
+            ring->sq_map_len = ring->cq_map_len;
+        }
+        ring->cq_map_len = 0;
+    }
+    ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    ring->sq_map = map_region(ring->fd, ring->sq_map_len, IORING_OFF_SQ_RING);
+    if(ring->cq_map_len > 0){
+        ring->cq_map = map_region(ring->fd, ring->cq_map_len,
+                                  IORING_OFF_CQ_RING);
+    }
+    ring->sqes = map_region(ring->fd, ring->sqes_len, IORING_OFF_SQES);
+    if(ring->sq_map == NULL || ring->sqes == NULL ||
+            (ring->cq_map_len > 0 && ring->cq_map == NULL)){
+        free_uring(ring);
+        return FALSE;
+    }
+
+    sq = ring->sq_map;
+    cq = ring->cq_map != NULL ? ring->cq_map : ring->sq_map;
+    ring->sq_head = (unsigned *) (sq + p.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + p.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + p.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    ring->cqes = cq + p.cq_off.cqes;
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Has the kernel write to an eventfd (efd) whenever an operation on the ring
+ * (ring) completes, so a thread waiting on other descriptors wakes for it.
+ * Returns TRUE if the eventfd was registered, else FALSE.
+ *
+ * @param ring - The ring
+ * @param efd - The eventfd to write to
+ * @return TRUE or FALSE - Whether or not the eventfd was registered
+ ******************************************************************************/
+bool uring_notify(uring_t * ring, int efd){
+    if(ring->fd < 0){
+        return FALSE;
+    }
+    return syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_EVENTFD,
+                   &efd, 1) == 0 ? TRUE : FALSE;
+}
+
+/*******************************************************************************
+ * Queues an operation (opcode) on a file (fd) with the given buffer (addr),
+ * length (len) and file offset (offset). Returns FALSE if URING_ENTRIES
+ * operations are already in flight.
+ *
+ * @param ring - The ring
+ * @param opcode - The IORING_OP_ operation
+ * @param fd - The file
+ * @param addr - The buffer, or iovec array
+ * @param len - The size of the buffer, or number of iovecs
+ * @param offset - The offset in the file
+ * @param user_data - A value returned with the result
+ * @return TRUE or FALSE - Whether or not the operation was queued
+ ******************************************************************************/
+static bool queue_op(uring_t * ring, u_int8_t opcode, int fd,
+                     const void * addr, u_int32_t len, u_int64_t offset,
+                     u_int64_t user_data){
+    struct io_uring_sqe * sqe;
+    unsigned tail, index;
+
+    /*The submission queue has URING_ENTRIES entries, so it cannot be full*/
+    if(ring->fd < 0 || ring->in_flight >= URING_ENTRIES){
+        return FALSE;
+    }
+    tail = *ring->sq_tail;
+    index = tail & *ring->sq_mask;
+    sqe = &((struct io_uring_sqe *) ring->sqes)[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (u_int64_t) (uintptr_t) addr;
+    sqe->len = len;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+
+    /*The entry must be written before the kernel can see the new tail*/
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->queued++;
+    ring->in_flight++;
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Queues a read of len bytes at a given offset (offset) of a file (fd) into
+ * a buffer (buf). The result is reaped with uring_reap along with user_data.
+ * Returns FALSE, queuing nothing, if URING_ENTRIES operations are already in
+ * flight.
+ *
+ * @param ring - The ring
+ * @param fd - The file to read
+ * @param buf - The buffer to read into
+ * @param len - The number of bytes to read
+ * @param offset - The offset in the file to read from
+ * @param user_data - A value returned with the result
+ * @return TRUE or FALSE - Whether or not the read was queued
+ ******************************************************************************/
+bool uring_read(uring_t * ring, int fd, void * buf, u_int32_t len,
+                u_int64_t offset, u_int64_t user_data){
+    return queue_op(ring, IORING_OP_READ, fd, buf, len, offset, user_data);
+}
+
+/*******************************************************************************
+ * Queues a gathering write of iov_len buffers (iov) at a given offset (offset)
+ * of a file (fd). The buffers, and the iovec array itself, must stay valid
+ * until the result is reaped with uring_reap along with user_data. Returns
+ * FALSE, queuing nothing, if URING_ENTRIES operations are already in flight.
+ *
+ * @param ring - The ring
+ * @param fd - The file to write
+ * @param iov - The buffers to write
+ * @param iov_len - The number of buffers
+ * @param offset - The offset in the file to write to
+ * @param user_data - A value returned with the result
+ * @return TRUE or FALSE - Whether or not the write was queued
+ ******************************************************************************/
+bool uring_writev(uring_t * ring, int fd, const struct iovec * iov,
+                  int iov_len, u_int64_t offset, u_int64_t user_data){
+    return queue_op(ring, IORING_OP_WRITEV, fd, iov, (u_int32_t) iov_len,
+                    offset, user_data);
+}
+
+/*******************************************************************************
+ * Submits every queued operation to the kernel with one system call, and, if
+ * wait is TRUE, blocks until at least one operation has completed.
+ *
+ * @param ring - The ring
+ * @param wait - Whether or not to wait for a completion
+ ******************************************************************************/
+void uring_submit(uring_t * ring, bool wait){
+    int ret;
+
+    /*Nothing can complete if nothing is in flight*/
+    if(ring->fd < 0 || ring->in_flight == 0 ||
+            (ring->queued == 0 && (!wait || uring_ready(ring)))){
+        return;
+    }
+
+    do {
+        ret = (int) syscall(__NR_io_uring_enter, ring->fd, ring->queued,
+                            wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0,
+                            NULL, 0);
+    } while(ret < 0 && errno == EINTR);
+
+    /*Operations the kernel did not take stay queued for the next call*/
+    if(ret > 0){
+        record_io(&ring->stats, ret);
+        ring->queued -= (u_int32_t) ret;
+    }
+}
+
+/*******************************************************************************
+ * Takes the result of a completed operation from the ring (ring), without
+ * blocking. The result (res) is the byte count of the read or write, or a
+ * negative errno. Returns FALSE if no operation has completed.
+ *
+ * @param ring - The ring
+ * @param user_data - Set to the value given when the operation was queued
+ * @param res - Set to the result of the operation
+ * @return TRUE or FALSE - Whether or not a result was taken
+ ******************************************************************************/
+bool uring_reap(uring_t * ring, u_int64_t * user_data, int * res){
+    struct io_uring_cqe * cqe;
+    unsigned head;
+
+    if(!uring_ready(ring)){
+        return FALSE;
+    }
+    head = *ring->cq_head;
+    cqe = &((struct io_uring_cqe *) ring->cqes)[head & *ring->cq_mask];
+    *user_data = cqe->user_data;
+    *res = cqe->res;
+
+    /*The entry must be read before the kernel may reuse it*/
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    ring->in_flight--;
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Returns TRUE if the ring (ring) has results waiting to be reaped, else FALSE
+ *
+ * @param ring - The ring
+ * @return TRUE or FALSE - Whether or not uring_reap would take a result
+ ******************************************************************************/
+bool uring_ready(uring_t * ring){
+    if(ring->fd < 0){
+        return FALSE;
+    }
+    return *ring->cq_head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) ?
+           TRUE : FALSE;
+}
+
+/*******************************************************************************
+ * Closes the ring (ring), keeping its stats. Any operations in flight must
+ * have been reaped.
+ *
+ * @param ring - The ring to close
+ ******************************************************************************/
+void free_uring(uring_t * ring){
+    io_stats_t stats = ring->stats;
+
+    if(ring->sqes != NULL){
+        munmap(ring->sqes, ring->sqes_len);
+    }
+    if(ring->cq_map != NULL){
+        munmap(ring->cq_map, ring->cq_map_len);
+    }
+    if(ring->sq_map != NULL){
+        munmap(ring->sq_map, ring->sq_map_len);
+    }
+    if(ring->fd >= 0){
+        close(ring->fd);
+    }
+    memset(ring, 0, sizeof(uring_t));
+    ring->fd = -1;
+    ring->stats = stats;
+}
+
+#else
+
+/*Without io_uring headers every ring is unused, so callers use ordinary
+ * I/O*/
+bool init_uring(uring_t * ring){
+    memset(ring, 0, sizeof(uring_t));
+    ring->fd = -1;
+    return FALSE;
+}
+
+bool uring_notify(uring_t * ring, int efd){
+    return FALSE;
+}
+
+bool uring_read(uring_t * ring, int fd, void * buf, u_int32_t len,
+                u_int64_t offset, u_int64_t user_data){
+    return FALSE;
+}
+
+bool uring_writev(uring_t * ring, int fd, const struct iovec * iov,
+                  int iov_len, u_int64_t offset, u_int64_t user_data){
+    return FALSE;
+}
+
+void uring_submit(uring_t * ring, bool wait){
+}
+
+bool uring_reap(uring_t * ring, u_int64_t * user_data, int * res){
+    return FALSE;
+}
+
+bool uring_ready(uring_t * ring){
+    return FALSE;
+}
+
+void free_uring(uring_t * ring){
+    ring->fd = -1;
+}
+
+#endif
+
+/*******************************************************************************
+ * Returns TRUE if the ring (ring) was created by init_uring, else FALSE
+ *
+ * @param ring - The ring
+ * @return TRUE or FALSE - Whether or not the ring is in use
+ ******************************************************************************/
+bool uring_active(uring_t * ring){
+    return ring->fd >= 0 ? TRUE : FALSE;
+}
@@ -0,0 +1,151 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * uring.h header file
+ * @author Mark Jannenga
+ *
+ * Defines constants and custom structs and declares functions used to queue
+ * file reads and writes on an io_uring, so disk I/O runs in the background
+ * while packets are sent and received, and many operations are submitted
+ * with one system call. The ring is driven with raw system calls, so no
+ * library is needed. Kernels without io_uring, or where it is not allowed,
+ * make init_uring fail, and callers fall back to ordinary reads and writes.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_URING_H
+#define PROJECT_4_URING_H
+
+#include "rudp_packet.h"
+#include <sys/uio.h>
+
+#define URING_ENTRIES 256   /*Operations in flight on a ring at once*/
+
+/*Custom struct for an io_uring. The submission and completion queues are
+ * shared with the kernel, which reads the submission tail and writes the
+ * completion tail. Operations are only queued while fewer than URING_ENTRIES
+ * are in flight, so the completion queue can never overflow*/
+struct uring_t{
+    int fd;                         //The io_uring, or -1 if not in use
+    unsigned *sq_head;              //Submissions consumed by the kernel
+    unsigned *sq_tail;              //Submissions queued
+    unsigned *sq_mask;              //Submission queue entries minus 1
+    unsigned *sq_array;             //Index of the entry of each submission
+    unsigned *cq_head;              //Completions reaped
+    unsigned *cq_tail;              //Completions posted by the kernel
+    unsigned *cq_mask;              //Completion queue entries minus 1
+    void *sqes;                     //Submission queue entries
+    void *cqes;                     //Completion queue entries
+    void *sq_map;                   //Mapping of the submission queue
+    void *cq_map;                   //Mapping of the completion queue
+    size_t sq_map_len;              //Size of the submission queue mapping
+    size_t cq_map_len;              //Size of the completion queue mapping
+    size_t sqes_len;                //Size of the entry mapping
+    u_int32_t queued;               //Operations not yet submitted
+    u_int32_t in_flight;            //Operations not yet reaped
+    io_stats_t stats;               //Operations per io_uring_enter call
+};
+
+/*Typedefs*/
+typedef struct uring_t uring_t;
+
+/*******************************************************************************
+ * Creates an io_uring (ring) with room for URING_ENTRIES operations. Returns
+ * TRUE if the ring can be used, or FALSE if the kernel lacks io_uring, does
+ * not allow it, or RUDP_IO_URING=0 is set in the environment, in which case
+ * the ring is left unused and the caller should use ordinary I/O.
+ *
+ * @param ring - The ring to create
+ * @return TRUE or FALSE - Whether or not the ring can be used
+ ******************************************************************************/
+bool init_uring(uring_t * ring);
+
+/*******************************************************************************
+ * Returns TRUE if the ring (ring) was created by init_uring, else FALSE
+ *
+ * @param ring - The ring
+ * @return TRUE or FALSE - Whether or not the ring is in use
+ ******************************************************************************/
+bool uring_active(uring_t * ring);
+
+/*******************************************************************************
+ * Has the kernel write to an eventfd (efd) whenever an operation on the ring
+ * (ring) completes, so a thread waiting on other descriptors wakes for it.
+ * Returns TRUE if the eventfd was registered, else FALSE.
+ *
+ * @param ring - The ring
+ * @param efd - The eventfd to write to
+ * @return TRUE or FALSE - Whether or not the eventfd was registered
+ ******************************************************************************/
+bool uring_notify(uring_t * ring, int efd);
+
+/*******************************************************************************
+ * Queues a read of len bytes at a given offset (offset) of a file (fd) into
+ * a buffer (buf). The result is reaped with uring_reap along with user_data.
+ * Returns FALSE, queuing nothing, if URING_ENTRIES operations are already in
+ * flight.
+ *
+ * @param ring - The ring
+ * @param fd - The file to read
+ * @param buf - The buffer to read into
+ * @param len - The number of bytes to read
+ * @param offset - The offset in the file to read from
+ * @param user_data - A value returned with the result
+ * @return TRUE or FALSE - Whether or not the read was queued
+ ******************************************************************************/
+bool uring_read(uring_t * ring, int fd, void * buf, u_int32_t len,
+                u_int64_t offset, u_int64_t user_data);
+
+/*******************************************************************************
+ * Queues a gathering write of iov_len buffers (iov) at a given offset (offset)
+ * of a file (fd). The buffers, and the iovec array itself, must stay valid
+ * until the result is reaped with uring_reap along with user_data. Returns
+ * FALSE, queuing nothing, if URING_ENTRIES operations are already in flight.
+ *
+ * @param ring - The ring
+ * @param fd - The file to write
+ * @param iov - The buffers to write
+ * @param iov_len - The number of buffers
+ * @param offset - The offset in the file to write to
+ * @param user_data - A value returned with the result
+ * @return TRUE or FALSE - Whether or not the write was queued
+ ******************************************************************************/
+bool uring_writev(uring_t * ring, int fd, const struct iovec * iov,
+                  int iov_len, u_int64_t offset, u_int64_t user_data);
+
+/*******************************************************************************
+ * Submits every queued operation to the kernel with one system call, and, if
+ * wait is TRUE, blocks until at least one operation has completed.
+ *
+ * @param ring - The ring
+ * @param wait - Whether or not to wait for a completion
+ ******************************************************************************/
+void uring_submit(uring_t * ring, bool wait);
+
+/*******************************************************************************
+ * Takes the result of a completed operation from the ring (ring), without
+ * blocking. The result (res) is the byte count of the read or write, or a
+ * negative errno. Returns FALSE if no operation has completed.
+ *
+ * @param ring - The ring
+ * @param user_data - Set to the value given when the operation was queued
+ * @param res - Set to the result of the operation
+ * @return TRUE or FALSE - Whether or not a result was taken
+ ******************************************************************************/
+bool uring_reap(uring_t * ring, u_int64_t * user_data, int * res);
+
+/*******************************************************************************
+ * Returns TRUE if the ring (ring) has results waiting to be reaped, else FALSE
+ *
+ * @param ring - The ring
+ * @return TRUE or FALSE - Whether or not uring_reap would take a result
+ ******************************************************************************/
+bool uring_ready(uring_t * ring);
+
+/*******************************************************************************
+ * Closes the ring (ring), keeping its stats. Any operations in flight must
+ * have been reaped.
+ *
+ * @param ring - The ring to close
+ ******************************************************************************/
+void free_uring(uring_t * ring);
+
+#endif //PROJECT_4_URING_H
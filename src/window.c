@@ -7,25 +7,494 @@
  ******************************************************************************/
 
 #include "window.h"
+#include "crc32c.h"
+#include "log.h"
+#include "trace.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <errno.h>
+#include <signal.h>
+
+#define BATCH_IOV 2         /*Buffers per datagram: header and mapped data*/
+
+static int map_guarded;     /*Whether on_sigbus has been installed*/
+static long map_page;       /*Size of a page, for on_sigbus*/
+
+/*******************************************************************************
+ * Handles a SIGBUS raised by reading a page of a mapped file past its end,
+ * which happens if the file is truncated while it is being sent. The page is
+ * replaced with a page of zeros and the read is retried, so only the session
+ * sending that file fails, once fill_window sees that the file has shrunk.
+ * The server maps no other files, so any other SIGBUS kills it as usual.
+ *
+ * @param sig - SIGBUS
+ * @param info - The cause and address of the fault
+ * @param context - Unused
+ ******************************************************************************/
+static void on_sigbus(int sig, siginfo_t * info, void * context){
+    uintptr_t page;
+
+    (void) context;
+    if(info->si_code == BUS_ADRERR){
+        page = (uintptr_t) info->si_addr & ~(uintptr_t) (map_page - 1);
+        if(mmap((void *) page, (size_t) map_page, PROT_READ,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) !=
+                MAP_FAILED){
+            return;
+        }
+    }
+    signal(sig, SIG_DFL);
+}
+
+/*******************************************************************************
+ * Installs on_sigbus the first time a file is mapped
+ ******************************************************************************/
+static void guard_mappings(void){
+    struct sigaction sa;
+
+    if(__atomic_exchange_n(&map_guarded, 1, __ATOMIC_ACQ_REL)){
+        return;
+    }
+    map_page = sysconf(_SC_PAGESIZE);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = on_sigbus;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGBUS, &sa, NULL);
+}
+
+/*******************************************************************************
+ * Removes a slot (slot) from the window's (window) retransmission list
+ *
+ * @param window - The window the slot belongs to
+ * @param slot - The index of the slot to remove
+ ******************************************************************************/
+static void timer_unlink(window_t * window, u_int32_t slot){
+    window_slot_t * s = &window->slots[slot];
+
+    if(s->prev != NO_SLOT)
+        window->slots[s->prev].next = s->next;
+    else if(window->timer_head == slot)
+        window->timer_head = s->next;
+
+    if(s->next != NO_SLOT)
+        window->slots[s->next].prev = s->prev;
+    else if(window->timer_tail == slot)
+        window->timer_tail = s->prev;
+
+    s->prev = NO_SLOT;
+    s->next = NO_SLOT;
+}
+
+/*******************************************************************************
+ * Appends a slot (slot) to the end of the window's (window) retransmission
+ * list. Since the timeout changes slowly, the list stays ordered by deadline
+ * closely enough as long as packets are appended when they are sent.
+ *
+ * @param window - The window the slot belongs to
+ * @param slot - The index of the slot to append
+ ******************************************************************************/
+static void timer_append(window_t * window, u_int32_t slot){
+    window_slot_t * s = &window->slots[slot];
+
+    s->prev = window->timer_tail;
+    s->next = NO_SLOT;
+    if(window->timer_tail != NO_SLOT)
+        window->slots[window->timer_tail].next = slot;
+    else
+        window->timer_head = slot;
+    window->timer_tail = slot;
+}
+
+/*******************************************************************************
+ * Passes every packet waiting in the window's (window) batch to the kernel over
+ * the specified socket (sockfd), using as few sendmmsg calls as possible. A
+ * packet the kernel refuses is left for its retransmission timer.
+ *
+ * @param window - The window whose batch is sent
+ * @param sockfd - The socket to send the packets over
+ ******************************************************************************/
+static void flush_batch(window_t * window, int sockfd){
+    rudp_packet_t * rudp_pkt;
+    int sent = 0, n;
+
+    while(sent < window->batch_len){
+        n = sendmmsg(sockfd, window->batch + sent,
+                     (unsigned int) (window->batch_len - sent), 0);
+        if(n <= 0){
+            log_msg(LOG_WARN, "sendmmsg failed, %d packets dropped\n",
+                    window->batch_len - sent);
+            for(; sent < window->batch_len; sent++){
+                rudp_pkt = window->batch[sent].msg_hdr.msg_iov[0].iov_base;
+                trace_event(TRACE_DROP, window->session,
+                            get_seq_num(rudp_pkt),
+                            RUDP_HEAD + get_length(rudp_pkt));
+            }
+            break;
+        }
+        record_io(&window->send_stats, n);
+        sent += n;
+    }
+    window->batch_len = 0;
+
+    /*No parity is left in the batch, so every set may be refilled*/
+    if(window->fec != NULL){
+        memset(window->fec->queued, 0, sizeof(window->fec->queued));
+    }
+}
+
+/*******************************************************************************
+ * Queues the packet in a slot (slot) of the window (window) to be sent and
+ * restarts its retransmission timer. The batch is sent once it is full.
+ *
+ * @param window - The window the slot belongs to
+ * @param slot - The index of the slot to send
+ * @param sockfd - The socket to send the packet over
+ * @param clientaddr - The destination to send the packet to
+ * @param rto - The retransmission timeout (us)
+ ******************************************************************************/
+static void send_slot(window_t * window, u_int32_t slot, int sockfd,
+                      struct sockaddr * clientaddr, u_int64_t rto){
+    window_slot_t * s = &window->slots[slot];
+    struct msghdr * msg = &window->batch[window->batch_len].msg_hdr;
+
+    /*The data was checksummed when the packet was made, so only the new
+     * timestamp in the header has to be added*/
+    set_timestamp(s->packet, (u_int32_t) get_time_us());
+    set_checksum(s->packet, 0);
+    set_checksum(s->packet, header_checksum(s->packet, s->payload_check));
+    trace_event(s->sends == 0 ? TRACE_SEND : TRACE_RETRANSMIT,
+                window->session, get_seq_num(s->packet), s->size);
+    log_msg(LOG_TRACE, "\n%s %d byte packet\n",
+            s->sends == 0 ? "Sending" : "Resending", s->size);
+    if(log_enabled(LOG_TRACE)){
+        print_rudp_header(s->packet, TRUE);
+    }
+
+    if(s->payload != NULL){
+
+        /*Gather the header and the data in the mapping into one datagram*/
+        msg->msg_iov[0].iov_base = s->packet;
+        msg->msg_iov[0].iov_len = (size_t) RUDP_HEAD;
+        msg->msg_iov[1].iov_base = (void *) s->payload;
+        msg->msg_iov[1].iov_len = (size_t) (s->size - RUDP_HEAD);
+        msg->msg_iovlen = 2;
+    }
+    else {
+        msg->msg_iov[0].iov_base = s->packet;
+        msg->msg_iov[0].iov_len = (size_t) s->size;
+        msg->msg_iovlen = 1;
+    }
+
+    /*Add the packet to the batch*/
+    window->batch[window->batch_len].msg_hdr.msg_name = clientaddr;
+    window->batch[window->batch_len].msg_hdr.msg_namelen =
+            sizeof(struct sockaddr_in);
+    window->batch_len++;
+    if(window->batch_len == BATCH_SIZE){
+        flush_batch(window, sockfd);
+    }
+
+    /*The timer starts when the packet actually leaves, not when the window
+     * started sending, since sending a large window takes a while*/
+    if(s->sends == 0){
+        window->in_flight++;
+    }
+    else {
+        window->retransmits++;
+    }
+    s->sends++;
+    s->sent = get_time_us();
+    s->deadline = s->sent + rto;
+    timer_unlink(window, slot);
+    timer_append(window, slot);
+}
+
+/*******************************************************************************
+ * Adds the packet just sent for the first time from a slot (slot) of the
+ * window (window) to the parity of its block, and if that finishes the block
+ * queues its parity packets to be sent after it. Parity is sent once and is
+ * not held in the window, but is counted by the congestion controller (cc).
+ * Loss detection of the block's packets is put off until something sent after
+ * the parity is acknowledged, so lost packets the parity can rebuild are not
+ * resent as well. They are moved to the end of the retransmission list, so it
+ * stays in the order packets were sent.
+ *
+ * @param window - The window the slot belongs to
+ * @param slot - The index of the slot just sent
+ * @param sockfd - The socket to send the parity over
+ * @param clientaddr - The destination to send the parity to
+ * @param cc - The congestion controller of the connection
+ * @param now - The current time (us)
+ ******************************************************************************/
+static void send_parity(window_t * window, u_int32_t slot, int sockfd,
+                        struct sockaddr * clientaddr, cc_t * cc,
+                        u_int64_t now){
+    fec_encoder_t * enc = window->fec;
+    window_slot_t * s = &window->slots[slot];
+    u_int64_t seq = get_seq_num(s->packet), i;
+    u_int32_t parity, row;
+    rudp_packet_t * pkt;
+    struct msghdr * msg;
+    bool last;
+
+    /*A new block refills a set of parity, which may still be in the batch*/
+    if(seq % enc->block == 0 && enc->queued[enc->set]){
+        flush_batch(window, sockfd);
+    }
+    last = window->eof && seq + 1 == window->next_seq ? TRUE : FALSE;
+    parity = encode_packet(enc, seq, s->payload != NULL ? s->payload :
+                           s->packet->data, s->size - RUDP_HEAD, last);
+    if(parity == 0){
+        return;
+    }
+
+    for(row = 0; row < parity; row++){
+        pkt = get_parity(enc, row);
+        set_flags(pkt, window->flags);
+        set_session(pkt, window->session);
+        stamp_packet(pkt, enc->packet_size);
+        trace_event(TRACE_PARITY, window->session, get_seq_num(pkt),
+                    enc->packet_size);
+
+        msg = &window->batch[window->batch_len].msg_hdr;
+        msg->msg_iov[0].iov_base = pkt;
+        msg->msg_iov[0].iov_len = (size_t) enc->packet_size;
+        msg->msg_iovlen = 1;
+        msg->msg_name = clientaddr;
+        msg->msg_namelen = sizeof(struct sockaddr_in);
+        window->batch_len++;
+        if(window->batch_len == BATCH_SIZE){
+            flush_batch(window, sockfd);
+        }
+        cc_on_send(cc, enc->packet_size, now);
+    }
+    enc->queued[enc->ready] = TRUE;
+    window->parity_sent += parity;
+
+    /*The deadlines move with the send times, so the list stays ordered by
+     * deadline as well*/
+    now = get_time_us();
+    for(i = enc->first; i != enc->first + enc->count; i++){
+        slot = (u_int32_t) (i % window->capacity);
+        s = &window->slots[slot];
+        if(s->packet != NULL && get_seq_num(s->packet) == i &&
+                s->sends == 1){
+            if(s->deadline != 0){
+                s->deadline += now - s->sent;
+            }
+            s->sent = now;
+            timer_unlink(window, slot);
+            timer_append(window, slot);
+        }
+    }
+}
+
+/*******************************************************************************
+ * Adds the data of the next packet of the file, whose payload_check is check
+ * and whose length is len, to the digest of the window (window), if the file
+ * is being checked with CRC32C. The CRC of the data is combined with the
+ * digest, so the data is not read again.
+ *
+ * @param window - The window whose digest is updated
+ * @param check - The payload_check of the packet's data
+ * @param len - The length of the packet's data
+ ******************************************************************************/
+static void add_digest(window_t * window, u_int32_t check, int len){
+    if(!(window->flags & CHECK_CRC32C)){
+        return;
+    }
+    if(len == (int) window->payload){
+        window->digest = crc32c_combine_op(window->digest, check,
+                                           window->digest_shift);
+    }
+    else {
+        window->digest = crc32c_combine(window->digest, check, (size_t) len);
+    }
+}
 
 /*******************************************************************************
- * Initializes an empty window (window)
+ * Initializes an empty window (window) able to hold capacity packets, each
+ * carrying up to payload bytes of the file. All of the packets are allocated
+ * up front in a pool owned by the window, so a transfer makes no further
+ * allocations. With large payloads the capacity is reduced so that the window
+ * never holds more than MAX_WINDOW_BYTES of data.
  *
  * @param window - The window to initialize
+ * @param capacity - The number of packets the window can hold
+ * @param payload - The size of the data segment of each packet
+ ******************************************************************************/
+void init_window(window_t * window, u_int32_t capacity, u_int32_t payload){
+    u_int32_t i;
+
+    if(capacity == 0 || capacity > MAX_WINDOW){
+        capacity = DEFAULT_WINDOW;
+    }
+    if(payload == 0 || payload > MAX_PAYLOAD){
+        payload = RUDP_DATA;
+    }
+    if((u_int64_t) capacity * payload > MAX_WINDOW_BYTES){
+        capacity = MAX_WINDOW_BYTES / payload;
+    }
+
+    window->slots = calloc(capacity, sizeof(window_slot_t));
+    window->batch = calloc(BATCH_SIZE, sizeof(struct mmsghdr));
+    window->batch_iov = calloc(BATCH_SIZE * BATCH_IOV, sizeof(struct iovec));
+    if(window->slots == NULL || window->batch == NULL ||
+            window->batch_iov == NULL){
+        fprintf(stderr, "Could not allocate %u packet window\n", capacity);
+        exit(1);
+    }
+    for(i = 0; i < capacity; i++){
+        window->slots[i].prev = NO_SLOT;
+        window->slots[i].next = NO_SLOT;
+    }
+    for(i = 0; i < BATCH_SIZE; i++){
+        window->batch[i].msg_hdr.msg_iov = &window->batch_iov[i * BATCH_IOV];
+        window->batch[i].msg_hdr.msg_iovlen = 1;
+    }
+    window->batch_len = 0;
+    memset(&window->send_stats, 0, sizeof(io_stats_t));
+    window->bytes_sent = 0;
+    window->retransmits = 0;
+    init_pool(&window->pool, capacity, (size_t) (RUDP_HEAD + payload));
+    window->map = NULL;
+    window->map_len = 0;
+    window->map_off = 0;
+    window->eof = FALSE;
+    window->flags = 0;
+    window->session = 0;
+    window->digest = 0;
+    window->digest_shift = crc32c_shift(payload);
+    window->ring = NULL;
+    window->read_fd = -1;
+    window->file_size = 0;
+    window->read_next = 0;
+    window->reads = 0;
+    window->read_reqs = NULL;
+    window->fec = NULL;
+    window->parity_sent = 0;
+
+    window->capacity = capacity;
+    window->payload = payload;
+    window->base = 0;
+    window->next_seq = 0;
+    window->next_send = 0;
+    window->cum_ack = 0;
+    window->count = 0;
+    window->in_flight = 0;
+    window->newest_acked = 0;
+    window->timer_head = NO_SLOT;
+    window->timer_tail = NO_SLOT;
+}
+
+/*******************************************************************************
+ * Frees any packets left in the window (window) and the ring buffer itself
+ *
+ * @param window - The window to free
  ******************************************************************************/
-void init_window(window_t * window){
-    int i;
-    for(i = 0; i < WINDOW_SIZE; i++){
-        window->packets[i] = NULL;
-        window->size[i] = 0;
+void free_window(window_t * window){
+    u_int32_t i;
+    for(i = 0; i < window->capacity; i++){
+        if(window->slots[i].packet != NULL){
+            release_packet(&window->pool, window->slots[i].packet);
+        }
+    }
+    free_pool(&window->pool);
+    if(window->map != NULL){
+        munmap((void *) window->map, (size_t) window->map_len);
+        window->map = NULL;
+    }
+    free(window->slots);
+    free(window->batch);
+    free(window->batch_iov);
+    free(window->read_reqs);
+    if(window->fec != NULL){
+        free_fec_encoder(window->fec);
+        free(window->fec);
+        window->fec = NULL;
+    }
+    window->slots = NULL;
+    window->read_reqs = NULL;
+    window->batch = NULL;
+    window->batch_iov = NULL;
+    window->count = 0;
+}
+
+/*******************************************************************************
+ * Reads a file (fd) into the window (window) through an io_uring (ring)
+ * shared with other windows, instead of with stdio. Reads are queued for up
+ * to READ_AHEAD packets past the last one in the window, as far as the window
+ * has room, so the disk works while packets are sent. Returns TRUE if the
+ * ring will be used, or FALSE if the ring is not in use or the file is not a
+ * regular file. Must be called before the window is first filled.
+ *
+ * @param window - The window that will send the file
+ * @param ring - The ring to read through
+ * @param fd - The file to read
+ * @return TRUE or FALSE - Whether or not the ring will be used
+ ******************************************************************************/
+bool read_with_uring(window_t * window, uring_t * ring, FILE * fd){
+    struct stat st;
+
+    if(!uring_active(ring) || fstat(fileno(fd), &st) != 0 ||
+            !S_ISREG(st.st_mode)){
+        return FALSE;
+    }
+    window->read_reqs = calloc(READ_AHEAD, sizeof(window_read_t));
+    if(window->read_reqs == NULL){
+        return FALSE;
+    }
+    window->ring = ring;
+    window->read_fd = fileno(fd);
+    window->file_size = (u_int64_t) st.st_size;
+    window->read_next = 0;
+    window->reads = 0;
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Makes the window (window) follow each block of block data packets with
+ * parity packets of a code (code), so the client can rebuild lost packets of
+ * the block without waiting for them to be resent. Parity is made as each
+ * packet is first sent, and is sent once, right after the last packet of its
+ * block. Must be called before the window is first sent.
+ *
+ * @param window - The window that will send the file
+ * @param code - FEC_XOR or FEC_RS
+ * @param block - The number of data packets per block
+ ******************************************************************************/
+void add_fec(window_t * window, u_int32_t code, u_int32_t block){
+    window->fec = malloc(sizeof(fec_encoder_t));
+    if(window->fec == NULL){
+        fprintf(stderr, "Could not allocate parity\n");
+        exit(1);
     }
-    window->head = 0;
-    window->tail = 0;
+    init_fec_encoder(window->fec, code, block, window->payload);
+}
+
+/*******************************************************************************
+ * Records the result (res) of a read queued by a window, given the user_data
+ * it was reaped with. The read is put into its window by the next
+ * fill_window. Every read must be completed before its window is freed.
+ *
+ * @param user_data - The user_data of the read
+ * @param res - The result of the read
+ ******************************************************************************/
+void complete_read(u_int64_t user_data, int res){
+    window_read_t * r = (window_read_t *) (uintptr_t) user_data;
+
+    r->len = res;
+    r->done = TRUE;
+    r->window->reads--;
 }
 
 /*******************************************************************************
  * Inserts a single packet (rudp_pkt) of a specified size (size) into the window
- * (window). Returns TRUE if successful, else FALSE.
+ * (window) at the slot for its sequence number. The caller sets the
+ * payload_check of the slot before the packet is sent. Returns TRUE if
+ * successful, else FALSE.
  *
  * @param window - The window to insert the packet into
  * @param rudp_pkt - The packet to insert
@@ -33,145 +502,542 @@ void init_window(window_t * window){
  * @return TRUE or FALSE - Whether or not insertion was successful
  ******************************************************************************/
 bool insert_packet(window_t * window, rudp_packet_t * rudp_pkt, int size){
-    if(window->tail < WINDOW_SIZE){
-        window->packets[window->tail] = rudp_pkt;
-        window->size[window->tail] = size;
-        window->tail++;
-        return TRUE;
+    u_int64_t seq_num = get_seq_num(rudp_pkt);
+    u_int64_t offset = seq_num - window->base;
+    window_slot_t * s = &window->slots[seq_num % window->capacity];
+
+    /*Packet must fall inside the window and its slot must be free*/
+    if(offset >= window->capacity || s->packet != NULL){
+        return FALSE;
     }
-    return FALSE;
+
+    s->packet = rudp_pkt;
+    s->size = size;
+    s->payload = NULL;
+    s->payload_check = 0;
+    s->sends = 0;
+    s->sent = 0;
+    s->deadline = 0;
+    window->count++;
+    if(offset >= window->next_seq - window->base){
+        window->next_seq = seq_num + 1;
+    }
+    return TRUE;
 }
 
 /*******************************************************************************
- * Fills the sliding window (window) with packets read in from a file (fd)
+ * Reads len bytes at a given offset (offset) of a file (fd) into a buffer
+ * (buf) with pread, finishing a read the io_uring could not. Bytes past the
+ * end of a file that has shrunk since it was opened are zeroed, so the
+ * packet still has the size the client was told. Returns FALSE on a read
+ * error, else TRUE.
+ *
+ * @param fd - The file to read
+ * @param buf - The buffer to read into
+ * @param len - The number of bytes to read
+ * @param offset - The offset in the file to read from
+ * @return TRUE or FALSE - Whether or not the bytes were read
+ ******************************************************************************/
+static bool read_at(int fd, unsigned char * buf, size_t len,
+                    u_int64_t offset){
+    ssize_t got;
+
+    while(len > 0){
+        got = pread(fd, buf, len, (off_t) offset);
+        if(got < 0 && errno == EINTR){
+            continue;
+        }
+        if(got < 0){
+            log_msg(LOG_ERROR, "File read error\n");
+            return FALSE;
+        }
+        if(got == 0){
+            memset(buf, 0, len);
+            return TRUE;
+        }
+        buf += got;
+        len -= (size_t) got;
+        offset += (u_int64_t) got;
+    }
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Puts every completed read of the window (window) into it, in file order,
+ * then queues reads for the packets that follow, as far as the window has
+ * room. Sets eof once the whole file has been put into the window. Returns
+ * FALSE if a packet could not be read, else TRUE.
+ *
+ * @param window - The window to fill
+ * @return TRUE or FALSE - Whether or not the file could be read
+ ******************************************************************************/
+static bool fill_from_reads(window_t * window){
+    rudp_packet_t *rudp_pkt;
+    window_read_t *r;
+    window_slot_t *s;
+    u_int64_t offset;
+    int buf_len;
+
+    while(window->next_seq != window->read_next){
+        r = &window->read_reqs[window->next_seq % READ_AHEAD];
+        if(!r->done){
+            break;
+        }
+
+        /*Every packet is full except the last one, and a failed or short
+         * read is finished with pread*/
+        rudp_pkt = r->packet;
+        r->packet = NULL;
+        offset = (u_int64_t) window->payload * window->next_seq;
+        buf_len = (int) window->payload;
+        if(window->file_size - offset < window->payload){
+            buf_len = (int) (window->file_size - offset);
+        }
+        if(r->len != buf_len &&
+                !read_at(window->read_fd, rudp_pkt->data, (size_t) buf_len,
+                         offset)){
+            release_packet(&window->pool, rudp_pkt);
+            return FALSE;
+        }
+
+        init_header(rudp_pkt, DATA_PKT, window->next_seq,
+                    (u_int16_t) buf_len);
+        set_flags(rudp_pkt, window->flags);
+        set_session(rudp_pkt, window->session);
+        s = &window->slots[window->next_seq % window->capacity];
+        insert_packet(window, rudp_pkt, buf_len + RUDP_HEAD);
+        s->payload_check = payload_check(window->flags, rudp_pkt->data,
+                                         (size_t) buf_len);
+        add_digest(window, s->payload_check, buf_len);
+    }
+
+    /*Read ahead into the free part of the window*/
+    while(window->read_next - window->base < window->capacity &&
+            window->read_next - window->next_seq < READ_AHEAD &&
+            (u_int64_t) window->payload * window->read_next <
+            window->file_size){
+        rudp_pkt = acquire_packet(&window->pool);
+        if(rudp_pkt == NULL){
+            break;
+        }
+        r = &window->read_reqs[window->read_next % READ_AHEAD];
+        r->window = window;
+        r->packet = rudp_pkt;
+        r->len = 0;
+        r->done = FALSE;
+        if(!uring_read(window->ring, window->read_fd, rudp_pkt->data,
+                       window->payload,
+                       (u_int64_t) window->payload * window->read_next,
+                       (u_int64_t) (uintptr_t) r)){
+            r->packet = NULL;
+            release_packet(&window->pool, rudp_pkt);
+            break;
+        }
+        window->reads++;
+        window->read_next++;
+    }
+
+    window->eof = window->next_seq == window->read_next &&
+                  (u_int64_t) window->payload * window->read_next >=
+                  window->file_size ? TRUE : FALSE;
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Fills the sliding window (window) with packets read in from a file (fd).
+ * If the file was mapped with map_file, each packet only gets a header that
+ * points at its data in the mapping, and the fill fails if the file has
+ * shrunk since it was mapped. If it is read with read_with_uring, the
+ * completed reads are put into the window in order and more reads are queued,
+ * to be submitted by the owner of the ring. Sets eof once the whole file has
+ * been put into the window. Returns FALSE if the file could not be read, in
+ * which case only this window's transfer should end, else TRUE.
  *
  * @param window - The window to insert packets into
  * @param fd - The file to read data and create packets from
+ * @return TRUE or FALSE - Whether or not the file could be read
  ******************************************************************************/
-void fill_window(window_t * window, FILE * fd){
-    unsigned char buffer[MAX_LINE];
+bool fill_window(window_t * window, FILE * fd){
     rudp_packet_t *rudp_pkt;
+    window_slot_t *s;
+    struct stat st;
     int buf_len;
 
-    while( window->tail < WINDOW_SIZE && !feof(fd) ){
-        buf_len = (int) fread(buffer, 1, RUDP_DATA, fd);
+    if(window->ring != NULL){
+        return fill_from_reads(window);
+    }
+
+    /*Packets of a mapped file only need a header*/
+    if(window->map != NULL){
+        while( window->next_seq - window->base < window->capacity &&
+               window->map_off < window->map_len ){
+            rudp_pkt = acquire_packet(&window->pool);
+            if(rudp_pkt == NULL){
+                break;
+            }
+            buf_len = (int) window->payload;
+            if(window->map_len - window->map_off < window->payload){
+                buf_len = (int) (window->map_len - window->map_off);
+            }
+
+            /*Only the header is filled in. Its checksum is computed as the
+             * packet is sent, from the header and the check of the data*/
+            init_header(rudp_pkt, DATA_PKT, window->next_seq,
+                        (u_int16_t) buf_len);
+            set_flags(rudp_pkt, window->flags);
+            set_session(rudp_pkt, window->session);
+            s = &window->slots[window->next_seq % window->capacity];
+            insert_packet(window, rudp_pkt, buf_len + RUDP_HEAD);
+            s->payload = window->map + window->map_off;
+            s->payload_check = payload_check(window->flags, s->payload,
+                                             (size_t) buf_len);
+            add_digest(window, s->payload_check, buf_len);
+            window->map_off += (u_int64_t) buf_len;
+        }
+        window->eof = window->map_off >= window->map_len ? TRUE : FALSE;
+
+        /*The pages past the end of a truncated file read as zeros, which
+         * must not be sent as its data*/
+        if(fstat(fileno(fd), &st) != 0 ||
+                (u_int64_t) st.st_size < window->map_len){
+            log_msg(LOG_ERROR, "File shrank while it was being sent\n");
+            return FALSE;
+        }
+        return TRUE;
+    }
 
+    while( window->next_seq - window->base < window->capacity && !feof(fd) ){
+
+        /*Read straight into a packet from the pool*/
+        rudp_pkt = acquire_packet(&window->pool);
+        if(rudp_pkt == NULL){
+            break;
+        }
+        buf_len = (int) fread(rudp_pkt->data, 1, window->payload, fd);
+
+        /*The file is closed by the owner of the window*/
         if( ferror(fd) ){
-            fprintf(stderr, "File read error\n");
-            fclose(fd);
-            exit(1);
+            log_msg(LOG_ERROR, "File read error\n");
+            release_packet(&window->pool, rudp_pkt);
+            return FALSE;
         }
 
         /*If read from file was successful*/
         if(buf_len > 0){
 
-            /*Create new RUDP packet*/
-            rudp_pkt = create_rudp_packet(buffer, (size_t) buf_len, NULL);
+            /*Fill in the header of the RUDP packet. Its checksum is
+             * computed as it is sent*/
+            init_header(rudp_pkt, DATA_PKT, window->next_seq,
+                        (u_int16_t) buf_len);
+            set_flags(rudp_pkt, window->flags);
+            set_session(rudp_pkt, window->session);
 
             /*Add packet to window*/
-            window->packets[window->tail] = rudp_pkt;
-            window->size[window->tail] = buf_len + RUDP_HEAD;
-            window->tail++;
+            s = &window->slots[window->next_seq % window->capacity];
+            insert_packet(window, rudp_pkt, buf_len + RUDP_HEAD);
+            s->payload_check = payload_check(window->flags, rudp_pkt->data,
+                                             (size_t) buf_len);
+            add_digest(window, s->payload_check, buf_len);
         }
+        else {
+            release_packet(&window->pool, rudp_pkt);
+        }
+    }
+    window->eof = feof(fd) ? TRUE : FALSE;
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Maps a file (fd) into memory as the data source of the window (window), so
+ * packets are sent straight from the mapping without copying the file into
+ * them. Returns TRUE if the file was mapped, or FALSE if it could not be, in
+ * which case fill_window reads the file with stdio instead. Pages past the
+ * end of a file truncated while it is mapped read as zeros instead of raising
+ * SIGBUS. Must be called before the window is first filled.
+ *
+ * @param window - The window that will send the file
+ * @param fd - The file to map
+ * @return TRUE or FALSE - Whether or not the file was mapped
+ ******************************************************************************/
+bool map_file(window_t * window, FILE * fd){
+    struct stat st;
+    void *map;
+
+    /*Only non-empty regular files that fit the address space can be mapped*/
+    if(fstat(fileno(fd), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 ||
+            (u_int64_t) st.st_size > SIZE_MAX){
+        return FALSE;
+    }
+
+    map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+               fileno(fd), 0);
+    if(map == MAP_FAILED){
+        return FALSE;
     }
+
+    /*The file is sent front to back, so let the kernel read ahead*/
+    madvise(map, (size_t) st.st_size, MADV_SEQUENTIAL);
+    guard_mappings();
+
+    window->map = map;
+    window->map_len = (u_int64_t) st.st_size;
+    window->map_off = 0;
+
+    /*Packets of a mapped file only hold a header*/
+    free_pool(&window->pool);
+    init_pool(&window->pool, window->capacity, (size_t) RUDP_HEAD);
+    return TRUE;
 }
 
 /*******************************************************************************
- * Processes an RUDP acknowledgement packet (rudp_ack) and removes the
- * acknowledged packet from the sliding window (window) if it is present.
- * Returns TRUE if the acknowledged packet was successfully removed, else FALSE.
+ * Removes packet seq_num from the window (window) and stops its timer, if the
+ * packet is still in the window. Returns TRUE if it was removed, else FALSE.
+ *
+ * @param window - The window to remove the packet from
+ * @param seq_num - The sequence number of the acknowledged packet
+ * @return TRUE or FALSE - Whether or not the packet was removed
+ ******************************************************************************/
+static bool remove_packet(window_t * window, u_int64_t seq_num){
+    u_int32_t slot = (u_int32_t) (seq_num % window->capacity);
+    window_slot_t * s = &window->slots[slot];
+
+    /*Ignore acknowledgements for packets outside of the window*/
+    if(seq_num - window->base >= window->next_seq - window->base){
+        return FALSE;
+    }
+
+    /*If the packet is still in the window, remove it and stop its timer*/
+    if(s->packet != NULL && get_seq_num(s->packet) == seq_num){
+        if(s->sends > 0){
+            window->in_flight--;
+            if(s->sent > window->newest_acked){
+                window->newest_acked = s->sent;
+            }
+        }
+        timer_unlink(window, slot);
+        release_packet(&window->pool, s->packet);
+        s->packet = NULL;
+        s->size = 0;
+        window->count--;
+        return TRUE;
+    }
+
+    /*Packet was already acknowledged*/
+    return FALSE;
+}
+
+/*******************************************************************************
+ * Processes an RUDP acknowledgement packet (rudp_ack) of a given size (size)
+ * and removes the acknowledged packets from the sliding window (window) if
+ * they are present. An ACK acknowledges the single packet seq_num, while a
+ * SACK acknowledges every packet before seq_num plus each packet marked in its
+ * bitmap. Packets are found directly from their sequence numbers, so the cost
+ * is O(1) per packet acknowledged. Returns the number of packets removed.
  *
  * @param window - The window too remove packets from
  * @param rudp_ack - The RUDP acknowledgement to process
- * @return TRUE or FALSE - whether or not the acknowledged packet was removed
+ * @param size - The size of the acknowledgement packet
+ * @return removed - The number of acknowledged packets removed
  ******************************************************************************/
-bool process_ack(window_t * window, rudp_packet_t * rudp_ack){
-    int i, j;
+int process_ack(window_t * window, rudp_packet_t * rudp_ack, int size){
+    u_int64_t seq, cum_ack, sack_base;
+    u_int32_t i, length;
+    int removed = 0;
 
-    /*Loop through all packets in the window*/
-    for(i = 0; i < WINDOW_SIZE; i++){
-        if(window->packets[i] == NULL)
-            continue;
+    if(get_type(rudp_ack) == ACK){
+        return remove_packet(window, get_seq_num(rudp_ack)) ? 1 : 0;
+    }
+    if(get_type(rudp_ack) != SACK){
+        return 0;
+    }
 
-        /*If the packet is found in the window, remove it*/
-        if(window->packets[i]->seq_num == rudp_ack->seq_num){
-            free(window->packets[i]);
-            window->packets[i] = NULL;
-
-            /*If this packet is at the head of the window, advance head*/
-            if(i == window->head){
-                for(j = window->head; j < WINDOW_SIZE; j++){
-                    if(window->packets[j] == NULL)
-                        window->head++;
-                    else
-                        break;
-                }
-            }
+    /*Stale ACKs may fall behind the window, and the ack point can never be
+     * past the last packet actually inserted*/
+    cum_ack = sack_base = get_seq_num(rudp_ack);
+    if((int64_t) (cum_ack - window->base) < 0){
+        cum_ack = window->base;
+    }
+    else if(cum_ack - window->base > window->next_seq - window->base){
+        cum_ack = window->next_seq;
+    }
 
-            /*Packet found*/
-            return TRUE;
+    /*Packets up to the last cumulative ack were removed by an earlier ACK*/
+    seq = window->base;
+    if(window->cum_ack - window->base <= cum_ack - window->base){
+        seq = window->cum_ack;
+    }
+    for(; seq != cum_ack; seq++){
+        removed += remove_packet(window, seq);
+    }
+    if(cum_ack - window->base > window->cum_ack - window->base){
+        window->cum_ack = cum_ack;
+    }
+
+    /*Remove each packet marked in the selective ack bitmap, which counts
+     * from the ack point the client sent, not the one clamped above*/
+    length = size > RUDP_HEAD ? (u_int32_t) (size - RUDP_HEAD) : 0;
+    if(length > SACK_BYTES){
+        length = SACK_BYTES;
+    }
+    for(i = 0; i < length * 8; i++){
+        if(rudp_ack->data[i / 8] == 0){
+            i += 7;
+            continue;
+        }
+        if(rudp_ack->data[i / 8] & 1 << i % 8){
+            removed += remove_packet(window, sack_base + 1 + i);
         }
     }
 
-    /*Made it through the window without finding the packet*/
-    return FALSE;
+    return removed;
+}
+
+/*******************************************************************************
+ * Marks packets in the window (window) as lost if a packet sent more than
+ * reorder microseconds after them has already been acknowledged, so they are
+ * resent right away instead of waiting for their timers. Since sent packets
+ * are listed in the order they were sent, only lost packets are examined.
+ * With add_fec, packets are not marked lost until their block's parity has
+ * had a chance to rebuild them. Returns the number of packets newly marked
+ * lost.
+ *
+ * @param window - The window to check
+ * @param reorder - How much reordering to tolerate (us)
+ * @return lost - The number of packets marked lost
+ ******************************************************************************/
+int detect_losses(window_t * window, u_int64_t reorder){
+    fec_encoder_t * enc = window->fec;
+    u_int32_t slot = window->timer_head;
+    window_slot_t * s;
+    int lost = 0;
+
+    while(slot != NO_SLOT &&
+            window->slots[slot].sent + reorder < window->newest_acked){
+        s = &window->slots[slot];
+
+        /*Packets of a block whose parity has not been sent yet are left for
+         * the parity to rebuild*/
+        if(enc != NULL && !enc->broken &&
+                get_seq_num(s->packet) - enc->first < enc->block){
+            slot = s->next;
+            continue;
+        }
+        if(s->deadline != 0){
+            s->deadline = 0;
+            lost++;
+        }
+        slot = s->next;
+    }
+    return lost;
 }
 
 /*******************************************************************************
  * Advances the sliding window (window) as far as possible until an
- * unacknowledged packet is encountered.
+ * unacknowledged packet is encountered. Each packet is stepped over once, so
+ * the cost is O(1) per acknowledged packet.
  *
  * @param window - The sliding to to be advanced
  ******************************************************************************/
 void advance_window(window_t * window){
-    int i;
-
-    for(i = 0; i + window->head < WINDOW_SIZE && window->head != 0; i++){
-        window->packets[i] = window->packets[window->head + i];
-        window->size[i] = window->size[window->head + i];
-
-        window->packets[window->head + i] = NULL;
-        window->size[window->head + i] = 0;
+    while(window->base != window->next_seq &&
+            window->slots[window->base % window->capacity].packet == NULL){
+        window->base++;
     }
 
-    window->tail -= window->head;
-    window->head = 0;
+    /*Packets that were acknowledged before ever being sent are skipped*/
+    if(window->next_send - window->base > window->next_seq - window->base){
+        window->next_send = window->base;
+    }
 }
 
 /*******************************************************************************
- * Sends the entire window (window) of packets to a specified destination
- * (clientaddr) over a specified socket (sockfd). Prints data about each packet
- * as it is sent.
+ * Sends the packets in the window (window) that are due to a specified
+ * destination (clientaddr) over a specified socket (sockfd). A packet is due if
+ * it has never been sent, if it was found to be lost, or if its retransmission
+ * deadline has passed without an acknowledgement. Each packet sent is given a
+ * new deadline one retransmission timeout of the RTT estimate (rtt) in the
+ * future. Packets are handed to the kernel in batches of up to BATCH_SIZE with
+ * sendmmsg. Packets of a mapped file are gathered from their header and their
+ * data in the mapping, so the file is never copied in user space. Only the
+ * header is checksummed as a packet is sent. The timeout is backed off and
+ * the congestion controller (cc) told of the loss if any timer expired. New
+ * packets are only sent while they fit in the congestion window, and all
+ * packets follow its pacing rate. With add_fec, the parity of each block
+ * follows its last packet. Prints data about each packet as it is
+ * sent. Returns the next time the window
+ * should be sent again, or 0 if it can only wait for acknowledgements.
  *
  * @param window - The sliding window to be sent
  * @param sockfd - The socket to send the packets over
  * @param clientaddr - The destination to send the packets to
+ * @param rtt - The RTT estimate of the connection
+ * @param cc - The congestion controller of the connection
+ * @return deadline - The next time the window needs to be sent (us)
  ******************************************************************************/
-void send_window(window_t * window, int sockfd, struct sockaddr* clientaddr){
-    static int bytes_sent;
-    int i;
-    bool good_checksum;
-    u_int16_t checksum;
-
-    print_window(window);
-    for(i = 0; i < WINDOW_SIZE; i++){
-        if(window->packets[i] != NULL){
-            fprintf(stdout, "\nSending %d byte packet\n", window->size[i]);
-            good_checksum = print_rudp_packet(window->packets[i]);
-            if(!good_checksum){
-                fprintf(stdout, "\t\t|-CHECKSUM CALC RESULT: 0x%04x\n",
-                        calc_checksum(window->packets[i]));
-                fprintf(stdout, "\t|-RECALCULATING CHECKSUM\n");
-                window->packets[i]->checksum = 0;
-                checksum = calc_checksum(window->packets[i]);
-                window->packets[i]->checksum = checksum;
-            }
-            sendto(sockfd, window->packets[i], (size_t) window->size[i], 0,
-                   clientaddr, sizeof(struct sockaddr));
-            bytes_sent += window->size[i] - RUDP_HEAD;
+u_int64_t send_window(window_t * window, int sockfd,
+                      struct sockaddr* clientaddr, rtt_t * rtt, cc_t * cc){
+    u_int64_t now = get_time_us();
+    u_int64_t rto, deadline;
+    u_int32_t slot;
+    window_slot_t * head;
+
+    if(log_enabled(LOG_TRACE)){
+        print_window(window);
+    }
+
+    /*A retransmission timeout (as opposed to a packet already marked lost)
+     * doubles the timeout of everything resent and signals congestion*/
+    head = window->timer_head == NO_SLOT ? NULL :
+           &window->slots[window->timer_head];
+    if(head != NULL && head->deadline != 0 && head->deadline <= now){
+        backoff_rto(rtt);
+        cc_on_loss(cc, TRUE);
+    }
+    rto = get_rto(rtt);
+
+    /*Resend lost packets and packets whose deadline has passed, oldest first*/
+    while(window->timer_head != NO_SLOT &&
+            window->slots[window->timer_head].deadline <= now &&
+            cc_can_send(cc, window->in_flight, FALSE, now)){
+        slot = window->timer_head;
+        send_slot(window, slot, sockfd, clientaddr, rto);
+        cc_on_send(cc, window->slots[slot].size, now);
+    }
+
+    /*Send packets that have not been sent yet, as the window allows*/
+    for(; window->next_send != window->next_seq; window->next_send++){
+        slot = window->next_send % window->capacity;
+        if(window->slots[slot].packet == NULL ||
+                window->slots[slot].sends != 0){
+            continue;
+        }
+        if(!cc_can_send(cc, window->in_flight, TRUE, now)){
+            break;
         }
+        send_slot(window, slot, sockfd, clientaddr, rto);
+        cc_on_send(cc, window->slots[slot].size, now);
+        window->bytes_sent +=
+                (u_int64_t) (window->slots[slot].size - RUDP_HEAD);
+        if(window->fec != NULL){
+            send_parity(window, slot, sockfd, clientaddr, cc, now);
+        }
+    }
+    flush_batch(window, sockfd);
+    log_msg(LOG_TRACE, "%llu total bytes sent\n",
+            (unsigned long long) window->bytes_sent);
+
+    /*If pacing held back a packet that was ready, wake when it may go*/
+    head = window->timer_head == NO_SLOT ? NULL :
+           &window->slots[window->timer_head];
+    if((head != NULL && head->deadline <= now) ||
+            (window->next_send != window->next_seq &&
+             window->in_flight < cc->cwnd)){
+        return cc->next_send;
     }
-    fprintf(stdout, "%d total bytes sent\n", bytes_sent);
+
+    /*Otherwise wake for the earliest timer*/
+    deadline = head == NULL ? 0 : head->deadline;
+    return deadline;
 }
 
 /*******************************************************************************
@@ -181,30 +1047,18 @@ void send_window(window_t * window, int sockfd, struct sockaddr* clientaddr){
  * @return TRUE or FALSE - Whether or not the window is empty
  ******************************************************************************/
 bool is_empty(window_t * window){
-    int i;
-    for(i = 0; i < WINDOW_SIZE; i++){
-        if(window->packets[i] != NULL)
-            return FALSE;
-    }
-    return TRUE;
+    return window->count == 0 ? TRUE : FALSE;
 }
 
 /*******************************************************************************
- * Prints the window to stderr.
+ * Prints a summary of the window to stderr.
  *
  * @param window - The window to print
  ******************************************************************************/
 void print_window(window_t * window){
-    int i;
-    fprintf(stderr, "\n|");
-    for(i = 0; i < WINDOW_SIZE; i++){
-        if(window->packets[i] != NULL){
-            fprintf(stderr, " %3d ", window->packets[i]->seq_num);
-        }
-        else{
-            fprintf(stderr, "     ");
-        }
-    }
-    fprintf(stderr, "|\n");
+    fprintf(stderr, "\n| %llu - %llu | %u of %u in flight |\n",
+            (unsigned long long) window->base,
+            (unsigned long long) window->next_seq, window->count,
+            window->capacity);
     fprintf(stderr, "---------------------------\n");
-}
\ No newline at end of file
+}
@@ -12,28 +12,169 @@
 #define PROJECT_4_WINDOW_H
 
 #include "rudp_packet.h"
+#include "rtt.h"
+#include "congestion.h"
+#include "pool.h"
+#include "uring.h"
+#include "fec.h"
 
-/*Custom struct to define a sliding window*/
+#define DEFAULT_WINDOW 4096 /*Default number of packets in the window*/
+#define MAX_WINDOW 1048576  /*Largest window that may be requested*/
+#define MAX_WINDOW_BYTES 67108864 /*Most file data held in one window*/
+
+#define NO_SLOT 0xFFFFFFFF  /*Marks the end of the retransmission list*/
+#define READ_AHEAD 64       /*Most file reads a window keeps in flight*/
+
+/*A single slot of the sliding window. Besides the packet itself, each slot
+ * carries its own retransmission timer and links into the window's list of
+ * sent packets, which is kept in the order they were (re)transmitted*/
+struct window_slot_t{
+    struct rudp_packet_t *packet;   //The packet, or NULL if slot is free
+    int size;                       //The size of the packet
+    const unsigned char *payload;   //Data in the mapped file, or NULL if the
+                                    //data is held in the packet itself
+    u_int32_t payload_check;        //payload_check of the data
+    u_int32_t sends;                //Number of times the packet was sent
+    u_int64_t sent;                 //Time of the last transmission (us)
+    u_int64_t deadline;             //Time to retransmit if not acked (us)
+    u_int32_t prev;                 //Previous slot in retransmission list
+    u_int32_t next;                 //Next slot in retransmission list
+};
+
+/*A read of the file into a packet, queued on an io_uring ahead of the window.
+ * The read of packet seq is kept at index seq % READ_AHEAD until it is put
+ * into the window*/
+struct window_read_t{
+    struct window_t *window;        //The window the read belongs to
+    struct rudp_packet_t *packet;   //The packet being read into
+    int len;                        //Result of the read
+    bool done;                      //Whether or not the read has completed
+};
+
+/*Custom struct to define a sliding window. Packets are stored in a ring buffer
+ * at index seq_num % capacity, so the window covers the sequence numbers
+ * [base, next_seq) and never holds more than capacity packets*/
 struct window_t{
-    struct rudp_packet_t *packets[WINDOW_SIZE]; //Array of pointers to packets
-    int size[WINDOW_SIZE];                      //The size of each packet
-    int head;                                   //First packet in window
-    int tail;                                   //Next available spot in window
+    struct window_slot_t *slots;    //Ring buffer of packets
+    u_int32_t capacity;             //Number of slots in the ring buffer
+    u_int32_t payload;              //Data in each packet but the last
+    u_int64_t base;                 //Sequence number of first packet in window
+    u_int64_t next_seq;             //Sequence number of next packet to insert
+    u_int64_t next_send;            //Sequence number of next unsent packet
+    u_int64_t cum_ack;              //Highest cumulative ack processed
+    u_int32_t count;                //Number of unacknowledged packets
+    u_int32_t in_flight;            //Packets sent but not acknowledged
+    u_int64_t newest_acked;         //Latest send time of an acked packet (us)
+    u_int32_t timer_head;           //Sent packet with the earliest deadline
+    u_int32_t timer_tail;           //Most recently sent packet
+    struct mmsghdr *batch;          //Packets waiting to be passed to sendmmsg
+    struct iovec *batch_iov;        //The buffer of each waiting packet
+    int batch_len;                  //Number of packets waiting
+    io_stats_t send_stats;          //Packets per sendmmsg call
+    u_int64_t bytes_sent;           //File data sent, not counting resends
+    u_int64_t retransmits;          //Packets sent more than once
+    packet_pool_t pool;             //Packets for the slots, one per slot
+    const unsigned char *map;       //Mapped file, or NULL if read with stdio
+    u_int64_t map_len;              //Size of the mapped file
+    u_int64_t map_off;              //Offset of the next packet's data
+    bool eof;                       //Whether the whole file is in the window
+    u_int8_t flags;                 //Flags of the data packets
+    u_int32_t session;              //Session of the data packets
+    u_int32_t digest;               //CRC32C of the data put in the window, if
+                                    //flags has CHECK_CRC32C
+    u_int32_t digest_shift;         //crc32c_shift of a full packet of data
+    uring_t *ring;                  //Ring the file is read through, or NULL
+    int read_fd;                    //Descriptor of the file read through ring
+    u_int64_t file_size;            //Size of the file read through ring
+    u_int64_t read_next;            //Sequence number of the next read
+    u_int32_t reads;                //Reads in flight on the ring
+    struct window_read_t *read_reqs;//Reads from next_seq to read_next
+    struct fec_encoder_t *fec;      //Parity of the blocks sent, or NULL
+    u_int64_t parity_sent;          //Parity packets sent
 };
 
 /*Typedefs*/
+typedef struct window_slot_t window_slot_t;
+typedef struct window_read_t window_read_t;
 typedef struct window_t window_t;
 
 /*******************************************************************************
- * Initializes an empty window (window)
+ * Initializes an empty window (window) able to hold capacity packets, each
+ * carrying up to payload bytes of the file. All of the packets are allocated
+ * up front in a pool owned by the window, so a transfer makes no further
+ * allocations. With large payloads the capacity is reduced so that the window
+ * never holds more than MAX_WINDOW_BYTES of data.
  *
  * @param window - The window to initialize
+ * @param capacity - The number of packets the window can hold
+ * @param payload - The size of the data segment of each packet
+ ******************************************************************************/
+void init_window(window_t * window, u_int32_t capacity, u_int32_t payload);
+
+/*******************************************************************************
+ * Frees any packets left in the window (window) and the ring buffer itself
+ *
+ * @param window - The window to free
+ ******************************************************************************/
+void free_window(window_t * window);
+
+/*******************************************************************************
+ * Maps a file (fd) into memory as the data source of the window (window), so
+ * packets are sent straight from the mapping without copying the file into
+ * them. Returns TRUE if the file was mapped, or FALSE if it could not be, in
+ * which case fill_window reads the file with stdio instead. Pages past the
+ * end of a file truncated while it is mapped read as zeros instead of raising
+ * SIGBUS. Must be called before the window is first filled.
+ *
+ * @param window - The window that will send the file
+ * @param fd - The file to map
+ * @return TRUE or FALSE - Whether or not the file was mapped
+ ******************************************************************************/
+bool map_file(window_t * window, FILE * fd);
+
+/*******************************************************************************
+ * Reads a file (fd) into the window (window) through an io_uring (ring)
+ * shared with other windows, instead of with stdio. Reads are queued for up
+ * to READ_AHEAD packets past the last one in the window, as far as the window
+ * has room, so the disk works while packets are sent. Returns TRUE if the
+ * ring will be used, or FALSE if the ring is not in use or the file is not a
+ * regular file. Must be called before the window is first filled.
+ *
+ * @param window - The window that will send the file
+ * @param ring - The ring to read through
+ * @param fd - The file to read
+ * @return TRUE or FALSE - Whether or not the ring will be used
+ ******************************************************************************/
+bool read_with_uring(window_t * window, uring_t * ring, FILE * fd);
+
+/*******************************************************************************
+ * Makes the window (window) follow each block of block data packets with
+ * parity packets of a code (code), so the client can rebuild lost packets of
+ * the block without waiting for them to be resent. Parity is made as each
+ * packet is first sent, and is sent once, right after the last packet of its
+ * block. Must be called before the window is first sent.
+ *
+ * @param window - The window that will send the file
+ * @param code - FEC_XOR or FEC_RS
+ * @param block - The number of data packets per block
  ******************************************************************************/
-void init_window(window_t * window);
+void add_fec(window_t * window, u_int32_t code, u_int32_t block);
+
+/*******************************************************************************
+ * Records the result (res) of a read queued by a window, given the user_data
+ * it was reaped with. The read is put into its window by the next
+ * fill_window. Every read must be completed before its window is freed.
+ *
+ * @param user_data - The user_data of the read
+ * @param res - The result of the read
+ ******************************************************************************/
+void complete_read(u_int64_t user_data, int res);
 
 /*******************************************************************************
  * Inserts a single packet (rudp_pkt) of a specified size (size) into the window
- * (window). Returns TRUE if successful, else FALSE.
+ * (window) at the slot for its sequence number. The caller sets the
+ * payload_check of the slot before the packet is sent. Returns TRUE if
+ * successful, else FALSE.
  *
  * @param window - The window to insert the packet into
  * @param rudp_pkt - The packet to insert
@@ -43,42 +184,88 @@ void init_window(window_t * window);
 bool insert_packet(window_t * window, rudp_packet_t * rudp_pkt, int size);
 
 /*******************************************************************************
- * Fills the sliding window (window) with packets read in from a file (fd)
+ * Fills the sliding window (window) with packets read in from a file (fd).
+ * If the file was mapped with map_file, each packet only gets a header that
+ * points at its data in the mapping, and the fill fails if the file has
+ * shrunk since it was mapped. If it is read with read_with_uring, the
+ * completed reads are put into the window in order and more reads are queued,
+ * to be submitted by the owner of the ring. The data of each packet is
+ * checksummed once here, and with CHECK_CRC32C its CRC is also added to the
+ * digest of the file. Sets eof once the whole file has been put into the
+ * window. Returns FALSE if the file could not be read, in which case only
+ * this window's transfer should end, else TRUE.
  *
  * @param window - The window to insert packets into
  * @param fd - The file to read data and create packets from
+ * @return TRUE or FALSE - Whether or not the file could be read
  ******************************************************************************/
-void fill_window(window_t * window, FILE * fd);
+bool fill_window(window_t * window, FILE * fd);
 
 /*******************************************************************************
- * Processes an RUDP acknowledgement packet (rudp_ack) and removes the
- * acknowledged packet from the sliding window (window) if it is present.
- * Returns TRUE if the acknowledged packet was successfully removed, else FALSE.
+ * Processes an RUDP acknowledgement packet (rudp_ack) of a given size (size)
+ * and removes the acknowledged packets from the sliding window (window) if
+ * they are present. An ACK acknowledges the single packet seq_num, while a
+ * SACK acknowledges every packet before seq_num plus each packet marked in its
+ * bitmap. Packets are found directly from their sequence numbers, so the cost
+ * is O(1) per packet acknowledged. Returns the number of packets removed.
  *
  * @param window - The window too remove packets from
  * @param rudp_ack - The RUDP acknowledgement to process
- * @return TRUE or FALSE - whether or not the acknowledged packet was removed
+ * @param size - The size of the acknowledgement packet
+ * @return removed - The number of acknowledged packets removed
+ ******************************************************************************/
+int process_ack(window_t * window, rudp_packet_t * rudp_ack, int size);
+
+/*******************************************************************************
+ * Marks packets in the window (window) as lost if a packet sent more than
+ * reorder microseconds after them has already been acknowledged, so they are
+ * resent right away instead of waiting for their timers. Since sent packets
+ * are listed in the order they were sent, only lost packets are examined.
+ * With add_fec, packets are not marked lost until their block's parity has
+ * had a chance to rebuild them. Returns the number of packets newly marked
+ * lost.
+ *
+ * @param window - The window to check
+ * @param reorder - How much reordering to tolerate (us)
+ * @return lost - The number of packets marked lost
  ******************************************************************************/
-bool process_ack(window_t * window, rudp_packet_t * rudp_ack);
+int detect_losses(window_t * window, u_int64_t reorder);
 
 /*******************************************************************************
  * Advances the sliding window (window) as far as possible until an
- * unacknowledged packet is encountered.
+ * unacknowledged packet is encountered. Each packet is stepped over once, so
+ * the cost is O(1) per acknowledged packet.
  *
  * @param window - The sliding to to be advanced
  ******************************************************************************/
 void advance_window(window_t * window);
 
 /*******************************************************************************
- * Sends the entire window (window) of packets to a specified destination
- * (clientaddr) over a specified socket (sockfd). Prints data about each packet
- * as it is sent.
+ * Sends the packets in the window (window) that are due to a specified
+ * destination (clientaddr) over a specified socket (sockfd). A packet is due if
+ * it has never been sent, if it was found to be lost, or if its retransmission
+ * deadline has passed without an acknowledgement. Each packet sent is given a
+ * new deadline one retransmission timeout of the RTT estimate (rtt) in the
+ * future. Packets are handed to the kernel in batches of up to BATCH_SIZE with
+ * sendmmsg. Packets of a mapped file are gathered from their header and their
+ * data in the mapping, so the file is never copied in user space. Only the
+ * header is checksummed as a packet is sent. The timeout is backed off and
+ * the congestion controller (cc) told of the loss if any timer expired. New
+ * packets are only sent while they fit in the congestion window, and all
+ * packets follow its pacing rate. With add_fec, the parity of each block
+ * follows its last packet. Prints data about each packet as it is
+ * sent. Returns the next time the window
+ * should be sent again, or 0 if it can only wait for acknowledgements.
  *
  * @param window - The sliding window to be sent
  * @param sockfd - The socket to send the packets over
  * @param clientaddr - The destination to send the packets to
+ * @param rtt - The RTT estimate of the connection
+ * @param cc - The congestion controller of the connection
+ * @return deadline - The next time the window needs to be sent (us)
  ******************************************************************************/
-void send_window(window_t * window, int sockfd, struct sockaddr* clientaddr);
+u_int64_t send_window(window_t * window, int sockfd,
+                      struct sockaddr* clientaddr, rtt_t * rtt, cc_t * cc);
 
 /*******************************************************************************
  * Checks if the sliding window is empty or not. Returns TRUE if so, else FALSE.
@@ -89,7 +276,7 @@ void send_window(window_t * window, int sockfd, struct sockaddr* clientaddr);
 bool is_empty(window_t * window);
 
 /*******************************************************************************
- * Prints the window to stderr.
+ * Prints a summary of the window to stderr.
  *
  * @param window - The window to print
  ******************************************************************************/
@@ -0,0 +1,282 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * writer.c source code
+ * @author Mark Jannenga
+ *
+ * Implements functions declared in writer.h
+ ******************************************************************************/
+
+#include "writer.h"
+#include <fcntl.h>
+#include <errno.h>
+
+/*******************************************************************************
+ * Creates the output file (filename) for a writer (writer) and allocates it at
+ * the size of the file being received (size), so its blocks do not have to be
+ * allocated as data arrives. Returns TRUE if the file was opened, else FALSE.
+ *
+ * @param writer - The writer to initialize
+ * @param filename - The name of the output file
+ * @param size - The size of the file being received
+ * @return TRUE or FALSE - Whether or not the file was opened
+ ******************************************************************************/
+bool open_writer(file_writer_t * writer, const char * filename, u_int64_t size){
+    writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(writer->fd < 0){
+        return FALSE;
+    }
+    writer->size = size;
+    writer->run_len = 0;
+    writer->run_start = 0;
+    writer->run_end = 0;
+    memset(&writer->stats, 0, sizeof(io_stats_t));
+    writer->group = 0;
+    memset(writer->pending, 0, sizeof(writer->pending));
+    writer->reqs = NULL;
+    writer->free_reqs = NULL;
+    writer->free_count = 0;
+    if(init_uring(&writer->ring)){
+        writer->reqs = malloc(sizeof(write_req_t) * URING_ENTRIES);
+        writer->free_reqs = malloc(sizeof(u_int32_t) * URING_ENTRIES);
+        if(writer->reqs == NULL || writer->free_reqs == NULL){
+            fprintf(stderr, "Could not allocate writes\n");
+            exit(1);
+        }
+        for(writer->free_count = 0; writer->free_count < URING_ENTRIES;
+                writer->free_count++){
+            writer->free_reqs[writer->free_count] = writer->free_count;
+        }
+    }
+
+    /*Reserve the blocks now. Not every file system supports this, and the
+     * length is set either way so the file ends up the right size*/
+    if(size > 0){
+        if(fallocate(writer->fd, 0, 0, (off_t) size) != 0 &&
+                errno != EOPNOTSUPP){
+            fprintf(stderr, "Could not allocate %llu bytes for %s\n",
+                    (unsigned long long) size, filename);
+        }
+        if(ftruncate(writer->fd, (off_t) size) != 0){
+            fprintf(stderr, "Could not set the size of %s\n", filename);
+        }
+    }
+    return TRUE;
+}
+
+/*******************************************************************************
+ * Writes iov_len buffers (iov) at a given offset (offset) of a file (fd) with
+ * pwritev, continuing after short writes. The iovecs are used up. Exits on a
+ * write error.
+ *
+ * @param fd - The file to write
+ * @param iov - The buffers to write
+ * @param iov_len - The number of buffers
+ * @param offset - The offset in the file to write to
+ ******************************************************************************/
+static void write_iov(int fd, struct iovec * iov, int iov_len,
+                      u_int64_t offset){
+    ssize_t written;
+
+    /*pwritev may write less than asked, so continue from where it stopped*/
+    while(iov_len > 0){
+        written = pwritev(fd, iov, iov_len, (off_t) offset);
+        if(written < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            fprintf(stderr, "File write error\n");
+            exit(1);
+        }
+        offset += (u_int64_t) written;
+        while(iov_len > 0 && (size_t) written >= iov->iov_len){
+            written -= (ssize_t) iov->iov_len;
+            iov++;
+            iov_len--;
+        }
+        if(iov_len > 0){
+            iov->iov_base = (unsigned char *) iov->iov_base + written;
+            iov->iov_len -= (size_t) written;
+        }
+    }
+}
+
+/*******************************************************************************
+ * Takes the result of every finished write of a writer (writer) from its ring.
+ * A write that failed or fell short is finished with pwritev.
+ *
+ * @param writer - The writer
+ ******************************************************************************/
+static void reap_writes(file_writer_t * writer){
+    u_int64_t user_data;
+    write_req_t * req;
+    int res;
+
+    while(uring_reap(&writer->ring, &user_data, &res)){
+        req = &writer->reqs[user_data];
+        if(res < 0){
+            res = 0;
+        }
+
+        /*Skip what was written, then write the rest*/
+        req->offset += (u_int64_t) res;
+        while(req->iov_len > 0 && (size_t) res >= req->iov[0].iov_len){
+            res -= (int) req->iov[0].iov_len;
+            memmove(req->iov, req->iov + 1,
+                    sizeof(struct iovec) * (size_t) (req->iov_len - 1));
+            req->iov_len--;
+        }
+        if(req->iov_len > 0){
+            req->iov[0].iov_base = (unsigned char *) req->iov[0].iov_base + res;
+            req->iov[0].iov_len -= (size_t) res;
+            write_iov(writer->fd, req->iov, req->iov_len, req->offset);
+        }
+
+        writer->pending[req->group]--;
+        writer->free_reqs[writer->free_count++] = (u_int32_t) user_data;
+    }
+}
+
+/*******************************************************************************
+ * Writes out the current run of the writer (writer), queuing it on the ring
+ * if there is one, and starts a new run
+ *
+ * @param writer - The writer
+ ******************************************************************************/
+static void write_run(file_writer_t * writer){
+    write_req_t * req;
+    u_int32_t index;
+
+    if(writer->run_len == 0){
+        return;
+    }
+    record_io(&writer->stats, writer->run_len);
+
+    if(!uring_active(&writer->ring)){
+        write_iov(writer->fd, writer->run, writer->run_len, writer->run_start);
+        writer->run_len = 0;
+        return;
+    }
+
+    /*Wait for a write to finish if every one is in flight*/
+    while(writer->free_count == 0){
+        uring_submit(&writer->ring, TRUE);
+        reap_writes(writer);
+    }
+    index = writer->free_reqs[--writer->free_count];
+    req = &writer->reqs[index];
+    memcpy(req->iov, writer->run, sizeof(struct iovec) *
+           (size_t) writer->run_len);
+    req->iov_len = writer->run_len;
+    req->offset = writer->run_start;
+    req->group = writer->group;
+    if(uring_writev(&writer->ring, writer->fd, req->iov, req->iov_len,
+                    req->offset, index)){
+        writer->pending[req->group]++;
+    }
+    else {
+        write_iov(writer->fd, req->iov, req->iov_len, req->offset);
+        writer->free_reqs[writer->free_count++] = index;
+    }
+    writer->run_len = 0;
+}
+
+/*******************************************************************************
+ * Adds len bytes of data (data) to be written at a given offset (offset) of the
+ * output file. Data that continues the current run is only remembered, and
+ * the run is written out when data for another part of the file arrives. The
+ * data must stay valid until flush_writer is called, or, with io_uring, until
+ * claim_buffers is next called for the current group.
+ *
+ * @param writer - The writer of the output file
+ * @param offset - The offset of the data in the file
+ * @param data - The data to write
+ * @param len - The number of bytes of data
+ ******************************************************************************/
+void write_data(file_writer_t * writer, u_int64_t offset, const void * data,
+                size_t len){
+    if(writer->run_len > 0 &&
+            (offset != writer->run_end || writer->run_len == BATCH_SIZE)){
+        write_run(writer);
+    }
+    if(writer->run_len == 0){
+        writer->run_start = offset;
+        writer->run_end = offset;
+    }
+    writer->run[writer->run_len].iov_base = (void *) data;
+    writer->run[writer->run_len].iov_len = len;
+    writer->run_len++;
+    writer->run_end += len;
+}
+
+/*******************************************************************************
+ * Writes len bytes of data (data) at a given offset (offset) of the output
+ * file right away with pwrite, apart from the run, for data that does not
+ * stay valid until the run is written, such as packets rebuilt from parity
+ *
+ * @param writer - The writer of the output file
+ * @param offset - The offset of the data in the file
+ * @param data - The data to write
+ * @param len - The number of bytes of data
+ ******************************************************************************/
+void write_now(file_writer_t * writer, u_int64_t offset, const void * data,
+               size_t len){
+    struct iovec iov;
+
+    iov.iov_base = (void *) data;
+    iov.iov_len = len;
+    record_io(&writer->stats, 1);
+    write_iov(writer->fd, &iov, 1, offset);
+}
+
+/*******************************************************************************
+ * Writes out the current run of the writer (writer) with a single pwritev, or,
+ * with io_uring, submits every write queued so far with one system call and
+ * takes the results of those that have finished, without waiting for the
+ * rest
+ *
+ * @param writer - The writer to flush
+ ******************************************************************************/
+void flush_writer(file_writer_t * writer){
+    write_run(writer);
+    uring_submit(&writer->ring, FALSE);
+    reap_writes(writer);
+}
+
+/*******************************************************************************
+ * Waits until no write in flight still reads from a group (group) of receive
+ * buffers, so the group can be received into again, and makes it the group
+ * of the data passed to write_data from now on. Returns at once if writes are
+ * not queued on an io_uring.
+ *
+ * @param writer - The writer of the output file
+ * @param group - The group of buffers, less than WRITE_GROUPS
+ ******************************************************************************/
+void claim_buffers(file_writer_t * writer, int group){
+    write_run(writer);
+    while(writer->pending[group] > 0){
+        uring_submit(&writer->ring, TRUE);
+        reap_writes(writer);
+    }
+    writer->group = group;
+}
+
+/*******************************************************************************
+ * Flushes and closes the output file of a writer (writer), waiting for every
+ * write in flight
+ *
+ * @param writer - The writer to close
+ ******************************************************************************/
+void close_writer(file_writer_t * writer){
+    int group;
+
+    for(group = 0; group < WRITE_GROUPS; group++){
+        claim_buffers(writer, group);
+    }
+    free_uring(&writer->ring);
+    free(writer->reqs);
+    free(writer->free_reqs);
+    writer->reqs = NULL;
+    writer->free_reqs = NULL;
+    close(writer->fd);
+    writer->fd = -1;
+}
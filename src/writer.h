@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * CIS 457 - Project 4: Reliable File Transfer over UDP
+ * writer.h header file
+ * @author Mark Jannenga
+ *
+ * Defines custom structs and declares functions used by the client to write
+ * received data to the output file. The file is allocated at its full size up
+ * front, and data is written with positional writes, with packets that follow
+ * one another in the file gathered into a single write. When the kernel has
+ * io_uring, the writes are queued on it and finish in the background while
+ * more packets are received.
+ ******************************************************************************/
+
+#ifndef PROJECT_4_WRITER_H
+#define PROJECT_4_WRITER_H
+
+#include "rudp_packet.h"
+#include "uring.h"
+#include <sys/uio.h>
+
+#define WRITE_GROUPS 4      /*Groups of receive buffers the client cycles
+                             *through, so writes from the buffers of one group
+                             *can finish while the others are reused*/
+
+/*A write queued on the io_uring, with its own copy of the run*/
+struct write_req_t{
+    struct iovec iov[BATCH_SIZE];   //Data being written
+    int iov_len;                    //Number of buffers
+    u_int64_t offset;               //File offset of the first buffer
+    int group;                      //Group of receive buffers it reads from
+};
+
+/*Custom struct for the output file. The run is a list of buffers that belong
+ * at consecutive offsets of the file, starting at run_start*/
+struct file_writer_t{
+    int fd;                         //The output file
+    u_int64_t size;                 //Size the file was allocated at
+    struct iovec run[BATCH_SIZE];   //Data waiting to be written
+    int run_len;                    //Number of buffers in the run
+    u_int64_t run_start;            //File offset of the first buffer
+    u_int64_t run_end;              //File offset just past the last buffer
+    io_stats_t stats;               //Packets per write
+    uring_t ring;                   //Ring writes are queued on, if in use
+    struct write_req_t *reqs;       //Writes that may be in flight
+    u_int32_t *free_reqs;           //Stack of indices of unused reqs
+    u_int32_t free_count;           //Number of unused reqs
+    int group;                      //Group of the buffers given to write_data
+    u_int32_t pending[WRITE_GROUPS];//Writes in flight from each group
+};
+
+/*Typedefs*/
+typedef struct write_req_t write_req_t;
+typedef struct file_writer_t file_writer_t;
+
+/*******************************************************************************
+ * Creates the output file (filename) for a writer (writer) and allocates it at
+ * the size of the file being received (size), so its blocks do not have to be
+ * allocated as data arrives. Writes go through an io_uring if the kernel has
+ * one to give. Returns TRUE if the file was opened, else FALSE.
+ *
+ * @param writer - The writer to initialize
+ * @param filename - The name of the output file
+ * @param size - The size of the file being received
+ * @return TRUE or FALSE - Whether or not the file was opened
+ ******************************************************************************/
+bool open_writer(file_writer_t * writer, const char * filename, u_int64_t size);
+
+/*******************************************************************************
+ * Adds len bytes of data (data) to be written at a given offset (offset) of the
+ * output file. Data that continues the current run is only remembered, and
+ * the run is written out when data for another part of the file arrives. The
+ * data must stay valid until flush_writer is called, or, with io_uring, until
+ * claim_buffers is next called for the current group.
+ *
+ * @param writer - The writer of the output file
+ * @param offset - The offset of the data in the file
+ * @param data - The data to write
+ * @param len - The number of bytes of data
+ ******************************************************************************/
+void write_data(file_writer_t * writer, u_int64_t offset, const void * data,
+                size_t len);
+
+/*******************************************************************************
+ * Writes len bytes of data (data) at a given offset (offset) of the output
+ * file right away with pwrite, apart from the run, for data that does not
+ * stay valid until the run is written, such as packets rebuilt from parity
+ *
+ * @param writer - The writer of the output file
+ * @param offset - The offset of the data in the file
+ * @param data - The data to write
+ * @param len - The number of bytes of data
+ ******************************************************************************/
+void write_now(file_writer_t * writer, u_int64_t offset, const void * data,
+               size_t len);
+
+/*******************************************************************************
+ * Writes out the current run of the writer (writer) with a single pwritev, or,
+ * with io_uring, submits every write queued so far with one system call and
+ * takes the results of those that have finished, without waiting for the
+ * rest
+ *
+ * @param writer - The writer to flush
+ ******************************************************************************/
+void flush_writer(file_writer_t * writer);
+
+/*******************************************************************************
+ * Waits until no write in flight still reads from a group (group) of receive
+ * buffers, so the group can be received into again, and makes it the group
+ * of the data passed to write_data from now on. Returns at once if writes are
+ * not queued on an io_uring.
+ *
+ * @param writer - The writer of the output file
+ * @param group - The group of buffers, less than WRITE_GROUPS
+ ******************************************************************************/
+void claim_buffers(file_writer_t * writer, int group);
+
+/*******************************************************************************
+ * Flushes and closes the output file of a writer (writer), waiting for every
+ * write in flight
+ *
+ * @param writer - The writer to close
+ ******************************************************************************/
+void close_writer(file_writer_t * writer);
+
+#endif //PROJECT_4_WRITER_H